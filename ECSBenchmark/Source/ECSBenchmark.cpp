@@ -0,0 +1,899 @@
+#include "../../GraphicsSandbox/Source/Engine/ECS.h"
+#include "../../GraphicsSandbox/Source/Engine/Components.h"
+#include "../../GraphicsSandbox/Source/Engine/TransformComponent.h"
+#include "../../GraphicsSandbox/Source/Engine/TransformStore.h"
+#include "../../GraphicsSandbox/Source/Engine/TransformHierarchy.h"
+#include "../../GraphicsSandbox/Source/Engine/JobSystem.h"
+#include "../../GraphicsSandbox/Source/Engine/AABBTree.h"
+#include "../../GraphicsSandbox/Source/Engine/MeshBVH.h"
+#include "../../GraphicsSandbox/Source/Engine/SceneSnapshot.h"
+#include "../../GraphicsSandbox/Source/Engine/Logger.h"
+#include "../../GraphicsSandbox/Source/Engine/Timer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unordered_map>
+#include <execution>
+#include <thread>
+
+#ifdef _WIN32
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/*
+* Headless benchmark for the ECS containers. It doesn't depend on
+* Vulkan/GLFW and only links ECS.cpp, TransformStore.cpp, TransformHierarchy.cpp,
+* JobSystem.cpp, AABBTree.cpp, MeshBVH.cpp, MathUtils.cpp, SceneSnapshot.cpp
+* and MappedFile.cpp.
+* Every result is written to stdout as a CSV row, diagnostics are
+* written to stderr so the output can be redirected to a file.
+* Usage: ECSBenchmark [maxEntityCount]
+*/
+
+// Engine log goes to stderr with the other diagnostics
+namespace Logger
+{
+	void Initialize() {}
+	void Debug(const std::string& str) { std::fprintf(stderr, "%s\n", str.c_str()); }
+	void Info(const std::string& str) { std::fprintf(stderr, "%s\n", str.c_str()); }
+	void Error(const std::string& str) { std::fprintf(stderr, "%s\n", str.c_str()); }
+	void Warn(const std::string& str) { std::fprintf(stderr, "%s\n", str.c_str()); }
+}
+
+struct BenchComponent
+{
+	float position[3] = { 0.0f, 0.0f, 0.0f };
+	float velocity[3] = { 1.0f, 1.0f, 1.0f };
+	uint32_t flags = 0;
+};
+
+struct BenchVelocity
+{
+	float value[3] = { 0.5f, 0.5f, 0.5f };
+};
+
+// Same layout stored in fixed size blocks
+struct ChunkedBenchComponent : BenchComponent {};
+template<> struct ecs::ComponentStorage<ChunkedBenchComponent> { using type = ecs::ChunkedStorage<ChunkedBenchComponent>; };
+
+// Reference implementation of the previous hashmap based ComponentArray
+template<typename T>
+class MapComponentArray
+{
+public:
+	T& addComponent(ecs::Entity entity) {
+		auto found = lookup_.find(entity);
+		if (found != lookup_.end())
+			return components[found->second];
+
+		lookup_[entity] = components.size();
+		components.emplace_back();
+		entities.push_back(entity);
+		return components.back();
+	}
+
+	bool removeComponent(ecs::Entity entity) {
+		auto found = lookup_.find(entity);
+		if (found != lookup_.end())
+		{
+			uint64_t index = found->second;
+			components[index] = std::move(components.back());
+			entities[index] = entities.back();
+			lookup_[entities[index]] = index;
+			lookup_.erase(entity);
+			components.pop_back();
+			entities.pop_back();
+			return true;
+		}
+		return false;
+	}
+
+	T* getComponent(ecs::Entity entity) {
+		auto found = lookup_.find(entity);
+		if (found != lookup_.end())
+			return &components[found->second];
+		return nullptr;
+	}
+
+	std::vector<ecs::Entity> entities;
+	std::vector<T> components;
+private:
+	std::unordered_map<uint32_t, uint64_t> lookup_;
+};
+
+// Peak resident set size of the process in KB
+static uint64_t GetPeakMemoryUsage()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize / 1024;
+#else
+	rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+}
+
+static void ReportHeader()
+{
+	std::printf("benchmark,variant,entities,operations,total_ms,ns_per_op,mops_per_s,peak_rss_kb\n");
+}
+
+static void Report(const char* benchmark, const char* variant, uint32_t entities, uint64_t operations, double milliseconds)
+{
+	const double nsPerOp = milliseconds * 1e6 / operations;
+	const double throughput = milliseconds > 0.0 ? operations / (milliseconds * 1e3) : 0.0;
+	std::printf("%s,%s,%u,%llu,%.3f,%.2f,%.2f,%llu\n", benchmark, variant, entities, (unsigned long long)operations,
+		milliseconds, nsPerOp, throughput, (unsigned long long)GetPeakMemoryUsage());
+	std::fflush(stdout);
+}
+
+// Prevent the compiler from removing the benchmark loop
+static volatile uint64_t gChecksum = 0;
+
+// Read only benchmarks are repeated so that the small entity count still runs long enough
+static uint32_t GetRepeatCount(uint32_t count)
+{
+	return std::max(1u, 1'000'000u / count);
+}
+
+static std::vector<ecs::Entity> CreateEntities(uint32_t count)
+{
+	std::vector<ecs::Entity> entities(count);
+	for (ecs::Entity& entity : entities)
+		entity = ecs::CreateEntity();
+	return entities;
+}
+
+// Add, random get and remove on a single component array
+template<typename ArrayType>
+void BenchmarkArray(const char* variant, const std::vector<ecs::Entity>& entities, const std::vector<ecs::Entity>& queries)
+{
+	const uint32_t count = static_cast<uint32_t>(entities.size());
+	ArrayType arr;
+	Timer timer;
+
+	timer.record();
+	for (ecs::Entity entity : entities)
+		arr.addComponent(entity).flags = entity;
+	Report("add", variant, count, count, timer.elapsedMilliseconds());
+
+	const uint32_t repeat = GetRepeatCount(count);
+	uint64_t checksum = 0;
+	timer.record();
+	for (uint32_t i = 0; i < repeat; ++i)
+	{
+		for (ecs::Entity entity : queries)
+			checksum += arr.getComponent(entity)->flags;
+	}
+	Report("random-get", variant, count, uint64_t(count) * repeat, timer.elapsedMilliseconds());
+
+	timer.record();
+	for (uint32_t i = 0; i < repeat; ++i)
+	{
+		for (auto& component : arr.components)
+		{
+			component.position[0] += component.velocity[0];
+			component.position[1] += component.velocity[1];
+			component.position[2] += component.velocity[2];
+		}
+	}
+	Report("iterate", variant, count, uint64_t(count) * repeat, timer.elapsedMilliseconds());
+	checksum += static_cast<uint64_t>(arr.components[0].position[0]);
+
+	timer.record();
+	for (ecs::Entity entity : queries)
+		arr.removeComponent(entity);
+	Report("remove", variant, count, count, timer.elapsedMilliseconds());
+
+	gChecksum += checksum;
+}
+
+void BenchmarkComponentArray(uint32_t count)
+{
+	std::vector<ecs::Entity> entities(count);
+	for (uint32_t i = 0; i < count; ++i)
+		entities[i] = i + 1;
+
+	std::mt19937 generator(count);
+	std::vector<ecs::Entity> queries = entities;
+	std::shuffle(queries.begin(), queries.end(), generator);
+
+	BenchmarkArray<MapComponentArray<BenchComponent>>("map", entities, queries);
+	BenchmarkArray<ecs::ComponentArray<BenchComponent>>("sparse", entities, queries);
+	BenchmarkArray<ecs::ComponentArray<ChunkedBenchComponent>>("chunked", entities, queries);
+}
+
+// Create entities with two components and destroy them through the ComponentManager
+void BenchmarkChurn(uint32_t count)
+{
+	const uint32_t kIterations = 4;
+	ecs::ComponentManager manager;
+	manager.RegisterComponent<BenchComponent>();
+	manager.RegisterComponent<BenchVelocity>();
+
+	std::vector<ecs::Entity> entities(count);
+	Timer timer;
+	double single = 0.0;
+	double bulk = 0.0;
+	for (uint32_t iter = 0; iter < kIterations; ++iter)
+	{
+		timer.record();
+		for (ecs::Entity& entity : entities)
+		{
+			entity = ecs::CreateEntity();
+			manager.AddComponent<BenchComponent>(entity);
+			manager.AddComponent<BenchVelocity>(entity);
+		}
+
+		// Alternate between the single and the bulk destroy
+		if (iter % 2 == 0)
+		{
+			for (ecs::Entity& entity : entities)
+				ecs::DestroyEntity(&manager, entity);
+			single += timer.elapsedMilliseconds();
+		}
+		else
+		{
+			ecs::DestroyEntities(&manager, entities.data(), count);
+			bulk += timer.elapsedMilliseconds();
+		}
+	}
+
+	Report("churn", "destroy", count, uint64_t(count) * kIterations / 2, single);
+	Report("churn", "destroy-bulk", count, uint64_t(count) * kIterations / 2, bulk);
+}
+
+// Add and remove a component through the ComponentManager in random order
+void BenchmarkAddRemove(uint32_t count)
+{
+	ecs::ComponentManager manager;
+	manager.RegisterComponent<BenchComponent>();
+
+	std::vector<ecs::Entity> entities = CreateEntities(count);
+	std::mt19937 generator(count);
+	std::vector<ecs::Entity> queries = entities;
+	std::shuffle(queries.begin(), queries.end(), generator);
+
+	Timer timer;
+	for (ecs::Entity& entity : queries)
+		manager.AddComponent<BenchComponent>(entity);
+	Report("add", "manager", count, count, timer.elapsedMilliseconds());
+
+	const uint32_t repeat = GetRepeatCount(count);
+	uint64_t checksum = 0;
+	timer.record();
+	for (uint32_t i = 0; i < repeat; ++i)
+	{
+		for (const ecs::Entity& entity : entities)
+			checksum += manager.GetComponent<BenchComponent>(entity)->flags;
+	}
+	Report("random-get", "manager", count, uint64_t(count) * repeat, timer.elapsedMilliseconds());
+
+	timer.record();
+	for (ecs::Entity& entity : entities)
+		manager.RemoveComponent<BenchComponent>(entity);
+	Report("remove", "manager", count, count, timer.elapsedMilliseconds());
+
+	ecs::DestroyEntities(&manager, entities.data(), count);
+	gChecksum += checksum;
+}
+
+template<typename Func>
+double RunJoin(uint32_t repeat, Func&& join)
+{
+	Timer timer;
+	for (uint32_t i = 0; i < repeat; ++i)
+		join();
+	return timer.elapsedMilliseconds();
+}
+
+/*
+* Iterate the entities having both components, every entity has BenchComponent
+* and half of them has BenchVelocity. Entity are added in random order so the
+* arrays are not sorted the same way.
+*/
+void BenchmarkJoin(uint32_t count)
+{
+	std::mt19937 generator(count);
+	std::vector<ecs::Entity> entities = CreateEntities(count);
+	std::vector<ecs::Entity> shuffled = entities;
+	std::shuffle(shuffled.begin(), shuffled.end(), generator);
+
+	auto createManager = [&](ecs::ComponentManager& manager) {
+		manager.RegisterComponent<BenchComponent>();
+		manager.RegisterComponent<BenchVelocity>();
+		for (ecs::Entity& entity : entities)
+			manager.AddComponent<BenchComponent>(entity);
+		for (uint32_t i = 0; i < count; i += 2)
+			manager.AddComponent<BenchVelocity>(shuffled[i]);
+	};
+
+	auto update = [](BenchComponent& component, const BenchVelocity& velocity) {
+		component.position[0] += velocity.value[0];
+		component.position[1] += velocity.value[1];
+		component.position[2] += velocity.value[2];
+	};
+
+	const uint32_t repeat = GetRepeatCount(count);
+	const uint64_t operations = uint64_t((count + 1) / 2) * repeat;
+
+	// Iterate the first array and lookup the second one
+	{
+		ecs::ComponentManager manager;
+		createManager(manager);
+		auto components = manager.GetComponentArray<BenchComponent>();
+		auto velocities = manager.GetComponentArray<BenchVelocity>();
+		double ms = RunJoin(repeat, [&]() {
+			for (uint32_t i = 0; i < components->GetCount(); ++i)
+			{
+				BenchVelocity* velocity = velocities->getComponent(components->entities[i]);
+				if (velocity)
+					update(components->components[i], *velocity);
+			}
+		});
+		Report("join", "lookup", count, operations, ms);
+	}
+
+	{
+		ecs::ComponentManager manager;
+		createManager(manager);
+		ecs::View<BenchComponent, BenchVelocity> view = manager.Query<BenchComponent, BenchVelocity>();
+		double ms = RunJoin(repeat, [&]() {
+			view.each([&](ecs::Entity, BenchComponent& component, BenchVelocity& velocity) { update(component, velocity); });
+		});
+		Report("join", "view", count, operations, ms);
+	}
+
+	{
+		ecs::ComponentManager manager;
+		createManager(manager);
+		auto group = manager.CreateGroup<BenchComponent, BenchVelocity>();
+		double ms = RunJoin(repeat, [&]() {
+			group->each([&](ecs::Entity, BenchComponent& component, BenchVelocity& velocity) { update(component, velocity); });
+		});
+		Report("join", "group", count, operations, ms);
+	}
+
+	// Release the entity indices, the components are already gone with the managers
+	ecs::ComponentManager manager;
+	ecs::DestroyEntities(&manager, entities.data(), count);
+}
+
+/*
+* Propagate the world matrix from the root like Scene::UpdateHierarchy,
+* the tree has a fixed branching factor and the components are added in
+* random order.
+*/
+void BenchmarkHierarchy(uint32_t count)
+{
+	const uint32_t kBranching = 4;
+	ecs::ComponentManager manager;
+	manager.RegisterComponent<TransformComponent>();
+	manager.RegisterComponent<HierarchyComponent>();
+
+	std::vector<ecs::Entity> entities = CreateEntities(count);
+	std::vector<uint32_t> order(count);
+	for (uint32_t i = 0; i < count; ++i)
+		order[i] = i;
+	std::mt19937 generator(count);
+	std::shuffle(order.begin(), order.end(), generator);
+
+	for (uint32_t index : order)
+	{
+		TransformComponent& transform = manager.AddComponent<TransformComponent>(entities[index]);
+		transform.position = glm::vec3(1.0f, 0.0f, 0.0f);
+		transform.CalculateWorldMatrix();
+
+		HierarchyComponent& hierarchy = manager.AddComponent<HierarchyComponent>(entities[index]);
+		if (index > 0)
+			hierarchy.parent = entities[(index - 1) / kBranching];
+		for (uint32_t child = index * kBranching + 1; child <= index * kBranching + kBranching && child < count; ++child)
+			hierarchy.childrens.push_back(entities[child]);
+	}
+
+	auto transforms = manager.GetComponentArray<TransformComponent>();
+	auto hierarchies = manager.GetComponentArray<HierarchyComponent>();
+
+	auto updateChildren = [&](auto& self, ecs::Entity entity, const glm::mat4& parentTransform) -> void {
+		TransformComponent* transform = transforms->getComponent(entity);
+		transform->worldMatrix = parentTransform * transform->localMatrix;
+
+		HierarchyComponent* hierarchy = hierarchies->getComponent(entity);
+		for (ecs::Entity child : hierarchy->childrens)
+			self(self, child, transform->worldMatrix);
+	};
+
+	const uint32_t repeat = std::max(1u, GetRepeatCount(count) / 10);
+	Timer timer;
+	for (uint32_t iter = 0; iter < repeat; ++iter)
+	{
+		for (uint32_t i = 0; i < hierarchies->GetCount(); ++i)
+		{
+			const HierarchyComponent& hierarchy = hierarchies->components[i];
+			if (hierarchy.parent == ecs::INVALID_ENTITY && hierarchy.childrens.size() > 0)
+				updateChildren(updateChildren, hierarchies->entities[i], glm::mat4(1.0f));
+		}
+	}
+	Report("hierarchy", "recursive", count, uint64_t(count) * repeat, timer.elapsedMilliseconds());
+
+	// Same walk on the depth sorted hierarchy, moving the root dirties the whole tree
+	TransformStore store;
+	for (uint32_t i = 0; i < transforms->GetCount(); ++i)
+		store.Add(transforms->entities[i], transforms->components[i]);
+	store.Update();
+
+	TransformHierarchy hierarchy;
+	hierarchy.Build(hierarchies, store);
+	hierarchy.Update(store);
+
+	const ecs::Entity root = entities[0];
+	timer.record();
+	for (uint32_t iter = 0; iter < repeat; ++iter)
+	{
+		store.Set(root, *transforms->getComponent(root));
+		store.Update();
+		hierarchy.Update(store);
+	}
+	Report("hierarchy", "flattened", count, uint64_t(count) * repeat, timer.elapsedMilliseconds());
+
+	// Moving a leaf only updates its own node
+	const ecs::Entity leaf = entities.back();
+	timer.record();
+	for (uint32_t iter = 0; iter < repeat; ++iter)
+	{
+		store.Set(leaf, *transforms->getComponent(leaf));
+		store.Update();
+		hierarchy.Update(store);
+	}
+	Report("hierarchy", "flattened-leaf", count, repeat, timer.elapsedMilliseconds());
+
+	float maxError = 0.0f;
+	const glm::mat4* worldMatrices = store.GetWorldMatrices();
+	for (uint32_t i = 0; i < transforms->GetCount(); ++i)
+	{
+		const glm::mat4& lhs = transforms->components[i].worldMatrix;
+		const glm::mat4& rhs = worldMatrices[store.GetSlot(transforms->entities[i])];
+		for (int c = 0; c < 4; ++c)
+			for (int r = 0; r < 4; ++r)
+				maxError = std::max(maxError, std::abs(lhs[c][r] - rhs[c][r]));
+	}
+	std::fprintf(stderr, "hierarchy %u levels: %u max error: %g\n", count, hierarchy.GetLevelCount(), maxError);
+
+	// Deepest node should be translated once per level
+	gChecksum += static_cast<uint64_t>(manager.GetComponent<TransformComponent>(entities.back())->worldMatrix[3][0]);
+	ecs::DestroyEntities(&manager, entities.data(), count);
+}
+
+// Compare the AoS TransformComponent update with the SoA TransformStore
+void BenchmarkTransforms(uint32_t count)
+{
+	const uint32_t kIterations = 20;
+	std::mt19937 generator(count);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+	std::vector<TransformComponent> transforms(count);
+	TransformStore store;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		TransformComponent& transform = transforms[i];
+		transform.position = glm::vec3(distribution(generator), distribution(generator), distribution(generator)) * 100.0f;
+		glm::quat rotation(distribution(generator), distribution(generator), distribution(generator), distribution(generator));
+		transform.rotation = glm::normalize(rotation);
+		transform.scale = glm::vec3(distribution(generator) + 2.0f);
+		store.Add(i + 1, transform);
+	}
+
+	Timer timer;
+	double aos = 0.0;
+	for (uint32_t iter = 0; iter < kIterations; ++iter)
+	{
+		for (auto& transform : transforms)
+			transform.dirty = true;
+
+		timer.record();
+		std::for_each(std::execution::par, transforms.begin(), transforms.end(), [](TransformComponent& transform) {
+			transform.CalculateWorldMatrix();
+		});
+		aos += timer.elapsedMilliseconds();
+	}
+
+	double soa = 0.0;
+	for (uint32_t iter = 0; iter < kIterations; ++iter)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+			store.Set(i + 1, transforms[i]);
+
+		timer.record();
+		store.Update();
+		soa += timer.elapsedMilliseconds();
+	}
+
+	// Both path should produce the same matrix
+	float maxError = 0.0f;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const glm::mat4& lhs = transforms[i].localMatrix;
+		const glm::mat4& rhs = store.GetLocalMatrix(store.GetSlot(i + 1));
+		for (int c = 0; c < 4; ++c)
+			for (int r = 0; r < 4; ++r)
+				maxError = std::max(maxError, std::abs(lhs[c][r] - rhs[c][r]));
+	}
+
+	Report("transform", "aos-par", count, uint64_t(count) * kIterations, aos);
+	Report("transform", "soa-sse", count, uint64_t(count) * kIterations, soa);
+	std::fprintf(stderr, "transform %u max error: %g\n", count, maxError);
+}
+
+// Same transform update with 1, 2, 4 ... N job system threads
+void BenchmarkJobScaling(uint32_t count)
+{
+	const uint32_t kIterations = 20;
+	std::mt19937 generator(count);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+	std::vector<TransformComponent> transforms(count);
+	TransformStore store;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		TransformComponent& transform = transforms[i];
+		transform.position = glm::vec3(distribution(generator), distribution(generator), distribution(generator)) * 100.0f;
+		transform.rotation = glm::normalize(glm::quat(distribution(generator), distribution(generator), distribution(generator), distribution(generator)));
+		store.Add(i + 1, transform);
+	}
+
+	const uint32_t maxThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<JobSystem::WorkerStats> stats;
+	Timer timer;
+	for (uint32_t threadCount = 1; ; threadCount = std::min(threadCount * 2, maxThreadCount))
+	{
+		JobSystem::Initialize(threadCount - 1);
+
+		double elapsed = 0.0;
+		for (uint32_t iter = 0; iter < kIterations; ++iter)
+		{
+			for (uint32_t i = 0; i < count; ++i)
+				store.Set(i + 1, transforms[i]);
+
+			timer.record();
+			store.Update();
+			elapsed += timer.elapsedMilliseconds();
+		}
+
+		char variant[32];
+		std::snprintf(variant, sizeof(variant), "threads-%u", threadCount);
+		Report("job-scaling", variant, count, uint64_t(count) * kIterations, elapsed);
+
+		// Share of the update executed by each thread
+		JobSystem::GetStatistics(stats);
+		double busyTime = 0.0;
+		for (const auto& stat : stats)
+			busyTime += stat.busyTime;
+		for (uint32_t i = 0; i < stats.size() && busyTime > 0.0; ++i)
+			std::fprintf(stderr, "job-scaling %u threads-%u worker %u: %.1f%% jobs %u steals %u\n", count, threadCount, i, stats[i].busyTime / busyTime * 100.0, stats[i].jobCount, stats[i].stealCount);
+
+		if (threadCount == maxThreadCount)
+			break;
+	}
+	JobSystem::Initialize();
+}
+
+// Per frame frustum cull of the world bounds, linear test of every box against the tree query
+void BenchmarkCulling(uint32_t count)
+{
+	const uint32_t kIterations = 20;
+	const float kWorldSize = 1000.0f;
+	std::mt19937 generator(count);
+	std::uniform_real_distribution<float> position(-kWorldSize * 0.5f, kWorldSize * 0.5f);
+	std::uniform_real_distribution<float> size(0.5f, 4.0f);
+	std::uniform_real_distribution<float> velocity(-1.0f, 1.0f);
+
+	std::vector<BoundingBox> boxes(count);
+	for (BoundingBox& box : boxes)
+	{
+		const glm::vec3 center(position(generator), position(generator), position(generator));
+		const glm::vec3 extent(size(generator), size(generator), size(generator));
+		box = BoundingBox(center - extent, center + extent);
+	}
+
+	AABBTree tree;
+	Timer timer;
+	std::vector<uint32_t> proxies(count);
+	for (uint32_t i = 0; i < count; ++i)
+		proxies[i] = tree.Insert(boxes[i], i);
+	const double build = timer.elapsedMilliseconds();
+
+	// Camera in the middle of the world turning around the y axis
+	auto createFrustum = [](uint32_t frame) {
+		const float angle = frame * 0.3f;
+		const glm::mat4 P = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+		const glm::mat4 V = glm::lookAt(glm::vec3(0.0f), glm::vec3(std::cos(angle), 0.0f, std::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+		const glm::mat4 VP = glm::transpose(P * V);
+
+		Frustum frustum;
+		frustum.planes[Frustum::PLANE::Left] = Plane(VP[3] + VP[0]);
+		frustum.planes[Frustum::PLANE::Right] = Plane(VP[3] - VP[0]);
+		frustum.planes[Frustum::PLANE::Bottom] = Plane(VP[3] + VP[1]);
+		frustum.planes[Frustum::PLANE::Top] = Plane(VP[3] - VP[1]);
+		frustum.planes[Frustum::PLANE::Near] = Plane(VP[3] + VP[2]);
+		frustum.planes[Frustum::PLANE::Far] = Plane(VP[3] - VP[2]);
+		return frustum;
+	};
+
+	std::vector<uint32_t> linearVisible;
+	std::vector<uint32_t> treeVisible;
+	double linear = 0.0;
+	double query = 0.0;
+	double update = 0.0;
+	uint64_t visibleCount = 0;
+	uint32_t mismatch = 0;
+	for (uint32_t iter = 0; iter < kIterations; ++iter)
+	{
+		// A hundredth of the objects moves every frame
+		timer.record();
+		for (uint32_t i = iter; i < count; i += 100)
+		{
+			const glm::vec3 delta(velocity(generator), velocity(generator), velocity(generator));
+			boxes[i].min += delta;
+			boxes[i].max += delta;
+			tree.Update(proxies[i], boxes[i]);
+		}
+		update += timer.elapsedMilliseconds();
+
+		Frustum frustum = createFrustum(iter);
+
+		timer.record();
+		linearVisible.clear();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (frustum.Intersect(boxes[i]))
+				linearVisible.push_back(i);
+		}
+		linear += timer.elapsedMilliseconds();
+
+		timer.record();
+		treeVisible.clear();
+		tree.QueryFrustum(frustum, [&](uint32_t index) { treeVisible.push_back(index); });
+		query += timer.elapsedMilliseconds();
+
+		// Tree reports the enlarged boxes so it is a superset of the linear result
+		std::sort(treeVisible.begin(), treeVisible.end());
+		for (uint32_t index : linearVisible)
+			mismatch += std::binary_search(treeVisible.begin(), treeVisible.end(), index) ? 0 : 1;
+		visibleCount += treeVisible.size();
+	}
+
+	Report("cull", "linear", count, uint64_t(count) * kIterations, linear);
+	Report("cull", "aabb-tree", count, uint64_t(count) * kIterations, query);
+	Report("cull", "aabb-tree-update", count, uint64_t(count / 100) * kIterations, update);
+	gChecksum += visibleCount;
+	std::fprintf(stderr, "cull %u build %.3fms height %u area ratio %.1f visible %.1f%% missing %u\n", count, build,
+		tree.GetHeight(), tree.GetAreaRatio(), visibleCount * 100.0 / (double(count) * kIterations), mismatch);
+}
+
+// Closest hit of the rays against instances of a sphere mesh, same path as Scene::RayCast
+void BenchmarkRayCast(uint32_t count)
+{
+	const uint32_t kRayCount = 200;
+	const uint32_t kSegments = 64;
+	const float kWorldSize = 1000.0f;
+
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	for (uint32_t ring = 0; ring <= kSegments; ++ring)
+	{
+		const float theta = glm::pi<float>() * ring / kSegments;
+		for (uint32_t segment = 0; segment <= kSegments; ++segment)
+		{
+			const float phi = 2.0f * glm::pi<float>() * segment / kSegments;
+			positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+		}
+	}
+	for (uint32_t ring = 0; ring < kSegments; ++ring)
+	{
+		for (uint32_t segment = 0; segment < kSegments; ++segment)
+		{
+			const uint32_t i0 = ring * (kSegments + 1) + segment;
+			const uint32_t i1 = i0 + kSegments + 1;
+			indices.insert(indices.end(), { i0, i0 + 1, i1, i1, i0 + 1, i1 + 1 });
+		}
+	}
+
+	Timer timer;
+	MeshBVH meshBVH;
+	meshBVH.Build(&positions[0].x, sizeof(glm::vec3), static_cast<uint32_t>(positions.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+	const double build = timer.elapsedMilliseconds();
+
+	std::mt19937 generator(count);
+	std::uniform_real_distribution<float> position(-kWorldSize * 0.5f, kWorldSize * 0.5f);
+	std::uniform_real_distribution<float> scale(0.5f, 4.0f);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+	std::vector<glm::mat4> invWorldMatrices(count);
+	std::vector<BoundingBox> boxes(count);
+	AABBTree tree;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const glm::mat4 world = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(position(generator), position(generator), position(generator))), glm::vec3(scale(generator)));
+		invWorldMatrices[i] = glm::inverse(world);
+		boxes[i] = meshBVH.GetBounds();
+		boxes[i].Transform(world);
+		tree.Insert(boxes[i], i);
+	}
+
+	std::vector<Ray> rays(kRayCount);
+	for (Ray& ray : rays)
+		ray = Ray(glm::vec3(position(generator), position(generator), position(generator)), glm::normalize(glm::vec3(direction(generator), direction(generator), direction(generator))));
+
+	auto testMesh = [&](const Ray& ray, uint32_t index, float maxDistance) {
+		const Ray localRay(glm::vec3(invWorldMatrices[index] * glm::vec4(ray.origin, 1.0f)), glm::vec3(invWorldMatrices[index] * glm::vec4(ray.direction, 0.0f)));
+		MeshBVH::Hit hit;
+		return meshBVH.RayCast(localRay, maxDistance, hit) ? hit.distance : maxDistance;
+	};
+
+	double linear = 0.0;
+	double query = 0.0;
+	uint32_t hitCount = 0;
+	uint32_t mismatch = 0;
+	for (const Ray& ray : rays)
+	{
+		timer.record();
+		float linearDistance = FLT_MAX;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			float tNear = 0.0f;
+			if (IntersectRayAABB(ray, boxes[i], linearDistance, tNear))
+				linearDistance = testMesh(ray, i, linearDistance);
+		}
+		linear += timer.elapsedMilliseconds();
+
+		timer.record();
+		float treeDistance = FLT_MAX;
+		tree.QueryRay(ray, FLT_MAX, [&](uint32_t index, float maxDistance) {
+			treeDistance = std::min(treeDistance, testMesh(ray, index, maxDistance));
+			return treeDistance;
+			});
+		query += timer.elapsedMilliseconds();
+
+		hitCount += treeDistance < FLT_MAX ? 1 : 0;
+		mismatch += linearDistance == treeDistance ? 0 : 1;
+	}
+
+	Report("raycast", "linear-bounds", count, kRayCount, linear);
+	Report("raycast", "aabb-tree", count, kRayCount, query);
+	gChecksum += hitCount;
+	std::fprintf(stderr, "raycast %u mesh %u triangles %u nodes build %.3fms hits %u mismatch %u\n", count,
+		meshBVH.GetTriangleCount(), meshBVH.GetNodeCount(), build, hitCount, mismatch);
+}
+
+// Mesh renderers reference the primitive stored in meshletOffset of a single source
+class BenchSnapshotResolver : public SceneSnapshot::Resolver
+{
+public:
+	std::string GetTextureName(uint32_t texture) override { return "texture" + std::to_string(texture); }
+
+	bool FindMeshPrimitive(const MeshRenderer& meshRenderer, uint32_t& source, uint32_t& primitive) override
+	{
+		source = 0;
+		primitive = meshRenderer.meshletOffset;
+		return true;
+	}
+
+	const SceneSnapshot::MeshSource& GetMeshSource(uint32_t source) override { return mSource; }
+
+	uint32_t LoadTexture(const std::string& name) override { return std::stoul(name.substr(7)); }
+
+	void LoadMeshSource(uint32_t index, const SceneSnapshot::MeshSource& source) override {}
+
+	bool SetMeshGeometry(uint32_t source, uint32_t primitive, MeshRenderer& meshRenderer) override
+	{
+		meshRenderer.meshletOffset = primitive;
+		return true;
+	}
+
+private:
+	SceneSnapshot::MeshSource mSource = { "mesh.gltf", {} };
+};
+
+/*
+* Save and load the components of the scene entities, every entity has a
+* transform, a name and a hierarchy, the mesh renderers and the materials
+* are on half of them.
+*/
+void BenchmarkSnapshot(uint32_t count)
+{
+	const uint32_t kBranching = 4;
+	const char* filename = "ECSBenchmark.snapshot";
+
+	auto registerComponents = [](ecs::ComponentManager& manager) {
+		manager.RegisterComponent<TransformComponent>();
+		manager.RegisterComponent<LightComponent>();
+		manager.RegisterComponent<MaterialComponent>();
+		manager.RegisterComponent<MeshRenderer>();
+		manager.RegisterComponent<NameComponent>();
+		manager.RegisterComponent<HierarchyComponent>();
+	};
+
+	ecs::ComponentManager manager;
+	registerComponents(manager);
+	std::vector<ecs::Entity> entities = CreateEntities(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		ecs::Entity entity = entities[i];
+		TransformComponent& transform = manager.AddComponent<TransformComponent>(entity);
+		transform.position = glm::vec3(float(i), 0.0f, 0.0f);
+		manager.AddComponent<NameComponent>(entity).name = "Entity" + std::to_string(i);
+
+		HierarchyComponent& hierarchy = manager.AddComponent<HierarchyComponent>(entity);
+		if (i > 0)
+			hierarchy.parent = entities[(i - 1) / kBranching];
+		for (uint32_t child = i * kBranching + 1; child <= i * kBranching + kBranching && child < count; ++child)
+			hierarchy.childrens.push_back(entities[child]);
+
+		if (i % 2 == 0)
+		{
+			manager.AddComponent<MeshRenderer>(entity).meshletOffset = i % 64;
+			manager.AddComponent<MaterialComponent>(entity).albedoMap = i % 16;
+		}
+		else if (i % 100 == 1)
+			manager.AddComponent<LightComponent>(entity);
+	}
+
+	BenchSnapshotResolver resolver;
+	Timer timer;
+	const bool saved = SceneSnapshot::Save(filename, manager, resolver);
+	Report("snapshot", "save", count, count, timer.elapsedMilliseconds());
+
+	ecs::ComponentManager loadedManager;
+	registerComponents(loadedManager);
+	std::vector<ecs::Entity> loaded;
+	timer.record();
+	const bool valid = saved && SceneSnapshot::Load(filename, loadedManager, resolver, &loaded);
+	Report("snapshot", "load", count, count, timer.elapsedMilliseconds());
+
+	uint64_t checksum = 0;
+	auto meshRenderers = loadedManager.GetComponentArray<MeshRenderer>();
+	for (uint32_t i = 0; i < meshRenderers->GetCount(); ++i)
+		checksum += meshRenderers->components[i].meshletOffset;
+	gChecksum += checksum;
+	std::fprintf(stderr, "snapshot %u loaded %zu entities %u hierarchies %u\n", count, valid ? loaded.size() : 0,
+		loadedManager.GetComponentArray<TransformComponent>()->GetCount(), loadedManager.GetComponentArray<HierarchyComponent>()->GetCount());
+
+	std::remove(filename);
+	ecs::DestroyEntities(&loadedManager, loaded.data(), static_cast<uint32_t>(loaded.size()));
+	ecs::DestroyEntities(&manager, entities.data(), count);
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t maxEntityCount = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1'000'000;
+
+	JobSystem::Initialize();
+	ReportHeader();
+
+	const uint32_t entityCounts[] = { 1'000, 10'000, 100'000, 1'000'000 };
+	for (uint32_t count : entityCounts)
+	{
+		if (count > maxEntityCount)
+			break;
+
+		BenchmarkComponentArray(count);
+		BenchmarkAddRemove(count);
+		BenchmarkChurn(count);
+		BenchmarkJoin(count);
+		BenchmarkHierarchy(count);
+		BenchmarkTransforms(count);
+		BenchmarkJobScaling(count);
+		BenchmarkCulling(count);
+		BenchmarkRayCast(count);
+		BenchmarkSnapshot(count);
+	}
+
+	std::fprintf(stderr, "checksum: %llu\n", (unsigned long long)gChecksum);
+	JobSystem::Shutdown();
+	return 0;
+}
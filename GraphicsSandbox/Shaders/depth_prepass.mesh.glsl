@@ -21,6 +21,11 @@ layout(binding = 1) readonly buffer Vertices {
    Vertex aVertices[];
 };
 
+// Same buffer for the meshes with compact vertices
+layout(binding = 1) readonly buffer CompactVertices {
+   uvec4 aCompactVertices[];
+};
+
 layout(binding = 2) readonly buffer TransformData
 {
    mat4 aTransformData[];
@@ -42,13 +47,27 @@ layout(binding = 6) readonly buffer MeshletTrianglesData {
   uint8_t meshletTriangles[];
 };
 
+layout(binding = 7) readonly buffer InstanceData {
+  PerObjectData aInstanceData[];
+};
+
+layout(binding = 8) readonly buffer MeshDrawBuffer {
+  MeshDrawData aMeshDraws[];
+};
+
+taskNV in Task {
+  uint instanceIndex;
+  uint meshletIndices[TASK_GROUP_SIZE];
+} IN;
+
 void main() {
 
     uint ti = gl_LocalInvocationID.x;
-    uint mi = gl_WorkGroupID.x;
 
+    // Meshlets that passed the culling of the task shader
     MeshDrawCommand drawCommand = drawCommands[gl_DrawIDARB];
-    uint drawId = drawCommand.drawId;
+    uint mi = IN.meshletIndices[gl_WorkGroupID.x];
+    PerObjectData instance = aInstanceData[IN.instanceIndex];
 
     uint vertexCount = meshlets[mi].vertexCount;
     uint triangleCount = meshlets[mi].triangleCount;
@@ -58,13 +77,20 @@ void main() {
     uint indexCount = triangleCount * 3;
     uint globalVBOffset = drawCommand.vertexOffset;
 
-    mat4 modelMatrix = aTransformData[drawId];
+    uint di = instance.drawIndex;
+    bool compact = aMeshDraws[di].vertexFormat == VERTEX_FORMAT_COMPACT;
+    vec3 positionOffset = aMeshDraws[di].positionOffset.xyz;
+    vec3 positionScale = aMeshDraws[di].positionScale.xyz;
+
+    mat4 modelMatrix = aTransformData[instance.transformIndex];
     for(uint i = ti; i < vertexCount; i+= LOCAL_SIZE)
     {
-        uint vi = meshletVertices[vertexOffset + i];
-        Vertex vertex = aVertices[vi + globalVBOffset];
-
-        vec3 position = vec3(vertex.px, vertex.py, vertex.pz);
+        uint vi = meshletVertices[vertexOffset + i] + globalVBOffset;
+        vec3 position;
+        if(compact)
+            position = DecodeCompactPosition(aCompactVertices[vi], positionOffset, positionScale);
+        else
+            position = vec3(aVertices[vi].px, aVertices[vi].py, aVertices[vi].pz);
         vec4 wP =  modelMatrix *  vec4(position, 1.0);
         gl_MeshVerticesNV[i].gl_Position = globalData.VP * wP;
     }
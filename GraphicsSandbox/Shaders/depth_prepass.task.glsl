@@ -0,0 +1,83 @@
+#version 450
+
+#extension GL_EXT_shader_16bit_storage : require
+#extension GL_EXT_shader_8bit_storage : require
+#extension GL_NV_mesh_shader : require 
+#extension GL_GOOGLE_include_directive : require
+#extension GL_ARB_shader_draw_parameters : require
+
+#include "meshdata.glsl"
+#include "globaldata.glsl"
+
+layout(local_size_x = TASK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+layout(binding = 0) uniform readonly Globals {
+    GlobalData globalData;
+};
+
+layout(binding = 2) readonly buffer TransformData
+{
+   mat4 aTransformData[];
+};
+
+layout(binding = 3) readonly buffer DrawCommands {
+   MeshDrawCommand drawCommands[];
+};
+
+layout(binding = 4) readonly buffer MeshletData {
+  Meshlet meshlets[];
+};
+
+layout(binding = 7) readonly buffer InstanceData {
+  PerObjectData aInstanceData[];
+};
+
+layout(binding = 8) readonly buffer MeshDrawBuffer {
+  MeshDrawData aMeshDraws[];
+};
+
+layout(binding = 9) buffer MeshletStatistics {
+  uint culledMeshletCount;
+};
+
+taskNV out Task {
+  uint instanceIndex;
+  uint meshletIndices[TASK_GROUP_SIZE];
+} OUT;
+
+shared uint visibleMeshletCount;
+
+void main() {
+  uint ti = gl_LocalInvocationID.x;
+
+  // Each visible instance adds one task per TASK_GROUP_SIZE meshlets of the LOD of the draw
+  MeshDrawCommand drawCommand = drawCommands[gl_DrawIDARB];
+  uint lod = gl_DrawIDARB % MAX_LODS;
+  uint meshletCount = aMeshDraws[drawCommand.drawId].lods[lod].meshletCount;
+  uint taskCount = drawCommand.taskCount / drawCommand.instanceCount;
+  uint task = gl_WorkGroupID.x - drawCommand.firstTask;
+  uint instanceIndex = drawCommand.firstInstance + task / taskCount;
+  uint firstMeshlet = (task % taskCount) * TASK_GROUP_SIZE;
+  uint mi = drawCommand.firstTask + firstMeshlet + ti;
+
+  if(ti == 0)
+    visibleMeshletCount = 0;
+  barrier();
+
+  bool visible = firstMeshlet + ti < meshletCount;
+  if(visible) {
+    mat4 modelMatrix = aTransformData[aInstanceData[instanceIndex].transformIndex];
+    visible = IsMeshletVisible(meshlets[mi], modelMatrix, globalData.VP, globalData.cameraPosition);
+  }
+
+  // Survivors are compacted to the front of the payload
+  if(visible)
+    OUT.meshletIndices[atomicAdd(visibleMeshletCount, 1)] = mi;
+  barrier();
+
+  if(ti == 0) {
+    OUT.instanceIndex = instanceIndex;
+    gl_TaskCountNV = visibleMeshletCount;
+    atomicAdd(culledMeshletCount, min(meshletCount - firstMeshlet, TASK_GROUP_SIZE) - visibleMeshletCount);
+  }
+}
@@ -1,7 +1,6 @@
 #version 460
 
 #extension GL_GOOGLE_include_directive: require
-#extension GL_ARB_shader_draw_parameters: require
 
 #include "meshdata.glsl"
 #include "globaldata.glsl"
@@ -17,23 +16,36 @@ layout(binding = 1) readonly buffer Vertices
    Vertex aVertices[];
 };
 
+// Same buffer for the meshes with compact vertices
+layout(binding = 1) readonly buffer CompactVertices
+{
+   uvec4 aCompactVertices[];
+};
+
 layout(binding = 2) readonly buffer TransformData
 {
    mat4 aTransformData[];
 };
 
-layout(binding = 3) readonly buffer DrawCommands {
-   MeshDrawCommand drawCommands[];
+// Visible instances compacted by the cull pass from the firstInstance of each draw
+layout(binding = 3) readonly buffer InstanceData {
+   PerObjectData aInstanceData[];
+};
+
+layout(binding = 4) readonly buffer MeshDrawBuffer {
+   MeshDrawData aMeshDraws[];
 };
 
 void main()
 {
-   MeshDrawCommand drawCommand = drawCommands[gl_DrawIDARB];
-   uint drawId = drawCommand.drawId;
-
-   Vertex vertex = aVertices[gl_VertexIndex]; 
-
-   vec3 position = vec3(vertex.px, vertex.py, vertex.pz);
-   mat4 worldMatrix = aTransformData[drawId];
+   PerObjectData instance = aInstanceData[gl_InstanceIndex];
+
+   uint di = instance.drawIndex;
+   vec3 position;
+   if(aMeshDraws[di].vertexFormat == VERTEX_FORMAT_COMPACT)
+      position = DecodeCompactPosition(aCompactVertices[gl_VertexIndex], aMeshDraws[di].positionOffset.xyz, aMeshDraws[di].positionScale.xyz);
+   else
+      position = vec3(aVertices[gl_VertexIndex].px, aVertices[gl_VertexIndex].py, aVertices[gl_VertexIndex].pz);
+   mat4 worldMatrix = aTransformData[instance.transformIndex];
    gl_Position = globalData.VP * worldMatrix * vec4(position, 1.0);
 }
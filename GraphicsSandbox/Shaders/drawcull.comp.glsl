@@ -6,10 +6,18 @@ layout(local_size_x = 32, local_size_y = 1, local_size_z = 1) in;
 
 #include "meshdata.glsl"
 
-layout(push_constant) uniform Frustum {
+#define CULL_FLAG_FRUSTUM 1
+// Append the meshlets of the visible instances for the meshlet cull pass
+#define CULL_FLAG_MESHLET_TASKS 2
+
+layout(push_constant) uniform CullData {
    vec4 planes[6];
-   uint nMesh;
-   uint enableFrustumCulling;
+   uint nInstance;
+   uint flags;
+   uint enableLod;
+   // Pixels per unit of error at distance 1 over the error threshold
+   float lodScale;
+   vec4 cameraPosition;
 };
 
 layout(binding = 0) readonly buffer TransformBuffer {
@@ -20,11 +28,11 @@ layout(binding = 1) readonly buffer MeshDrawBuffer {
   MeshDrawData meshData[];
 };
 
-layout(binding = 2) writeonly buffer DrawCommandBuffer {
+layout(binding = 2) buffer DrawCommandBuffer {
   MeshDrawCommand drawCommands[];
 };
 
-layout(binding = 3) writeonly buffer DrawCommandCount {
+layout(binding = 3) buffer DrawCommandCount {
   uint drawCommandCount;
 };
 
@@ -32,19 +40,40 @@ layout(binding = 4) writeonly buffer TotalVisibleCount {
   uint visibleMeshCount;
 };
 
+layout(binding = 5) readonly buffer InstanceBuffer {
+  PerObjectData instances[];
+};
+
+layout(binding = 6) writeonly buffer VisibleInstanceBuffer {
+  PerObjectData visibleInstances[];
+};
+
+layout(binding = 7) writeonly buffer MeshletTaskBuffer {
+  MeshletTask meshletTasks[];
+};
+
+layout(binding = 8) buffer MeshletCounterBuffer {
+  MeshletCullCounters meshletCounters;
+};
+
 void main() {
-   //uint ti = gl_LocalInvocationID.x;
-   //uint gi = gl_WorkGroupID.x;
-   //uint di = gi * 32 + ti;
-   uint di = gl_GlobalInvocationID.x;
-   if(di < nMesh) {
+   uint ii = gl_GlobalInvocationID.x;
+   bool emitMeshletTasks = (flags & CULL_FLAG_MESHLET_TASKS) != 0;
+   if(ii == 0 && emitMeshletTasks)
+      meshletCounters.groupCountZ = 1;
+
+   if(ii < nInstance) {
+      PerObjectData instance = instances[ii];
+      uint di = instance.drawIndex;
       MeshDrawData mesh = meshData[di];
-	  mat4 transform = transforms[di];
+	  mat4 transform = transforms[instance.transformIndex];
 
-	  vec3 center = mesh.boundingSphere.xyz;
-	  float radius = mesh.boundingSphere.w;
+	  // Bounding sphere is in mesh space, radius is scaled by the largest axis
+	  vec3 center = (transform * vec4(mesh.boundingSphere.xyz, 1.0)).xyz;
+	  float scale = sqrt(max(dot(transform[0].xyz, transform[0].xyz), max(dot(transform[1].xyz, transform[1].xyz), dot(transform[2].xyz, transform[2].xyz))));
+	  float radius = mesh.boundingSphere.w * scale;
 	  bool visible = true;
-	  if(enableFrustumCulling > 0.5) {
+	  if((flags & CULL_FLAG_FRUSTUM) != 0) {
 	    for(int i = 0; i < 6; ++i) {
     		vec4 plane = planes[i];
 			if((dot(plane.xyz, center) + plane.w) <	-radius)
@@ -56,16 +85,49 @@ void main() {
 	  }
 
 	  if(visible) {
+        // Coarsest level whose error projected from the closest point of the sphere stays under the threshold
+        uint lod = 0;
+        if(enableLod > 0) {
+          float distance = max(length(center - cameraPosition.xyz) - radius, 0.0);
+          float maxError = distance / (lodScale * scale);
+          for(uint i = 1; i < mesh.lodCount && mesh.lods[i].error <= maxError; ++i)
+            lod = i;
+        }
+        MeshLod meshLod = mesh.lods[lod];
+
         atomicAdd(visibleMeshCount, 1);
-        uint dci = atomicAdd(drawCommandCount, 1);
-        drawCommands[dci].drawId = di;
-		drawCommands[dci].indexCount = mesh.indexCount;
-		drawCommands[dci].instanceCount	=	1;
-		drawCommands[dci].firstIndex = mesh.indexOffset;
-		drawCommands[dci].vertexOffset = mesh.vertexOffset;
-		drawCommands[dci].firstInstance	=	0;
-		drawCommands[dci].taskCount	= mesh.meshletCount;
-		drawCommands[dci].firstTask	= mesh.meshletOffset;
+        // Commands are cleared every frame, each LOD of a draw has its own command and range of visible instances
+        uint ci = di * MAX_LODS + lod;
+        uint firstInstance = lod * nInstance + mesh.firstInstance;
+        uint slot = atomicAdd(drawCommands[ci].instanceCount, 1);
+        atomicAdd(drawCommands[ci].taskCount, (meshLod.meshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE);
+        visibleInstances[firstInstance + slot] = instance;
+
+        // Tasks past the capacity of the batch are dropped, the dispatch skips them
+        if(emitMeshletTasks) {
+          uint taskCount = (meshLod.meshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE;
+          uint firstTask = atomicAdd(meshletCounters.taskCount, taskCount);
+          // Dispatch grows with the tasks in the capacity, the counters are cleared every frame
+          uint dispatchCount = min(firstTask + taskCount, meshletTasks.length());
+          atomicMax(meshletCounters.groupCountX, min(dispatchCount, MAX_DISPATCH_GROUPS));
+          atomicMax(meshletCounters.groupCountY, (dispatchCount + MAX_DISPATCH_GROUPS - 1) / MAX_DISPATCH_GROUPS);
+          for(uint i = 0; i < taskCount && firstTask + i < meshletTasks.length(); ++i) {
+            uint meshletOffset = i * TASK_GROUP_SIZE;
+            meshletTasks[firstTask + i] = MeshletTask(firstInstance + slot, meshLod.meshletOffset + meshletOffset,
+              min(meshLod.meshletCount - meshletOffset, TASK_GROUP_SIZE), mesh.vertexOffset);
+          }
+        }
+
+        if(slot == 0) {
+          drawCommands[ci].drawId = di;
+		  drawCommands[ci].indexCount = meshLod.indexCount;
+		  drawCommands[ci].firstIndex = meshLod.indexOffset;
+		  drawCommands[ci].vertexOffset = mesh.vertexOffset;
+		  drawCommands[ci].firstInstance = firstInstance;
+		  drawCommands[ci].firstTask = meshLod.meshletOffset;
+          // Draws after the last visible one are skipped
+          atomicMax(drawCommandCount, ci + 1);
+        }
 	  }
    }
 }
\ No newline at end of file
@@ -22,6 +22,11 @@ layout(binding = 1) readonly buffer Vertices {
    Vertex aVertices[];
 };
 
+// Same buffer for the meshes with compact vertices
+layout(binding = 1) readonly buffer CompactVertices {
+   uvec4 aCompactVertices[];
+};
+
 layout(binding = 2) readonly buffer TransformData
 {
    mat4 aTransformData[];
@@ -43,6 +48,19 @@ layout(binding = 7) readonly buffer MeshletTrianglesData {
   uint8_t meshletTriangles[];
 };
 
+layout(binding = 8) readonly buffer InstanceData {
+  PerObjectData aInstanceData[];
+};
+
+layout(binding = 9) readonly buffer MeshDrawBuffer {
+  MeshDrawData aMeshDraws[];
+};
+
+taskNV in Task {
+  uint instanceIndex;
+  uint meshletIndices[TASK_GROUP_SIZE];
+} IN;
+
 layout(location = 0) out VS_OUT 
 {
    vec3 normal;
@@ -68,10 +86,11 @@ uint hash(uint a)
 
 void main() {
     uint ti = gl_LocalInvocationID.x;
-    uint mi = gl_WorkGroupID.x;
 
+    // Meshlets that passed the culling of the task shader
     MeshDrawCommand drawCommand = drawCommands[gl_DrawIDARB];
-    uint drawId = drawCommand.drawId;
+    uint mi = IN.meshletIndices[gl_WorkGroupID.x];
+    PerObjectData instance = aInstanceData[IN.instanceIndex];
 
     uint vertexCount = meshlets[mi].vertexCount;
     uint triangleCount = meshlets[mi].triangleCount;
@@ -83,25 +102,34 @@ void main() {
     vec3 mColor = vec3(float(mhash & 255), float((mhash >> 8) & 255), float((mhash >> 16) & 255)) / 255.0;
     uint globalVBOffset = drawCommand.vertexOffset;
 
-    mat4 modelMatrix = aTransformData[drawId];
+    uint di = instance.drawIndex;
+    bool compact = aMeshDraws[di].vertexFormat == VERTEX_FORMAT_COMPACT;
+    vec3 positionOffset = aMeshDraws[di].positionOffset.xyz;
+    vec3 positionScale = aMeshDraws[di].positionScale.xyz;
+
+    mat4 modelMatrix = aTransformData[instance.transformIndex];
     for(uint i = ti; i < vertexCount; i+= LOCAL_SIZE)
     {
-        uint vi = meshletVertices[vertexOffset + i];
-        Vertex vertex = aVertices[vi + globalVBOffset];
-
-        vec3 position = vec3(vertex.px, vertex.py, vertex.pz);
+        uint vi = meshletVertices[vertexOffset + i] + globalVBOffset;
+        VertexAttributes vertex;
+        if(compact)
+            vertex = DecodeCompactVertex(aCompactVertices[vi], positionOffset, positionScale);
+        else
+            vertex = DecodeVertex(aVertices[vi]);
+
+        vec3 position = vertex.position;
         vec4 wP =  modelMatrix *  vec4(position, 1.0);
         gl_MeshVerticesNV[i].gl_Position = globalData.VP * wP;
 
         mat3 normalTransform = mat3(transpose(inverse(modelMatrix)));
-		vs_out[i].normal	 = normalTransform * UnpackU8toFloat(vertex.nx,	vertex.ny, vertex.nz);
-		vs_out[i].tangent	 = normalTransform * UnpackU8toFloat(vertex.tx,	vertex.ty, vertex.tz);
-		vs_out[i].bitangent  = normalTransform * UnpackU8toFloat(vertex.bx,	vertex.by, vertex.bz);
+		vs_out[i].normal	 = normalTransform * vertex.normal;
+		vs_out[i].tangent	 = normalTransform * vertex.tangent;
+		vs_out[i].bitangent  = normalTransform * vertex.bitangent;
         //vs_out[i].bitangent  = mColor;
-        vs_out[i].uv = vec2(vertex.tu, vertex.tv);
+        vs_out[i].uv = vertex.uv;
 		vs_out[i].lsPos	     = vec3(globalData.V * wP);
 		vs_out[i].viewDir	 = globalData.cameraPosition - wP.xyz;
-		vs_out[i].matId	     = drawId;
+		vs_out[i].matId	     = instance.materialIndex;
 		vs_out[i].worldPos   = wP.xyz;
     }
 
@@ -7,8 +7,18 @@
 #extension GL_ARB_shader_draw_parameters : require
 
 #include "meshdata.glsl"
+#include "globaldata.glsl"
 
-layout(local_size_x = 32, local_size_y = 1, local_size_z = 1) in;
+layout(local_size_x = TASK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+layout(binding = 0) uniform readonly Globals {
+    GlobalData globalData;
+};
+
+layout(binding = 2) readonly buffer TransformData
+{
+   mat4 aTransformData[];
+};
 
 layout(binding = 3) readonly buffer DrawCommands {
    MeshDrawCommand drawCommands[];
@@ -18,18 +28,56 @@ layout(binding = 5) readonly buffer MeshletData {
   Meshlet meshlets[];
 };
 
-out taskNV block {
-  uint meshletIndices[32];
+layout(binding = 8) readonly buffer InstanceData {
+  PerObjectData aInstanceData[];
 };
 
+layout(binding = 9) readonly buffer MeshDrawBuffer {
+  MeshDrawData aMeshDraws[];
+};
+
+layout(binding = 10) buffer MeshletStatistics {
+  uint culledMeshletCount;
+};
+
+taskNV out Task {
+  uint instanceIndex;
+  uint meshletIndices[TASK_GROUP_SIZE];
+} OUT;
+
+shared uint visibleMeshletCount;
+
 void main() {
   uint ti = gl_LocalInvocationID.x;
-  uint gi = gl_WorkGroupID.x;
-  uint mi = gi * 32 + ti;
 
+  // Each visible instance adds one task per TASK_GROUP_SIZE meshlets of the LOD of the draw
   MeshDrawCommand drawCommand = drawCommands[gl_DrawIDARB];
+  uint lod = gl_DrawIDARB % MAX_LODS;
+  uint meshletCount = aMeshDraws[drawCommand.drawId].lods[lod].meshletCount;
+  uint taskCount = drawCommand.taskCount / drawCommand.instanceCount;
+  uint task = gl_WorkGroupID.x - drawCommand.firstTask;
+  uint instanceIndex = drawCommand.firstInstance + task / taskCount;
+  uint firstMeshlet = (task % taskCount) * TASK_GROUP_SIZE;
+  uint mi = drawCommand.firstTask + firstMeshlet + ti;
 
-  meshletIndices[ti] = mi;
   if(ti == 0)
-     gl_TaskCountNV = 32;
-}
\ No newline at end of file
+    visibleMeshletCount = 0;
+  barrier();
+
+  bool visible = firstMeshlet + ti < meshletCount;
+  if(visible) {
+    mat4 modelMatrix = aTransformData[aInstanceData[instanceIndex].transformIndex];
+    visible = IsMeshletVisible(meshlets[mi], modelMatrix, globalData.VP, globalData.cameraPosition);
+  }
+
+  // Survivors are compacted to the front of the payload
+  if(visible)
+    OUT.meshletIndices[atomicAdd(visibleMeshletCount, 1)] = mi;
+  barrier();
+
+  if(ti == 0) {
+    OUT.instanceIndex = instanceIndex;
+    gl_TaskCountNV = visibleMeshletCount;
+    atomicAdd(culledMeshletCount, min(meshletCount - firstMeshlet, TASK_GROUP_SIZE) - visibleMeshletCount);
+  }
+}
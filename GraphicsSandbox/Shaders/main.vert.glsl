@@ -1,7 +1,6 @@
 #version 460
 
 #extension GL_GOOGLE_include_directive: require
-#extension GL_ARB_shader_draw_parameters: require
 
 #include "meshdata.glsl"
 #include "globaldata.glsl"
@@ -29,24 +28,39 @@ layout(binding = 1) readonly buffer Vertices
    Vertex aVertices[];
 };
 
+// Same buffer for the meshes with compact vertices
+layout(binding = 1) readonly buffer CompactVertices
+{
+   uvec4 aCompactVertices[];
+};
+
 layout(binding = 2) readonly buffer TransformData
 {
    mat4 aTransformData[];
 };
 
-layout(binding = 3) readonly buffer DrawCommands {
-   MeshDrawCommand drawCommands[];
+// Visible instances compacted by the cull pass from the firstInstance of each draw
+layout(binding = 3) readonly buffer InstanceData {
+   PerObjectData aInstanceData[];
+};
+
+layout(binding = 5) readonly buffer MeshDrawBuffer {
+   MeshDrawData aMeshDraws[];
 };
 
 void main()
 {
-   MeshDrawCommand drawCommand = drawCommands[gl_DrawIDARB];
-   uint drawId = drawCommand.drawId;
+   PerObjectData instance = aInstanceData[gl_InstanceIndex];
 
-   Vertex vertex = aVertices[gl_VertexIndex]; 
+   uint di = instance.drawIndex;
+   VertexAttributes vertex;
+   if(aMeshDraws[di].vertexFormat == VERTEX_FORMAT_COMPACT)
+      vertex = DecodeCompactVertex(aCompactVertices[gl_VertexIndex], aMeshDraws[di].positionOffset.xyz, aMeshDraws[di].positionScale.xyz);
+   else
+      vertex = DecodeVertex(aVertices[gl_VertexIndex]);
 
-   vec3 position = vec3(vertex.px, vertex.py, vertex.pz);
-   mat4 worldMatrix = aTransformData[drawId];
+   vec3 position = vertex.position;
+   mat4 worldMatrix = aTransformData[instance.transformIndex];
 
    vec4 wP = worldMatrix * vec4(position, 1.0);
    gl_Position = globalData.VP * wP;
@@ -54,14 +68,14 @@ void main()
    // Calculate normal matrix
    // http://www.lighthouse3d.com/tutorials/glsl-12-tutorial/the-normal-matrix/
    vs_out.worldPos	= wP.xyz;
-   vs_out.uv = vec2(vertex.tu, vertex.tv);
+   vs_out.uv = vertex.uv;
 
    mat3 normalTransform = mat3(transpose(inverse(worldMatrix)));
-   vs_out.normal    = normalTransform * UnpackU8toFloat(vertex.nx, vertex.ny, vertex.nz);
-   vs_out.tangent   = normalTransform * UnpackU8toFloat(vertex.tx, vertex.ty, vertex.tz);
-   vs_out.bitangent = normalTransform * UnpackU8toFloat(vertex.bx, vertex.by, vertex.bz);
+   vs_out.normal    = normalTransform * vertex.normal;
+   vs_out.tangent   = normalTransform * vertex.tangent;
+   vs_out.bitangent = normalTransform * vertex.bitangent;
    vs_out.lsPos     = vec3(globalData.V * wP);
 
    vs_out.viewDir   = globalData.cameraPosition - wP.xyz;
-   vs_out.matId     = drawId;
+   vs_out.matId     = instance.materialIndex;
 }
@@ -39,6 +39,7 @@ struct PerObjectData
 {
 	uint transformIndex;
 	uint materialIndex;
+	uint drawIndex;
 };
 
 vec3 UnpackU8toFloat(uint nx, uint ny, uint nz)
@@ -46,6 +47,63 @@ vec3 UnpackU8toFloat(uint nx, uint ny, uint nz)
    return vec3((nx - 127.0f) / 127.0f, (ny - 127.0f) / 127.0f, (nz - 127.0f) / 127.0f);
 }
 
+#define VERTEX_FORMAT_FULL 0
+#define VERTEX_FORMAT_COMPACT 1
+
+// Mesh space attributes of a vertex of either format
+struct VertexAttributes
+{
+	vec3 position;
+	vec3 normal;
+	vec3 tangent;
+	vec3 bitangent;
+	vec2 uv;
+};
+
+VertexAttributes DecodeVertex(Vertex vertex)
+{
+	VertexAttributes attributes;
+	attributes.position = vec3(vertex.px, vertex.py, vertex.pz);
+	attributes.normal = UnpackU8toFloat(vertex.nx, vertex.ny, vertex.nz);
+	attributes.tangent = UnpackU8toFloat(vertex.tx, vertex.ty, vertex.tz);
+	attributes.bitangent = UnpackU8toFloat(vertex.bx, vertex.by, vertex.bz);
+	attributes.uv = vec2(vertex.tu, vertex.tv);
+	return attributes;
+}
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-v.z, 0.0);
+	v.x += v.x >= 0.0 ? -t : t;
+	v.y += v.y >= 0.0 ? -t : t;
+	return normalize(v);
+}
+
+/*
+* CompactVertex read as 4 words: px py, pz nx ny, tx ty tw, u v.
+* Position is decoded with the offset and scale of the draw, the
+* bitangent is rebuilt from the normal, the tangent and its sign.
+*/
+vec3 DecodeCompactPosition(uvec4 data, vec3 offset, vec3 scale)
+{
+	return offset + vec3(unpackUnorm2x16(data.x), unpackUnorm2x16(data.y).x) * scale;
+}
+
+VertexAttributes DecodeCompactVertex(uvec4 data, vec3 offset, vec3 scale)
+{
+	vec4 normal = unpackSnorm4x8(data.y);
+	vec4 tangent = unpackSnorm4x8(data.z);
+
+	VertexAttributes attributes;
+	attributes.position = DecodeCompactPosition(data, offset, scale);
+	attributes.normal = DecodeOctahedral(normal.zw);
+	attributes.tangent = DecodeOctahedral(tangent.xy);
+	attributes.bitangent = cross(attributes.normal, attributes.tangent) * (tangent.z < 0.0 ? -1.0 : 1.0);
+	attributes.uv = unpackHalf2x16(data.w);
+	return attributes;
+}
+
 
 struct Meshlet {
 	// Offset specified in element count
@@ -56,9 +114,69 @@ struct Meshlet {
 	uint triangleOffset;
 	uint triangleCount;
 
+	// Mesh space, xyz center and w radius
+	vec4 boundingSphere;
+	// xyz axis and w cutoff
 	vec4 cone;
 };
 
+// Meshlets tested by a task shader workgroup, a visible instance adds one task per group of meshlets
+#define TASK_GROUP_SIZE 32
+
+// Planes extracted from the view projection, the clip space depth is [0, 1]
+bool IsSphereInFrustum(vec3 center, float radius, mat4 viewProjection)
+{
+	mat4 m = transpose(viewProjection);
+	vec4 planes[6] = vec4[](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]);
+	for(int i = 0; i < 6; ++i)
+	{
+		if(dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+			return false;
+	}
+	return true;
+}
+
+// Every triangle of the meshlet faces away from the camera, a cutoff of 1 is never culled
+bool IsConeBackfacing(vec3 center, float radius, vec3 coneAxis, float coneCutoff, vec3 cameraPosition)
+{
+	vec3 direction = center - cameraPosition;
+	return dot(direction, coneAxis) >= coneCutoff * length(direction) + radius;
+}
+
+// Casters in front of the near plane are clamped onto it, only the sides of the cascade are tested
+bool IsSphereInCascade(vec3 center, float radius, mat4 viewProjection)
+{
+	mat4 m = transpose(viewProjection);
+	vec4 planes[4] = vec4[](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1]);
+	for(int i = 0; i < 4; ++i)
+	{
+		if(dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+			return false;
+	}
+	return true;
+}
+
+bool IsMeshletVisible(Meshlet meshlet, mat4 modelMatrix, mat4 viewProjection, vec3 cameraPosition)
+{
+	vec3 center = (modelMatrix * vec4(meshlet.boundingSphere.xyz, 1.0)).xyz;
+	float scale = max(length(modelMatrix[0].xyz), max(length(modelMatrix[1].xyz), length(modelMatrix[2].xyz)));
+	float radius = meshlet.boundingSphere.w * scale;
+	vec3 coneAxis = normalize(transpose(inverse(mat3(modelMatrix))) * meshlet.cone.xyz);
+
+	return IsSphereInFrustum(center, radius, viewProjection) && !IsConeBackfacing(center, radius, coneAxis, meshlet.cone.w, cameraPosition);
+}
+
+
+#define MAX_LODS 8
+
+// Ranges of a level of detail, the error is the deviation from LOD 0 in mesh space
+struct MeshLod {
+	uint indexOffset;
+	uint indexCount;
+	uint meshletOffset;
+	uint meshletCount;
+	float error;
+};
 
 struct MeshDrawData {
 	vec4 boundingSphere;
@@ -70,8 +188,49 @@ struct MeshDrawData {
 
 	uint meshletOffset;
 	uint meshletCount;
-	uint meshletTriangleOffset;
-	uint meshletTriangleCount;
+	uint firstInstance;
+	uint instanceCount;
+
+	uint lodCount;
+	MeshLod lods[MAX_LODS];
+
+	uint vertexFormat;
+	uint reserved0;
+	uint reserved1;
+	// Compact positions are decoded as offset + position * scale
+	vec4 positionOffset;
+	vec4 positionScale;
+};
+
+// Meshlets of a visible instance, culled and compacted by the meshlet cull pass
+struct MeshletTask {
+   uint instanceIndex;
+   uint meshletOffset;
+   uint meshletCount;
+   uint vertexOffset;
+};
+
+// Minimum of maxComputeWorkGroupCount, larger dispatches are split in rows
+#define MAX_DISPATCH_GROUPS 65535
+
+// Per batch, the first three are the arguments of the meshlet cull dispatch
+struct MeshletCullCounters {
+   uint groupCountX;
+   uint groupCountY;
+   uint groupCountZ;
+   uint commandCount;
+   uint indexCount;
+   uint taskCount;
+   uint reserved0;
+   uint reserved1;
+};
+
+struct DrawIndexedCommand {
+   uint indexCount;
+   uint instanceCount;
+   uint firstIndex;
+   int vertexOffset;
+   uint firstInstance;
 };
 
 struct MeshDrawCommand {
@@ -0,0 +1,113 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive : require
+
+#include "meshdata.glsl"
+#include "globaldata.glsl"
+
+// One workgroup per task, one thread per meshlet
+layout(local_size_x = TASK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+layout(push_constant) uniform MeshletCullData {
+   // Index window of the batch in the compacted index buffer
+   uint firstIndex;
+};
+
+layout(binding = 0) uniform readonly Globals {
+   GlobalData globalData;
+};
+
+layout(binding = 1) readonly buffer TransformBuffer {
+   mat4 transforms[];
+};
+
+layout(binding = 2) readonly buffer VisibleInstanceBuffer {
+  PerObjectData visibleInstances[];
+};
+
+layout(binding = 3) readonly buffer MeshletTaskBuffer {
+  MeshletTask tasks[];
+};
+
+layout(binding = 4) readonly buffer MeshletData {
+  Meshlet meshlets[];
+};
+
+layout(binding = 5) readonly buffer MeshletVerticesData {
+  uint meshletVertices[];
+};
+
+layout(binding = 6) readonly buffer MeshletTrianglesData {
+  uint8_t meshletTriangles[];
+};
+
+layout(binding = 7) buffer MeshletCounterBuffer {
+  MeshletCullCounters counters;
+};
+
+layout(binding = 8) writeonly buffer DrawCommandBuffer {
+  DrawIndexedCommand drawCommands[];
+};
+
+layout(binding = 9) writeonly buffer CompactedIndexBuffer {
+  uint compactedIndices[];
+};
+
+layout(binding = 10) buffer MeshletStatistics {
+  uint culledMeshletCount;
+};
+
+shared uint groupIndexCount;
+shared uint groupVisibleCount;
+shared uint groupFirstIndex;
+
+void main() {
+  uint ti = gl_LocalInvocationID.x;
+
+  // Groups are laid out in rows, the last row is padded past the written tasks
+  uint taskIndex = gl_WorkGroupID.y * MAX_DISPATCH_GROUPS + gl_WorkGroupID.x;
+  if(taskIndex >= min(counters.taskCount, tasks.length()))
+    return;
+
+  MeshletTask task = tasks[taskIndex];
+  if(ti == 0) {
+    groupIndexCount = 0;
+    groupVisibleCount = 0;
+  }
+  barrier();
+
+  uint mi = task.meshletOffset + ti;
+  uint indexCount = 0;
+  if(ti < task.meshletCount) {
+    mat4 modelMatrix = transforms[visibleInstances[task.instanceIndex].transformIndex];
+    if(IsMeshletVisible(meshlets[mi], modelMatrix, globalData.VP, globalData.cameraPosition)) {
+      indexCount = meshlets[mi].triangleCount * 3;
+      atomicAdd(groupVisibleCount, 1);
+    }
+  }
+  uint localOffset = atomicAdd(groupIndexCount, indexCount);
+  barrier();
+
+  // One draw per task with the visible meshlets of the instance
+  if(ti == 0) {
+    groupFirstIndex = ~0u;
+    if(groupIndexCount > 0) {
+      uint first = atomicAdd(counters.indexCount, groupIndexCount);
+      if(first + groupIndexCount <= compactedIndices.length()) {
+        groupFirstIndex = first;
+        uint ci = atomicAdd(counters.commandCount, 1);
+        drawCommands[ci] = DrawIndexedCommand(groupIndexCount, 1, firstIndex + first, int(task.vertexOffset), task.instanceIndex);
+      }
+    }
+    atomicAdd(culledMeshletCount, task.meshletCount - groupVisibleCount);
+  }
+  barrier();
+
+  if(indexCount > 0 && groupFirstIndex != ~0u) {
+    uint vertexOffset = meshlets[mi].vertexOffset;
+    uint triangleOffset = meshlets[mi].triangleOffset;
+    uint dst = groupFirstIndex + localOffset;
+    for(uint i = 0; i < indexCount; ++i)
+      compactedIndices[dst + i] = meshletVertices[vertexOffset + uint(meshletTriangles[triangleOffset + i])];
+  }
+}
@@ -0,0 +1,122 @@
+#version 450
+
+#extension GL_EXT_shader_16bit_storage : require
+#extension GL_EXT_shader_8bit_storage : require
+#extension GL_NV_mesh_shader: require
+#extension GL_GOOGLE_include_directive: require
+#extension GL_ARB_shader_draw_parameters: require
+
+#include "meshdata.glsl"
+
+#define CASCADE_COUNT 5
+
+const uint LOCAL_SIZE = 32;
+layout(local_size_x = LOCAL_SIZE, local_size_y = 1, local_size_z = 1) in;
+layout(triangles, max_vertices = 64, max_primitives = 126) out;
+
+struct Cascade {
+   mat4 VP;
+   vec4 splitDistance;
+};
+
+layout(binding = 1) readonly buffer Vertices {
+   Vertex aVertices[];
+};
+
+// Same buffer for the meshes with compact vertices
+layout(binding = 1) readonly buffer CompactVertices {
+   uvec4 aCompactVertices[];
+};
+
+layout(binding = 2) readonly buffer TransformData
+{
+   mat4 aTransformData[];
+};
+
+layout(binding = 3, std140) uniform CascadeInfo
+{
+   Cascade cascades[CASCADE_COUNT];
+   vec4 shadowDims;
+};
+
+layout(binding = 4) readonly buffer InstanceData {
+  PerObjectData aInstanceData[];
+};
+
+layout(binding = 5) readonly buffer MeshDrawBuffer {
+  MeshDrawData aMeshDraws[];
+};
+
+layout(binding = 6) readonly buffer DrawCommands {
+  MeshDrawCommand drawCommands[];
+};
+
+layout(binding = 7) readonly buffer MeshletData {
+  Meshlet meshlets[];
+};
+
+layout(binding = 8) readonly buffer MeshletVerticesData {
+  uint meshletVertices[];
+};
+
+layout(binding = 9) readonly buffer MeshletTrianglesData {
+  uint8_t meshletTriangles[];
+};
+
+taskNV in Task {
+  uint instanceIndex;
+  uint meshletCascades[TASK_GROUP_SIZE * CASCADE_COUNT];
+} IN;
+
+void main() {
+
+    uint ti = gl_LocalInvocationID.x;
+
+    // Meshlet and the cascade it overlaps, written by the task shader
+    MeshDrawCommand drawCommand = drawCommands[gl_DrawIDARB];
+    uint meshletCascade = IN.meshletCascades[gl_WorkGroupID.x];
+    uint mi = meshletCascade >> 3;
+    uint cascade = meshletCascade & 7;
+    PerObjectData instance = aInstanceData[IN.instanceIndex];
+
+    uint vertexCount = meshlets[mi].vertexCount;
+    uint triangleCount = meshlets[mi].triangleCount;
+    uint vertexOffset = meshlets[mi].vertexOffset;
+    uint triangleOffset = meshlets[mi].triangleOffset;
+
+    uint indexCount = triangleCount * 3;
+    uint globalVBOffset = drawCommand.vertexOffset;
+
+    uint di = instance.drawIndex;
+    bool compact = aMeshDraws[di].vertexFormat == VERTEX_FORMAT_COMPACT;
+    vec3 positionOffset = aMeshDraws[di].positionOffset.xyz;
+    vec3 positionScale = aMeshDraws[di].positionScale.xyz;
+
+    mat4 cascadeMVP = cascades[cascade].VP * aTransformData[instance.transformIndex];
+    for(uint i = ti; i < vertexCount; i+= LOCAL_SIZE)
+    {
+        uint vi = meshletVertices[vertexOffset + i] + globalVBOffset;
+        vec3 position;
+        if(compact)
+            position = DecodeCompactPosition(aCompactVertices[vi], positionOffset, positionScale);
+        else
+            position = vec3(aVertices[vi].px, aVertices[vi].py, aVertices[vi].pz);
+        vec4 clipPosition = cascadeMVP * vec4(position, 1.0);
+        // Same as the geometry shader, casters in front of the cascade are pancaked on the near plane
+        clipPosition.z = max(clipPosition.z, 0.0);
+        gl_MeshVerticesNV[i].gl_Position = clipPosition;
+    }
+
+    for(uint i = ti; i < indexCount; i+= LOCAL_SIZE)
+    {
+        gl_PrimitiveIndicesNV[i] = uint(meshletTriangles[triangleOffset + i]);
+    }
+
+    for(uint i = ti; i < triangleCount; i+= LOCAL_SIZE)
+    {
+        gl_MeshPrimitivesNV[i].gl_Layer = int(cascade);
+    }
+
+    if(ti == 0)
+      gl_PrimitiveCountNV = triangleCount;
+}
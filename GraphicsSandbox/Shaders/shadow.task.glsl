@@ -0,0 +1,93 @@
+#version 450
+
+#extension GL_EXT_shader_16bit_storage : require
+#extension GL_EXT_shader_8bit_storage : require
+#extension GL_NV_mesh_shader : require 
+#extension GL_GOOGLE_include_directive : require
+#extension GL_ARB_shader_draw_parameters : require
+
+#include "meshdata.glsl"
+#include "globaldata.glsl"
+
+#define CASCADE_COUNT 5
+
+layout(local_size_x = TASK_GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+struct Cascade {
+   mat4 VP;
+   vec4 splitDistance;
+};
+
+layout(binding = 0) uniform readonly Globals {
+    GlobalData globalData;
+};
+
+layout(binding = 2) readonly buffer TransformData
+{
+   mat4 aTransformData[];
+};
+
+layout(binding = 3, std140) uniform CascadeInfo
+{
+   Cascade cascades[CASCADE_COUNT];
+   vec4 shadowDims;
+};
+
+layout(binding = 4) readonly buffer InstanceData {
+  PerObjectData aInstanceData[];
+};
+
+layout(binding = 5) readonly buffer MeshDrawBuffer {
+  MeshDrawData aMeshDraws[];
+};
+
+layout(binding = 6) readonly buffer DrawCommands {
+   MeshDrawCommand drawCommands[];
+};
+
+layout(binding = 7) readonly buffer MeshletData {
+  Meshlet meshlets[];
+};
+
+// One mesh workgroup per meshlet and cascade it overlaps, the cascade is in the low 3 bits
+taskNV out Task {
+  uint instanceIndex;
+  uint meshletCascades[TASK_GROUP_SIZE * CASCADE_COUNT];
+} OUT;
+
+shared uint meshletCascadeCount;
+
+void main() {
+  uint ti = gl_LocalInvocationID.x;
+
+  // One command per draw with all the instances at LOD 0, shadow casters aren't culled by the camera
+  MeshDrawCommand drawCommand = drawCommands[gl_DrawIDARB];
+  uint meshletCount = aMeshDraws[drawCommand.drawId].lods[0].meshletCount;
+  uint taskCount = drawCommand.taskCount / drawCommand.instanceCount;
+  uint task = gl_WorkGroupID.x - drawCommand.firstTask;
+  uint instanceIndex = drawCommand.firstInstance + task / taskCount;
+  uint firstMeshlet = (task % taskCount) * TASK_GROUP_SIZE;
+  uint mi = drawCommand.firstTask + firstMeshlet + ti;
+
+  if(ti == 0)
+    meshletCascadeCount = 0;
+  barrier();
+
+  if(firstMeshlet + ti < meshletCount) {
+    mat4 modelMatrix = aTransformData[aInstanceData[instanceIndex].transformIndex];
+    vec3 center = (modelMatrix * vec4(meshlets[mi].boundingSphere.xyz, 1.0)).xyz;
+    float scale = max(length(modelMatrix[0].xyz), max(length(modelMatrix[1].xyz), length(modelMatrix[2].xyz)));
+    float radius = meshlets[mi].boundingSphere.w * scale;
+
+    for(uint cascade = 0; cascade < CASCADE_COUNT; ++cascade) {
+      if(IsSphereInCascade(center, radius, cascades[cascade].VP))
+        OUT.meshletCascades[atomicAdd(meshletCascadeCount, 1)] = (mi << 3) | cascade;
+    }
+  }
+  barrier();
+
+  if(ti == 0) {
+    OUT.instanceIndex = instanceIndex;
+    gl_TaskCountNV = meshletCascadeCount;
+  }
+}
@@ -1,7 +1,6 @@
 #version 460
 
 #extension GL_GOOGLE_include_directive: require
-#extension GL_ARB_shader_draw_parameters: require
 
 #include "globaldata.glsl"
 #include "meshdata.glsl"
@@ -17,14 +16,37 @@ layout(binding = 1) readonly buffer Vertices
    Vertex aVertices[];
 };
 
+// Same buffer for the meshes with compact vertices
+layout(binding = 1) readonly buffer CompactVertices
+{
+   uvec4 aCompactVertices[];
+};
+
 layout(binding = 2) readonly buffer TransformData
 {
    mat4 aTransformData[];
 };
 
+layout(binding = 4) readonly buffer InstanceData
+{
+   PerObjectData aInstanceData[];
+};
+
+layout(binding = 5) readonly buffer MeshDrawBuffer
+{
+   MeshDrawData aMeshDraws[];
+};
+
 void main()
 {
-   Vertex vertex = aVertices[gl_VertexIndex]; 
-   mat4 worldMatrix = aTransformData[gl_DrawIDARB];
-   gl_Position = worldMatrix * vec4(vertex.px, vertex.py, vertex.pz, 1.0f);
+   PerObjectData instance = aInstanceData[gl_InstanceIndex];
+   uint di = instance.drawIndex;
+   vec3 position;
+   if(aMeshDraws[di].vertexFormat == VERTEX_FORMAT_COMPACT)
+      position = DecodeCompactPosition(aCompactVertices[gl_VertexIndex], aMeshDraws[di].positionOffset.xyz, aMeshDraws[di].positionScale.xyz);
+   else
+      position = vec3(aVertices[gl_VertexIndex].px, aVertices[gl_VertexIndex].py, aVertices[gl_VertexIndex].pz);
+
+   mat4 worldMatrix = aTransformData[instance.transformIndex];
+   gl_Position = worldMatrix * vec4(position, 1.0f);
 }
\ No newline at end of file
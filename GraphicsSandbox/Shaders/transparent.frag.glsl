@@ -24,7 +24,7 @@ layout(binding = 4) readonly buffer MaterialData {
   Material aMaterialData[];
 };
 
-layout(binding = 5) readonly buffer LightBuffer {
+layout(binding = 7) readonly buffer LightBuffer {
    LightData lightData[];
 } lightBuffer;
 
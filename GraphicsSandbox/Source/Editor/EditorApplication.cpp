@@ -95,6 +95,7 @@ void EditorApplication::InitializeScene()
 {
 	InitializeSponzaScene(&mScene);
 	//InitializeAOScene(&mScene);
+	//InitializeInstancingScene(&mScene);
 }
 
 /*
@@ -160,5 +161,6 @@ void EditorApplication::DrawSkeleton()
 */
 EditorApplication::~EditorApplication()
 {
+	stopRenderThread_();
 	mDevice->WaitForGPU();
 }
@@ -10,7 +10,10 @@ void InitializeSponzaScene(Scene* scene) {
 	camera->SetFarPlane(500.0f);
 
 	auto compMgr = scene->GetComponentManager();
-	ecs::Entity e0 = scene->CreateMesh("C:/Users/Dell/OneDrive/Documents/3D-Assets/Models/sponza/sponza.gltf");
+	// Set to false to compare with the full vertex format
+	MeshCache::ImportOptions sponzaOptions;
+	sponzaOptions.compactVertices = true;
+	ecs::Entity e0 = scene->CreateMesh("C:/Users/Dell/OneDrive/Documents/3D-Assets/Models/sponza/sponza.gltf", sponzaOptions);
 	{
 		ecs::Entity e1 = scene->CreateMesh("C:/Users/Dell/OneDrive/Documents/3D-Assets/Models/damagedHelmet/damagedHelmet.gltf");
 		TransformComponent* transform = compMgr->GetComponent<TransformComponent>(e1);
@@ -50,4 +53,31 @@ void InitializeAOScene(Scene* scene) {
 	ecs::Entity e0 = scene->CreateMesh("C:/Users/Dell/OneDrive/Documents/3D-Assets/Models/dragon/dragon.glb");
 	ecs::Entity sphere = scene->CreateSphere("Sphere");
 	compMgr->GetComponent<TransformComponent>(sphere)->position = glm::vec3(0.0f, 1.0f, 3.0f);
+}
+
+// 50k cubes sharing the prefab mesh, drawn with one instanced draw
+void InitializeInstancingScene(Scene* scene) {
+	Camera* camera = scene->GetCamera();
+	camera->SetPosition({ 0.0f, 20.0f, 0.0f });
+	camera->SetRotation({ 0.0f, -glm::pi<float>() * 0.5f, 0.0f });
+	camera->SetNearPlane(0.2f);
+	camera->SetFarPlane(500.0f);
+
+	auto compMgr = scene->GetComponentManager();
+	const int gridSize = 224;
+	const float spacing = 2.0f;
+	const float halfSize = gridSize * spacing * 0.5f;
+	for (int z = 0; z < gridSize; ++z)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			ecs::Entity cube = scene->CreateCube("Cube");
+			TransformComponent* transform = compMgr->GetComponent<TransformComponent>(cube);
+			transform->position = glm::vec3(x * spacing - halfSize, MathUtils::Rand01() * 4.0f, z * spacing - halfSize);
+			transform->scale = glm::vec3(0.5f + MathUtils::Rand01() * 0.5f);
+
+			MaterialComponent* material = compMgr->GetComponent<MaterialComponent>(cube);
+			material->albedo = glm::vec4(MathUtils::Rand01(), MathUtils::Rand01(), MathUtils::Rand01(), 1.0f);
+		}
+	}
 }
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "AABBTree.h"
+
+#include <algorithm>
+#include <cassert>
+
+static BoundingBox Union(const BoundingBox& lhs, const BoundingBox& rhs)
+{
+	return BoundingBox(glm::min(lhs.min, rhs.min), glm::max(lhs.max, rhs.max));
+}
+
+static float Area(const BoundingBox& aabb)
+{
+	const glm::vec3 size = aabb.max - aabb.min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool Contains(const BoundingBox& outer, const BoundingBox& inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+		outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+uint32_t AABBTree::Insert(const BoundingBox& aabb, uint32_t userData)
+{
+	const uint32_t leaf = allocateNode();
+	Node& node = mNodes[leaf];
+	node.aabb = BoundingBox(aabb.min - glm::vec3(mMargin), aabb.max + glm::vec3(mMargin));
+	node.userData = userData;
+	node.height = 0;
+
+	insertLeaf(leaf);
+	mProxyCount++;
+	return leaf;
+}
+
+void AABBTree::Remove(uint32_t proxy)
+{
+	assert(proxy < mNodes.size() && mNodes[proxy].IsLeaf());
+	removeLeaf(proxy);
+	freeNode(proxy);
+	mProxyCount--;
+}
+
+bool AABBTree::Update(uint32_t proxy, const BoundingBox& aabb)
+{
+	assert(proxy < mNodes.size() && mNodes[proxy].IsLeaf());
+	if (Contains(mNodes[proxy].aabb, aabb))
+		return false;
+
+	removeLeaf(proxy);
+	mNodes[proxy].aabb = BoundingBox(aabb.min - glm::vec3(mMargin), aabb.max + glm::vec3(mMargin));
+	insertLeaf(proxy);
+	return true;
+}
+
+void AABBTree::Clear()
+{
+	mNodes.clear();
+	mRoot = kInvalidNode;
+	mFreeList = kInvalidNode;
+	mProxyCount = 0;
+}
+
+float AABBTree::GetAreaRatio() const
+{
+	if (mRoot == kInvalidNode)
+		return 0.0f;
+
+	const float rootArea = Area(mNodes[mRoot].aabb);
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	float totalArea = 0.0f;
+	std::vector<uint32_t> stack{ mRoot };
+	while (!stack.empty())
+	{
+		const Node& node = mNodes[stack.back()];
+		stack.pop_back();
+		if (node.IsLeaf())
+			continue;
+
+		totalArea += Area(node.aabb);
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+	return totalArea / rootArea;
+}
+
+uint32_t AABBTree::allocateNode()
+{
+	uint32_t index = mFreeList;
+	if (index != kInvalidNode)
+		mFreeList = mNodes[index].parent;
+	else
+	{
+		index = static_cast<uint32_t>(mNodes.size());
+		mNodes.emplace_back();
+	}
+
+	Node& node = mNodes[index];
+	node.parent = kInvalidNode;
+	node.child1 = kInvalidNode;
+	node.child2 = kInvalidNode;
+	node.height = 0;
+	node.userData = kInvalidNode;
+	return index;
+}
+
+void AABBTree::freeNode(uint32_t node)
+{
+	mNodes[node].parent = mFreeList;
+	mNodes[node].height = kInvalidNode;
+	mFreeList = node;
+}
+
+void AABBTree::insertLeaf(uint32_t leaf)
+{
+	if (mRoot == kInvalidNode)
+	{
+		mRoot = leaf;
+		mNodes[leaf].parent = kInvalidNode;
+		return;
+	}
+
+	/*
+	* Descend toward the child with the lowest cost. Cost of a sibling is
+	* the area of the new parent plus the area added to the ancestors, the
+	* search stops when pairing with the current node is the cheapest.
+	*/
+	const BoundingBox leafBox = mNodes[leaf].aabb;
+	auto childCost = [&](uint32_t child, float inheritedCost) {
+		const float area = Area(Union(leafBox, mNodes[child].aabb));
+		return (mNodes[child].IsLeaf() ? area : area - Area(mNodes[child].aabb)) + inheritedCost;
+	};
+
+	uint32_t sibling = mRoot;
+	while (!mNodes[sibling].IsLeaf())
+	{
+		const Node& node = mNodes[sibling];
+		const float combinedArea = Area(Union(node.aabb, leafBox));
+		const float cost = 2.0f * combinedArea;
+		const float inheritedCost = 2.0f * (combinedArea - Area(node.aabb));
+
+		const float cost1 = childCost(node.child1, inheritedCost);
+		const float cost2 = childCost(node.child2, inheritedCost);
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		sibling = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	// New parent takes the place of the sibling
+	const uint32_t oldParent = mNodes[sibling].parent;
+	const uint32_t newParent = allocateNode();
+	Node& parent = mNodes[newParent];
+	parent.parent = oldParent;
+	parent.aabb = Union(leafBox, mNodes[sibling].aabb);
+	parent.height = mNodes[sibling].height + 1;
+	parent.child1 = sibling;
+	parent.child2 = leaf;
+	mNodes[sibling].parent = newParent;
+	mNodes[leaf].parent = newParent;
+
+	if (oldParent == kInvalidNode)
+		mRoot = newParent;
+	else if (mNodes[oldParent].child1 == sibling)
+		mNodes[oldParent].child1 = newParent;
+	else
+		mNodes[oldParent].child2 = newParent;
+
+	refit(oldParent);
+}
+
+void AABBTree::removeLeaf(uint32_t leaf)
+{
+	if (leaf == mRoot)
+	{
+		mRoot = kInvalidNode;
+		return;
+	}
+
+	const uint32_t parent = mNodes[leaf].parent;
+	const uint32_t grandParent = mNodes[parent].parent;
+	const uint32_t sibling = mNodes[parent].child1 == leaf ? mNodes[parent].child2 : mNodes[parent].child1;
+
+	// Sibling takes the place of the parent
+	mNodes[sibling].parent = grandParent;
+	if (grandParent == kInvalidNode)
+		mRoot = sibling;
+	else if (mNodes[grandParent].child1 == parent)
+		mNodes[grandParent].child1 = sibling;
+	else
+		mNodes[grandParent].child2 = sibling;
+
+	freeNode(parent);
+	refit(grandParent);
+}
+
+void AABBTree::refit(uint32_t node)
+{
+	while (node != kInvalidNode)
+	{
+		Node& current = mNodes[node];
+		current.aabb = Union(mNodes[current.child1].aabb, mNodes[current.child2].aabb);
+		current.height = std::max(mNodes[current.child1].height, mNodes[current.child2].height) + 1;
+
+		rotate(node);
+		node = mNodes[node].parent;
+	}
+}
+
+/*
+* Swap a child of the node with a grandchild on the other side when it
+* reduces the area of the child that receives it. The node box itself
+* doesn't change, so only the box of the modified child is recomputed.
+*/
+void AABBTree::rotate(uint32_t node)
+{
+	Node& a = mNodes[node];
+	const uint32_t b = a.child1;
+	const uint32_t c = a.child2;
+
+	enum Rotation { None, BF, BG, CD, CE };
+	Rotation rotation = None;
+	float bestReduction = 0.0f;
+
+	if (!mNodes[c].IsLeaf())
+	{
+		const float area = Area(mNodes[c].aabb);
+		const uint32_t f = mNodes[c].child1;
+		const uint32_t g = mNodes[c].child2;
+
+		// B <-> F, C becomes B + G
+		float reduction = area - Area(Union(mNodes[b].aabb, mNodes[g].aabb));
+		if (reduction > bestReduction)
+		{
+			bestReduction = reduction;
+			rotation = BF;
+		}
+
+		// B <-> G, C becomes B + F
+		reduction = area - Area(Union(mNodes[b].aabb, mNodes[f].aabb));
+		if (reduction > bestReduction)
+		{
+			bestReduction = reduction;
+			rotation = BG;
+		}
+	}
+
+	if (!mNodes[b].IsLeaf())
+	{
+		const float area = Area(mNodes[b].aabb);
+		const uint32_t d = mNodes[b].child1;
+		const uint32_t e = mNodes[b].child2;
+
+		// C <-> D, B becomes C + E
+		float reduction = area - Area(Union(mNodes[c].aabb, mNodes[e].aabb));
+		if (reduction > bestReduction)
+		{
+			bestReduction = reduction;
+			rotation = CD;
+		}
+
+		// C <-> E, B becomes C + D
+		reduction = area - Area(Union(mNodes[c].aabb, mNodes[d].aabb));
+		if (reduction > bestReduction)
+		{
+			bestReduction = reduction;
+			rotation = CE;
+		}
+	}
+
+	if (rotation == None)
+		return;
+
+	// Child of the node is swapped with the grandchild under the other child
+	const bool intoC = rotation == BF || rotation == BG;
+	const uint32_t child = intoC ? b : c;
+	const uint32_t target = intoC ? c : b;
+	Node& targetNode = mNodes[target];
+	const bool first = rotation == BF || rotation == CD;
+	const uint32_t grandChild = first ? targetNode.child1 : targetNode.child2;
+
+	if (first)
+		targetNode.child1 = child;
+	else
+		targetNode.child2 = child;
+	mNodes[child].parent = target;
+
+	if (intoC)
+		a.child1 = grandChild;
+	else
+		a.child2 = grandChild;
+	mNodes[grandChild].parent = node;
+
+	targetNode.aabb = Union(mNodes[targetNode.child1].aabb, mNodes[targetNode.child2].aabb);
+	targetNode.height = std::max(mNodes[targetNode.child1].height, mNodes[targetNode.child2].height) + 1;
+	a.height = std::max(mNodes[a.child1].height, mNodes[a.child2].height) + 1;
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "MathUtils.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+* Dynamic bounding volume hierarchy over axis aligned boxes. Leaves keep
+* a box enlarged by the margin so small movements don't touch the tree.
+* New leaves are paired with the sibling of the lowest surface area cost
+* and the ancestors are refit with the tree rotations that reduce the
+* surface area, so the tree stays good without a full rebuild.
+*/
+class AABBTree
+{
+public:
+	static constexpr uint32_t kInvalidNode = ~0u;
+
+	AABBTree() = default;
+	AABBTree(const AABBTree&) = delete;
+	void operator=(const AABBTree&) = delete;
+
+	// Returns the proxy id of the new leaf
+	uint32_t Insert(const BoundingBox& aabb, uint32_t userData);
+	void Remove(uint32_t proxy);
+
+	// Returns true if the leaf is reinserted, boxes inside the enlarged box keep the leaf
+	bool Update(uint32_t proxy, const BoundingBox& aabb);
+
+	void Clear();
+
+	void SetMargin(float margin) { mMargin = margin; }
+
+	uint32_t GetUserData(uint32_t proxy) const { return mNodes[proxy].userData; }
+	const BoundingBox& GetFatAABB(uint32_t proxy) const { return mNodes[proxy].aabb; }
+	uint32_t GetProxyCount() const { return mProxyCount; }
+	uint32_t GetHeight() const { return mRoot == kInvalidNode ? 0 : mNodes[mRoot].height; }
+
+	// Sum of the internal node areas divided by the root area, lower is better
+	float GetAreaRatio() const;
+
+	/*
+	* Call func(userData) for each leaf inside all the planes, normals point
+	* inward. Subtree fully inside a plane skips the test of that plane and
+	* subtree inside all the planes is reported without any test.
+	*/
+	template<typename Func>
+	void QueryPlanes(const Plane* planes, uint32_t planeCount, const Func& func) const;
+
+	template<typename Func>
+	void QueryFrustum(const Frustum& frustum, const Func& func) const
+	{
+		QueryPlanes(frustum.planes.data(), static_cast<uint32_t>(frustum.planes.size()), func);
+	}
+
+	template<typename Func>
+	void QueryAABB(const BoundingBox& aabb, const Func& func) const;
+
+	template<typename Func>
+	void QuerySphere(const glm::vec3& center, float radius, const Func& func) const;
+
+	/*
+	* Call func(userData, maxDistance) for each leaf hit by the ray closer
+	* than maxDistance. The returned distance clips the ray, so the nodes
+	* behind the closest hit found so far are skipped.
+	*/
+	template<typename Func>
+	void QueryRay(const Ray& ray, float maxDistance, const Func& func) const;
+
+private:
+	struct Node
+	{
+		BoundingBox aabb;
+		// Next free node when the node is not used
+		uint32_t parent;
+		uint32_t child1;
+		uint32_t child2;
+		uint32_t height;
+		uint32_t userData;
+
+		bool IsLeaf() const { return child1 == kInvalidNode; }
+	};
+
+	std::vector<Node> mNodes;
+	uint32_t mRoot = kInvalidNode;
+	uint32_t mFreeList = kInvalidNode;
+	uint32_t mProxyCount = 0;
+	float mMargin = 0.1f;
+
+	uint32_t allocateNode();
+	void freeNode(uint32_t node);
+
+	void insertLeaf(uint32_t leaf);
+	void removeLeaf(uint32_t leaf);
+	// Refit the boxes and the heights from the node up to the root
+	void refit(uint32_t node);
+	void rotate(uint32_t node);
+
+	template<typename Func>
+	void reportSubtree(uint32_t node, const Func& func, std::vector<uint32_t>& stack) const;
+};
+
+inline bool Overlaps(const BoundingBox& lhs, const BoundingBox& rhs)
+{
+	return lhs.min.x <= rhs.max.x && lhs.max.x >= rhs.min.x &&
+		lhs.min.y <= rhs.max.y && lhs.max.y >= rhs.min.y &&
+		lhs.min.z <= rhs.max.z && lhs.max.z >= rhs.min.z;
+}
+
+template<typename Func>
+void AABBTree::reportSubtree(uint32_t node, const Func& func, std::vector<uint32_t>& stack) const
+{
+	const std::size_t base = stack.size();
+	stack.push_back(node);
+	while (stack.size() > base)
+	{
+		const Node& current = mNodes[stack.back()];
+		stack.pop_back();
+		if (current.IsLeaf())
+			func(current.userData);
+		else
+		{
+			stack.push_back(current.child1);
+			stack.push_back(current.child2);
+		}
+	}
+}
+
+template<typename Func>
+void AABBTree::QueryPlanes(const Plane* planes, uint32_t planeCount, const Func& func) const
+{
+	if (mRoot == kInvalidNode)
+		return;
+
+	// Node and the mask of the planes still intersecting the parent
+	std::vector<std::pair<uint32_t, uint32_t>> stack;
+	std::vector<uint32_t> subtree;
+	stack.reserve(64);
+	stack.push_back({ mRoot, (1u << planeCount) - 1 });
+	while (!stack.empty())
+	{
+		auto [index, mask] = stack.back();
+		stack.pop_back();
+
+		const Node& node = mNodes[index];
+		const glm::vec3 center = node.aabb.GetCenter();
+		const glm::vec3 extent = node.aabb.max - center;
+
+		bool outside = false;
+		for (uint32_t i = 0; i < planeCount && !outside; ++i)
+		{
+			if ((mask & (1u << i)) == 0)
+				continue;
+
+			const Plane& plane = planes[i];
+			const float distance = glm::dot(plane.normal, center) + plane.distance;
+			const float radius = glm::dot(glm::abs(plane.normal), extent);
+			if (distance < -radius)
+				outside = true;
+			else if (distance >= radius)
+				mask &= ~(1u << i);
+		}
+
+		if (outside)
+			continue;
+
+		if (mask == 0)
+			reportSubtree(index, func, subtree);
+		else if (node.IsLeaf())
+			func(node.userData);
+		else
+		{
+			stack.push_back({ node.child1, mask });
+			stack.push_back({ node.child2, mask });
+		}
+	}
+}
+
+template<typename Func>
+void AABBTree::QueryAABB(const BoundingBox& aabb, const Func& func) const
+{
+	if (mRoot == kInvalidNode)
+		return;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(mRoot);
+	while (!stack.empty())
+	{
+		const Node& node = mNodes[stack.back()];
+		stack.pop_back();
+		if (!Overlaps(node.aabb, aabb))
+			continue;
+
+		if (node.IsLeaf())
+			func(node.userData);
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+template<typename Func>
+void AABBTree::QuerySphere(const glm::vec3& center, float radius, const Func& func) const
+{
+	if (mRoot == kInvalidNode)
+		return;
+
+	const float radiusSq = radius * radius;
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(mRoot);
+	while (!stack.empty())
+	{
+		const Node& node = mNodes[stack.back()];
+		stack.pop_back();
+
+		// Distance from the center to the closest point of the box
+		const glm::vec3 closest = glm::clamp(center, node.aabb.min, node.aabb.max);
+		const glm::vec3 delta = closest - center;
+		if (glm::dot(delta, delta) > radiusSq)
+			continue;
+
+		if (node.IsLeaf())
+			func(node.userData);
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+template<typename Func>
+void AABBTree::QueryRay(const Ray& ray, float maxDistance, const Func& func) const
+{
+	if (mRoot == kInvalidNode)
+		return;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(mRoot);
+	while (!stack.empty())
+	{
+		const Node& node = mNodes[stack.back()];
+		stack.pop_back();
+
+		float tNear = 0.0f;
+		if (!IntersectRayAABB(ray, node.aabb, maxDistance, tNear))
+			continue;
+
+		if (node.IsLeaf())
+			maxDistance = std::min(maxDistance, func(node.userData, maxDistance));
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
@@ -5,7 +5,9 @@
 #include "VulkanGraphicsDevice.h"
 #include "Scene.h"
 #include "Profiler.h"
+#include "JobSystem.h"
 #include "TextureCache.h"
+#include "TransferQueue.h"
 #include "DebugDraw.h"
 #include "StringConstants.h"
 #include "GUI/ImGuiService.h"
@@ -28,8 +30,10 @@ void Application::initialize_()
 	}
 
 	Logger::Initialize();
+	JobSystem::Initialize();
 	Input::Initialize(window);
 	TextureCache::Initialize();
+	TransferQueue::Initialize();
 	ShaderPath::LoadStringPath();
 
    	mScene.Initialize();
@@ -59,14 +63,28 @@ void Application::Run()
 		mInitialized = true;
 	}
 
+	if (!mRenderThread.joinable())
+	{
+		mRenderThreadRunning = true;
+		mRenderThread = std::thread(&Application::renderLoop_, this);
+	}
+
 	mDeltaTime = float(std::max(0.0, mTimer.elapsed())) * 0.001f;
 	mTimer.record();
 	const float dt = mDeltaTime;
 	mElapsedTime += dt;
 
+	// Runs while the render thread is recording the previous frame
 	update_(dt);
 
-	render_();
+	waitForRender_();
+
+	// Render thread is idle, GPU resources and UI are only touched here
+	Input::Update(window);
+	PostUpdate(dt);
+	mScene.UpdateResources();
+	mRenderer->SwapFrame();
+	mRenderer->UpdateUI();
 
 	mWindowTitle << "CPU Time: " << timer.elapsedMilliseconds() << "ms ";
 	mWindowTitle << "FPS: " << 1.0f / mDeltaTime << " FrameTime: " << mDeltaTime * 1000.0f << "ms ";
@@ -75,6 +93,12 @@ void Application::Run()
 	
 	Profiler::EndRangeCPU(totalTime);
 	Profiler::EndFrame();
+
+	{
+		std::lock_guard<std::mutex> lock(mRenderMutex);
+		mRenderRequested = true;
+	}
+	mRenderCondition.notify_all();
 }
 
 void Application::update_(float dt)
@@ -82,8 +106,8 @@ void Application::update_(float dt)
 	PreUpdate(dt);
 	mScene.Update(dt);
 	mRenderer->Update(dt);
-	Input::Update(window);
-	PostUpdate(dt);
+	// Changes made after this point are consumed in the next frame
+	mScene.GetComponentManager()->ClearChanges();
 }
 
 void Application::render_()
@@ -109,6 +133,44 @@ void Application::render_()
 
 }
 
+void Application::renderLoop_()
+{
+	std::unique_lock<std::mutex> lock(mRenderMutex);
+	while (true)
+	{
+		mRenderCondition.wait(lock, [this]() { return mRenderRequested || !mRenderThreadRunning; });
+		if (!mRenderRequested)
+			break;
+
+		lock.unlock();
+		render_();
+		lock.lock();
+
+		mRenderRequested = false;
+		mRenderCondition.notify_all();
+	}
+}
+
+void Application::waitForRender_()
+{
+	std::unique_lock<std::mutex> lock(mRenderMutex);
+	mRenderCondition.wait(lock, [this]() { return !mRenderRequested; });
+}
+
+void Application::stopRenderThread_()
+{
+	if (!mRenderThread.joinable())
+		return;
+
+	// Last requested frame is recorded before the thread exits
+	{
+		std::lock_guard<std::mutex> lock(mRenderMutex);
+		mRenderThreadRunning = false;
+	}
+	mRenderCondition.notify_all();
+	mRenderThread.join();
+}
+
 void Application::SetWindow(Platform::WindowType window, bool fullscreen)
 {
 	this->window = window;
@@ -137,11 +199,14 @@ void Application::SetWindow(Platform::WindowType window, bool fullscreen)
 Application::~Application()
 {
 	// Wait for rendering to finish
+	stopRenderThread_();
 	ui::ImGuiService::GetInstance()->Shutdown();
 	TextureCache::Shutdown();
 	mScene.Shutdown();
+	TransferQueue::Shutdown();
 	mRenderer->Shutdown();
 	mDevice->Shutdown();
+	JobSystem::Shutdown();
 }
 
 bool Application::windowResizeEvent(const Event& evt)
@@ -12,6 +12,9 @@
 
 #include <sstream>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 class Renderer;
 
@@ -50,6 +53,11 @@ protected:
 
 	void render_();
 
+	// Frame N is recorded by the render thread while frame N + 1 is updated
+	void renderLoop_();
+	void waitForRender_();
+	void stopRenderThread_();
+
 	Timer mTimer;
 
 	bool mInitialized = false;
@@ -72,6 +80,12 @@ protected:
 
 	bool bRunning = true;
 
+	std::thread mRenderThread;
+	std::mutex mRenderMutex;
+	std::condition_variable mRenderCondition;
+	bool mRenderRequested = false;
+	bool mRenderThreadRunning = false;
+
 	bool windowResizeEvent(const Event& event);
 	
 };
\ No newline at end of file
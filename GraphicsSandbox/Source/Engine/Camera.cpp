@@ -52,6 +52,20 @@ glm::vec4 Camera::ComputeViewSpaceCoordinate(const glm::vec3& p)
 	return mView * glm::vec4(p, 1.0f);
 }
 
+Ray Camera::ComputeRay(const glm::vec2& uv) const
+{
+	// Inverse of ComputeNDCCoordinate on the near and the far plane
+	const glm::vec2 ndc = glm::vec2(uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f);
+	const glm::mat4 invViewProjection = mInvView * mInvProjection;
+
+	glm::vec4 nearPoint = invViewProjection * glm::vec4(ndc.x, ndc.y, 0.0f, 1.0f);
+	glm::vec4 farPoint = invViewProjection * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+	nearPoint /= nearPoint.w;
+	farPoint /= farPoint.w;
+
+	return Ray(glm::vec3(nearPoint), glm::normalize(glm::vec3(farPoint - nearPoint)));
+}
+
 void Camera::CalculateProjection()
 {
 	mProjection = glm::perspective(mFov, mAspect, mNearPlane, mFarPlane);
@@ -96,6 +96,9 @@ public:
 	glm::vec4 ComputeNDCCoordinate(const glm::vec3& p);
 	glm::vec4 ComputeViewSpaceCoordinate(const glm::vec3& p);
 
+	// World space ray through the screen point, uv is in 0-1 range with Y pointing down
+	Ray ComputeRay(const glm::vec2& uv) const;
+
 	glm::vec3 GetForward() { return mForward; }
 	glm::vec3 GetPosition() const { return mPosition; }
 	
@@ -12,10 +12,12 @@
 
 #include "ECS.h"
 
+// Instance of a mesh draw, indices are relative to the batch
 struct PerObjectData
 {
 	uint32_t transformIndex;
 	uint32_t materialIndex;
+	uint32_t drawIndex;
 };
 
 inline bool IsTextureValid(uint32_t texture)
@@ -95,12 +97,20 @@ struct DrawData
 	uint32_t meshletOffset;
 	gfx::BufferView vertexBuffer;
 	gfx::BufferView indexBuffer;
+	gfx::IndexType indexType;
 	gfx::BufferHandle meshletVertexBuffer;
 	gfx::BufferHandle meshletTriangleBuffer;
 	gfx::BufferHandle meshletBuffer;
 
 	glm::vec4 boundingSphere;
 
+	uint32_t lodCount;
+	MeshLod lods[kMaxLODs];
+
+	VertexFormat vertexFormat;
+	// Mesh space bounds, compact positions are quantized in it
+	BoundingBox boundingBox;
+
 	uint32_t elmSize;
 	ecs::Entity entity;
 };
@@ -168,7 +178,11 @@ struct IMeshRenderer
 		Empty = 0,
 		Renderable = 1 << 0,
 		DoubleSided = 1 << 1,
-		Skinned = 1 << 2
+		Skinned = 1 << 2,
+		// Vertex buffer holds CompactVertex quantized in the bounding box
+		CompactVertices = 1 << 3,
+		// Index buffer holds 16 bit indices
+		ShortIndices = 1 << 4
 	};
 
 	uint32_t flags = Renderable;
@@ -182,6 +196,10 @@ struct IMeshRenderer
 	uint32_t meshletOffset;
 	uint32_t meshletCount;
 
+	// Generated levels of detail, offsets are in the index and meshlet buffers, empty draws the range above
+	uint32_t lodCount = 0;
+	MeshLod lods[kMaxLODs];
+
 	BoundingBox boundingBox;
 	glm::vec4 boundingSphere;
 
@@ -199,9 +217,19 @@ struct IMeshRenderer
 		if (value) flags |= DoubleSided; else flags &= ~DoubleSided;
 	}
 
+	void SetCompactVertices(bool value) {
+		if (value) flags |= CompactVertices; else flags &= ~CompactVertices;
+	}
+
+	void SetShortIndices(bool value) {
+		if (value) flags |= ShortIndices; else flags &= ~ShortIndices;
+	}
+
 	bool IsRenderable() const { return flags & Renderable; }
 	bool IsDoubleSided() const { return flags & DoubleSided; }
 	bool IsSkinned() const { return flags & Skinned; }
+	bool HasCompactVertices() const { return flags & CompactVertices; }
+	gfx::IndexType GetIndexType() const { return (flags & ShortIndices) ? gfx::IndexType::UInt16 : gfx::IndexType::UInt32; }
 
 	virtual uint32_t GetIndexCount() const = 0;
 
@@ -217,7 +245,7 @@ struct MeshRenderer : public IMeshRenderer
 	}
 
 	uint32_t GetIndexCount() const override {
-		return indexBuffer.byteLength / sizeof(uint32_t);
+		return indexBuffer.byteLength / gfx::GetIndexSize(GetIndexType());
 	}
 
 	virtual ~MeshRenderer() {
@@ -245,8 +273,13 @@ struct SkinnedMeshRenderer : public IMeshRenderer
 	}
 	
 	uint32_t GetIndexCount() const override {
-		return static_cast<uint32_t>(indexBuffer.byteLength / sizeof(uint32_t));
+		return static_cast<uint32_t>(indexBuffer.byteLength / gfx::GetIndexSize(GetIndexType()));
 	}
 
 	virtual ~SkinnedMeshRenderer() = default;
 };
+
+// Renderer keeps pointers to these components while the scene is
+// being populated so the storage must not move them when it grows
+template<> struct ecs::ComponentStorage<MeshRenderer> { using type = ecs::ChunkedStorage<MeshRenderer>; };
+template<> struct ecs::ComponentStorage<MaterialComponent> { using type = ecs::ChunkedStorage<MaterialComponent>; };
@@ -4,6 +4,7 @@
 #include "Utils.h"
 
 #include <algorithm>
+#include <mutex>
 
 bool gEnableDebugDraw = false;
 gfx::PipelineHandle gPipeline = gfx::INVALID_PIPELINE;
@@ -12,9 +13,6 @@ gfx::BufferHandle gBuffer = gfx::INVALID_BUFFER;
 gfx::BufferHandle gPrimitiveBuffer = gfx::INVALID_BUFFER;
 gfx::PipelineHandle gPrimitivePipeline = gfx::INVALID_PIPELINE;
 
-uint32_t gDataOffset = 0;
-uint32_t gPrimBufferOffset = 0;
-
 const uint32_t kMaxDebugData = 100'000;
 
 struct DebugData
@@ -35,7 +33,13 @@ struct Quad {
 	}
 };
 
+// Primitives are added by both the update and the render thread, the pending
+// list is handed to Draw() by Submit() when the threads are synchronized
+std::mutex gMutex;
+std::vector<DebugData> gLines;
 std::vector<Quad> gQuadPrimitive;
+std::vector<DebugData> gSubmittedLines;
+std::vector<Quad> gSubmittedQuads;
 
 DebugData* gDataBufferPtr = nullptr;
 DebugData* gPrimitiveBufferPtr = nullptr;
@@ -95,16 +99,9 @@ void DebugDraw::AddLine(const glm::vec3& start, const glm::vec3& end, uint32_t c
 	if (!gEnableDebugDraw)
 		return;
 
-	assert(gDataBufferPtr != nullptr);
-	DebugData* data = gDataBufferPtr + gDataOffset;
-	data->position = start;
-	data->color = color;
-	gDataOffset++;
-
-	data = data + 1;
-	data->position = end;
-	data->color = color;
-	gDataOffset++;
+	std::lock_guard<std::mutex> lock(gMutex);
+	gLines.push_back({ start, color });
+	gLines.push_back({ end, color });
 }
 
 void DebugDraw::AddAABB(const glm::vec3& min, const glm::vec3& max, uint32_t color)
@@ -158,6 +155,7 @@ void DebugDraw::AddQuadPrimitive(const glm::vec3& p0, const glm::vec3& p1, const
 	if (!gEnableDebugDraw)
 		return;
 
+	std::lock_guard<std::mutex> lock(gMutex);
 	gQuadPrimitive.emplace_back(Quad{ p0, p1, p2, p3, color });
 
 }
@@ -193,40 +191,40 @@ void DebugDraw::AddFrustumPrimitive(const std::array<glm::vec3, 8>& points, uint
 	AddQuadPrimitive(nbr, ntr, ftr, fbr, color);
 }
 
-static void AddQuadInternal(Quad& quad) {
+static void AddQuadInternal(const Quad& quad, uint32_t& primitiveOffset) {
 
 	assert(gPrimitiveBufferPtr != nullptr);
 
-	DebugData* data = gPrimitiveBufferPtr + gPrimBufferOffset;
+	DebugData* data = gPrimitiveBufferPtr + primitiveOffset;
 
 	data->position = quad.p0;
 	data->color = quad.color;
-	gPrimBufferOffset++;
+	primitiveOffset++;
 	data++;
 
 	data->position = quad.p1;
 	data->color = quad.color;
-	gPrimBufferOffset++;
+	primitiveOffset++;
 	data++;
 
 	data->position = quad.p2;
 	data->color = quad.color;
-	gPrimBufferOffset++;
+	primitiveOffset++;
 	data++;
 
 	data->position = quad.p0;
 	data->color = quad.color;
-	gPrimBufferOffset++;
+	primitiveOffset++;
 	data++;
 
 	data->position = quad.p2;
 	data->color = quad.color;
-	gPrimBufferOffset++;
+	primitiveOffset++;
 	data++;
 
 	data->position = quad.p3;
 	data->color = quad.color;
-	gPrimBufferOffset++;
+	primitiveOffset++;
 }
 
 void DebugDraw::AddFrustum(const glm::vec3* points, uint32_t count, uint32_t color)
@@ -254,44 +252,62 @@ void DebugDraw::AddFrustum(const glm::vec3* points, uint32_t count, uint32_t col
 }
 
 
+void DebugDraw::Submit()
+{
+	std::lock_guard<std::mutex> lock(gMutex);
+	gSubmittedLines.swap(gLines);
+	gSubmittedQuads.swap(gQuadPrimitive);
+	gLines.clear();
+	gQuadPrimitive.clear();
+}
+
 void DebugDraw::Draw(gfx::CommandList* commandList, glm::mat4 VP, const glm::vec3& camPos)
 {
-	if (gQuadPrimitive.size() > 0) {
+	uint32_t primitiveOffset = 0;
+	if (gSubmittedQuads.size() > 0) {
 
-		std::sort(gQuadPrimitive.begin(), gQuadPrimitive.end(), [&camPos](const Quad& a, const Quad& b) {
+		std::sort(gSubmittedQuads.begin(), gSubmittedQuads.end(), [&camPos](const Quad& a, const Quad& b) {
 
 			float d1 = glm::distance2(a.getCenter(), camPos);
 			float d2 = glm::distance2(b.getCenter(), camPos);
 			return d1 > d2;
 		});
 
-		for (auto& quad : gQuadPrimitive)
-			AddQuadInternal(quad);
-
-		gQuadPrimitive.clear();
+		for (auto& quad : gSubmittedQuads)
+		{
+			if (primitiveOffset + 6 > kMaxDebugData)
+				break;
+			AddQuadInternal(quad, primitiveOffset);
+		}
 	}
+
+	assert(gDataBufferPtr != nullptr);
+	const uint32_t lineCount = std::min(static_cast<uint32_t>(gSubmittedLines.size()), kMaxDebugData);
+	if (lineCount > 0)
+		std::copy(gSubmittedLines.begin(), gSubmittedLines.begin() + lineCount, gDataBufferPtr);
+
 	if (gEnableDebugDraw)
 	{
 		auto device = gfx::GetDevice();
-		if (gDataOffset > 0) {
-			gfx::DescriptorInfo descriptorInfo = { gBuffer, 0, (uint32_t)(gDataOffset * sizeof(DebugData)), gfx::DescriptorType::StorageBuffer };
+		if (lineCount > 0) {
+			gfx::DescriptorInfo descriptorInfo = { gBuffer, 0, (uint32_t)(lineCount * sizeof(DebugData)), gfx::DescriptorType::StorageBuffer };
 			device->UpdateDescriptor(gPipeline, &descriptorInfo, 1);
 			device->BindPipeline(commandList, gPipeline);
 			device->PushConstants(commandList, gPipeline, gfx::ShaderStage::Vertex, &VP[0][0], sizeof(glm::mat4), 0);
-			device->Draw(commandList, gDataOffset, 0, 1);
+			device->Draw(commandList, lineCount, 0, 1);
 		}
 
-		if (gPrimBufferOffset > 0) {
-			gfx::DescriptorInfo descriptorInfo = { gPrimitiveBuffer, 0, (uint32_t)(gPrimBufferOffset * sizeof(DebugData)), gfx::DescriptorType::StorageBuffer };
+		if (primitiveOffset > 0) {
+			gfx::DescriptorInfo descriptorInfo = { gPrimitiveBuffer, 0, (uint32_t)(primitiveOffset * sizeof(DebugData)), gfx::DescriptorType::StorageBuffer };
 			device->UpdateDescriptor(gPrimitivePipeline, &descriptorInfo, 1);
 			device->BindPipeline(commandList, gPrimitivePipeline);
 			device->PushConstants(commandList, gPrimitivePipeline, gfx::ShaderStage::Vertex, &VP[0][0], sizeof(glm::mat4), 0);
-			device->Draw(commandList, gPrimBufferOffset, 0, 1);
+			device->Draw(commandList, primitiveOffset, 0, 1);
 		}
 
 	}
-	gPrimBufferOffset = 0;
-	gDataOffset = 0;
+	gSubmittedLines.clear();
+	gSubmittedQuads.clear();
 }
 
 void DebugDraw::Shutdown()
@@ -28,6 +28,9 @@ namespace DebugDraw
 	*/
 	void AddFrustum(const glm::vec3* points, uint32_t count = 8, uint32_t color = 0xff0000);
 
+	// Hand the primitives added since the last call to Draw(), called when the render thread is idle
+	void Submit();
+
 	void Draw(gfx::CommandList* commandList, glm::mat4 VP, const glm::vec3& camPos);
 
 	void Shutdown();
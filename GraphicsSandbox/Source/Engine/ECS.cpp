@@ -1,24 +1,137 @@
 #include "ECS.h"
+
+#include <deque>
+
 namespace ecs
 {
+	// Number of destroyed index that is kept before it is recycled,
+	// delaying the reuse so that the generation doesn't wrap too often
+	constexpr uint32_t kMinFreeIndices = 1024;
+
+	// Index 0 is reserved for INVALID_ENTITY
+	static std::vector<uint8_t> gGenerations(1, 0);
+	static std::deque<uint32_t> gFreeIndices;
+
+	static std::array<uint64_t, MAX_COMPONENTS> gComponentTypeHashes;
+	static uint32_t gComponentTypeCount = 0;
+
+	uint32_t RegisterComponentType(uint64_t typeHash)
+	{
+		for (uint32_t i = 0; i < gComponentTypeCount; ++i)
+		{
+			if (gComponentTypeHashes[i] == typeHash)
+				return i;
+		}
+
+		assert(gComponentTypeCount < MAX_COMPONENTS);
+		gComponentTypeHashes[gComponentTypeCount] = typeHash;
+		return gComponentTypeCount++;
+	}
+
+	Entity CreateEntity()
+	{
+		uint32_t index = 0;
+		if (gFreeIndices.size() > kMinFreeIndices)
+		{
+			index = gFreeIndices.front();
+			gFreeIndices.pop_front();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(gGenerations.size());
+			assert(index <= ENTITY_INDEX_MASK);
+			gGenerations.push_back(0);
+		}
+		return MakeEntity(index, gGenerations[index]);
+	}
+
+	uint32_t GetAvailableEntityCount()
+	{
+		// Free indices are only recycled above the minimum
+		const uint32_t unused = ENTITY_INDEX_MASK + 1 - static_cast<uint32_t>(gGenerations.size());
+		const uint32_t recyclable = static_cast<uint32_t>(gFreeIndices.size());
+		return unused + (recyclable > kMinFreeIndices ? recyclable - kMinFreeIndices : 0);
+	}
+
+	bool IsAlive(Entity entity)
+	{
+		const uint32_t index = GetEntityIndex(entity);
+		return IsValid(entity) && index < gGenerations.size() && gGenerations[index] == GetEntityGeneration(entity);
+	}
+
+	static void ReleaseEntity(Entity entity)
+	{
+		const uint32_t index = GetEntityIndex(entity);
+		gGenerations[index]++;
+		gFreeIndices.push_back(index);
+	}
+
 	void DestroyEntity(ComponentManager* mgr, Entity& entity)
 	{
-		for (uint32_t i = 0; i < MAX_COMPONENTS; ++i)
+		if (!IsAlive(entity))
+			return;
+
+		// Only visit the component arrays that contains the entity
+		Signature signature = mgr->GetSignature(entity);
+		for (uint32_t i = 0; signature != 0; ++i, signature >>= 1)
 		{
-			std::shared_ptr<IComponentArray> comp = mgr->GetBaseComponentArray(i);
+			if ((signature & 1) == 0) continue;
+
+			IComponentArray* comp = mgr->GetBaseComponentArray(i);
 			if(comp)
 				comp->removeEntity(entity);
 		}
+
+		if (GetEntityIndex(entity) < mgr->signatures.size())
+			mgr->signatures[GetEntityIndex(entity)] = 0;
+
+		ReleaseEntity(entity);
 		entity = 0;
 	}
 
-	void Destroy(ComponentManager* mgr)
+	void DestroyEntities(ComponentManager* mgr, const Entity* entities, uint32_t count)
 	{
-		for (uint32_t i = 0; i < MAX_COMPONENTS; ++i)
+		Signature combined = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (IsAlive(entities[i]))
+				combined |= mgr->GetSignature(entities[i]);
+		}
+
+		// Remove all the entities from one component array before moving to the next
+		for (uint32_t compId = 0; combined != 0; ++compId, combined >>= 1)
+		{
+			if ((combined & 1) == 0) continue;
+
+			IComponentArray* comp = mgr->GetBaseComponentArray(compId);
+			if (comp == nullptr) continue;
+
+			const Signature mask = Signature(1) << compId;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				Entity entity = entities[i];
+				if (IsAlive(entity) && (mgr->GetSignature(entity) & mask))
+					comp->removeEntity(entity);
+			}
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
 		{
-			std::shared_ptr<IComponentArray> comp = mgr->GetBaseComponentArray(i);
-			comp.reset();
+			const Entity entity = entities[i];
+			if (!IsAlive(entity)) continue;
+
+			if (GetEntityIndex(entity) < mgr->signatures.size())
+				mgr->signatures[GetEntityIndex(entity)] = 0;
+			ReleaseEntity(entity);
 		}
 	}
 
-}
\ No newline at end of file
+	void Destroy(ComponentManager* mgr)
+	{
+		// Group hold the reference to component array
+		mgr->groupMap.clear();
+		for (uint32_t i = 0; i < MAX_COMPONENTS; ++i)
+			mgr->componentArray[i].reset();
+	}
+
+}
@@ -4,8 +4,14 @@
 #include <array>
 #include <memory>
 #include <unordered_map>
-
-#include <stdint.h>
+#include <algorithm>
+#include <tuple>
+#include <iterator>
+#include <type_traits>
+#include <new>
+
+#include <cstdint>
+#include <cstddef>
 #include <cassert>
 
 
@@ -15,27 +21,284 @@ namespace ecs
 	using ComponentType = std::uint8_t;
 	const uint8_t MAX_COMPONENTS = 64;
 
+	/*
+	* Entity handle stores the index in the lower bits and the
+	* generation in the upper bits. Generation is incremented
+	* when the index is recycled so the stale handle doesn't 
+	* resolve to the newly created entity.
+	*/
 	using Entity = std::uint32_t;
+	using Signature = std::uint64_t;
+
+	constexpr uint32_t ENTITY_INDEX_BITS = 24;
+	constexpr uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+	constexpr uint32_t ENTITY_GENERATION_MASK = 0xff;
 
 	inline bool IsValid(Entity entity) {
 		return entity != INVALID_ENTITY;
 	}
+
+	inline uint32_t GetEntityIndex(Entity entity) {
+		return entity & ENTITY_INDEX_MASK;
+	}
+
+	inline uint32_t GetEntityGeneration(Entity entity) {
+		return (entity >> ENTITY_INDEX_BITS) & ENTITY_GENERATION_MASK;
+	}
+
+	inline Entity MakeEntity(uint32_t index, uint32_t generation) {
+		return ((generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK);
+	}
 	/*
-	* This doesn't seem to work when the dll is made and
-	* called from exe?
+	* FNV-1a hash of the type name computed at compile time. The name
+	* is same in every module so the hash can be used to identify the
+	* type across the DLL boundary unlike the address of static variable.
 	*/
-	static uint32_t GetId()
+	template<typename T>
+	constexpr uint64_t TypeHash()
 	{
-		static uint32_t gComponentId = 0;
-		return gComponentId++;
+#if defined(_MSC_VER)
+		const char* name = __FUNCSIG__;
+#else
+		const char* name = __PRETTY_FUNCTION__;
+#endif
+		uint64_t hash = 0xcbf29ce484222325;
+		while (*name) {
+			hash ^= static_cast<uint64_t>(*name);
+			hash *= 0x00000100000001b3;
+			++name;
+		}
+		return hash;
 	}
 
+	/*
+	* Returns the sequential id for the type hash. The registry lives in 
+	* ECS.cpp so every module that links the engine resolves the same id.
+	*/
+	uint32_t RegisterComponentType(uint64_t typeHash);
+
+	// Resolved once during static initialization, after that it's a plain load
+	template<typename T>
+	struct ComponentTypeId
+	{
+		static constexpr uint64_t hash = TypeHash<T>();
+		static inline const uint32_t value = RegisterComponentType(hash);
+	};
+
 	class IComponentArray
 	{
 	public:
 		virtual ~IComponentArray() = default;
 
 		virtual bool removeEntity(Entity& handle) { return false; }
+
+		virtual void clearChanges() {}
+	};
+
+	/*
+	* Group that owns a set of component arrays and keeps the
+	* entities that have all the components packed at the front
+	* of every owned array in the same order.
+	*/
+	class IGroup
+	{
+	public:
+		virtual ~IGroup() = default;
+
+		virtual void onAdd(Entity entity) = 0;
+		virtual void onRemove(Entity entity) = 0;
+	};
+
+	/*
+	* Maps entity index to the index in the dense component array.
+	* Sparse array is allocated in fixed size pages so that the
+	* memory stays bounded even when the entity ids are sparse.
+	*/
+	class SparseIndex
+	{
+	public:
+		static constexpr uint32_t kPageSize = 4096;
+		static constexpr uint32_t kInvalidIndex = ~0u;
+
+		SparseIndex() = default;
+		SparseIndex(const SparseIndex&) = delete;
+		void operator=(const SparseIndex&) = delete;
+
+		inline uint32_t get(Entity entity) const
+		{
+			const uint32_t entityIndex = GetEntityIndex(entity);
+			const std::size_t page = entityIndex / kPageSize;
+			if (page < pages_.size() && pages_[page])
+				return pages_[page][entityIndex % kPageSize];
+			return kInvalidIndex;
+		}
+
+		inline void set(Entity entity, uint32_t index)
+		{
+			const uint32_t entityIndex = GetEntityIndex(entity);
+			assure(entityIndex / kPageSize)[entityIndex % kPageSize] = index;
+		}
+
+		inline void reset(Entity entity)
+		{
+			const uint32_t entityIndex = GetEntityIndex(entity);
+			const std::size_t page = entityIndex / kPageSize;
+			if (page < pages_.size() && pages_[page])
+				pages_[page][entityIndex % kPageSize] = kInvalidIndex;
+		}
+
+	private:
+		uint32_t* assure(std::size_t page)
+		{
+			if (page >= pages_.size())
+				pages_.resize(page + 1);
+
+			if (!pages_[page])
+			{
+				pages_[page] = std::make_unique<uint32_t[]>(kPageSize);
+				std::fill(pages_[page].get(), pages_[page].get() + kPageSize, kInvalidIndex);
+			}
+			return pages_[page].get();
+		}
+
+		std::vector<std::unique_ptr<uint32_t[]>> pages_;
+	};
+
+	/*
+	* Dense storage allocated in fixed size blocks. Growing never moves
+	* the existing elements so the pointer to a component stays valid
+	* when other components are added. Removing still moves the last
+	* element into the removed slot to keep the storage packed.
+	*/
+	template<typename T, uint32_t BlockSize = 256>
+	class ChunkedStorage
+	{
+	public:
+		static_assert((BlockSize & (BlockSize - 1)) == 0, "BlockSize must be power of two");
+		static constexpr uint32_t kBlockSize = BlockSize;
+
+		class iterator
+		{
+		public:
+			using iterator_category = std::random_access_iterator_tag;
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+			using pointer = T*;
+			using reference = T&;
+
+			iterator() = default;
+			iterator(ChunkedStorage* storage, std::size_t index) : storage_(storage), index_(index) {}
+
+			reference operator*() const { return (*storage_)[index_]; }
+			pointer operator->() const { return &(*storage_)[index_]; }
+			reference operator[](difference_type n) const { return (*storage_)[index_ + n]; }
+
+			iterator& operator++() { ++index_; return *this; }
+			iterator operator++(int) { iterator it = *this; ++index_; return it; }
+			iterator& operator--() { --index_; return *this; }
+			iterator operator--(int) { iterator it = *this; --index_; return it; }
+			iterator& operator+=(difference_type n) { index_ += n; return *this; }
+			iterator& operator-=(difference_type n) { index_ -= n; return *this; }
+
+			friend iterator operator+(iterator it, difference_type n) { return it += n; }
+			friend iterator operator+(difference_type n, iterator it) { return it += n; }
+			friend iterator operator-(iterator it, difference_type n) { return it -= n; }
+			friend difference_type operator-(const iterator& lhs, const iterator& rhs) {
+				return static_cast<difference_type>(lhs.index_) - static_cast<difference_type>(rhs.index_);
+			}
+
+			friend bool operator==(const iterator& lhs, const iterator& rhs) { return lhs.index_ == rhs.index_; }
+			friend bool operator!=(const iterator& lhs, const iterator& rhs) { return lhs.index_ != rhs.index_; }
+			friend bool operator<(const iterator& lhs, const iterator& rhs) { return lhs.index_ < rhs.index_; }
+			friend bool operator>(const iterator& lhs, const iterator& rhs) { return lhs.index_ > rhs.index_; }
+			friend bool operator<=(const iterator& lhs, const iterator& rhs) { return lhs.index_ <= rhs.index_; }
+			friend bool operator>=(const iterator& lhs, const iterator& rhs) { return lhs.index_ >= rhs.index_; }
+
+		private:
+			ChunkedStorage* storage_ = nullptr;
+			std::size_t index_ = 0;
+		};
+
+		ChunkedStorage() = default;
+		ChunkedStorage(const ChunkedStorage&) = delete;
+		void operator=(const ChunkedStorage&) = delete;
+
+		~ChunkedStorage()
+		{
+			clear();
+			for (T* block : blocks_)
+				::operator delete(block, std::align_val_t(alignof(T)));
+		}
+
+		inline T& operator[](std::size_t index) { return blocks_[index / kBlockSize][index % kBlockSize]; }
+		inline const T& operator[](std::size_t index) const { return blocks_[index / kBlockSize][index % kBlockSize]; }
+
+		inline std::size_t size() const { return size_; }
+		inline bool empty() const { return size_ == 0; }
+
+		T& back() { return (*this)[size_ - 1]; }
+
+		template<typename ...Args>
+		T& emplace_back(Args&& ...args)
+		{
+			// Blocks are kept after pop_back() and reused
+			if (size_ == blocks_.size() * kBlockSize)
+				blocks_.push_back(static_cast<T*>(::operator new(sizeof(T) * kBlockSize, std::align_val_t(alignof(T)))));
+
+			T* element = new (&blocks_[size_ / kBlockSize][size_ % kBlockSize]) T(std::forward<Args>(args)...);
+			size_++;
+			return *element;
+		}
+
+		void push_back(T&& value) { emplace_back(std::move(value)); }
+		void push_back(const T& value) { emplace_back(value); }
+
+		void pop_back()
+		{
+			assert(size_ > 0);
+			back().~T();
+			size_--;
+		}
+
+		void clear()
+		{
+			while (size_ > 0)
+				pop_back();
+		}
+
+		iterator begin() { return iterator(this, 0); }
+		iterator end() { return iterator(this, size_); }
+
+		// Returns the index of the element or ~0u if the pointer doesn't belong to the storage
+		uint32_t indexOf(const T* val) const
+		{
+			for (std::size_t i = 0; i < blocks_.size(); ++i)
+			{
+				const T* block = blocks_[i];
+				if (val >= block && val < block + kBlockSize)
+				{
+					const std::size_t index = i * kBlockSize + (val - block);
+					return index < size_ ? static_cast<uint32_t>(index) : ~0u;
+				}
+			}
+			return ~0u;
+		}
+
+	private:
+		std::vector<T*> blocks_;
+		std::size_t size_ = 0;
+	};
+
+	/*
+	* Storage used by ComponentArray<T>, the default is contiguous std::vector.
+	* Specialize it to ChunkedStorage<T> for the components whose address
+	* has to stay stable, e.g:
+	* template<> struct ecs::ComponentStorage<Foo> { using type = ecs::ChunkedStorage<Foo>; };
+	*/
+	template<typename T>
+	struct ComponentStorage
+	{
+		using type = std::vector<T>;
 	};
 
 	template<typename T>
@@ -50,17 +313,25 @@ namespace ecs
 
 		T& addComponent(Entity entity) {
 			assert(components.size() == entities.size());
-			assert(entities.size() == lookup_.size());
 			assert(IsValid(entity));
 
-			auto found = lookup_.find(entity);
-			if (found != lookup_.end())
-				return components[found->second];
+			uint32_t index = find(entity);
+			if (index != SparseIndex::kInvalidIndex)
+				return components[index];
 
-			lookup_[entity] = components.size();
+			// Entity with old generation should have been removed when destroyed
+			assert(lookup_.get(entity) == SparseIndex::kInvalidIndex);
+			lookup_.set(entity, (uint32_t)components.size());
 			components.emplace_back();
 			entities.push_back(entity);
+			changeFlags_.push_back(kAdded);
+			added_.push_back(entity);
 
+			if (group_)
+			{
+				group_->onAdd(entity);
+				return components[find(entity)];
+			}
 			return components.back();
 		}
 
@@ -68,63 +339,185 @@ namespace ecs
 		T& addComponent(Entity entity, Args&& ...args)
 		{
 			assert(components.size() == entities.size());
-			assert(entities.size() == lookup_.size());
+			assert(IsValid(entity));
 
-			auto found = lookup_.find(entity);
-			if (found != lookup_.end())
-				return components[found->second];
+			uint32_t index = find(entity);
+			if (index != SparseIndex::kInvalidIndex)
+				return components[index];
 
-			lookup_[entity] = components.size();
+			// Entity with old generation should have been removed when destroyed
+			assert(lookup_.get(entity) == SparseIndex::kInvalidIndex);
+			lookup_.set(entity, (uint32_t)components.size());
 			components.push_back(T(std::forward<Args>(args)...));
 			entities.push_back(entity);
+			changeFlags_.push_back(kAdded);
+			added_.push_back(entity);
+
+			if (group_)
+			{
+				group_->onAdd(entity);
+				return components[find(entity)];
+			}
 			return components.back();
 		}
 
+		// Append the components of the entities that doesn't have it yet
+		void addComponents(const Entity* entityList, const T* data, uint32_t count) {
+			assert(components.size() == entities.size());
+			if constexpr (std::is_same_v<Storage, std::vector<T>>)
+				components.reserve(components.size() + count);
+			entities.reserve(entities.size() + count);
+			changeFlags_.reserve(changeFlags_.size() + count);
+
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				assert(IsValid(entityList[i]) && !contains(entityList[i]));
+				lookup_.set(entityList[i], (uint32_t)entities.size());
+				entities.push_back(entityList[i]);
+				changeFlags_.push_back(kAdded);
+			}
+			added_.insert(added_.end(), entityList, entityList + count);
+
+			if constexpr (std::is_same_v<Storage, std::vector<T>>)
+				components.insert(components.end(), data, data + count);
+			else
+			{
+				for (uint32_t i = 0; i < count; ++i)
+					components.push_back(data[i]);
+			}
+
+			if (group_)
+			{
+				for (uint32_t i = 0; i < count; ++i)
+					group_->onAdd(entityList[i]);
+			}
+		}
+
 		bool removeComponent(Entity entity) {
-			auto found = lookup_.find(entity);
-			if (found != lookup_.end())
+			if (!contains(entity))
+				return false;
+
+			// Move the entity out of the group range before removing
+			if (group_)
+				group_->onRemove(entity);
+
+			uint32_t index = find(entity);
+			const uint32_t last = (uint32_t)components.size() - 1;
+			if (index != last)
 			{
-				uint64_t index = found->second;
 				components[index] = std::move(components.back());
 				entities[index] = entities.back();
-				lookup_[entities[index]] = index;
-				lookup_.erase(entity);
-				components.pop_back();
-				entities.pop_back();
-				return true;
+				changeFlags_[index] = changeFlags_.back();
+				lookup_.set(entities[index], index);
 			}
-			return false;
+			lookup_.reset(entity);
+			components.pop_back();
+			entities.pop_back();
+			changeFlags_.pop_back();
+			removed_.push_back(entity);
+			return true;
+		}
+
+		inline bool contains(Entity entity) const {
+			return find(entity) != SparseIndex::kInvalidIndex;
+		}
+
+		// Returns the index in the dense array, the generation of the entity must match
+		inline uint32_t find(Entity entity) const {
+			uint32_t index = lookup_.get(entity);
+			if (index != SparseIndex::kInvalidIndex && entities[index] == entity)
+				return index;
+			return SparseIndex::kInvalidIndex;
+		}
+
+		// Swap the position of two element in the dense array
+		void swapEntries(uint32_t lhs, uint32_t rhs) {
+			if (lhs == rhs) return;
+			std::swap(components[lhs], components[rhs]);
+			std::swap(entities[lhs], entities[rhs]);
+			std::swap(changeFlags_[lhs], changeFlags_[rhs]);
+			lookup_.set(entities[lhs], lhs);
+			lookup_.set(entities[rhs], rhs);
 		}
 
 		bool removeEntity(Entity& entity) override {
 			return removeComponent(entity);
 		}
 
+		/*
+		* Change tracking, the list of added, removed and modified entities
+		* are accumulated until clearChanges() is called once per frame.
+		* Modification isn't detected automatically, the system that writes
+		* to the component has to call markModified().
+		*/
+		void markModified(Entity entity) {
+			uint32_t index = find(entity);
+			if (index == SparseIndex::kInvalidIndex || changeFlags_[index] != 0)
+				return;
+
+			changeFlags_[index] = kModified;
+			modified_.push_back(entity);
+		}
+
+		// Returns true if the entity is added or modified since last clearChanges()
+		bool isChanged(Entity entity) const {
+			uint32_t index = find(entity);
+			return index != SparseIndex::kInvalidIndex && changeFlags_[index] != 0;
+		}
+
+		bool hasChanges() const {
+			return added_.size() > 0 || removed_.size() > 0 || modified_.size() > 0;
+		}
+
+		bool hasStructuralChanges() const {
+			return added_.size() > 0 || removed_.size() > 0;
+		}
+
+		// Entity in the list might be removed afterwards
+		const std::vector<Entity>& getAdded() const { return added_; }
+		const std::vector<Entity>& getRemoved() const { return removed_; }
+		const std::vector<Entity>& getModified() const { return modified_; }
+
+		void clearChanges() override {
+			for (Entity entity : added_) {
+				uint32_t index = find(entity);
+				if (index != SparseIndex::kInvalidIndex) changeFlags_[index] = 0;
+			}
+
+			for (Entity entity : modified_) {
+				uint32_t index = find(entity);
+				if (index != SparseIndex::kInvalidIndex) changeFlags_[index] = 0;
+			}
+			added_.clear();
+			removed_.clear();
+			modified_.clear();
+		}
+
 		T* getComponent(Entity entity) {
-			auto found = lookup_.find(entity);
-			if (found != lookup_.end())
-				return &components[found->second];
+			uint32_t index = find(entity);
+			if (index != SparseIndex::kInvalidIndex)
+				return &components[index];
 			return nullptr;
 		}
 
 		std::size_t GetIndex(Entity entity)
 		{
-			auto found = lookup_.find(entity);
-			if (found != lookup_.end())
-				return found->second;
+			uint32_t index = find(entity);
+			if (index != SparseIndex::kInvalidIndex)
+				return index;
 			return ~0ull;
 		}
 
-		template<typename T>
 		uint32_t GetIndex(const T* val)
 		{
-			auto found = std::find_if(components.begin(), components.end(), [val](T& comp) {
-				return &comp == val;
-			});
-
-			if (found != components.end())
-				return (uint32_t)std::distance(components.begin(), found);
-			return -1;
+			if constexpr (std::is_same_v<Storage, std::vector<T>>)
+			{
+				if (components.size() > 0 && val >= components.data() && val < components.data() + components.size())
+					return (uint32_t)(val - components.data());
+				return ~0u;
+			}
+			else
+				return components.indexOf(val);
 		}
 
 		std::size_t GetCount()
@@ -132,10 +525,142 @@ namespace ecs
 			return components.size();
 		}
 		
+		using Storage = typename ComponentStorage<T>::type;
+
 		std::vector<Entity> entities;
-		std::vector<T> components;
+		Storage components;
 	private:
-		std::unordered_map<uint32_t, uint64_t> lookup_;
+		SparseIndex lookup_;
+		IGroup* group_ = nullptr;
+
+		static constexpr uint8_t kAdded = 1;
+		static constexpr uint8_t kModified = 2;
+		std::vector<uint8_t> changeFlags_;
+		std::vector<Entity> added_;
+		std::vector<Entity> removed_;
+		std::vector<Entity> modified_;
+
+		template<typename ...Ts>
+		friend class Group;
+	};
+
+	/*
+	* Non-owning view over multiple component arrays. Iteration is
+	* driven by the smallest array and the remaining components are
+	* fetched through the sparse index.
+	* Adding or removing the viewed components inside each() is not allowed.
+	*/
+	template<typename ...Ts>
+	class View
+	{
+	public:
+		View(ComponentArray<Ts>*... arrays) : arrays_{ arrays... } {}
+
+		template<typename Func>
+		void each(Func func)
+		{
+			const std::vector<Entity>* entities = nullptr;
+			std::apply([&entities](auto*... arrays) {
+				((entities = (entities == nullptr || arrays->entities.size() < entities->size()) ? &arrays->entities : entities), ...);
+				}, arrays_);
+
+			for (std::size_t i = 0; i < entities->size(); ++i)
+			{
+				const Entity entity = (*entities)[i];
+				if ((std::get<ComponentArray<Ts>*>(arrays_)->contains(entity) && ...))
+					func(entity, *std::get<ComponentArray<Ts>*>(arrays_)->getComponent(entity)...);
+			}
+		}
+
+		// Upper bound of the number of entities visited by each()
+		std::size_t sizeHint() const
+		{
+			std::size_t count = ~0ull;
+			std::apply([&count](auto*... arrays) {
+				((count = std::min(count, arrays->entities.size())), ...);
+				}, arrays_);
+			return count;
+		}
+
+	private:
+		std::tuple<ComponentArray<Ts>*...> arrays_;
+	};
+
+	/*
+	* Owning group over multiple component arrays. The entities that have
+	* all the components are kept in the range [0, size()) of every owned
+	* array with matching order, so the iteration is a linear walk without
+	* any lookup. A component array can only be owned by a single group.
+	* Adding or removing a component to an owned array reorders it, so the
+	* reference/index to the component of other entities can change.
+	*/
+	template<typename ...Ts>
+	class Group : public IGroup
+	{
+	public:
+		Group(ComponentArray<Ts>*... arrays) : arrays_{ arrays... }
+		{
+			((assert(arrays->group_ == nullptr && "ComponentArray is already owned by other group"), arrays->group_ = this), ...);
+
+			auto* first = std::get<0>(arrays_);
+			for (std::size_t i = 0; i < first->entities.size(); ++i)
+				onAdd(first->entities[i]);
+		}
+
+		Group(const Group&) = delete;
+		void operator=(const Group&) = delete;
+
+		void onAdd(Entity entity) override
+		{
+			if (!(std::get<ComponentArray<Ts>*>(arrays_)->contains(entity) && ...))
+				return;
+
+			if (std::get<0>(arrays_)->find(entity) < size_)
+				return;
+
+			(std::get<ComponentArray<Ts>*>(arrays_)->swapEntries(std::get<ComponentArray<Ts>*>(arrays_)->find(entity), size_), ...);
+			size_++;
+		}
+
+		void onRemove(Entity entity) override
+		{
+			if (!(std::get<ComponentArray<Ts>*>(arrays_)->contains(entity) && ...))
+				return;
+
+			if (std::get<0>(arrays_)->find(entity) >= size_)
+				return;
+
+			size_--;
+			(std::get<ComponentArray<Ts>*>(arrays_)->swapEntries(std::get<ComponentArray<Ts>*>(arrays_)->find(entity), size_), ...);
+		}
+
+		template<typename Func>
+		void each(Func func)
+		{
+			const std::vector<Entity>& entities = std::get<0>(arrays_)->entities;
+			for (uint32_t i = 0; i < size_; ++i)
+				func(entities[i], std::get<ComponentArray<Ts>*>(arrays_)->components[i]...);
+		}
+
+		// Iterate the range [begin, end) of the group, disjoint ranges can be visited in parallel
+		template<typename Func>
+		void each(uint32_t begin, uint32_t end, Func func)
+		{
+			const std::vector<Entity>& entities = std::get<0>(arrays_)->entities;
+			for (uint32_t i = begin; i < end && i < size_; ++i)
+				func(entities[i], std::get<ComponentArray<Ts>*>(arrays_)->components[i]...);
+		}
+
+		uint32_t size() const { return size_; }
+
+		virtual ~Group()
+		{
+			((std::get<ComponentArray<Ts>*>(arrays_)->group_ = nullptr), ...);
+		}
+
+	private:
+		std::tuple<ComponentArray<Ts>*...> arrays_;
+		uint32_t size_ = 0;
 	};
 
 	struct ComponentManager
@@ -147,45 +672,38 @@ namespace ecs
 		template<typename T>
 		void RegisterComponent()
 		{
-			std::size_t compHash = typeid(T).hash_code();
-			auto found = componentIdMap.find(compHash);
-			if (found != componentIdMap.end())
-				return;
-			uint32_t id = GetId();
-			componentArray[id] = std::make_shared<ComponentArray<T>>();
-			componentIdMap.insert(std::make_pair(compHash, id));
+			uint32_t id = GetComponentTypeId<T>();
+			assert(id < MAX_COMPONENTS);
+			if (componentArray[id] == nullptr)
+				componentArray[id] = std::make_unique<ComponentArray<T>>();
 		}
 
 		template<typename T>
-		uint32_t GetComponentTypeId() {
-			std::size_t compHash = typeid(T).hash_code();
-			auto found = componentIdMap.find(compHash);
-			assert(found != componentIdMap.end());
-			return found->second;
+		inline uint32_t GetComponentTypeId() {
+			return ComponentTypeId<T>::value;
 		}
 
 		template<typename T>
-		inline std::shared_ptr<ComponentArray<T>> GetComponentArray()
+		inline ComponentArray<T>* GetComponentArray()
 		{
 			uint32_t compId = GetComponentTypeId<T>();
 			assert(compId < MAX_COMPONENTS);
-			return std::static_pointer_cast<ComponentArray<T>>(componentArray[compId]);
+			return static_cast<ComponentArray<T>*>(componentArray[compId].get());
 		}
 
 		template<typename T>
-		inline std::shared_ptr<ComponentArray<T>> GetComponentArray(int index)
+		inline ComponentArray<T>* GetComponentArray(int index)
 		{
-			return std::static_pointer_cast<ComponentArray<T>>(componentArray[index]);
+			return static_cast<ComponentArray<T>*>(componentArray[index].get());
 		}
 
-		inline std::shared_ptr<IComponentArray> GetBaseComponentArray(uint64_t index)
+		inline IComponentArray* GetBaseComponentArray(uint64_t index)
 		{
 			assert(index < MAX_COMPONENTS);
 
-			return componentArray[index];
+			return componentArray[index].get();
 		}
 
-
 		template<typename T>
 		bool HasComponent(const Entity& entity) {
 			uint32_t compId = GetComponentTypeId<T>();
@@ -195,8 +713,10 @@ namespace ecs
 
 		/*
 		* We should be careful when keeping this reference for future use.
-		* When the size of vector is not enough, the container is resized
-		* which invalidate all the reference and the pointer.
+		* With the default vector storage the container is resized when it
+		* is full which invalidate all the reference and the pointer.
+		* Components using ChunkedStorage stay valid while adding, only removing
+		* a component (or group reordering) moves the element.
 		*/
 		template<typename T>
 		T& AddComponent(Entity& entity)
@@ -205,6 +725,7 @@ namespace ecs
 			assert(compId < MAX_COMPONENTS);
 			auto comp = GetComponentArray<T>(compId);
 			assert(comp != nullptr);
+			AddToSignature(entity, compId);
 			return comp->addComponent(entity);
 		}
 
@@ -215,9 +736,23 @@ namespace ecs
 			assert(compId < MAX_COMPONENTS);
 			auto comp = GetComponentArray<T>();
 			assert(comp != nullptr);
+			AddToSignature(entity, compId);
 			return comp->addComponent(entity, std::forward<Args>(args)...);
 		}
 
+		// Bulk version of AddComponent, the components are copied
+		template<typename T>
+		void AddComponents(const Entity* entities, const T* components, uint32_t count)
+		{
+			uint32_t compId = GetComponentTypeId<T>();
+			assert(compId < MAX_COMPONENTS);
+			auto comp = GetComponentArray<T>(compId);
+			assert(comp != nullptr);
+			for (uint32_t i = 0; i < count; ++i)
+				AddToSignature(entities[i], compId);
+			comp->addComponents(entities, components, count);
+		}
+
 		template<typename T>
 		T* GetComponent(const Entity& entity)
 		{
@@ -237,20 +772,101 @@ namespace ecs
 			assert(compId < MAX_COMPONENTS);
 			auto comp = GetComponentArray<T>(compId);
 			assert(comp != nullptr);
+			RemoveFromSignature(entity, compId);
 			return comp->removeComponent(entity);
 		}
 
-		// Global Component Array
-		std::array<std::shared_ptr<IComponentArray>, MAX_COMPONENTS> componentArray;
-		std::unordered_map<std::size_t, uint32_t> componentIdMap;
+		// Bitmask of the component arrays that contains the entity
+		inline Signature GetSignature(Entity entity) const
+		{
+			const uint32_t index = GetEntityIndex(entity);
+			return index < signatures.size() ? signatures[index] : 0;
+		}
+
+		inline void AddToSignature(Entity entity, uint32_t compId)
+		{
+			const uint32_t index = GetEntityIndex(entity);
+			if (index >= signatures.size())
+				signatures.resize(index + 1, 0);
+			signatures[index] |= (Signature(1) << compId);
+		}
+
+		inline void RemoveFromSignature(Entity entity, uint32_t compId)
+		{
+			const uint32_t index = GetEntityIndex(entity);
+			if (index < signatures.size())
+				signatures[index] &= ~(Signature(1) << compId);
+		}
+
+		template<typename T>
+		void MarkModified(const Entity& entity)
+		{
+			ComponentArray<T>* comp = GetComponentArray<T>();
+			assert(comp != nullptr);
+			comp->markModified(entity);
+		}
+
+		// Reset the change tracking of all the component arrays, called once per frame
+		void ClearChanges()
+		{
+			for (auto& comp : componentArray)
+			{
+				if (comp) comp->clearChanges();
+			}
+		}
+
+		template<typename ...Ts>
+		ecs::View<Ts...> Query()
+		{
+			return ecs::View<Ts...>(GetComponentArray<Ts>()...);
+		}
+
+		/*
+		* Create a group that owns the component arrays of Ts.
+		* Owned arrays are sorted so that Group::each is a linear walk.
+		*/
+		template<typename ...Ts>
+		ecs::Group<Ts...>* CreateGroup()
+		{
+			uint64_t groupHash = TypeHash<ecs::Group<Ts...>>();
+			auto found = groupMap.find(groupHash);
+			if (found != groupMap.end())
+				return static_cast<ecs::Group<Ts...>*>(found->second.get());
+
+			auto group = std::make_unique<ecs::Group<Ts...>>(GetComponentArray<Ts>()...);
+			ecs::Group<Ts...>* result = group.get();
+			groupMap.insert(std::make_pair(groupHash, std::move(group)));
+			return result;
+		}
+
+		template<typename ...Ts>
+		ecs::Group<Ts...>* GetGroup()
+		{
+			auto found = groupMap.find(TypeHash<ecs::Group<Ts...>>());
+			assert(found != groupMap.end());
+			return static_cast<ecs::Group<Ts...>*>(found->second.get());
+		}
+
+		// Global Component Array indexed by ComponentTypeId
+		std::array<std::unique_ptr<IComponentArray>, MAX_COMPONENTS> componentArray;
+		std::unordered_map<uint64_t, std::unique_ptr<IGroup>> groupMap;
+		// Component signature indexed by the entity index
+		std::vector<Signature> signatures;
 	};
 
-	inline Entity CreateEntity()
-	{
-		static uint32_t id = 0;
-		return ++id;
-	}
+	// Returns the new entity, index of the destroyed entity is recycled with new generation
+	Entity CreateEntity();
+
+	// Number of entities that can still be created
+	uint32_t GetAvailableEntityCount();
+
+	// Returns true if the entity is not destroyed
+	bool IsAlive(Entity entity);
 
 	void DestroyEntity(ComponentManager* mgr, Entity& entity);
+
+	// Destroy all the entities removing them from each component array in a single pass
+	void DestroyEntities(ComponentManager* mgr, const Entity* entities, uint32_t count);
+
 	void Destroy(ComponentManager* mgr);
 }
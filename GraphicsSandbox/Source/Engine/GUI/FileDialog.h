@@ -24,6 +24,30 @@ public:
 			return std::wstring(szFile);
 #else 
     #error "Unsupported Platform"
+#endif
+		return std::wstring();
+	}
+
+	// Returns the path of the file to write, defaultExtension is appended when the user omits it
+	static std::wstring Save(const wchar_t* basePath, Platform::WindowType window, const wchar_t* filter, const wchar_t* defaultExtension)
+	{
+#ifdef PLATFORM_WINDOW
+		TCHAR szFile[256] = { 0 };
+		OPENFILENAME ofn;
+		ZeroMemory(&ofn, sizeof(ofn));
+		ofn.lStructSize = sizeof(ofn);
+		ofn.hwndOwner = Platform::GetWindowHandle(window);
+		ofn.lpstrFile = szFile;
+		ofn.nMaxFile = sizeof(szFile);
+		ofn.lpstrFilter = filter;
+		ofn.lpstrInitialDir = basePath;
+		ofn.lpstrDefExt = defaultExtension;
+		ofn.nFilterIndex = 1;
+		ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT | OFN_NOCHANGEDIR;
+		if (GetSaveFileName(&ofn) == TRUE)
+			return std::wstring(szFile);
+#else 
+    #error "Unsupported Platform"
 #endif
 		return std::wstring();
 	}
@@ -58,7 +58,7 @@ namespace ui {
 		ImGui::NewFrame();
 	}
 
-	void ImGuiService::Render(gfx::CommandList* commandList)
+	void ImGuiService::EndFrame()
 	{
 		if (!enabled) return;
 
@@ -78,10 +78,62 @@ namespace ui {
 			}
 			ImGui::Text("%s", ss.str().c_str());
 		}
+
+		std::vector<Profiler::CounterData> counterData;
+		Profiler::GetCounters(counterData);
+		if (counterData.size() > 0)
+		{
+			ImGui::Separator();
+			std::stringstream ss;
+			for (auto& data : counterData)
+				ss << data.name << " " << data.value << "\n";
+			ImGui::Text("%s", ss.str().c_str());
+		}
+
+		std::vector<Profiler::WorkerData> workerData;
+		Profiler::GetWorkerData(workerData);
+		if (workerData.size() > 0)
+		{
+			ImGui::Separator();
+			std::stringstream ss;
+			for (std::size_t i = 0; i < workerData.size(); ++i)
+			{
+				const auto& data = workerData[i];
+				ss << "Worker " << i << " " << std::setprecision(3) << data.utilization * 100.0f << "% jobs " << data.jobCount << " steals " << data.stealCount << "\n";
+			}
+			ImGui::Text("%s", ss.str().c_str());
+		}
 		ImGui::End();
 
 		ImGui::Render();
-		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), device->Get(commandList));
+
+		// Draw lists are reused by the next NewFrame(), keep a copy for the render thread
+		releaseDrawData();
+		ImDrawData* imDrawData = ImGui::GetDrawData();
+		drawData.Valid = imDrawData->Valid;
+		drawData.TotalIdxCount = imDrawData->TotalIdxCount;
+		drawData.TotalVtxCount = imDrawData->TotalVtxCount;
+		drawData.DisplayPos = imDrawData->DisplayPos;
+		drawData.DisplaySize = imDrawData->DisplaySize;
+		drawData.FramebufferScale = imDrawData->FramebufferScale;
+		drawData.OwnerViewport = imDrawData->OwnerViewport;
+		for (ImDrawList* drawList : imDrawData->CmdLists)
+			drawData.CmdLists.push_back(drawList->CloneOutput());
+		drawData.CmdListsCount = drawData.CmdLists.Size;
+	}
+
+	void ImGuiService::Render(gfx::CommandList* commandList)
+	{
+		if (!enabled || !drawData.Valid) return;
+
+		ImGui_ImplVulkan_RenderDrawData(&drawData, device->Get(commandList));
+	}
+
+	void ImGuiService::releaseDrawData()
+	{
+		for (ImDrawList* drawList : drawData.CmdLists)
+			IM_DELETE(drawList);
+		drawData.Clear();
 	}
 
 	void ImGuiService::AddImage(gfx::TextureHandle texture, const ImVec2& size)
@@ -108,6 +160,7 @@ namespace ui {
 
 	void ImGuiService::Shutdown()
 	{
+		releaseDrawData();
 		ImGui_ImplVulkan_Shutdown();
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
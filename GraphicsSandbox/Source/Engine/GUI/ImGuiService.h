@@ -26,6 +26,9 @@ namespace ui {
 
 		void NewFrame();
 
+		// Finish the UI of the frame and copy the draw data used by Render()
+		void EndFrame();
+
 		void Render(gfx::CommandList* commandList);
 
 		void AddImage(gfx::TextureHandle texture, const ImVec2& size = {256, 256});
@@ -36,5 +39,10 @@ namespace ui {
 
 		std::shared_ptr<gfx::VulkanGraphicsDevice> device;
 		bool enabled = true;
+
+	private:
+		ImDrawData drawData;
+
+		void releaseDrawData();
 	};
 };
\ No newline at end of file
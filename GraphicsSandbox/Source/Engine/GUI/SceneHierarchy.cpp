@@ -11,10 +11,41 @@
 namespace ui {
 
 	SceneHierarchy::SceneHierarchy(Scene* scene) : mScene(scene),
-		mSelected(ecs::INVALID_ENTITY)
+		mSelected(ecs::INVALID_ENTITY),
+		mHovered(ecs::INVALID_ENTITY)
 	{
 	}
 
+	void SceneHierarchy::UpdatePicking()
+	{
+		mHovered = ecs::INVALID_ENTITY;
+
+		ImGuiIO& io = ImGui::GetIO();
+		if (io.WantCaptureMouse || !ImGui::IsMousePosValid() || io.DisplaySize.x <= 0.0f || io.DisplaySize.y <= 0.0f)
+			return;
+
+		const glm::vec2 uv = glm::vec2(io.MousePos.x / io.DisplaySize.x, io.MousePos.y / io.DisplaySize.y);
+		RayHit hit;
+		if (!mScene->RayCast(mScene->GetCamera()->ComputeRay(uv), hit))
+			return;
+
+		// Left button also rotates the camera, only a click without dragging selects
+		mHovered = hit.entity;
+		const float dragThreshold = io.MouseDragThreshold * io.MouseDragThreshold;
+		if (ImGui::IsMouseReleased(ImGuiMouseButton_Left) && io.MouseDragMaxDistanceSqr[ImGuiMouseButton_Left] < dragThreshold)
+			mSelected = hit.entity;
+
+		auto componentManager = mScene->GetComponentManager();
+		MeshRenderer* meshRenderer = componentManager->GetComponent<MeshRenderer>(mHovered);
+		TransformComponent* transform = componentManager->GetComponent<TransformComponent>(mHovered);
+		if (meshRenderer && transform)
+		{
+			BoundingBox aabb = meshRenderer->boundingBox;
+			aabb.Transform(transform->worldMatrix);
+			DebugDraw::AddAABB(aabb.min, aabb.max, 0xffff00);
+		}
+	}
+
 	void SceneHierarchy::Update(float dt)
 	{
 		auto componentManager = mScene->GetComponentManager();
@@ -22,11 +53,13 @@ namespace ui {
 		{
 			if (mSelected != mScene->GetSun())
 			{
-				mScene->Destroy(mSelected);
+				mScene->DestroyHierarchy(mSelected);
 				mSelected = ecs::INVALID_ENTITY;
 			}
 		}
 
+		UpdatePicking();
+
 		auto lightComp = componentManager->GetComponent<LightComponent>(mSelected);
 		if (lightComp && lightComp->type == LightType::Point)
 		{
@@ -138,22 +171,28 @@ namespace ui {
 
 				// TransformComponent
 				TransformComponent* transform = componentManager->GetComponent<TransformComponent>(mSelected);
-				DrawTransformComponent(transform);
+				if (transform && DrawTransformComponent(transform))
+					componentManager->MarkModified<TransformComponent>(mSelected);
 
 				IMeshRenderer* meshRenderer = componentManager->GetComponent<MeshRenderer>(mSelected);
 				if (meshRenderer == nullptr)
 					meshRenderer = componentManager->GetComponent<SkinnedMeshRenderer>(mSelected);
-				if (meshRenderer)
-					DrawMeshRendererComponent(meshRenderer);
+				if (meshRenderer && DrawMeshRendererComponent(meshRenderer))
+				{
+					if (meshRenderer->IsSkinned())
+						componentManager->MarkModified<SkinnedMeshRenderer>(mSelected);
+					else
+						componentManager->MarkModified<MeshRenderer>(mSelected);
+				}
 
 				// MaterialCompoenent
 				MaterialComponent* material = componentManager->GetComponent<MaterialComponent>(mSelected);
-				if (material)
-					DrawMaterialComponent(material);
+				if (material && DrawMaterialComponent(material))
+					componentManager->MarkModified<MaterialComponent>(mSelected);
 
 				LightComponent* light = componentManager->GetComponent<LightComponent>(mSelected);
-				if (light)
-					DrawLightComponent(light);
+				if (light && DrawLightComponent(light))
+					componentManager->MarkModified<LightComponent>(mSelected);
 
 			}
 			else {
@@ -183,7 +222,7 @@ namespace ui {
 			{
 				std::wstring file = FileDialog::Open(L"", Application::window, L"Model(gltf/glb)\0*.gltf\0*.glb\0\0");
 				if (file.size() > 0)
-					mSelected = mScene->CreateMesh(Platform::WStringToString(file).c_str());
+					mSelected = mScene->CreateMeshAsync(Platform::WStringToString(file).c_str());
 			}
 
 			if (ImGui::Button("HDRI"))
@@ -197,16 +236,41 @@ namespace ui {
 		}
 	}
 
-	void SceneHierarchy::DrawTransformComponent(TransformComponent* transform)
+	void SceneHierarchy::CreateSnapshotTab()
+	{
+		if (ImGui::BeginTabItem("Snapshot"))
+		{
+			// Default entities aren't saved, loaded entities are added to the scene
+			const wchar_t* filter = L"Snapshot(snapshot)\0*.snapshot\0\0";
+			if (ImGui::Button("Save"))
+			{
+				std::wstring file = FileDialog::Save(L"", Application::window, filter, L"snapshot");
+				if (file.size() > 0)
+					mScene->SaveSnapshot(Platform::WStringToString(file));
+			}
+
+			if (ImGui::Button("Load"))
+			{
+				std::wstring file = FileDialog::Open(L"", Application::window, filter);
+				if (file.size() > 0)
+					mScene->LoadSnapshot(Platform::WStringToString(file));
+			}
+
+			ImGui::EndTabItem();
+		}
+	}
+
+	bool SceneHierarchy::DrawTransformComponent(TransformComponent* transform)
 	{
+		bool changed = false;
 		if (ImGui::CollapsingHeader("Transform Component", ImGuiTreeNodeFlags_DefaultOpen))
 		{
-			transform->dirty = ImGui::DragFloat3("Position", &transform->position[0]);
+			changed |= ImGui::DragFloat3("Position", &transform->position[0]);
 			glm::vec3 rotation = glm::degrees(glm::eulerAngles(transform->rotation));
 			if (ImGui::DragFloat3("Rotation", &rotation[0], 1.0f, -180.0f, 180.0f))
 			{
 				transform->rotation = glm::quat(glm::radians(rotation));
-				transform->dirty = true;
+				changed = true;
 			}
 
 			static bool uniform = true;
@@ -217,31 +281,34 @@ namespace ui {
 				if (ImGui::DragFloat("Scale", &scaleFactor, 0.01f, -1000.0f, 1000.0f))
 				{
 					transform->scale = { scaleFactor,scaleFactor, scaleFactor };
-					transform->dirty = true;
+					changed = true;
 				}
 			}
 			else
-				transform->dirty = ImGui::DragFloat3("Scale", &transform->scale[0], 0.01f, -1000.0f, 1000.0f);
+				changed |= ImGui::DragFloat3("Scale", &transform->scale[0], 0.01f, -1000.0f, 1000.0f);
 
 			glm::vec3 localPosition = glm::vec3(transform->defaultMatrix[3]);
 			ImGui::Text("LocalPosition: %.2f %.2f %.2f", localPosition.x, localPosition.y, localPosition.z);
 			ImGui::Separator();
 		}
+		transform->dirty |= changed;
+		return changed;
 	}
 
-	void SceneHierarchy::DrawMaterialComponent(MaterialComponent* material)
+	bool SceneHierarchy::DrawMaterialComponent(MaterialComponent* material)
 	{
+		bool changed = false;
 		if (ImGui::CollapsingHeader("Material Component", ImGuiTreeNodeFlags_DefaultOpen))
 		{
-			ImGui::ColorEdit3("Albedo", &material->albedo[0]);
-			ImGui::SliderFloat("Roughness", &material->roughness, 0.0f, 1.0f);
-			ImGui::SliderFloat("Metallic", &material->metallic, 0.0f, 1.0f);
-			ImGui::ColorEdit3("Emissive", &material->emissive[0]);
-			ImGui::SliderFloat("AO", &material->ao, 0.0f, 1.0f);
+			changed |= ImGui::ColorEdit3("Albedo", &material->albedo[0]);
+			changed |= ImGui::SliderFloat("Roughness", &material->roughness, 0.0f, 1.0f);
+			changed |= ImGui::SliderFloat("Metallic", &material->metallic, 0.0f, 1.0f);
+			changed |= ImGui::ColorEdit3("Emissive", &material->emissive[0]);
+			changed |= ImGui::SliderFloat("AO", &material->ao, 0.0f, 1.0f);
 
 			const char* blendModes = "ALPHAMODE_NONE\0ALPHAMODE_BLEND\0ALPHAMODE_MASK";
-			ImGui::Combo("AlphaMode", &material->alphaMode, blendModes);
-			ImGui::SliderFloat("Transparency", &material->transparency, 0.0f, 1.0f);
+			changed |= ImGui::Combo("AlphaMode", &material->alphaMode, blendModes);
+			changed |= ImGui::SliderFloat("Transparency", &material->transparency, 0.0f, 1.0f);
 
 			auto ShowTexture = [](uint32_t index, std::string textureType) {
 				std::string filename = "No File";
@@ -261,16 +328,18 @@ namespace ui {
 			ShowTexture(material->opacityMap, "Opacity");
 			ImGui::Separator();
 		}
+		return changed;
 	}
 
-	void SceneHierarchy::DrawLightComponent(LightComponent* light)
+	bool SceneHierarchy::DrawLightComponent(LightComponent* light)
 	{
+		bool changed = false;
 		if (ImGui::CollapsingHeader("Light Component", ImGuiTreeNodeFlags_DefaultOpen))
 		{
-			ImGui::Checkbox("Enable", &light->enabled);
-			ImGui::ColorPicker3("LightColor", &light->color[0]);
-			ImGui::SliderFloat("Intensity", &light->intensity, 0.0f, 100.0f);
-			ImGui::SliderFloat("Radius", &light->radius, 0.0f, 10.0f);
+			changed |= ImGui::Checkbox("Enable", &light->enabled);
+			changed |= ImGui::ColorPicker3("LightColor", &light->color[0]);
+			changed |= ImGui::SliderFloat("Intensity", &light->intensity, 0.0f, 100.0f);
+			changed |= ImGui::SliderFloat("Radius", &light->radius, 0.0f, 10.0f);
 
 			const char* lightTypes[] = {
 				"Directional",
@@ -281,23 +350,27 @@ namespace ui {
 			if (ImGui::Combo("Light Type", &currentItem, lightTypes, IM_ARRAYSIZE(lightTypes)))
 			{
 				light->type = (LightType)(currentItem);
+				changed = true;
 			}
 			ImGui::Separator();
 		}
+		return changed;
 	}
 
-	void SceneHierarchy::DrawMeshRendererComponent(IMeshRenderer* meshRenderer)
+	bool SceneHierarchy::DrawMeshRendererComponent(IMeshRenderer* meshRenderer)
 	{
+		bool changed = false;
 		const std::string title = meshRenderer->IsSkinned() ? "SkinnedMeshRenderer" : "MeshRenderer";
 		if (ImGui::CollapsingHeader(title.c_str()))
 		{
 			static bool isVisible = meshRenderer->IsRenderable();
 			ImGui::Checkbox("Visible", &isVisible);
+			changed |= meshRenderer->IsRenderable() != isVisible;
 			meshRenderer->SetRenderable(isVisible);
 
 			ImGui::Text("Bounding Box");
-			ImGui::DragFloat3("min", &meshRenderer->boundingBox.min[0]);
-			ImGui::DragFloat3("max", &meshRenderer->boundingBox.max[0]);
+			changed |= ImGui::DragFloat3("min", &meshRenderer->boundingBox.min[0]);
+			changed |= ImGui::DragFloat3("max", &meshRenderer->boundingBox.max[0]);
 			ImGui::Separator();
 
 
@@ -309,6 +382,7 @@ namespace ui {
 					skeleton.SetPoseMode(static_cast<PoseMode>(poseMode));
 			}
 		}
+		return changed;
 	}
 
 	void SceneHierarchy::AddUI()
@@ -320,6 +394,7 @@ namespace ui {
 				CreateHierarchyTab(componentManager);
 				CreateComponentTab(componentManager);
 				CreateObjectTab(componentManager);
+				CreateSnapshotTab();
 				ImGui::EndTabBar();
 			}
 		}
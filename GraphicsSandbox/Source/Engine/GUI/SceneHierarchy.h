@@ -12,6 +12,10 @@ namespace ui {
 	private:
 		Scene* mScene;
 		ecs::Entity mSelected;
+		// Mesh under the mouse cursor
+		ecs::Entity mHovered;
+
+		void UpdatePicking();
 
 		void CreateTreeNode(ecs::Entity entity, std::shared_ptr<ecs::ComponentManager> compMgr);
 
@@ -25,12 +29,15 @@ namespace ui {
 
 		void CreateObjectTab(std::shared_ptr<ecs::ComponentManager> mgr);
 
-		void DrawTransformComponent(TransformComponent* transform);
+		void CreateSnapshotTab();
+
+		// Returns true if the component is edited
+		bool DrawTransformComponent(TransformComponent* transform);
 
-		void DrawMaterialComponent(MaterialComponent* material);
+		bool DrawMaterialComponent(MaterialComponent* material);
 
-		void DrawLightComponent(LightComponent* light);
+		bool DrawLightComponent(LightComponent* light);
 
-		void DrawMeshRendererComponent(IMeshRenderer* meshRenderer);
+		bool DrawMeshRendererComponent(IMeshRenderer* meshRenderer);
 	};
 }
\ No newline at end of file
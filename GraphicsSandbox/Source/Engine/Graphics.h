@@ -105,6 +105,14 @@ namespace gfx
 		Line
 	};
 
+	enum class IndexType
+	{
+		UInt16,
+		UInt32
+	};
+
+	inline uint32_t GetIndexSize(IndexType indexType) { return indexType == IndexType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+
 	enum class CullMode
 	{
 		Back,
@@ -213,7 +221,8 @@ namespace gfx
 		ColorAttachmentWrite,
 		TransferWriteBit,
 		TransferReadBit,
-		DrawCommandRead
+		DrawCommandRead,
+		MemoryRead
 	};
 
 	enum class PipelineStage
@@ -227,7 +236,8 @@ namespace gfx
 		BottomOfPipe,
 		Transfer,
 		ColorAttachmentOutput,
-		DrawIndirect
+		DrawIndirect,
+		AllCommands
 	};
 
 	enum ResourceBarrierType {
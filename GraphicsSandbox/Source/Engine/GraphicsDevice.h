@@ -20,11 +20,14 @@ namespace gfx
 		//virtual SemaphoreHandle CreateSemaphore(const SemaphoreDesc* desc) = 0;
 		virtual void CreateQueryPool(QueryPool* out, uint32_t count, QueryType type) = 0;
 
-		virtual void CopyToBuffer(BufferHandle buffer, void* data, uint32_t offset, uint32_t size) = 0;
+		virtual void CopyToBuffer(BufferHandle buffer, const void* data, uint32_t offset, uint32_t size) = 0;
 		virtual void CopyBuffer(BufferHandle dst, BufferHandle src, uint32_t dstOffset = 0) = 0;
 		virtual void CopyTexture(TextureHandle dst, BufferHandle src, PipelineBarrierInfo* barrier = nullptr, uint32_t arrayLevel = 0, uint32_t mipLevel = 0) = 0;
 		virtual void CopyTexture(TextureHandle dst, void* src, uint32_t sizeInByte, uint32_t arrayLevel = 0, uint32_t mipLevel = 0, bool generateMipMap = false) = 0;
 		virtual void FillBuffer(CommandList* commandList, BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t data = 0) = 0;
+		// Copies recorded in the command list, the texture is left in the shader read layout after the last row
+		virtual void CopyBuffer(CommandList* commandList, BufferHandle dst, BufferHandle src, uint32_t dstOffset, uint32_t srcOffset, uint32_t size) = 0;
+		virtual void CopyTexture(CommandList* commandList, TextureHandle dst, BufferHandle src, uint32_t srcOffset, uint32_t firstRow, uint32_t rowCount, bool generateMipMap) = 0;
 
 		virtual void* GetMappedDataPtr(BufferHandle buffer) = 0;
 		virtual uint32_t GetBufferSize(BufferHandle handle) = 0;
@@ -57,7 +60,7 @@ namespace gfx
 
 		//virtual void BindViewport(Viewport* viewports, int count, CommandList* commandList) = 0;
 		virtual void BindPipeline(CommandList* commandList, PipelineHandle pipeline)   = 0;
-		virtual void BindIndexBuffer(CommandList* commandList, BufferHandle buffer) = 0;
+		virtual void BindIndexBuffer(CommandList* commandList, BufferHandle buffer, IndexType indexType) = 0;
 		
 		virtual void Draw(CommandList* commandList, uint32_t vertexCount, uint32_t firstVertex, uint32_t instanceCount) = 0;
 		virtual void DrawIndexed(CommandList* commandList, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex) = 0;
@@ -65,6 +68,7 @@ namespace gfx
 		virtual void DrawIndexedIndirectCount(CommandList* commandList, BufferHandle indirectBuffer, uint32_t offset, BufferHandle drawCountBuffer, uint32_t drawCountBufferOffset, uint32_t maxDrawCount, uint32_t stride) = 0;
 
 		virtual void DispatchCompute(CommandList* commandList, uint32_t groupCountX, uint32_t groupCountY, uint32_t workGroupZ) = 0;
+		virtual void DispatchComputeIndirect(CommandList* commandList, BufferHandle argumentBuffer, uint32_t offset) = 0;
 		virtual void DrawMeshTasksIndirect(CommandList* commandList, BufferHandle meshDrawBuffer, uint32_t offset, uint32_t count, uint32_t stride) = 0;
 		virtual void DrawMeshTasksIndirectCount(CommandList* commandList, BufferHandle meshDrawBuffer, uint32_t offset, BufferHandle drawCountBuffer, uint32_t drawCountBufferOffset, uint32_t maxDrawCount, uint32_t stride) = 0;
 		virtual void DrawMeshTasks(CommandList* commandList, uint32_t count, uint32_t firstTask) = 0;
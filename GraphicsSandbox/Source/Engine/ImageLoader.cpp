@@ -21,6 +21,11 @@ uint8_t* Utils::ImageLoader::Load(const char* filename, int& width, int& height,
 	return stbi_load(filename, &width, &height, &nComponent, STBI_rgb_alpha);
 }
 
+uint8_t* Utils::ImageLoader::LoadFromMemory(const uint8_t* data, uint32_t size, int& width, int& height, int& nComponent)
+{
+	return stbi_load_from_memory(data, static_cast<int>(size), &width, &height, &nComponent, STBI_rgb_alpha);
+}
+
 void Utils::ImageLoader::Free(void* data)
 {
 	if(data)
@@ -9,6 +9,9 @@ namespace Utils::ImageLoader
 
 	uint8_t* Load(const char* filename, int& width, int& height, int& nComponent);
 
+	// Decode the encoded image in memory
+	uint8_t* LoadFromMemory(const uint8_t* data, uint32_t size, int& width, int& height, int& nComponent);
+
 
 	void Free(void* data);
 };
@@ -0,0 +1,262 @@
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace JobSystem
+{
+	struct Job
+	{
+		Counter* counter = nullptr;
+		JobFunc func;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+
+		// Queue 0 is shared by the non worker threads so stats are atomic
+		std::atomic<uint64_t> busyTime{ 0 };
+		std::atomic<uint32_t> jobCount{ 0 };
+		std::atomic<uint32_t> stealCount{ 0 };
+	};
+
+	std::unique_ptr<WorkQueue[]> gQueues;
+	uint32_t gQueueCount = 0;
+	std::vector<std::thread> gWorkers;
+
+	// Jobs pushed to the queues and not yet popped
+	std::atomic<uint32_t> gPendingJobs{ 0 };
+	std::atomic<bool> gRunning{ false };
+	std::mutex gWakeMutex;
+	std::condition_variable gWakeCondition;
+
+	thread_local uint32_t tQueueIndex = 0;
+
+	static void push(Job&& job)
+	{
+		WorkQueue& queue = gQueues[tQueueIndex];
+		gPendingJobs.fetch_add(1, std::memory_order_acq_rel);
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(std::move(job));
+		}
+
+		// Worker can check the pending count and go to sleep between the push and notify
+		{
+			std::lock_guard<std::mutex> lock(gWakeMutex);
+		}
+		gWakeCondition.notify_one();
+	}
+
+	// Removes the job from the queue, the caller holds the lock of the queue
+	static void take(WorkQueue& queue, std::deque<Job>::iterator it, Job& out)
+	{
+		out = std::move(*it);
+		queue.jobs.erase(it);
+		gPendingJobs.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	// Only the jobs of the counter when it isn't null
+	static bool pop(uint32_t queueIndex, Job& out, bool& stolen, const Counter* counter = nullptr)
+	{
+		auto matches = [counter](const Job& job) { return counter == nullptr || job.counter == counter; };
+
+		// Most recent job of the own queue is hot in cache
+		{
+			WorkQueue& queue = gQueues[queueIndex];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			auto it = std::find_if(queue.jobs.rbegin(), queue.jobs.rend(), matches);
+			if (it != queue.jobs.rend())
+			{
+				take(queue, std::next(it).base(), out);
+				stolen = false;
+				return true;
+			}
+		}
+
+		// Oldest job of the other queues
+		for (uint32_t i = 1; i < gQueueCount; ++i)
+		{
+			WorkQueue& queue = gQueues[(queueIndex + i) % gQueueCount];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			auto it = std::find_if(queue.jobs.begin(), queue.jobs.end(), matches);
+			if (it != queue.jobs.end())
+			{
+				take(queue, it, out);
+				stolen = true;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static void finish(Counter* counter)
+	{
+		// Decrement under the lock so Wait() can't return while the
+		// continuations are moved out of the counter
+		std::vector<std::pair<Counter*, JobFunc>> continuations;
+		{
+			std::lock_guard<std::mutex> lock(counter->mutex);
+			if (counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				continuations.swap(counter->continuations);
+		}
+
+		for (auto& [dependent, func] : continuations)
+		{
+			if (gQueueCount == 0)
+			{
+				func();
+				finish(dependent);
+			}
+			else
+				push({ dependent, std::move(func) });
+		}
+	}
+
+	static void run(uint32_t queueIndex, Job& job, bool stolen)
+	{
+		Timer timer;
+		job.func();
+		finish(job.counter);
+
+		WorkQueue& queue = gQueues[queueIndex];
+		queue.busyTime.fetch_add(static_cast<uint64_t>(timer.elapsedSeconds() * 1e9), std::memory_order_relaxed);
+		queue.jobCount.fetch_add(1, std::memory_order_relaxed);
+		if (stolen)
+			queue.stealCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void workerLoop(uint32_t queueIndex)
+	{
+		tQueueIndex = queueIndex;
+		while (true)
+		{
+			Job job;
+			bool stolen = false;
+			if (pop(queueIndex, job, stolen))
+			{
+				run(queueIndex, job, stolen);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(gWakeMutex);
+			gWakeCondition.wait(lock, []() {
+				return gPendingJobs.load(std::memory_order_acquire) > 0 || !gRunning.load(std::memory_order_acquire);
+				});
+
+			if (!gRunning.load(std::memory_order_acquire) && gPendingJobs.load(std::memory_order_acquire) == 0)
+				break;
+		}
+	}
+
+	void Initialize(uint32_t workerCount)
+	{
+		if (gQueueCount > 0)
+			Shutdown();
+
+		if (workerCount == 0)
+		{
+			const uint32_t coreCount = std::thread::hardware_concurrency();
+			workerCount = coreCount > 1 ? coreCount - 1 : 0;
+		}
+
+		gQueueCount = workerCount + 1;
+		gQueues = std::make_unique<WorkQueue[]>(gQueueCount);
+		gPendingJobs.store(0);
+		gRunning.store(true);
+
+		tQueueIndex = 0;
+		gWorkers.reserve(workerCount);
+		for (uint32_t i = 1; i <= workerCount; ++i)
+			gWorkers.emplace_back(workerLoop, i);
+	}
+
+	uint32_t GetThreadCount()
+	{
+		return std::max(gQueueCount, 1u);
+	}
+
+	void Execute(Counter& counter, JobFunc job)
+	{
+		counter.value.fetch_add(1, std::memory_order_acq_rel);
+		if (gQueueCount == 0)
+		{
+			job();
+			finish(&counter);
+			return;
+		}
+		push({ &counter, std::move(job) });
+	}
+
+	void Execute(Counter& counter, Counter& dependency, JobFunc job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(dependency.mutex);
+			if (!dependency.IsDone())
+			{
+				counter.value.fetch_add(1, std::memory_order_acq_rel);
+				dependency.continuations.emplace_back(&counter, std::move(job));
+				return;
+			}
+		}
+		Execute(counter, std::move(job));
+	}
+
+	void Wait(Counter& counter)
+	{
+		// Jobs of other counters are left to the workers, e.g. the main thread
+		// must not run the import jobs queued by a loader thread. Without
+		// workers the waiting thread is the only one that can run them
+		const Counter* filter = gWorkers.empty() ? nullptr : &counter;
+		while (!counter.IsDone())
+		{
+			Job job;
+			bool stolen = false;
+			if (gQueueCount > 0 && pop(tQueueIndex, job, stolen, filter))
+				run(tQueueIndex, job, stolen);
+			else
+				std::this_thread::yield();
+		}
+
+		// Last job could still hold the lock after the decrement
+		std::lock_guard<std::mutex> lock(counter.mutex);
+	}
+
+	void GetStatistics(std::vector<WorkerStats>& out, bool reset)
+	{
+		out.resize(gQueueCount);
+		for (uint32_t i = 0; i < gQueueCount; ++i)
+		{
+			WorkQueue& queue = gQueues[i];
+			const uint64_t busyTime = reset ? queue.busyTime.exchange(0) : queue.busyTime.load();
+			out[i].busyTime = busyTime * 1e-6;
+			out[i].jobCount = reset ? queue.jobCount.exchange(0) : queue.jobCount.load();
+			out[i].stealCount = reset ? queue.stealCount.exchange(0) : queue.stealCount.load();
+		}
+	}
+
+	void Shutdown()
+	{
+		if (gQueueCount == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(gWakeMutex);
+			gRunning.store(false);
+		}
+		gWakeCondition.notify_all();
+
+		for (auto& worker : gWorkers)
+			worker.join();
+
+		gWorkers.clear();
+		gQueues.reset();
+		gQueueCount = 0;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+* Job system with a work queue per worker thread. Workers pop their own
+* queue from the back and steal from the front of the other queues when
+* it is empty. Thread calling Wait() executes the pending jobs of the
+* counter instead of blocking, so the frame never picks up the long jobs
+* of a loader thread. Index 0 of the statistics is used by these threads.
+*/
+namespace JobSystem
+{
+	using JobFunc = std::function<void()>;
+
+	/*
+	* Number of unfinished jobs. Jobs scheduled with a dependency are
+	* queued once the dependency counter reaches zero.
+	*/
+	struct Counter
+	{
+		Counter() = default;
+		Counter(const Counter&) = delete;
+		void operator=(const Counter&) = delete;
+
+		bool IsDone() const { return value.load(std::memory_order_acquire) == 0; }
+
+		std::atomic<uint32_t> value{ 0 };
+
+		// Jobs waiting for this counter
+		std::mutex mutex;
+		std::vector<std::pair<Counter*, JobFunc>> continuations;
+	};
+
+	struct WorkerStats
+	{
+		double busyTime = 0.0;
+		uint32_t jobCount = 0;
+		uint32_t stealCount = 0;
+	};
+
+	// workerCount of zero uses one thread per core excluding the calling thread
+	void Initialize(uint32_t workerCount = 0);
+
+	// Number of threads executing the jobs including the calling thread
+	uint32_t GetThreadCount();
+
+	void Execute(Counter& counter, JobFunc job);
+
+	// Job is executed after all the jobs of the dependency counter are finished
+	void Execute(Counter& counter, Counter& dependency, JobFunc job);
+
+	// Execute the pending jobs of the counter until it reaches zero
+	void Wait(Counter& counter);
+
+	// Busy time (ms) and job count of each thread since the last call
+	void GetStatistics(std::vector<WorkerStats>& out, bool reset = true);
+
+	void Shutdown();
+
+	/*
+	* Call func(begin, end) over [0, count) split in groups of grainSize
+	* and return once all the groups are finished. Runs on the calling
+	* thread when there is a single group or no worker thread.
+	*/
+	template<typename Func>
+	void ParallelFor(uint32_t count, uint32_t grainSize, const Func& func)
+	{
+		if (count == 0)
+			return;
+
+		grainSize = grainSize == 0 ? 1 : grainSize;
+		if (count <= grainSize || GetThreadCount() <= 1)
+		{
+			func(0u, count);
+			return;
+		}
+
+		Counter counter;
+		for (uint32_t begin = 0; begin < count; begin += grainSize)
+		{
+			const uint32_t end = count - begin > grainSize ? begin + grainSize : count;
+			Execute(counter, [&func, begin, end]() { func(begin, end); });
+		}
+		Wait(counter);
+	}
+};
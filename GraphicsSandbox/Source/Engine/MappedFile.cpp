@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+#include "Logger.h"
+
+#ifdef _WIN32
+#include "Platform.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		Logger::Error("Failed to open file: " + filename);
+		return false;
+	}
+
+	LARGE_INTEGER fileSize = {};
+	GetFileSizeEx(file, &fileSize);
+	if (fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		Logger::Error("Failed to map file: " + filename);
+		CloseHandle(file);
+		return false;
+	}
+
+	mData = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (mData == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mSize = static_cast<std::size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData) UnmapViewOfFile(mData);
+	if (mMapping) CloseHandle(mMapping);
+	if (mFile) CloseHandle(mFile);
+
+	mData = nullptr;
+	mMapping = nullptr;
+	mFile = nullptr;
+	mSize = 0;
+}
+#else
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		Logger::Error("Failed to open file: " + filename);
+		return false;
+	}
+
+	struct stat fileStat = {};
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (data == MAP_FAILED)
+	{
+		Logger::Error("Failed to map file: " + filename);
+		close(file);
+		return false;
+	}
+
+	mFile = file;
+	mData = static_cast<const uint8_t*>(data);
+	mSize = static_cast<std::size_t>(fileStat.st_size);
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData) munmap(const_cast<uint8_t*>(mData), mSize);
+	if (mFile >= 0) close(mFile);
+
+	mData = nullptr;
+	mFile = -1;
+	mSize = 0;
+}
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+/*
+* Read-only memory mapped file, the view is unmapped when the
+* object is destroyed so the pointer returned by GetData() must
+* not outlive it.
+*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	void operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& filename);
+	void Close();
+
+	const uint8_t* GetData() const { return mData; }
+	std::size_t GetSize() const { return mSize; }
+	bool IsOpen() const { return mData != nullptr; }
+
+	~MappedFile() { Close(); }
+
+private:
+	const uint8_t* mData = nullptr;
+	std::size_t mSize = 0;
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#else
+	int mFile = -1;
+#endif
+};
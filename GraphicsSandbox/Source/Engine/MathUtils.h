@@ -2,6 +2,7 @@
 
 #include "../Engine/GlmIncludes.h"
 #include <array>
+#include <algorithm>
 
 inline uint32_t ConvertFloat3ToU32Color(const glm::vec3& color) {
 	uint32_t r = glm::clamp(static_cast<uint32_t>(color.x * 255), 0u, 255u);
@@ -133,6 +134,36 @@ public:
 	};
 };
 
+struct Ray
+{
+	Ray() = default;
+
+	// Direction isn't normalized, hit distances are in units of the direction
+	Ray(const glm::vec3& origin, const glm::vec3& direction) : origin(origin), direction(direction),
+		invDirection(1.0f / direction)
+	{
+	}
+
+	glm::vec3 GetPoint(float t) const { return origin + direction * t; }
+
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 invDirection;
+};
+
+// Slab test, tNear is the entry distance clamped to zero
+inline bool IntersectRayAABB(const Ray& ray, const BoundingBox& aabb, float maxDistance, float& tNear)
+{
+	const glm::vec3 t0 = (aabb.min - ray.origin) * ray.invDirection;
+	const glm::vec3 t1 = (aabb.max - ray.origin) * ray.invDirection;
+	const glm::vec3 tMin = glm::min(t0, t1);
+	const glm::vec3 tMax = glm::max(t0, t1);
+
+	tNear = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+	const float tFar = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+	return tNear <= tFar;
+}
+
 namespace MathUtils
 {
 	inline float Rand01()
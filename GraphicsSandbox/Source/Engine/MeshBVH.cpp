@@ -0,0 +1,257 @@
+#include "MeshBVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+// Triangles of a leaf are tested without any culling, larger leaves are split if it's cheaper
+constexpr uint32_t kMaxLeafTriangles = 4;
+constexpr uint32_t kBinCount = 16;
+// Depth is limited so the traversal stack has a fixed size
+constexpr uint32_t kMaxDepth = 48;
+constexpr uint32_t kStackSize = kMaxDepth + 1;
+// Cost of visiting a node relative to a triangle test
+constexpr float kTraversalCost = 1.0f;
+
+static float Area(const BoundingBox& aabb)
+{
+	const glm::vec3 size = aabb.max - aabb.min;
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static BoundingBox EmptyBox()
+{
+	return BoundingBox(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+}
+
+static void Grow(BoundingBox& aabb, const BoundingBox& other)
+{
+	aabb.min = glm::min(aabb.min, other.min);
+	aabb.max = glm::max(aabb.max, other.max);
+}
+
+void MeshBVH::Build(const float* positions, uint32_t stride, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+	mNodes.clear();
+	mTriangles.clear();
+	mTriangleIndices.clear();
+
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	auto getPosition = [&](uint32_t index) {
+		assert(index < vertexCount);
+		const float* p = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + std::size_t(index) * stride);
+		return glm::vec3(p[0], p[1], p[2]);
+	};
+
+	std::vector<BoundingBox> bounds(triangleCount);
+	std::vector<glm::vec3> centroids(triangleCount);
+	BoundingBox rootBox = EmptyBox();
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		const glm::vec3 p0 = getPosition(indices[i * 3 + 0]);
+		const glm::vec3 p1 = getPosition(indices[i * 3 + 1]);
+		const glm::vec3 p2 = getPosition(indices[i * 3 + 2]);
+
+		bounds[i] = BoundingBox(glm::min(p0, glm::min(p1, p2)), glm::max(p0, glm::max(p1, p2)));
+		centroids[i] = bounds[i].GetCenter();
+		Grow(rootBox, bounds[i]);
+	}
+
+	mTriangleIndices.resize(triangleCount);
+	std::iota(mTriangleIndices.begin(), mTriangleIndices.end(), 0);
+
+	mNodes.reserve(std::size_t(triangleCount) * 2);
+	mNodes.push_back({ rootBox, 0, triangleCount });
+
+	// Children are appended to the node list, so this visits the tree breadth first
+	std::vector<uint32_t> depths{ 0 };
+	for (uint32_t node = 0; node < mNodes.size(); ++node)
+	{
+		if (depths[node] < kMaxDepth && subdivide(node, bounds, centroids))
+			depths.insert(depths.end(), 2, depths[node] + 1);
+	}
+	mNodes.shrink_to_fit();
+
+	mTriangles.resize(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; ++i)
+	{
+		const uint32_t triangle = mTriangleIndices[i];
+		const glm::vec3 p0 = getPosition(indices[triangle * 3 + 0]);
+		const glm::vec3 p1 = getPosition(indices[triangle * 3 + 1]);
+		const glm::vec3 p2 = getPosition(indices[triangle * 3 + 2]);
+		mTriangles[i] = { p0, p1 - p0, p2 - p0 };
+	}
+}
+
+bool MeshBVH::subdivide(uint32_t node, std::vector<BoundingBox>& bounds, std::vector<glm::vec3>& centroids)
+{
+	const uint32_t first = mNodes[node].first;
+	const uint32_t count = mNodes[node].count;
+	if (count <= 1)
+		return false;
+
+	BoundingBox centroidBox = EmptyBox();
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const glm::vec3& centroid = centroids[mTriangleIndices[i]];
+		centroidBox.min = glm::min(centroidBox.min, centroid);
+		centroidBox.max = glm::max(centroidBox.max, centroid);
+	}
+
+	// Find the cheapest split plane between the bins of the three axes
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float extent = centroidBox.max[axis] - centroidBox.min[axis];
+		if (extent <= 0.0f)
+			continue;
+
+		BoundingBox binBounds[kBinCount];
+		uint32_t binCounts[kBinCount] = {};
+		for (uint32_t bin = 0; bin < kBinCount; ++bin)
+			binBounds[bin] = EmptyBox();
+
+		const float scale = kBinCount / extent;
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			const uint32_t triangle = mTriangleIndices[i];
+			const uint32_t bin = std::min(static_cast<uint32_t>((centroids[triangle][axis] - centroidBox.min[axis]) * scale), kBinCount - 1);
+			binCounts[bin]++;
+			Grow(binBounds[bin], bounds[triangle]);
+		}
+
+		// Right side is accumulated first, the left side is swept in the second pass
+		float rightArea[kBinCount - 1];
+		uint32_t rightCount[kBinCount - 1];
+		BoundingBox box = EmptyBox();
+		uint32_t sum = 0;
+		for (uint32_t bin = kBinCount - 1; bin > 0; --bin)
+		{
+			Grow(box, binBounds[bin]);
+			sum += binCounts[bin];
+			rightArea[bin - 1] = sum > 0 ? Area(box) : 0.0f;
+			rightCount[bin - 1] = sum;
+		}
+
+		box = EmptyBox();
+		sum = 0;
+		for (uint32_t split = 0; split < kBinCount - 1; ++split)
+		{
+			Grow(box, binBounds[split]);
+			sum += binCounts[split];
+			if (sum == 0 || rightCount[split] == 0)
+				continue;
+
+			const float cost = sum * Area(box) + rightCount[split] * rightArea[split];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	// All the centroids are at the same point
+	if (bestAxis < 0)
+		return false;
+
+	const float leafCost = count * Area(mNodes[node].aabb);
+	if (count <= kMaxLeafTriangles && bestCost + kTraversalCost * Area(mNodes[node].aabb) >= leafCost)
+		return false;
+
+	const float scale = kBinCount / (centroidBox.max[bestAxis] - centroidBox.min[bestAxis]);
+	auto middle = std::partition(mTriangleIndices.begin() + first, mTriangleIndices.begin() + first + count, [&](uint32_t triangle) {
+		const uint32_t bin = std::min(static_cast<uint32_t>((centroids[triangle][bestAxis] - centroidBox.min[bestAxis]) * scale), kBinCount - 1);
+		return bin <= bestSplit;
+		});
+	const uint32_t leftCount = static_cast<uint32_t>(middle - mTriangleIndices.begin()) - first;
+
+	BoundingBox leftBox = EmptyBox();
+	BoundingBox rightBox = EmptyBox();
+	for (uint32_t i = first; i < first + leftCount; ++i)
+		Grow(leftBox, bounds[mTriangleIndices[i]]);
+	for (uint32_t i = first + leftCount; i < first + count; ++i)
+		Grow(rightBox, bounds[mTriangleIndices[i]]);
+
+	const uint32_t leftChild = static_cast<uint32_t>(mNodes.size());
+	mNodes.push_back({ leftBox, first, leftCount });
+	mNodes.push_back({ rightBox, first + leftCount, count - leftCount });
+	mNodes[node].first = leftChild;
+	mNodes[node].count = 0;
+	return true;
+}
+
+bool MeshBVH::RayCast(const Ray& ray, float maxDistance, Hit& hit) const
+{
+	float tNear = 0.0f;
+	if (mNodes.empty() || !IntersectRayAABB(ray, mNodes[0].aabb, maxDistance, tNear))
+		return false;
+
+	bool found = false;
+	float closest = maxDistance;
+
+	// Each level adds at most one entry to the stack
+	uint32_t stack[kStackSize];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = mNodes[stack[--stackSize]];
+		if (node.IsLeaf())
+		{
+			// Moller-Trumbore, both faces are tested
+			for (uint32_t i = node.first; i < node.first + node.count; ++i)
+			{
+				const Triangle& triangle = mTriangles[i];
+				const glm::vec3 p = glm::cross(ray.direction, triangle.e2);
+				const float det = glm::dot(triangle.e1, p);
+				if (std::abs(det) < 1e-12f)
+					continue;
+
+				const float invDet = 1.0f / det;
+				const glm::vec3 s = ray.origin - triangle.v0;
+				const float u = glm::dot(s, p) * invDet;
+				if (u < 0.0f || u > 1.0f)
+					continue;
+
+				const glm::vec3 q = glm::cross(s, triangle.e1);
+				const float v = glm::dot(ray.direction, q) * invDet;
+				if (v < 0.0f || u + v > 1.0f)
+					continue;
+
+				const float t = glm::dot(triangle.e2, q) * invDet;
+				if (t > 0.0f && t < closest)
+				{
+					closest = t;
+					hit.distance = t;
+					hit.triangle = mTriangleIndices[i];
+					hit.normal = glm::cross(triangle.e1, triangle.e2);
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// Nearest child is visited first so the farther one is usually culled by the closest hit
+		float tLeft = 0.0f, tRight = 0.0f;
+		const bool hitLeft = IntersectRayAABB(ray, mNodes[node.first].aabb, closest, tLeft);
+		const bool hitRight = IntersectRayAABB(ray, mNodes[node.first + 1].aabb, closest, tRight);
+		if (hitLeft && hitRight)
+		{
+			const bool leftFirst = tLeft <= tRight;
+			stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+			stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+		}
+		else if (hitLeft)
+			stack[stackSize++] = node.first;
+		else if (hitRight)
+			stack[stackSize++] = node.first + 1;
+	}
+	return found;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "MathUtils.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+* Static bounding volume hierarchy over the triangles of a mesh, built
+* once from the CPU copy of the vertices with the binned surface area
+* heuristic. Triangles are reordered so the triangles of a leaf are
+* contiguous and stored as a vertex and two edges for the ray test.
+*/
+class MeshBVH
+{
+public:
+	struct Hit
+	{
+		float distance;
+		uint32_t triangle;
+		// Geometric normal in mesh space, not normalized
+		glm::vec3 normal;
+	};
+
+	MeshBVH() = default;
+
+	// Positions are read with the stride in bytes, indices are relative to the first position
+	void Build(const float* positions, uint32_t stride, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+	// Closest hit in front of the ray origin, closer than maxDistance
+	bool RayCast(const Ray& ray, float maxDistance, Hit& hit) const;
+
+	uint32_t GetTriangleCount() const { return static_cast<uint32_t>(mTriangles.size()); }
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(mNodes.size()); }
+	const BoundingBox& GetBounds() const { return mNodes[0].aabb; }
+
+	bool IsEmpty() const { return mNodes.empty(); }
+
+private:
+	struct Node
+	{
+		BoundingBox aabb;
+		// First triangle for the leaves, first child for the internal nodes. Children are adjacent
+		uint32_t first;
+		uint32_t count;
+
+		bool IsLeaf() const { return count > 0; }
+	};
+
+	struct Triangle
+	{
+		glm::vec3 v0;
+		glm::vec3 e1;
+		glm::vec3 e2;
+	};
+
+	std::vector<Node> mNodes;
+	std::vector<Triangle> mTriangles;
+	// Index of the triangle in the source index buffer
+	std::vector<uint32_t> mTriangleIndices;
+
+	// Returns false if the node is kept as a leaf
+	bool subdivide(uint32_t node, std::vector<BoundingBox>& bounds, std::vector<glm::vec3>& centroids);
+};
@@ -0,0 +1,411 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace MeshCache
+{
+	namespace
+	{
+		constexpr uint32_t kMagic = 0x48534d47; // GMSH
+		constexpr uint64_t kHashOffset = 0xcbf29ce484222325;
+		constexpr uint64_t kHashPrime = 0x00000100000001b3;
+		constexpr uint32_t kSectionCount = static_cast<uint32_t>(Section::Count);
+
+		struct SectionRange
+		{
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			SourceKey source;
+			uint64_t reserved;
+			SectionRange sections[kSectionCount];
+		};
+		static_assert(sizeof(Header) % kAlignment == 0);
+
+		static_assert(std::is_trivially_copyable_v<Vertex>);
+		static_assert(std::is_trivially_copyable_v<CompactVertex>);
+		static_assert(std::is_trivially_copyable_v<Meshlet>);
+		static_assert(std::is_trivially_copyable_v<Primitive>);
+		static_assert(std::is_trivially_copyable_v<MeshLod>);
+		static_assert(std::is_trivially_copyable_v<Node>);
+		static_assert(std::is_trivially_copyable_v<MaterialComponent>);
+		static_assert(std::is_trivially_copyable_v<Texture>);
+		static_assert(std::is_trivially_copyable_v<Dependency>);
+
+		uint64_t AlignOffset(uint64_t offset)
+		{
+			return (offset + kAlignment - 1) / kAlignment * kAlignment;
+		}
+
+		// FNV-1a, folded eight bytes at a time
+		uint64_t HashBytes(uint64_t hash, const uint8_t* data, std::size_t size)
+		{
+			std::size_t i = 0;
+			for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+			{
+				uint64_t value;
+				std::memcpy(&value, data + i, sizeof(uint64_t));
+				hash = (hash ^ value) * kHashPrime;
+			}
+			for (; i < size; ++i)
+				hash = (hash ^ data[i]) * kHashPrime;
+			return hash;
+		}
+
+		bool HashFile(const std::string& filename, uint64_t& hash)
+		{
+			if (!std::ifstream(filename).good())
+				return false;
+
+			MappedFile file;
+			if (!file.Open(filename))
+				return false;
+
+			hash = HashBytes(hash, file.GetData(), file.GetSize());
+			// Size separates the files so the same bytes split differently don't collide
+			const uint64_t size = file.GetSize();
+			hash = HashBytes(hash, reinterpret_cast<const uint8_t*>(&size), sizeof(uint64_t));
+			return true;
+		}
+
+		// Only the metadata is read, a touched file gets a new stamp with the same hash
+		bool StampFile(const std::string& filename, uint64_t& stamp)
+		{
+			std::error_code error;
+			const uint64_t size = std::filesystem::file_size(filename, error);
+			if (error)
+				return false;
+
+			const int64_t time = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+			if (error)
+				return false;
+
+			stamp = HashBytes(stamp, reinterpret_cast<const uint8_t*>(&size), sizeof(uint64_t));
+			stamp = HashBytes(stamp, reinterpret_cast<const uint8_t*>(&time), sizeof(int64_t));
+			return true;
+		}
+
+		// Folds the options and fileFunc(filename, hash) of the source and the dependencies
+		template<typename Func>
+		bool HashSource(const std::string& source, const ImportOptions& options, const View& view, const Func& fileFunc, uint64_t& hash)
+		{
+			hash = kHashOffset;
+			if (!fileFunc(source, hash))
+				return false;
+
+			// Fields are hashed one by one, the padding of the struct is undefined
+			const uint32_t flags = uint32_t(options.optimizeVertexCache) | uint32_t(options.optimizeOverdraw) << 1 | uint32_t(options.optimizeVertexFetch) << 2 |
+				uint32_t(options.compactVertices) << 3;
+			hash = HashBytes(hash, reinterpret_cast<const uint8_t*>(&flags), sizeof(uint32_t));
+			hash = HashBytes(hash, reinterpret_cast<const uint8_t*>(&options.overdrawThreshold), sizeof(float));
+
+			const std::string directory = source.substr(0, source.find_last_of("/\\") + 1);
+			for (const Dependency& dependency : view.dependencies)
+			{
+				if (!fileFunc(directory + std::string(view.GetString(dependency.path, dependency.pathLength)), hash))
+					return false;
+			}
+			return true;
+		}
+
+		template<typename T>
+		void SetSlice(Slice<T>& slice, const std::vector<T>& values)
+		{
+			slice.data = values.data();
+			slice.count = values.size();
+		}
+
+		template<typename T>
+		bool ReadSlice(const uint8_t* data, std::size_t size, const SectionRange& range, Slice<T>& slice)
+		{
+			if (range.offset % kAlignment != 0 || range.size % sizeof(T) != 0 || range.offset > size || range.size > size - range.offset)
+				return false;
+
+			slice.data = reinterpret_cast<const T*>(data + range.offset);
+			slice.count = static_cast<std::size_t>(range.size / sizeof(T));
+			return true;
+		}
+
+		bool InRange(uint64_t offset, uint64_t count, std::size_t size)
+		{
+			return offset <= size && count <= size - offset;
+		}
+
+		// Ranges are checked once on load, the instantiation and the streaming index the sections without checks
+		bool ValidateRanges(const View& view)
+		{
+			const std::size_t vertexCount = view.HasCompactVertices() ? view.compactVertices.count : view.vertices.count;
+			const std::size_t indexCount = view.HasShortIndices() ? view.shortIndices.count : view.indices.count;
+			auto validString = [&](uint32_t offset, uint32_t length) { return InRange(offset, length, view.strings.count); };
+
+			for (const Meshlet& meshlet : view.meshlets)
+			{
+				if (!InRange(meshlet.vertexOffset, meshlet.vertexCount, view.meshletVertices.count) ||
+					!InRange(meshlet.triangleOffset, uint64_t(meshlet.triangleCount) * 3, view.meshletTriangles.count))
+					return false;
+			}
+
+			for (const MeshLod& lod : view.lods)
+			{
+				if (!InRange(lod.indexOffset, lod.indexCount, indexCount) || !InRange(lod.meshletOffset, lod.meshletCount, view.meshlets.count))
+					return false;
+			}
+
+			// Indices and meshlet vertices are relative to the first vertex of the primitive
+			auto validIndices = [&](const MeshLod& lod, uint32_t limit) {
+				auto belowLimit = [limit](uint32_t index) { return index < limit; };
+				if (view.HasShortIndices())
+					return std::all_of(view.shortIndices.begin() + lod.indexOffset, view.shortIndices.begin() + lod.indexOffset + lod.indexCount, belowLimit);
+				return std::all_of(view.indices.begin() + lod.indexOffset, view.indices.begin() + lod.indexOffset + lod.indexCount, belowLimit);
+			};
+
+			auto validMeshlets = [&](const MeshLod& lod, uint32_t limit) {
+				for (uint32_t i = lod.meshletOffset; i < lod.meshletOffset + lod.meshletCount; ++i)
+				{
+					const Meshlet& meshlet = view.meshlets[i];
+					const uint32_t* vertices = view.meshletVertices.begin() + meshlet.vertexOffset;
+					const uint8_t* triangles = view.meshletTriangles.begin() + meshlet.triangleOffset;
+					if (!std::all_of(vertices, vertices + meshlet.vertexCount, [limit](uint32_t vertex) { return vertex < limit; }) ||
+						!std::all_of(triangles, triangles + meshlet.triangleCount * 3, [&](uint8_t vertex) { return vertex < meshlet.vertexCount; }))
+						return false;
+				}
+				return true;
+			};
+
+			// Every primitive has LOD 0, the streaming waits for the last level
+			for (const Primitive& primitive : view.primitives)
+			{
+				if (!InRange(primitive.vertexOffset, primitive.vertexCount, vertexCount) ||
+					!InRange(primitive.indexOffset, primitive.indexCount, indexCount) ||
+					!InRange(primitive.meshletOffset, primitive.meshletCount, view.meshlets.count) ||
+					primitive.lodCount == 0 || !InRange(primitive.lodOffset, primitive.lodCount, view.lods.count))
+					return false;
+
+				if (primitive.material != kInvalidIndex && primitive.material >= view.materials.count)
+					return false;
+
+				if (view.HasShortIndices() && primitive.vertexCount > kMaxShortIndexVertices)
+					return false;
+
+				// LOD 0 is the range of the primitive so the values are checked once per level
+				const MeshLod& baseLod = view.lods[primitive.lodOffset];
+				if (baseLod.indexOffset != primitive.indexOffset || baseLod.indexCount != primitive.indexCount ||
+					baseLod.meshletOffset != primitive.meshletOffset || baseLod.meshletCount != primitive.meshletCount)
+					return false;
+
+				for (uint32_t i = primitive.lodOffset; i < primitive.lodOffset + primitive.lodCount; ++i)
+				{
+					if (!validIndices(view.lods[i], primitive.vertexCount) || !validMeshlets(view.lods[i], primitive.vertexCount))
+						return false;
+				}
+			}
+
+			// Parents are written before the children
+			for (std::size_t i = 0; i < view.nodes.count; ++i)
+			{
+				const Node& node = view.nodes[i];
+				if ((node.parent != kInvalidIndex && node.parent >= i) ||
+					(node.primitive != kInvalidIndex && node.primitive >= view.primitives.count) ||
+					!validString(node.name, node.nameLength))
+					return false;
+			}
+
+			for (const Texture& texture : view.textures)
+			{
+				if (!validString(texture.name, texture.nameLength) ||
+					(texture.source != TextureSource::File && !InRange(texture.dataOffset, texture.dataSize, view.blob.count)))
+					return false;
+			}
+
+			for (const Dependency& dependency : view.dependencies)
+			{
+				if (!validString(dependency.path, dependency.pathLength))
+					return false;
+			}
+			return true;
+		}
+
+		// Calls func(section, data, byteSize) for each section in the file order
+		template<typename Func>
+		void ForEachSection(const View& view, const Func& func)
+		{
+			func(Section::Vertices, view.vertices.data, view.vertices.GetByteSize());
+			func(Section::CompactVertices, view.compactVertices.data, view.compactVertices.GetByteSize());
+			func(Section::Indices, view.indices.data, view.indices.GetByteSize());
+			func(Section::ShortIndices, view.shortIndices.data, view.shortIndices.GetByteSize());
+			func(Section::Meshlets, view.meshlets.data, view.meshlets.GetByteSize());
+			func(Section::MeshletVertices, view.meshletVertices.data, view.meshletVertices.GetByteSize());
+			func(Section::MeshletTriangles, view.meshletTriangles.data, view.meshletTriangles.GetByteSize());
+			func(Section::Primitives, view.primitives.data, view.primitives.GetByteSize());
+			func(Section::Lods, view.lods.data, view.lods.GetByteSize());
+			func(Section::Nodes, view.nodes.data, view.nodes.GetByteSize());
+			func(Section::Materials, view.materials.data, view.materials.GetByteSize());
+			func(Section::Textures, view.textures.data, view.textures.GetByteSize());
+			func(Section::Dependencies, view.dependencies.data, view.dependencies.GetByteSize());
+			func(Section::Strings, view.strings.data, view.strings.GetByteSize());
+			func(Section::Blob, view.blob.data, view.blob.GetByteSize());
+		}
+	}
+
+	uint32_t Data::AddString(std::string_view value)
+	{
+		const uint32_t offset = static_cast<uint32_t>(strings.size());
+		strings.insert(strings.end(), value.begin(), value.end());
+		return offset;
+	}
+
+	uint64_t Data::AddBlob(const uint8_t* data, std::size_t size)
+	{
+		// Keep the entries aligned so they can be read in place
+		blob.resize(AlignOffset(blob.size()), 0);
+		const uint64_t offset = blob.size();
+		blob.insert(blob.end(), data, data + size);
+		return offset;
+	}
+
+	View Data::GetView() const
+	{
+		View view;
+		SetSlice(view.vertices, vertices);
+		SetSlice(view.compactVertices, compactVertices);
+		SetSlice(view.indices, indices);
+		SetSlice(view.shortIndices, shortIndices);
+		SetSlice(view.meshlets, meshlets);
+		SetSlice(view.meshletVertices, meshletVertices);
+		SetSlice(view.meshletTriangles, meshletTriangles);
+		SetSlice(view.primitives, primitives);
+		SetSlice(view.lods, lods);
+		SetSlice(view.nodes, nodes);
+		SetSlice(view.materials, materials);
+		SetSlice(view.textures, textures);
+		SetSlice(view.dependencies, dependencies);
+		SetSlice(view.strings, strings);
+		SetSlice(view.blob, blob);
+		return view;
+	}
+
+	std::string GetCachePath(const std::string& source)
+	{
+		return source + kExtension;
+	}
+
+	bool KeySource(const std::string& source, const ImportOptions& options, const View& view, SourceKey& key)
+	{
+		return HashSource(source, options, view, StampFile, key.stamp) && HashSource(source, options, view, HashFile, key.hash);
+	}
+
+	bool MatchSource(const std::string& source, const ImportOptions& options, const View& view, const SourceKey& cachedKey, SourceKey& key)
+	{
+		if (!HashSource(source, options, view, StampFile, key.stamp))
+			return false;
+
+		// Same size and modification time, the content isn't read
+		if (key.stamp == cachedKey.stamp)
+		{
+			key.hash = cachedKey.hash;
+			return true;
+		}
+		return HashSource(source, options, view, HashFile, key.hash) && key.hash == cachedKey.hash;
+	}
+
+	bool Write(const std::string& filename, const SourceKey& sourceKey, const View& view)
+	{
+		std::ofstream stream(filename, std::ios::binary);
+		if (!stream)
+		{
+			Logger::Warn("Failed to create mesh cache: " + filename);
+			return false;
+		}
+
+		Header header = {};
+		header.magic = kMagic;
+		header.version = kImporterVersion;
+		header.source = sourceKey;
+
+		uint64_t offset = sizeof(Header);
+		ForEachSection(view, [&](Section section, const void*, std::size_t size) {
+			offset = AlignOffset(offset);
+			header.sections[static_cast<uint32_t>(section)] = { offset, size };
+			offset += size;
+			});
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+		const char padding[kAlignment] = {};
+		offset = sizeof(Header);
+		ForEachSection(view, [&](Section section, const void* data, std::size_t size) {
+			const uint64_t sectionOffset = header.sections[static_cast<uint32_t>(section)].offset;
+			stream.write(padding, sectionOffset - offset);
+			if (size > 0)
+				stream.write(static_cast<const char*>(data), size);
+			offset = sectionOffset + size;
+			});
+
+		stream.close();
+		if (stream.fail())
+		{
+			Logger::Warn("Failed to write mesh cache: " + filename);
+			std::remove(filename.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool WriteKey(const std::string& filename, const SourceKey& sourceKey)
+	{
+		std::fstream stream(filename, std::ios::binary | std::ios::in | std::ios::out);
+		if (!stream)
+			return false;
+
+		stream.seekp(offsetof(Header, source));
+		stream.write(reinterpret_cast<const char*>(&sourceKey), sizeof(SourceKey));
+		return stream.good();
+	}
+
+	bool Read(const MappedFile& file, SourceKey& sourceKey, View& view)
+	{
+		const uint8_t* data = file.GetData();
+		const std::size_t size = file.GetSize();
+		if (size < sizeof(Header))
+			return false;
+
+		const Header* header = reinterpret_cast<const Header*>(data);
+		if (header->magic != kMagic || header->version != kImporterVersion)
+			return false;
+
+		auto section = [&](Section section) { return header->sections[static_cast<uint32_t>(section)]; };
+		const bool valid = ReadSlice(data, size, section(Section::Vertices), view.vertices) &&
+			ReadSlice(data, size, section(Section::CompactVertices), view.compactVertices) &&
+			ReadSlice(data, size, section(Section::Indices), view.indices) &&
+			ReadSlice(data, size, section(Section::ShortIndices), view.shortIndices) &&
+			ReadSlice(data, size, section(Section::Meshlets), view.meshlets) &&
+			ReadSlice(data, size, section(Section::MeshletVertices), view.meshletVertices) &&
+			ReadSlice(data, size, section(Section::MeshletTriangles), view.meshletTriangles) &&
+			ReadSlice(data, size, section(Section::Primitives), view.primitives) &&
+			ReadSlice(data, size, section(Section::Lods), view.lods) &&
+			ReadSlice(data, size, section(Section::Nodes), view.nodes) &&
+			ReadSlice(data, size, section(Section::Materials), view.materials) &&
+			ReadSlice(data, size, section(Section::Textures), view.textures) &&
+			ReadSlice(data, size, section(Section::Dependencies), view.dependencies) &&
+			ReadSlice(data, size, section(Section::Strings), view.strings) &&
+			ReadSlice(data, size, section(Section::Blob), view.blob);
+		if (!valid || !ValidateRanges(view))
+			return false;
+
+		sourceKey = header->source;
+		return true;
+	}
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "MeshData.h"
+#include "Components.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class MappedFile;
+
+/*
+* Cooked mesh written next to the source with the kExtension suffix.
+* File starts with Header followed by the sections, every section starts
+* at a multiple of kAlignment so the mapped file is read in place. Cache
+* is rebuilt when the importer version or the source key doesn't match,
+* the content of the source and its external buffers is only hashed when
+* their size or modification time changed.
+*/
+namespace MeshCache
+{
+	// Bump when the output of the importer changes
+	constexpr uint32_t kImporterVersion = 7;
+	constexpr uint32_t kAlignment = 16;
+	constexpr uint32_t kInvalidIndex = ~0u;
+	// Vertices a primitive can have for its indices to be stored in 16 bits
+	constexpr uint32_t kMaxShortIndexVertices = 1u << 16;
+	constexpr const char* kExtension = ".gsmesh";
+
+	enum class Section : uint32_t
+	{
+		Vertices = 0,
+		CompactVertices,
+		Indices,
+		ShortIndices,
+		Meshlets,
+		MeshletVertices,
+		MeshletTriangles,
+		Primitives,
+		Lods,
+		Nodes,
+		Materials,
+		Textures,
+		Dependencies,
+		Strings,
+		Blob,
+		Count
+	};
+
+	/*
+	* Vertex, index and meshlet range in elements, indices are relative to the first vertex.
+	* Index and meshlet counts are the ones of LOD 0, the ranges of the simplified levels
+	* follow it and are listed in the LOD table.
+	*/
+	struct Primitive
+	{
+		uint32_t vertexOffset;
+		uint32_t vertexCount;
+		uint32_t indexOffset;
+		uint32_t indexCount;
+		uint32_t meshletOffset;
+		uint32_t meshletCount;
+		uint32_t material;
+		uint32_t lodOffset;
+		BoundingBox boundingBox;
+		uint32_t lodCount;
+		uint32_t reserved;
+	};
+
+	// Entities in the creation order, the parent is always written before the children
+	struct Node
+	{
+		uint32_t parent;
+		uint32_t name;
+		uint32_t nameLength;
+		uint32_t primitive;
+		glm::vec3 position;
+		uint32_t reserved;
+		glm::fquat rotation;
+		glm::vec3 scale;
+		uint32_t reserved2;
+	};
+
+	enum class TextureSource : uint32_t
+	{
+		// Image file relative to the source, the name is the path
+		File = 0,
+		// Encoded image in the blob
+		Encoded,
+		// RGBA pixels in the blob
+		Raw
+	};
+
+	struct Texture
+	{
+		TextureSource source;
+		uint32_t name;
+		uint32_t nameLength;
+		uint32_t width;
+		uint32_t height;
+		uint32_t reserved[3];
+		uint64_t dataOffset;
+		uint64_t dataSize;
+	};
+
+	// External file hashed with the source, relative to the source
+	struct Dependency
+	{
+		uint32_t path;
+		uint32_t pathLength;
+	};
+
+	// Importer settings of an asset, a cache written with other settings is rebuilt
+	struct ImportOptions
+	{
+		// Triangle order for the post transform cache of the indexed path
+		bool optimizeVertexCache = true;
+		// Triangle clusters sorted front to back, needs the vertex cache order
+		bool optimizeOverdraw = true;
+		// Vertices in the order of the first use by the indices
+		bool optimizeVertexFetch = true;
+		// Largest vertex cache degradation accepted for less overdraw, 1.05 is 5% worse
+		float overdrawThreshold = 1.05f;
+		// CompactVertex instead of Vertex, positions are quantized in the bounds of each primitive
+		bool compactVertices = false;
+	};
+
+	// Identifies the source and the options a cache is written from
+	struct SourceKey
+	{
+		// Size and modification time of the source and the dependencies
+		uint64_t stamp = 0;
+		// Content of the same files
+		uint64_t hash = 0;
+	};
+
+	static_assert(sizeof(Primitive) % kAlignment == 0);
+	static_assert(sizeof(Node) % kAlignment == 0);
+	static_assert(sizeof(Texture) % kAlignment == 0);
+
+	template<typename T>
+	struct Slice
+	{
+		const T* data = nullptr;
+		std::size_t count = 0;
+
+		const T& operator[](std::size_t index) const { return data[index]; }
+		const T* begin() const { return data; }
+		const T* end() const { return data + count; }
+		std::size_t GetByteSize() const { return count * sizeof(T); }
+	};
+
+	// Points into the mapped file or into Data, material texture slots are indices in the texture table
+	struct View
+	{
+		Slice<Vertex> vertices;
+		Slice<CompactVertex> compactVertices;
+		Slice<uint32_t> indices;
+		Slice<uint16_t> shortIndices;
+		Slice<Meshlet> meshlets;
+		Slice<uint32_t> meshletVertices;
+		Slice<uint8_t> meshletTriangles;
+		Slice<Primitive> primitives;
+		Slice<MeshLod> lods;
+		Slice<Node> nodes;
+		Slice<MaterialComponent> materials;
+		Slice<Texture> textures;
+		Slice<Dependency> dependencies;
+		Slice<char> strings;
+		Slice<uint8_t> blob;
+
+		std::string_view GetString(uint32_t offset, uint32_t length) const
+		{
+			return std::string_view(strings.data + offset, length);
+		}
+
+		// Only one of the vertex sections is written, depending on the import options
+		bool HasCompactVertices() const { return compactVertices.count > 0; }
+		uint32_t GetVertexStride() const { return HasCompactVertices() ? sizeof(CompactVertex) : sizeof(Vertex); }
+		const void* GetVertexData() const { return HasCompactVertices() ? static_cast<const void*>(compactVertices.data) : vertices.data; }
+		std::size_t GetVertexByteSize() const { return HasCompactVertices() ? compactVertices.GetByteSize() : vertices.GetByteSize(); }
+
+		// Same for the indices, 16 bit when every primitive has at most kMaxShortIndexVertices vertices
+		bool HasShortIndices() const { return shortIndices.count > 0; }
+		gfx::IndexType GetIndexType() const { return HasShortIndices() ? gfx::IndexType::UInt16 : gfx::IndexType::UInt32; }
+		const void* GetIndexData() const { return HasShortIndices() ? static_cast<const void*>(shortIndices.data) : indices.data; }
+		std::size_t GetIndexByteSize() const { return HasShortIndices() ? shortIndices.GetByteSize() : indices.GetByteSize(); }
+	};
+
+	// Output of the importer
+	struct Data
+	{
+		std::vector<Vertex> vertices;
+		std::vector<CompactVertex> compactVertices;
+		std::vector<uint32_t> indices;
+		std::vector<uint16_t> shortIndices;
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+		std::vector<Primitive> primitives;
+		std::vector<MeshLod> lods;
+		std::vector<Node> nodes;
+		std::vector<MaterialComponent> materials;
+		std::vector<Texture> textures;
+		std::vector<Dependency> dependencies;
+		std::vector<char> strings;
+		std::vector<uint8_t> blob;
+
+		// Returns the offset of the string in the string table
+		uint32_t AddString(std::string_view value);
+
+		// Returns the offset of the data in the blob
+		uint64_t AddBlob(const uint8_t* data, std::size_t size);
+
+		View GetView() const;
+	};
+
+	std::string GetCachePath(const std::string& source);
+
+	// Stamp and hash of the source, the dependencies and the options, returns false if any of the files can't be read
+	bool KeySource(const std::string& source, const ImportOptions& options, const View& view, SourceKey& key);
+
+	// True if the cache is written from the current source, the files are hashed only when the stamp differs
+	bool MatchSource(const std::string& source, const ImportOptions& options, const View& view, const SourceKey& cachedKey, SourceKey& key);
+
+	bool Write(const std::string& filename, const SourceKey& sourceKey, const View& view);
+
+	// Rewrites the key of a cache that isn't mapped, used when only the stamp of the source changed
+	bool WriteKey(const std::string& filename, const SourceKey& sourceKey);
+
+	// View points into the mapped file, returns false if the file is corrupted or written by other importer version
+	bool Read(const MappedFile& file, SourceKey& sourceKey, View& view);
+}
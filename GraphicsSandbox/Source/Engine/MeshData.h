@@ -3,6 +3,7 @@
 #include "../Engine/GlmIncludes.h"
 #include "MathUtils.h"
 
+#include <cstddef>
 #include <vector>
 #include <string>
 
@@ -35,6 +36,28 @@ struct Vertex
 	}
 };
 
+/*
+* Vertex of the meshes imported with the compact option, read as 4 words by the shaders.
+* Position is quantized to unorm16 in the bounds of the primitive, normal and tangent are
+* octahedral snorm8 with the sign of the bitangent, uv is half float.
+*/
+struct CompactVertex
+{
+	uint16_t px, py, pz;
+	int8_t nx, ny;
+	int8_t tx, ty, tw;
+	uint8_t reserved;
+	uint16_t u, v;
+};
+
+static_assert(sizeof(CompactVertex) == 16);
+
+enum class VertexFormat : uint32_t
+{
+	Full = 0,
+	Compact
+};
+
 constexpr int NUM_BONE_PER_VERTEX = 4;
 struct AnimatedVertex : public Vertex
 {
@@ -83,12 +106,26 @@ struct Meshlet {
 	uint32_t triangleOffset;
 	uint32_t triangleCount;
 
-	// Cone information
+	// Mesh space bounding sphere, xyz center and w radius
+	glm::vec4 boundingSphere;
+
+	// Normal cone, xyz axis and w cutoff. Every triangle faces away from
+	// a viewer at the center when dot(dir, axis) >= cutoff * |dir| + radius
 	glm::vec4 cone;
 };
 
 static_assert(sizeof(Meshlet) % 16 == 0);
 
+// Index and meshlet range of a level of detail, the error is the deviation from LOD 0 in mesh space
+struct MeshLod
+{
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	uint32_t meshletOffset;
+	uint32_t meshletCount;
+	float error;
+};
+
 struct MeshDrawData {
 	glm::vec4 boudingSphere;
 
@@ -99,11 +136,56 @@ struct MeshDrawData {
 
 	uint32_t meshletOffset;
 	uint32_t meshletCount;
-	uint32_t meshletTriangleOffset;
-	uint32_t meshletTriangleCount;
+
+	// Range of the draw in the instance buffer, visible instances are compacted from firstInstance
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+
+	// Levels from the most detailed, LOD 0 is the range above
+	uint32_t lodCount;
+	MeshLod lods[kMaxLODs];
+
+	VertexFormat vertexFormat;
+	uint32_t reserved[2];
+	// Compact positions are decoded as offset + position * scale
+	glm::vec4 positionOffset;
+	glm::vec4 positionScale;
 };
 
 static_assert(sizeof(MeshDrawData) % 16 == 0);
+// vec4 members are 16 byte aligned in the std430 layout of the shaders
+static_assert(offsetof(MeshDrawData, positionOffset) % 16 == 0);
+
+// Meshlets in a task, TASK_GROUP_SIZE of the shaders
+constexpr uint32_t kMeshletTaskSize = 32;
+
+// Meshlets of a visible instance appended by the cull pass, culled and compacted by the meshlet cull pass
+struct MeshletTask
+{
+	// Visible instance, also the firstInstance of the compacted draw
+	uint32_t instanceIndex;
+	uint32_t meshletOffset;
+	uint32_t meshletCount;
+	uint32_t vertexOffset;
+};
+
+/*
+* Counters of a batch, the first three are the arguments of the meshlet
+* cull dispatch. Tasks are allocated with taskCount, the dispatch covers
+* the ones in the capacity of the batch in rows of MAX_DISPATCH_GROUPS.
+*/
+struct MeshletCullCounters
+{
+	uint32_t groupCountX;
+	uint32_t groupCountY;
+	uint32_t groupCountZ;
+	uint32_t commandCount;
+	uint32_t indexCount;
+	uint32_t taskCount;
+	uint32_t reserved[2];
+};
+
+static_assert(sizeof(MeshletCullCounters) % 16 == 0);
 
 void InitializeCubeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
 void InitializePlaneMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t subdivide = 2);
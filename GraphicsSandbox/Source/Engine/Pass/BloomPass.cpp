@@ -72,7 +72,7 @@ namespace gfx
 		uint32_t width = mWidth;
 		uint32_t height = mHeight;
 
-		float shaderData[] = { mBloomStrength, mRenderer->mEnvironmentData.exposure, 0.0f, 0.0f };
+		float shaderData[] = { mBloomStrength, mRenderer->GetRenderFrame().environmentData.exposure, 0.0f, 0.0f };
 		mDevice->PushConstants(commandList, mUpSamplePipeline, gfx::ShaderStage::Compute, shaderData, (uint32_t)(sizeof(float) * 4), 0);
 
 		mDevice->UpdateDescriptor(mCompositePipeline, descriptorInfos, static_cast<uint32_t>(std::size(descriptorInfos)));
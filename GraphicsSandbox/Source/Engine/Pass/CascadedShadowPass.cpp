@@ -43,6 +43,23 @@ namespace gfx {
 		for (uint32_t i = 0; i < std::size(shaders); ++i)
 			delete[] shaders[i].code;
 
+		// Task shader writes each meshlet only to the cascades it overlaps, no geometry shader
+		mSupportMeshShading = mDevice->SupportMeshShading();
+		if (mSupportMeshShading) {
+			for (uint32_t i = 0; i < std::size(shaders); ++i)
+			{
+				char* code = Utils::ReadFile(pathInfo->meshShaders[i], &size);
+				shaders[i] = { code, size };
+			}
+			mMeshletPipeline = mDevice->CreateGraphicsPipeline(&pipelineDesc);
+
+			for (uint32_t i = 0; i < std::size(shaders); ++i)
+				delete[] shaders[i].code;
+
+			meshletDescriptorInfos[0] = { renderer->mGlobalUniformBuffer, 0, sizeof(GlobalUniformData), gfx::DescriptorType::UniformBuffer };
+			meshletDescriptorInfos[3] = { renderer->mCascadeInfoBuffer, 0, sizeof(CascadeData), gfx::DescriptorType::UniformBuffer };
+		}
+
 		{
 			gfx::GPUBufferDesc bufferDesc;
 			bufferDesc.usage = gfx::Usage::Upload;
@@ -59,19 +76,16 @@ namespace gfx {
 
 	void CascadedShadowPass::Render(CommandList* commandList, Scene* scene)
 	{
-		ecs::Entity sun = scene->GetSun();
-		LightComponent* lightComponent = scene->GetComponentManager()->GetComponent<LightComponent>(sun);
-		if (!lightComponent->enabled) return;
-
-		// Calculate light direction
-		TransformComponent* lightTransform = scene->GetComponentManager()->GetComponent<TransformComponent>(sun);
-		glm::mat4 rotationMatrix = lightTransform->GetRotationMatrix();
-		glm::vec3 lightDir = rotationMatrix * glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
-		lightDir = glm::normalize(lightDir);
+		// Scene is updated by the main thread while recording, use the snapshot
+		const RenderFrame& frame = renderer->GetRenderFrame();
+		if (!frame.sunEnabled) return;
 
-		update(scene->GetCamera(), lightDir);
+		update(&frame.camera, frame.sunDirection);
 
-		render(commandList);
+		if (mSupportMeshShading && renderer->mUseMeshShading)
+			renderMeshlet(commandList);
+		else
+			render(commandList);
 
 	}
 
@@ -98,27 +112,60 @@ namespace gfx {
 	{
 		gfx::BufferHandle transformBuffer = renderer->mTransformBuffer;
 		gfx::BufferHandle dcb = renderer->mIndexedIndirectCommandBuffer;
+		// Shadow casters aren't culled, all the instances are drawn
+		gfx::BufferHandle instanceBuffer = renderer->mInstanceBuffer;
 
 		//Bind Pipeline
-		const std::vector<RenderBatch>& batches = renderer->mDrawBatches;
+		const std::vector<RenderBatch>& batches = renderer->GetRenderFrame().drawBatches;
 
 		uint32_t batchCount = 0;
 		for (const auto& batch : batches) {
 			const gfx::BufferView& vbView = batch.vertexBuffer;
 			descriptorInfos[1] = { vbView.buffer, 0, mDevice->GetBufferSize(vbView.buffer), gfx::DescriptorType::StorageBuffer };
-			descriptorInfos[2] = { transformBuffer, (uint32_t)(batch.offset * sizeof(glm::mat4)), (uint32_t)(batch.count * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[2] = { transformBuffer, (uint32_t)(batch.instanceOffset * sizeof(glm::mat4)), (uint32_t)(batch.instanceCount * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[4] = { instanceBuffer, (uint32_t)(batch.instanceOffset * sizeof(PerObjectData)), (uint32_t)(batch.instanceCount * sizeof(PerObjectData)), gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[5] = { renderer->mMeshDrawDataBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawData)), (uint32_t)(batch.count * sizeof(MeshDrawData)), gfx::DescriptorType::StorageBuffer };
 
 			const gfx::BufferView& ibView = batch.indexBuffer;
 			mDevice->UpdateDescriptor(mPipeline, descriptorInfos, (uint32_t)std::size(descriptorInfos));
 			mDevice->BindPipeline(commandList, mPipeline);
 
-			mDevice->BindIndexBuffer(commandList, ibView.buffer);
+			mDevice->BindIndexBuffer(commandList, ibView.buffer, batch.indexType);
 
 			mDevice->DrawIndexedIndirect(commandList,
 				dcb,
-				batch.offset * sizeof(gfx::DrawIndirectCommand),
+				batch.offset * sizeof(gfx::MeshDrawIndirectCommand),
 				batch.count,
-				sizeof(gfx::DrawIndirectCommand));
+				sizeof(gfx::MeshDrawIndirectCommand));
+		}
+	}
+
+	void CascadedShadowPass::renderMeshlet(CommandList* commandList)
+	{
+		gfx::BufferHandle transformBuffer = renderer->mTransformBuffer;
+		gfx::BufferHandle dcb = renderer->mIndexedIndirectCommandBuffer;
+		gfx::BufferHandle instanceBuffer = renderer->mInstanceBuffer;
+
+		const std::vector<RenderBatch>& batches = renderer->GetRenderFrame().drawBatches;
+		for (const auto& batch : batches) {
+			if (batch.count == 0) continue;
+
+			const gfx::BufferView& vbView = batch.vertexBuffer;
+			const uint32_t commandSize = sizeof(gfx::MeshDrawIndirectCommand);
+			meshletDescriptorInfos[1] = { vbView.buffer, 0, mDevice->GetBufferSize(vbView.buffer), gfx::DescriptorType::StorageBuffer };
+			meshletDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.instanceOffset * sizeof(glm::mat4)), (uint32_t)(batch.instanceCount * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
+			meshletDescriptorInfos[4] = { instanceBuffer, (uint32_t)(batch.instanceOffset * sizeof(PerObjectData)), (uint32_t)(batch.instanceCount * sizeof(PerObjectData)), gfx::DescriptorType::StorageBuffer };
+			meshletDescriptorInfos[5] = { renderer->mMeshDrawDataBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawData)), (uint32_t)(batch.count * sizeof(MeshDrawData)), gfx::DescriptorType::StorageBuffer };
+			meshletDescriptorInfos[6] = { dcb, batch.offset * commandSize, batch.count * commandSize, gfx::DescriptorType::StorageBuffer };
+			meshletDescriptorInfos[7] = { batch.meshletBuffer, 0, mDevice->GetBufferSize(batch.meshletBuffer), gfx::DescriptorType::StorageBuffer };
+			meshletDescriptorInfos[8] = { batch.meshletVertexBuffer, 0, mDevice->GetBufferSize(batch.meshletVertexBuffer), gfx::DescriptorType::StorageBuffer };
+			meshletDescriptorInfos[9] = { batch.meshletTriangleBuffer, 0, mDevice->GetBufferSize(batch.meshletTriangleBuffer), gfx::DescriptorType::StorageBuffer };
+
+			mDevice->UpdateDescriptor(mMeshletPipeline, meshletDescriptorInfos, (uint32_t)std::size(meshletDescriptorInfos));
+			mDevice->BindPipeline(commandList, mMeshletPipeline);
+
+			uint32_t offset = batch.offset * commandSize + offsetof(gfx::MeshDrawIndirectCommand, taskCount);
+			mDevice->DrawMeshTasksIndirect(commandList, dcb, offset, batch.count, commandSize);
 		}
 	}
 
@@ -150,7 +197,7 @@ namespace gfx {
 		return frustumCorners;
 	}
 
-	void CascadedShadowPass::update(Camera* camera, const glm::vec3& lightDirection)
+	void CascadedShadowPass::update(const Camera* camera, const glm::vec3& lightDirection)
 	{
 		CalculateSplitDistance(camera);
 		if (!mFreezeCameraFrustum) {
@@ -211,10 +258,12 @@ namespace gfx {
 	{
 		mDevice->Destroy(mPipeline);
 		mDevice->Destroy(mSkinnedPipeline);
+		if (mMeshletPipeline.handle != gfx::K_INVALID_RESOURCE_HANDLE)
+			mDevice->Destroy(mMeshletPipeline);
 
 	}
 
-	void CascadedShadowPass::CalculateSplitDistance(Camera* camera)
+	void CascadedShadowPass::CalculateSplitDistance(const Camera* camera)
 	{
 #if 0
 		mCascadeData.cascades[0].splitDistance.x = kShadowDistance / 50.0f;
@@ -42,11 +42,14 @@ namespace gfx {
 		void Shutdown() override;
 		virtual ~CascadedShadowPass() = default;
 
-		DescriptorInfo descriptorInfos[4];
+		DescriptorInfo descriptorInfos[6];
+		DescriptorInfo meshletDescriptorInfos[10];
 
 	private:
 		gfx::PipelineHandle mPipeline = gfx::INVALID_PIPELINE;
 		gfx::PipelineHandle mSkinnedPipeline = gfx::INVALID_PIPELINE;
+		gfx::PipelineHandle mMeshletPipeline = gfx::INVALID_PIPELINE;
+		bool mSupportMeshShading = false;
 
 		const int kNumCascades = 5;
 
@@ -59,7 +62,7 @@ namespace gfx {
 
 		CascadeData mCascadeData;
 
-		void CalculateSplitDistance(Camera* camera);
+		void CalculateSplitDistance(const Camera* camera);
 
 		uint32_t colors[5] = {
 		0xff000022,
@@ -72,12 +75,13 @@ namespace gfx {
 		glm::mat4 cameraVP = glm::mat4(1.0f);
 		bool mFreezeCameraFrustum = false;
 		bool mEnableCascadeDebug = false;
-		glm::vec3* cameraFrustumPoints = nullptr;
+		const glm::vec3* cameraFrustumPoints = nullptr;
 		int debugCascadeIndex = 0;
 
 		TextureHandle csmTexture = gfx::INVALID_TEXTURE;
 
-		void update(Camera* camera, const glm::vec3& lightDirection);
+		void update(const Camera* camera, const glm::vec3& lightDirection);
 		void render(CommandList* commandList);
+		void renderMeshlet(CommandList* commandList);
 	};
 };
\ No newline at end of file
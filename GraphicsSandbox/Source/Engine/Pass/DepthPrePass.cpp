@@ -22,14 +22,19 @@ void gfx::DepthPrePass::Initialize(RenderPassHandle renderPass)
 
 	ShaderPathInfo* shaderPathInfo = ShaderPath::get("depth_prepass");
 	if (mSupportMeshShading) {
-		uint32_t size = 0;
-		char* code = Utils::ReadFile(shaderPathInfo->meshShaders[0], &size);
-		ShaderDescription shader = { code, size };
-		pipelineDesc.shaderCount = 1;
-		pipelineDesc.shaderDesc = &shader;
+		uint32_t taskSize = 0;
+		char* taskCode = Utils::ReadFile(shaderPathInfo->meshShaders[0], &taskSize);
+		uint32_t meshSize = 0;
+		char* meshCode = Utils::ReadFile(shaderPathInfo->meshShaders[1], &meshSize);
+		ShaderDescription shaders[2] = { { taskCode, taskSize }, { meshCode, meshSize } };
+		pipelineDesc.shaderCount = 2;
+		pipelineDesc.shaderDesc = shaders;
 		meshletPipeline = device->CreateGraphicsPipeline(&pipelineDesc);
 		meshletDescriptorInfos[0] = { renderer->mGlobalUniformBuffer, 0, sizeof(GlobalUniformData), gfx::DescriptorType::UniformBuffer };
-		delete[] code;
+		const uint32_t counter = static_cast<uint32_t>(Renderer::MeshletCounter::DepthPrePass);
+		meshletDescriptorInfos[9] = { renderer->mCulledMeshletCountBuffer, counter * (uint32_t)sizeof(uint32_t), sizeof(uint32_t), gfx::DescriptorType::StorageBuffer };
+		delete[] taskCode;
+		delete[] meshCode;
 	}
 	
 	uint32_t size = 0;
@@ -47,7 +52,7 @@ void gfx::DepthPrePass::Render(CommandList* commandList, Scene* scene)
 	gfx::GraphicsDevice* device = gfx::GetDevice();
 
 	//Bind Pipeline
-	const std::vector<RenderBatch>& renderBatches = renderer->mDrawBatches;
+	const std::vector<RenderBatch>& renderBatches = renderer->GetRenderFrame().drawBatches;
 
 	if (mSupportMeshShading && renderer->mUseMeshShading)
 		drawMeshlet(device, commandList, renderBatches);
@@ -61,6 +66,7 @@ void gfx::DepthPrePass::drawIndexed(gfx::GraphicsDevice* device, gfx::CommandLis
 	gfx::BufferHandle transformBuffer = renderer->mTransformBuffer;
 	gfx::BufferHandle drawIndirectBuffer = renderer->mDrawIndirectBuffer;
 	gfx::BufferHandle drawCommandCountBuffer = renderer->mDrawCommandCountBuffer;
+	gfx::BufferHandle instanceBuffer = renderer->mVisibleInstanceBuffer;
 
 	uint32_t batchCount = 0;
 	for (const auto& batch : batches) {
@@ -68,23 +74,38 @@ void gfx::DepthPrePass::drawIndexed(gfx::GraphicsDevice* device, gfx::CommandLis
 
 		const gfx::BufferView& vbView = batch.vertexBuffer;
 		indexedDescriptorInfos[1] = { vbView.buffer, 0, device->GetBufferSize(vbView.buffer), gfx::DescriptorType::StorageBuffer };
-		indexedDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.offset * sizeof(glm::mat4)), (uint32_t)(batch.count * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
-		indexedDescriptorInfos[3] = { drawIndirectBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawIndirectCommand)), (uint32_t)(batch.count * sizeof(MeshDrawIndirectCommand)), gfx::DescriptorType::StorageBuffer };
+		indexedDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.instanceOffset * sizeof(glm::mat4)), (uint32_t)(batch.instanceCount * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
+		indexedDescriptorInfos[3] = { instanceBuffer, (uint32_t)(batch.GetVisibleInstanceOffset() * sizeof(PerObjectData)), (uint32_t)(batch.GetVisibleInstanceCount() * sizeof(PerObjectData)), gfx::DescriptorType::StorageBuffer };
+		indexedDescriptorInfos[4] = { renderer->mMeshDrawDataBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawData)), (uint32_t)(batch.count * sizeof(MeshDrawData)), gfx::DescriptorType::StorageBuffer };
 
 		const gfx::BufferView& ibView = batch.indexBuffer;
 
 		device->UpdateDescriptor(indexedPipeline, indexedDescriptorInfos, (uint32_t)std::size(indexedDescriptorInfos));
 		device->BindPipeline(commandList, indexedPipeline);
 
-		device->BindIndexBuffer(commandList, ibView.buffer);
+		// Draws of the visible meshlets written by the meshlet cull pass
+		if (renderer->IsMeshletCullingEnabled() && batch.meshletTaskCount > 0)
+		{
+			device->BindIndexBuffer(commandList, renderer->mMeshletIndexBuffer, gfx::IndexType::UInt32);
+			device->DrawIndexedIndirectCount(commandList,
+				renderer->mMeshletDrawCommandBuffer,
+				batch.meshletTaskOffset * sizeof(gfx::DrawIndirectCommand),
+				renderer->mMeshletCounterBuffer,
+				batch.id * sizeof(MeshletCullCounters) + offsetof(MeshletCullCounters, commandCount),
+				batch.meshletTaskCount,
+				sizeof(gfx::DrawIndirectCommand));
+			continue;
+		}
+
+		device->BindIndexBuffer(commandList, ibView.buffer, batch.indexType);
 
 		//device->DrawIndexedIndirect(commandList, drawIndirectBuffer, batch.offset * sizeof(gfx::MeshDrawIndirectCommand), batch.count, sizeof(gfx::MeshDrawIndirectCommand));
 		device->DrawIndexedIndirectCount(commandList,
 			drawIndirectBuffer,
-			batch.offset * sizeof(gfx::MeshDrawIndirectCommand),
+			batch.GetCommandOffset() * sizeof(gfx::MeshDrawIndirectCommand),
 			drawCommandCountBuffer,
 			batch.id * sizeof(uint32_t),
-			batch.count,
+			batch.GetCommandCount(),
 			sizeof(MeshDrawIndirectCommand));
 	}
 }
@@ -95,23 +116,26 @@ void gfx::DepthPrePass::drawMeshlet(gfx::GraphicsDevice* device, gfx::CommandLis
 	gfx::BufferHandle transformBuffer = renderer->mTransformBuffer;
 	gfx::BufferHandle dib = renderer->mDrawIndirectBuffer;
 	gfx::BufferHandle dcb = renderer->mDrawCommandCountBuffer;
+	gfx::BufferHandle instanceBuffer = renderer->mVisibleInstanceBuffer;
 
 	for (const auto& batch : batches) {
 		const gfx::BufferView& vbView = batch.vertexBuffer;
 		meshletDescriptorInfos[1] = { vbView.buffer, 0, device->GetBufferSize(vbView.buffer), gfx::DescriptorType::StorageBuffer };
-		meshletDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.offset * sizeof(glm::mat4)), (uint32_t)(batch.count * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
-		meshletDescriptorInfos[3] = { dib, (uint32_t)(batch.offset * sizeof(MeshDrawIndirectCommand)), (uint32_t)(batch.count * sizeof(MeshDrawIndirectCommand)), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.instanceOffset * sizeof(glm::mat4)), (uint32_t)(batch.instanceCount * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[3] = { dib, (uint32_t)(batch.GetCommandOffset() * sizeof(MeshDrawIndirectCommand)), (uint32_t)(batch.GetCommandCount() * sizeof(MeshDrawIndirectCommand)), gfx::DescriptorType::StorageBuffer };
 		meshletDescriptorInfos[4] = { batch.meshletBuffer, 0, device->GetBufferSize(batch.meshletBuffer), gfx::DescriptorType::StorageBuffer };
 		meshletDescriptorInfos[5] = { batch.meshletVertexBuffer, 0, device->GetBufferSize(batch.meshletVertexBuffer), gfx::DescriptorType::StorageBuffer };
 		meshletDescriptorInfos[6] = { batch.meshletTriangleBuffer, 0, device->GetBufferSize(batch.meshletTriangleBuffer), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[7] = { instanceBuffer, (uint32_t)(batch.GetVisibleInstanceOffset() * sizeof(PerObjectData)), (uint32_t)(batch.GetVisibleInstanceCount() * sizeof(PerObjectData)), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[8] = { renderer->mMeshDrawDataBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawData)), (uint32_t)(batch.count * sizeof(MeshDrawData)), gfx::DescriptorType::StorageBuffer };
 
 		device->UpdateDescriptor(meshletPipeline, meshletDescriptorInfos, (uint32_t)std::size(meshletDescriptorInfos));
 		device->BindPipeline(commandList, meshletPipeline);
 
 		uint32_t stride = sizeof(MeshDrawIndirectCommand);
-		uint32_t offset = batch.offset * sizeof(gfx::MeshDrawIndirectCommand) + offsetof(gfx::MeshDrawIndirectCommand, taskCount);
+		uint32_t offset = batch.GetCommandOffset() * sizeof(gfx::MeshDrawIndirectCommand) + offsetof(gfx::MeshDrawIndirectCommand, taskCount);
 		device->DrawMeshTasksIndirectCount(commandList, dib, offset, dcb, batch.id * sizeof(uint32_t),
-			batch.count,
+			batch.GetCommandCount(),
 			stride);
 	}
 }
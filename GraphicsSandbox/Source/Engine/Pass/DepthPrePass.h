@@ -19,10 +19,10 @@ namespace gfx {
 		//void OnResize(gfx::GraphicsDevice* device, uint32_t width, uint32_t height);
 
 		PipelineHandle indexedPipeline = INVALID_PIPELINE;
-		DescriptorInfo indexedDescriptorInfos[4];
+		DescriptorInfo indexedDescriptorInfos[5];
 
 		PipelineHandle meshletPipeline = INVALID_PIPELINE;
-		DescriptorInfo meshletDescriptorInfos[7];
+		DescriptorInfo meshletDescriptorInfos[10];
 		Renderer* renderer;
 
 	private: 
@@ -6,6 +6,7 @@
 #include "../GraphicsUtils.h"
 #include "../StringConstants.h"
 #include "../GUI/ImGuiService.h"
+#include <algorithm>
 #include <cassert>
 
 namespace gfx {
@@ -35,22 +36,47 @@ namespace gfx {
 		gfx::BufferHandle meshDrawDataBuffer = renderer->mMeshDrawDataBuffer;
 		gfx::BufferHandle drawIndirectBuffer = renderer->mDrawIndirectBuffer;
 		gfx::BufferHandle drawCommandCountBuffer = renderer->mDrawCommandCountBuffer;
+		gfx::BufferHandle instanceBuffer = renderer->mInstanceBuffer;
+		gfx::BufferHandle visibleInstanceBuffer = renderer->mVisibleInstanceBuffer;
+		gfx::BufferHandle meshletTaskBuffer = renderer->mMeshletTaskBuffer;
+		gfx::BufferHandle meshletCounterBuffer = renderer->mMeshletCounterBuffer;
 
 		// @TODO avoid copy if possible
-		std::vector<RenderBatch> renderBatches = renderer->mDrawBatches;
-		const std::vector<RenderBatch>& transparentBatches = renderer->mTransparentBatches;
+		const RenderFrame& frame = renderer->GetRenderFrame();
+		std::vector<RenderBatch> renderBatches = frame.drawBatches;
+		const std::vector<RenderBatch>& transparentBatches = frame.transparentBatches;
 		renderBatches.insert(renderBatches.end(), transparentBatches.begin(), transparentBatches.end());
 
 		const uint32_t mat4Size = sizeof(glm::mat4);
 		const uint32_t drawDataSize = sizeof(MeshDrawData);
 		const uint32_t drawIndirectSize = sizeof(MeshDrawIndirectCommand);
+		const uint32_t instanceSize = sizeof(PerObjectData);
+		const uint32_t meshletTaskSize = sizeof(MeshletTask);
+		const uint32_t meshletCounterSize = sizeof(MeshletCullCounters);
+		const bool meshletCulling = renderer->IsMeshletCullingEnabled();
 
 		std::array<glm::vec4, 6> frustumPlanes;
-		scene->GetCamera()->mFrustum->GetPlanes(frustumPlanes);
+		frame.camera.mFrustum->GetPlanes(frustumPlanes);
+
+		// Mesh space error times lodScale over the distance is the error in pixels over the threshold
+		LodData lodData = {};
+		lodData.enableLod = enableLod ? 1u : 0u;
+		lodData.lodScale = std::abs(frame.camera.GetProjectionMatrix()[1][1]) * 0.5f * renderer->GetHeight() / std::max(lodErrorThreshold, 0.01f);
+		lodData.cameraPosition = glm::vec4(frame.camera.GetPosition(), 1.0f);
+
+		// Instance counts are accumulated by the visible instances, commands of the LODs without any stay empty
+		uint32_t drawCount = 0;
+		for (auto& batch : renderBatches)
+			drawCount += batch.GetCommandCount();
+		const uint32_t sumDIBufferSize = std::max(drawCount * drawIndirectSize, drawIndirectSize);
 
 		device->FillBuffer(commandList, drawCommandCountBuffer, 0, device->GetBufferSize(drawCommandCountBuffer));
+		device->FillBuffer(commandList, drawIndirectBuffer, 0, sumDIBufferSize);
+		device->FillBuffer(commandList, meshletCounterBuffer, 0, device->GetBufferSize(meshletCounterBuffer));
 		ResourceBarrierInfo drawCountInitialize[] = {
 			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::None, gfx::AccessFlag::ShaderWrite, drawCommandCountBuffer, 0, device->GetBufferSize(drawCommandCountBuffer)),
+			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::TransferWriteBit, gfx::AccessFlag::ShaderReadWrite, drawIndirectBuffer, 0, sumDIBufferSize),
+			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::TransferWriteBit, gfx::AccessFlag::ShaderReadWrite, meshletCounterBuffer, 0, device->GetBufferSize(meshletCounterBuffer)),
 		};
 
 		gfx::PipelineBarrierInfo bufferInitializeBarrier = {
@@ -62,42 +88,61 @@ namespace gfx {
 		device->PipelineBarrier(commandList, &bufferInitializeBarrier);
 
 		device->PushConstants(commandList, pipeline, gfx::ShaderStage::Compute, frustumPlanes.data(), sizeof(glm::vec4) * 6, 0);
+		device->PushConstants(commandList, pipeline, gfx::ShaderStage::Compute, &lodData, sizeof(LodData), sizeof(glm::vec4) * 6 + sizeof(uint32_t) * 2);
 
-		uint32_t sumDIBufferSize = 0;
 		uint32_t sumDICBufferSize = 0;
+		uint32_t sumInstanceBufferSize = 0;
 
 		// Reset the totalVisibleCount buffer
 		// Instead of using fence we assume that the data filled during the last frame is valid and available
 		uint32_t* ptr = static_cast<uint32_t*>(device->GetMappedDataPtr(visibleMeshCountBuffer));
 		totalVisibleMesh = ptr[0];
 		std::memset(ptr, 0, sizeof(uint32_t));
+
+		// Same for the culled meshlets, the prepass culls the same meshlets as the GBuffer
+		uint32_t* culledMeshlets = static_cast<uint32_t*>(device->GetMappedDataPtr(renderer->mCulledMeshletCountBuffer));
+		const Renderer::MeshletCounter meshletCounter = renderer->mUseMeshShading ? Renderer::MeshletCounter::GBuffer : Renderer::MeshletCounter::MeshletCull;
+		totalCulledMeshlets = culledMeshlets[static_cast<uint32_t>(meshletCounter)];
+		std::memset(culledMeshlets, 0, sizeof(uint32_t) * static_cast<uint32_t>(Renderer::MeshletCounter::Count));
 		totalMesh = 0;
+		totalDraws = 0;
 		descriptorInfos[4] = { visibleMeshCountBuffer, 0, sizeof(uint32_t), gfx::DescriptorType::StorageBuffer };
 		for (auto& batch : renderBatches) {
 			if (batch.count == 0) continue;
 
-			uint32_t diBufferSize = (uint32_t)batch.count * drawIndirectSize;
-
-			descriptorInfos[0] = { transformBuffer, (uint32_t)batch.offset * mat4Size, (uint32_t)batch.count * mat4Size, gfx::DescriptorType::StorageBuffer };
+			// One thread per instance, the transform and instance buffers are indexed per instance
+			const uint32_t instanceBufferSize = batch.instanceCount * instanceSize;
+			const uint32_t visibleInstanceBufferSize = batch.GetVisibleInstanceCount() * instanceSize;
+			descriptorInfos[0] = { transformBuffer, batch.instanceOffset * mat4Size, batch.instanceCount * mat4Size, gfx::DescriptorType::StorageBuffer };
 			descriptorInfos[1] = { meshDrawDataBuffer, (uint32_t)batch.offset * drawDataSize, (uint32_t)batch.count * drawDataSize, gfx::DescriptorType::StorageBuffer };
-			descriptorInfos[2] = { drawIndirectBuffer, (uint32_t)batch.offset * drawIndirectSize, diBufferSize, gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[2] = { drawIndirectBuffer, batch.GetCommandOffset() * drawIndirectSize, batch.GetCommandCount() * drawIndirectSize, gfx::DescriptorType::StorageBuffer };
 			descriptorInfos[3] = { drawCommandCountBuffer, batch.id * (uint32_t)sizeof(uint32_t), sizeof(uint32_t), gfx::DescriptorType::StorageBuffer};
+			descriptorInfos[5] = { instanceBuffer, batch.instanceOffset * instanceSize, instanceBufferSize, gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[6] = { visibleInstanceBuffer, batch.GetVisibleInstanceOffset() * instanceSize, visibleInstanceBufferSize, gfx::DescriptorType::StorageBuffer };
+
+			// Batches that aren't culled per meshlet bind a single task, the shader doesn't write it
+			const bool emitTasks = meshletCulling && batch.meshletTaskCount > 0;
+			const uint32_t meshletTaskCount = emitTasks ? batch.meshletTaskCount : 1;
+			descriptorInfos[7] = { meshletTaskBuffer, batch.meshletTaskOffset * meshletTaskSize, meshletTaskCount * meshletTaskSize, gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[8] = { meshletCounterBuffer, batch.id * meshletCounterSize, meshletCounterSize, gfx::DescriptorType::StorageBuffer };
 
 			device->UpdateDescriptor(pipeline, descriptorInfos, (uint32_t)std::size(descriptorInfos));
 
-			uint32_t extraPushConstants[] = { batch.count, enableFrustumCulling ? 1u : 0u };
+			const uint32_t flags = (enableFrustumCulling ? kCullFlagFrustum : 0u) | (emitTasks ? kCullFlagMeshletTasks : 0u);
+			uint32_t extraPushConstants[] = { batch.instanceCount, flags };
 			device->PushConstants(commandList, pipeline, gfx::ShaderStage::Compute, (void*) &extraPushConstants, sizeof(uint32_t) * 2, sizeof(glm::vec4) * 6);
 			device->BindPipeline(commandList, pipeline);
-			device->DispatchCompute(commandList, gfx::GetWorkSize(batch.count, 32), 1, 1);
+			device->DispatchCompute(commandList, gfx::GetWorkSize(batch.instanceCount, 32), 1, 1);
 
-			sumDIBufferSize += diBufferSize;
 			sumDICBufferSize += sizeof(uint32_t);
-			totalMesh += batch.count;
+			sumInstanceBufferSize += visibleInstanceBufferSize;
+			totalMesh += batch.instanceCount;
+			totalDraws += batch.count;
 		}
 
 		// Add pipeline barrier
 		ResourceBarrierInfo barrierInfos[] = { 
-			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderWrite, gfx::AccessFlag::DrawCommandRead, drawIndirectBuffer, 0, sumDIBufferSize),
+			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderReadWrite, gfx::AccessFlag::DrawCommandRead, drawIndirectBuffer, 0, sumDIBufferSize),
 			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderWrite, gfx::AccessFlag::DrawCommandRead, drawCommandCountBuffer, 0, sumDICBufferSize),
 		};
 
@@ -108,6 +153,13 @@ namespace gfx {
 			gfx::PipelineStage::DrawIndirect
 		};
 		device->PipelineBarrier(commandList, &pipelineBarrier);
+
+		if (sumInstanceBufferSize > 0)
+		{
+			ResourceBarrierInfo instanceBarrier = ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderWrite, gfx::AccessFlag::ShaderRead, visibleInstanceBuffer, 0, sumInstanceBufferSize);
+			gfx::PipelineBarrierInfo vertexBarrier = { &instanceBarrier, 1, gfx::PipelineStage::ComputeShader, gfx::PipelineStage::VertexShader };
+			device->PipelineBarrier(commandList, &vertexBarrier);
+		}
 	}
 
 	void DrawCullPass::Shutdown()
@@ -122,8 +174,13 @@ namespace gfx {
 		ImGui::Separator();
 		if(ImGui::CollapsingHeader("DrawCull")) {
 			ImGui::Checkbox("Frustum Culling", &enableFrustumCulling);
+			ImGui::Checkbox("LOD Selection", &enableLod);
+			ImGui::SliderFloat("LOD Error (px)", &lodErrorThreshold, 0.1f, 16.0f);
 			ImGui::Text("Total Mesh: %d", totalMesh);
+			ImGui::Text("Mesh Draws: %d", totalDraws);
 			ImGui::Text("Visible Mesh Last Frame: %d", totalVisibleMesh);
+			if (renderer->mUseMeshShading || renderer->IsMeshletCullingEnabled())
+				ImGui::Text("Culled Meshlets Last Frame: %d", totalCulledMeshlets);
 		}
 	}
 }
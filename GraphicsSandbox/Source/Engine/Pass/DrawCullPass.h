@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../FrameGraph.h"
+#include "../GlmIncludes.h"
 
 class Renderer;
 class Scene;
@@ -23,11 +24,28 @@ namespace gfx {
 		Renderer* renderer;
 
 		PipelineHandle pipeline;
-		DescriptorInfo descriptorInfos[5];
+		DescriptorInfo descriptorInfos[9];
 	private:
+		// Bits of the flags pushed after the instance count, same as CULL_FLAG_* in the shader
+		static constexpr uint32_t kCullFlagFrustum = 1;
+		static constexpr uint32_t kCullFlagMeshletTasks = 2;
+
+		// Pushed after the frustum planes, instance count and culling flags
+		struct LodData
+		{
+			uint32_t enableLod;
+			float lodScale;
+			glm::vec4 cameraPosition;
+		};
+
 		uint32_t totalVisibleMesh = 0;
+		uint32_t totalCulledMeshlets = 0;
 		uint32_t totalMesh = 0;
+		uint32_t totalDraws = 0;
 		bool enableFrustumCulling = true;
+		bool enableLod = true;
+		// Largest projected error of the selected LOD in pixels
+		float lodErrorThreshold = 1.0f;
 		bool mSupportMeshShading = false;
 		BufferHandle visibleMeshCountBuffer;
 	};
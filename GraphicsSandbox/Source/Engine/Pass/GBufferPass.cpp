@@ -31,23 +31,25 @@ void gfx::GBufferPass::Initialize(RenderPassHandle renderPass)
 	ShaderPathInfo* shaderPathInfo = ShaderPath::get("gbuffer_pass");
 	if (mSupportMeshShading) {
 		uint32_t size = 0;
-		//char* taskCode = Utils::ReadFile(StringConstants::GBUFER_TASK_PATH, &size);
-		//shaders[0] = { taskCode, size };
+		char* taskCode = Utils::ReadFile(shaderPathInfo->meshShaders[0], &size);
+		shaders[0] = { taskCode, size };
 
 		char* meshCode = Utils::ReadFile(shaderPathInfo->meshShaders[1], &size);
-		shaders[0] = { meshCode, size };
+		shaders[1] = { meshCode, size };
 
 		char* fragmentCode = Utils::ReadFile(shaderPathInfo->shaders[1], &size);
-		shaders[1] = { fragmentCode, size };
+		shaders[2] = { fragmentCode, size };
 
-		pipelineDesc.shaderCount = 2;
+		pipelineDesc.shaderCount = 3;
 		pipelineDesc.rasterizationState.cullMode = gfx::CullMode::Back;
 		meshletPipeline = device->CreateGraphicsPipeline(&pipelineDesc);
 
-		//delete[] taskCode;
+		delete[] taskCode;
 		delete[] meshCode;
 		delete[] fragmentCode;
 		meshletDescriptorInfos[0] = { renderer->mGlobalUniformBuffer, 0, sizeof(GlobalUniformData), gfx::DescriptorType::UniformBuffer };
+		const uint32_t counter = static_cast<uint32_t>(Renderer::MeshletCounter::GBuffer);
+		meshletDescriptorInfos[10] = { renderer->mCulledMeshletCountBuffer, counter * (uint32_t)sizeof(uint32_t), sizeof(uint32_t), gfx::DescriptorType::StorageBuffer };
 	}
 
 	uint32_t size = 0;
@@ -71,7 +73,7 @@ void gfx::GBufferPass::Render(CommandList* commandList, Scene* scene)
 	gfx::GraphicsDevice* device = gfx::GetDevice();
 
 	//Bind Pipeline
-	const std::vector<RenderBatch>& renderBatches = renderer->mDrawBatches;
+	const std::vector<RenderBatch>& renderBatches = renderer->GetRenderFrame().drawBatches;
 	if (renderBatches.size() == 0) return;
 
 	if (mSupportMeshShading && renderer->mUseMeshShading)
@@ -89,30 +91,46 @@ void gfx::GBufferPass::drawIndexed(gfx::GraphicsDevice* device, gfx::CommandList
 	gfx::BufferHandle materialBuffer = renderer->mMaterialBuffer;
 	gfx::BufferHandle drawIndirectBuffer = renderer->mDrawIndirectBuffer;
 	gfx::BufferHandle drawCommandCountBuffer = renderer->mDrawCommandCountBuffer;
+	gfx::BufferHandle instanceBuffer = renderer->mVisibleInstanceBuffer;
 
 	for (const auto& batch : batches) {
 		if (batch.count == 0) continue;
 
 		const gfx::BufferView& vbView = batch.vertexBuffer;
 		indexedDescriptorInfos[1] = { vbView.buffer, 0, device->GetBufferSize(vbView.buffer), gfx::DescriptorType::StorageBuffer };
-		indexedDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.offset * sizeof(glm::mat4)), (uint32_t)(batch.count * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
-		indexedDescriptorInfos[3] = { drawIndirectBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawIndirectCommand)), (uint32_t)(batch.count * sizeof(MeshDrawIndirectCommand)), gfx::DescriptorType::StorageBuffer };
-		indexedDescriptorInfos[4] = { materialBuffer, (uint32_t)(batch.offset * sizeof(MaterialComponent)), (uint32_t)(batch.count * sizeof(MaterialComponent)), gfx::DescriptorType::StorageBuffer };
+		indexedDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.instanceOffset * sizeof(glm::mat4)), (uint32_t)(batch.instanceCount * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
+		indexedDescriptorInfos[3] = { instanceBuffer, (uint32_t)(batch.GetVisibleInstanceOffset() * sizeof(PerObjectData)), (uint32_t)(batch.GetVisibleInstanceCount() * sizeof(PerObjectData)), gfx::DescriptorType::StorageBuffer };
+		indexedDescriptorInfos[4] = { materialBuffer, (uint32_t)(batch.instanceOffset * sizeof(MaterialComponent)), (uint32_t)(batch.instanceCount * sizeof(MaterialComponent)), gfx::DescriptorType::StorageBuffer };
+		indexedDescriptorInfos[5] = { renderer->mMeshDrawDataBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawData)), (uint32_t)(batch.count * sizeof(MeshDrawData)), gfx::DescriptorType::StorageBuffer };
 
 		const gfx::BufferView& ibView = batch.indexBuffer;
 
 		device->UpdateDescriptor(indexedPipeline, indexedDescriptorInfos, (uint32_t)std::size(indexedDescriptorInfos));
 		device->BindPipeline(commandList, indexedPipeline);
 
-		device->BindIndexBuffer(commandList, ibView.buffer);
+		// Draws of the visible meshlets written by the meshlet cull pass
+		if (renderer->IsMeshletCullingEnabled() && batch.meshletTaskCount > 0)
+		{
+			device->BindIndexBuffer(commandList, renderer->mMeshletIndexBuffer, gfx::IndexType::UInt32);
+			device->DrawIndexedIndirectCount(commandList,
+				renderer->mMeshletDrawCommandBuffer,
+				batch.meshletTaskOffset * sizeof(gfx::DrawIndirectCommand),
+				renderer->mMeshletCounterBuffer,
+				batch.id * sizeof(MeshletCullCounters) + offsetof(MeshletCullCounters, commandCount),
+				batch.meshletTaskCount,
+				sizeof(gfx::DrawIndirectCommand));
+			continue;
+		}
+
+		device->BindIndexBuffer(commandList, ibView.buffer, batch.indexType);
 
 		//device->DrawIndexedIndirect(commandList, drawIndirectBuffer, batch.offset * sizeof(gfx::DrawIndirectCommand), batch.count, sizeof(gfx::DrawIndirectCommand));
 		device->DrawIndexedIndirectCount(commandList,
 			drawIndirectBuffer,
-			batch.offset * sizeof(gfx::MeshDrawIndirectCommand),
+			batch.GetCommandOffset() * sizeof(gfx::MeshDrawIndirectCommand),
 			drawCommandCountBuffer,
 			batch.id * sizeof(uint32_t),
-			batch.count,
+			batch.GetCommandCount(),
 			sizeof(MeshDrawIndirectCommand));
 	}
 }
@@ -124,26 +142,29 @@ void gfx::GBufferPass::drawMeshlet(gfx::GraphicsDevice* device, gfx::CommandList
 	gfx::BufferHandle materialBuffer = renderer->mMaterialBuffer;
 	gfx::BufferHandle dib = renderer->mDrawIndirectBuffer;
 	gfx::BufferHandle dcb = renderer->mDrawCommandCountBuffer;
+	gfx::BufferHandle instanceBuffer = renderer->mVisibleInstanceBuffer;
 
 	for (const auto& batch : batches) {
 		const gfx::BufferView& vbView = batch.vertexBuffer;
 		meshletDescriptorInfos[1] = { vbView.buffer, 0, device->GetBufferSize(vbView.buffer), gfx::DescriptorType::StorageBuffer };
-		meshletDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.offset * sizeof(glm::mat4)), (uint32_t)(batch.count * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
-		meshletDescriptorInfos[3] = { dib, (uint32_t)(batch.offset * sizeof(MeshDrawIndirectCommand)), (uint32_t)(batch.count * sizeof(MeshDrawIndirectCommand)), gfx::DescriptorType::StorageBuffer };
-		meshletDescriptorInfos[4] = { materialBuffer, (uint32_t)(batch.offset * sizeof(MaterialComponent)), (uint32_t)(batch.count * sizeof(MaterialComponent)), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[2] = { transformBuffer, (uint32_t)(batch.instanceOffset * sizeof(glm::mat4)), (uint32_t)(batch.instanceCount * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[3] = { dib, (uint32_t)(batch.GetCommandOffset() * sizeof(MeshDrawIndirectCommand)), (uint32_t)(batch.GetCommandCount() * sizeof(MeshDrawIndirectCommand)), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[4] = { materialBuffer, (uint32_t)(batch.instanceOffset * sizeof(MaterialComponent)), (uint32_t)(batch.instanceCount * sizeof(MaterialComponent)), gfx::DescriptorType::StorageBuffer };
 	
 		meshletDescriptorInfos[5] = { batch.meshletBuffer, 0, device->GetBufferSize(batch.meshletBuffer), gfx::DescriptorType::StorageBuffer };
 		meshletDescriptorInfos[6] = { batch.meshletVertexBuffer, 0, device->GetBufferSize(batch.meshletVertexBuffer), gfx::DescriptorType::StorageBuffer };
 		meshletDescriptorInfos[7] = { batch.meshletTriangleBuffer, 0, device->GetBufferSize(batch.meshletTriangleBuffer), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[8] = { instanceBuffer, (uint32_t)(batch.GetVisibleInstanceOffset() * sizeof(PerObjectData)), (uint32_t)(batch.GetVisibleInstanceCount() * sizeof(PerObjectData)), gfx::DescriptorType::StorageBuffer };
+		meshletDescriptorInfos[9] = { renderer->mMeshDrawDataBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawData)), (uint32_t)(batch.count * sizeof(MeshDrawData)), gfx::DescriptorType::StorageBuffer };
 
 		device->UpdateDescriptor(meshletPipeline, meshletDescriptorInfos, (uint32_t)std::size(meshletDescriptorInfos));
 		device->BindPipeline(commandList, meshletPipeline);
 
 		uint32_t stride = sizeof(MeshDrawIndirectCommand);
-		uint32_t offset = batch.offset * sizeof(gfx::MeshDrawIndirectCommand) + offsetof(gfx::MeshDrawIndirectCommand, taskCount);
+		uint32_t offset = batch.GetCommandOffset() * sizeof(gfx::MeshDrawIndirectCommand) + offsetof(gfx::MeshDrawIndirectCommand, taskCount);
 
 		device->DrawMeshTasksIndirectCount(commandList, dib, offset, dcb, batch.id * sizeof(uint32_t),
-			batch.count,
+			batch.GetCommandCount(),
 			stride);
 	}
 }
@@ -21,11 +21,11 @@ namespace gfx {
 		void Shutdown() override;
 
 		gfx::PipelineHandle indexedPipeline = gfx::INVALID_PIPELINE;
-		DescriptorInfo indexedDescriptorInfos[5];
+		DescriptorInfo indexedDescriptorInfos[6];
 
 		// Mesh shader pipeline
 		gfx::PipelineHandle meshletPipeline = gfx::INVALID_PIPELINE;
-		DescriptorInfo meshletDescriptorInfos[8];
+		DescriptorInfo meshletDescriptorInfos[11];
 
 		Renderer* renderer;
 
@@ -79,7 +79,8 @@ void gfx::LightingPass::Render(CommandList* commandList, Scene* scene)
 	};
 	device->UpdateDescriptor(pipeline, descriptorInfo, (uint32_t)std::size(descriptorInfo));
 	device->BindPipeline(commandList, pipeline);
-	device->PushConstants(commandList, pipeline, gfx::ShaderStage::Fragment, &renderer->mEnvironmentData, sizeof(EnvironmentData), 0);
+	EnvironmentData environmentData = renderer->GetRenderFrame().environmentData;
+	device->PushConstants(commandList, pipeline, gfx::ShaderStage::Fragment, &environmentData, sizeof(EnvironmentData), 0);
 	device->Draw(commandList, 6, 0, 1);
 
 	drawCubemap(commandList, scene);
@@ -89,7 +90,7 @@ void gfx::LightingPass::Render(CommandList* commandList, Scene* scene)
 void gfx::LightingPass::drawCubemap(gfx::CommandList* commandList, Scene* scene)
 {
 	// TODO: Define static Descriptor beforehand
-	MeshRenderer* cubeRenderer = scene->GetComponentManager()->GetComponent<MeshRenderer>(scene->mCube);
+	const RenderFrame& frame = renderer->GetRenderFrame();
 
 	gfx::DescriptorInfo descriptorInfos[3] = {};
 	descriptorInfos[0].buffer = renderer->mGlobalUniformBuffer;
@@ -97,16 +98,15 @@ void gfx::LightingPass::drawCubemap(gfx::CommandList* commandList, Scene* scene)
 	descriptorInfos[0].size = sizeof(GlobalUniformData);
 	descriptorInfos[0].type = gfx::DescriptorType::UniformBuffer;
 
-	auto& vb = cubeRenderer->vertexBuffer;
-	auto& ib = cubeRenderer->indexBuffer;
+	const gfx::BufferView& vb = frame.skyboxVertexBuffer;
+	const gfx::BufferView& ib = frame.skyboxIndexBuffer;
 
 	descriptorInfos[1].buffer = vb.buffer;
 	descriptorInfos[1].offset = vb.byteOffset;
 	descriptorInfos[1].size = vb.byteLength;
 	descriptorInfos[1].type = gfx::DescriptorType::StorageBuffer;
 
-	std::unique_ptr<EnvironmentMap>& envMap = scene->GetEnvironmentMap();
-	TextureHandle texture = envMap->GetCubemap();
+	TextureHandle texture = frame.skyboxTexture;
 	descriptorInfos[2].texture = &texture;
 	descriptorInfos[2].offset = 0;
 	descriptorInfos[2].type = gfx::DescriptorType::Image;
@@ -115,11 +115,11 @@ void gfx::LightingPass::drawCubemap(gfx::CommandList* commandList, Scene* scene)
 	gfx::GraphicsDevice* device = gfx::GetDevice();
 	device->UpdateDescriptor(cubemapPipeline, descriptorInfos, static_cast<uint32_t>(std::size(descriptorInfos)));
 	device->BindPipeline(commandList, cubemapPipeline);
-	float bloomThreshold = renderer->mEnvironmentData.bloomThreshold;
+	float bloomThreshold = frame.environmentData.bloomThreshold;
 	device->PushConstants(commandList, cubemapPipeline, ShaderStage::Fragment, &bloomThreshold, (uint32_t)sizeof(float));
 
-	device->BindIndexBuffer(commandList, ib.buffer);
-	device->DrawIndexed(commandList, cubeRenderer->GetIndexCount(), 1, ib.byteOffset / sizeof(uint32_t));
+	device->BindIndexBuffer(commandList, ib.buffer, frame.skyboxIndexType);
+	device->DrawIndexed(commandList, frame.skyboxIndexCount, 1, ib.byteOffset / gfx::GetIndexSize(frame.skyboxIndexType));
 }
 
 
@@ -0,0 +1,108 @@
+#include "MeshletCullPass.h"
+
+#include "../Renderer.h"
+#include "../GraphicsUtils.h"
+#include "../StringConstants.h"
+#include "../GUI/ImGuiService.h"
+
+namespace gfx {
+
+	MeshletCullPass::MeshletCullPass(Renderer* renderer_) : renderer(renderer_), pipeline({ gfx::K_INVALID_RESOURCE_HANDLE }) {
+
+	}
+
+	void MeshletCullPass::Initialize(RenderPassHandle renderPass)
+	{
+		ShaderPathInfo* shaderPathInfo = ShaderPath::get("meshletcull_pass");
+		gfx::GraphicsDevice* device = gfx::GetDevice();
+		pipeline = gfx::CreateComputePipeline(shaderPathInfo->shaders[0], device);
+
+		const uint32_t counter = static_cast<uint32_t>(Renderer::MeshletCounter::MeshletCull);
+		descriptorInfos[0] = { renderer->mGlobalUniformBuffer, 0, sizeof(GlobalUniformData), gfx::DescriptorType::UniformBuffer };
+		descriptorInfos[10] = { renderer->mCulledMeshletCountBuffer, counter * (uint32_t)sizeof(uint32_t), sizeof(uint32_t), gfx::DescriptorType::StorageBuffer };
+	}
+
+	void MeshletCullPass::Render(CommandList* commandList, Scene* scene)
+	{
+		if (!renderer->IsMeshletCullingEnabled())
+			return;
+
+		gfx::GraphicsDevice* device = gfx::GetDevice();
+
+		gfx::BufferHandle transformBuffer = renderer->mTransformBuffer;
+		gfx::BufferHandle visibleInstanceBuffer = renderer->mVisibleInstanceBuffer;
+		gfx::BufferHandle taskBuffer = renderer->mMeshletTaskBuffer;
+		gfx::BufferHandle counterBuffer = renderer->mMeshletCounterBuffer;
+		gfx::BufferHandle drawCommandBuffer = renderer->mMeshletDrawCommandBuffer;
+		gfx::BufferHandle indexBuffer = renderer->mMeshletIndexBuffer;
+
+		const uint32_t mat4Size = sizeof(glm::mat4);
+		const uint32_t instanceSize = sizeof(PerObjectData);
+		const uint32_t taskSize = sizeof(MeshletTask);
+		const uint32_t counterSize = sizeof(MeshletCullCounters);
+		const uint32_t drawCommandSize = sizeof(gfx::DrawIndirectCommand);
+		const uint32_t counterBufferSize = device->GetBufferSize(counterBuffer);
+
+		// Tasks, visible instances and dispatch arguments written by the cull pass
+		ResourceBarrierInfo taskBarriers[] = {
+			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderWrite, gfx::AccessFlag::ShaderRead, taskBuffer, 0, device->GetBufferSize(taskBuffer)),
+			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderWrite, gfx::AccessFlag::ShaderRead, visibleInstanceBuffer, 0, device->GetBufferSize(visibleInstanceBuffer)),
+			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderReadWrite, gfx::AccessFlag::ShaderReadWrite, counterBuffer, 0, counterBufferSize),
+		};
+		gfx::PipelineBarrierInfo taskBarrier = { taskBarriers, (uint32_t)std::size(taskBarriers), gfx::PipelineStage::ComputeShader, gfx::PipelineStage::ComputeShader };
+		device->PipelineBarrier(commandList, &taskBarrier);
+
+		ResourceBarrierInfo dispatchBarrierInfo = ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderReadWrite, gfx::AccessFlag::DrawCommandRead, counterBuffer, 0, counterBufferSize);
+		gfx::PipelineBarrierInfo dispatchBarrier = { &dispatchBarrierInfo, 1, gfx::PipelineStage::ComputeShader, gfx::PipelineStage::DrawIndirect };
+		device->PipelineBarrier(commandList, &dispatchBarrier);
+
+		for (const RenderBatch& batch : renderer->GetRenderFrame().drawBatches) {
+			if (batch.count == 0 || batch.meshletTaskCount == 0) continue;
+
+			descriptorInfos[1] = { transformBuffer, batch.instanceOffset * mat4Size, batch.instanceCount * mat4Size, gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[2] = { visibleInstanceBuffer, batch.GetVisibleInstanceOffset() * instanceSize, batch.GetVisibleInstanceCount() * instanceSize, gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[3] = { taskBuffer, batch.meshletTaskOffset * taskSize, batch.meshletTaskCount * taskSize, gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[4] = { batch.meshletBuffer, 0, device->GetBufferSize(batch.meshletBuffer), gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[5] = { batch.meshletVertexBuffer, 0, device->GetBufferSize(batch.meshletVertexBuffer), gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[6] = { batch.meshletTriangleBuffer, 0, device->GetBufferSize(batch.meshletTriangleBuffer), gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[7] = { counterBuffer, batch.id * counterSize, counterSize, gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[8] = { drawCommandBuffer, batch.meshletTaskOffset * drawCommandSize, batch.meshletTaskCount * drawCommandSize, gfx::DescriptorType::StorageBuffer };
+			descriptorInfos[9] = { indexBuffer, batch.meshletIndexOffset * (uint32_t)sizeof(uint32_t), batch.meshletIndexCount * (uint32_t)sizeof(uint32_t), gfx::DescriptorType::StorageBuffer };
+
+			device->UpdateDescriptor(pipeline, descriptorInfos, (uint32_t)std::size(descriptorInfos));
+
+			uint32_t firstIndex = batch.meshletIndexOffset;
+			device->PushConstants(commandList, pipeline, gfx::ShaderStage::Compute, &firstIndex, sizeof(uint32_t));
+			device->BindPipeline(commandList, pipeline);
+			// Group counts are clamped to the task capacity of the batch by the cull pass
+			device->DispatchComputeIndirect(commandList, counterBuffer, batch.id * counterSize);
+		}
+
+		ResourceBarrierInfo drawBarriers[] = {
+			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderWrite, gfx::AccessFlag::DrawCommandRead, drawCommandBuffer, 0, device->GetBufferSize(drawCommandBuffer)),
+			ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderReadWrite, gfx::AccessFlag::DrawCommandRead, counterBuffer, 0, counterBufferSize),
+		};
+		gfx::PipelineBarrierInfo drawBarrier = { drawBarriers, (uint32_t)std::size(drawBarriers), gfx::PipelineStage::ComputeShader, gfx::PipelineStage::DrawIndirect };
+		device->PipelineBarrier(commandList, &drawBarrier);
+
+		// Indices are read by the input assembly, there is no narrower stage for it
+		ResourceBarrierInfo indexBarrierInfo = ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::ShaderWrite, gfx::AccessFlag::MemoryRead, indexBuffer, 0, device->GetBufferSize(indexBuffer));
+		gfx::PipelineBarrierInfo indexBarrier = { &indexBarrierInfo, 1, gfx::PipelineStage::ComputeShader, gfx::PipelineStage::AllCommands };
+		device->PipelineBarrier(commandList, &indexBarrier);
+	}
+
+	void MeshletCullPass::Shutdown()
+	{
+		gfx::GetDevice()->Destroy(pipeline);
+	}
+
+	void MeshletCullPass::AddUI()
+	{
+		ImGui::Separator();
+		if (ImGui::CollapsingHeader("MeshletCull")) {
+			ImGui::Checkbox("Meshlet Culling", &renderer->mUseMeshletCulling);
+			if (renderer->mUseMeshShading)
+				ImGui::Text("Task shaders cull the meshlets with mesh shading");
+		}
+	}
+}
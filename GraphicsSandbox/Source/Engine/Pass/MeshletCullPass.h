@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../FrameGraph.h"
+
+class Renderer;
+class Scene;
+
+namespace gfx {
+	/*
+	* Meshlet culling of the indexed path. The cull pass appends a task per
+	* group of meshlets of each visible instance, each task is tested against
+	* the frustum and the normal cones and the triangles of the visible
+	* meshlets are written to a compacted index buffer with one draw per task.
+	*/
+	class MeshletCullPass : public FrameGraphPass
+	{
+	public:
+		MeshletCullPass(Renderer* renderer);
+
+		void Initialize(RenderPassHandle renderPass) override;
+
+		void Render(CommandList* commandList, Scene* scene) override;
+
+		void Shutdown() override;
+
+		void AddUI() override;
+
+		Renderer* renderer;
+
+		PipelineHandle pipeline;
+		DescriptorInfo descriptorInfos[11];
+	};
+}
@@ -6,6 +6,7 @@
 #include "TransparentPass.h"
 #include "FXAAPass.h"
 #include "DrawCullPass.h"
+#include "MeshletCullPass.h"
 #include "CascadedShadowPass.h"
 #include "SSAO.h"
 #include "BlurPass.h"
@@ -12,7 +12,7 @@
 
 namespace gfx {
 
-	SSAO::SSAO(Renderer* renderer)
+	SSAO::SSAO(Renderer* renderer) : renderer(renderer)
 	{
 		pushConstants.depthTexture = renderer->mFrameGraphBuilder.AccessResource("depth")->info.texture.texture.handle;
 		pushConstants.normalTexture = renderer->mFrameGraphBuilder.AccessResource("gbuffer_normals")->info.texture.texture.handle;
@@ -61,8 +61,9 @@ namespace gfx {
 
 	void SSAO::Render(CommandList* commandList, Scene* scene)
 	{
-		pushConstants.projectionMatrix = scene->GetCamera()->GetProjectionMatrix();
-		pushConstants.normalViewMatrix = glm::inverse(glm::transpose(scene->GetCamera()->GetViewMatrix()));
+		const Camera& camera = renderer->GetRenderFrame().camera;
+		pushConstants.projectionMatrix = camera.GetProjectionMatrix();
+		pushConstants.normalViewMatrix = glm::inverse(glm::transpose(camera.GetViewMatrix()));
 		gfx::GraphicsDevice* device = gfx::GetDevice();
 
 		device->UpdateDescriptor(pipeline, descriptorInfos, (uint32_t)std::size(descriptorInfos));
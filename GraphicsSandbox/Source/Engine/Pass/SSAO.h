@@ -27,6 +27,7 @@ namespace gfx {
 		TextureHandle randomRotationTexture;
 
 		gfx::PipelineHandle pipeline;
+		Renderer* renderer;
 
 		void GenerateKernelBuffer();
 		void GenerateRandomTexture();
@@ -52,7 +52,7 @@ void gfx::TransparentPass::Render(CommandList* commandList, Scene* scene)
 {
 	gfx::GraphicsDevice* device = gfx::GetDevice();
 
-	std::vector<RenderBatch>& renderBatches = renderer->mTransparentBatches;
+	const std::vector<RenderBatch>& renderBatches = renderer->GetRenderFrame().transparentBatches;
 	if (renderBatches.size() == 0) return;
 	drawIndexed(device, commandList, renderBatches);
 }
@@ -64,43 +64,46 @@ void gfx::TransparentPass::drawIndexed(gfx::GraphicsDevice* device, gfx::Command
 	gfx::BufferHandle materialBuffer = renderer->mMaterialBuffer;
 	gfx::BufferHandle drawIndirectBuffer = renderer->mDrawIndirectBuffer;
 	gfx::BufferHandle drawCommandCountBuffer = renderer->mDrawCommandCountBuffer;
+	gfx::BufferHandle instanceBuffer = renderer->mVisibleInstanceBuffer;
 
 	// Update push constant data
-	mPushConstantData.brdfLUT = renderer->mEnvironmentData.brdfLUT;
-	mPushConstantData.nLight = renderer->mEnvironmentData.nLight;
-	mPushConstantData.irradianceMap = renderer->mEnvironmentData.irradianceMap;
-	mPushConstantData.prefilterEnvMap = renderer->mEnvironmentData.prefilterEnvMap;
-	mPushConstantData.cameraPosition = renderer->mEnvironmentData.cameraPosition;
-	mPushConstantData.exposure = renderer->mEnvironmentData.exposure;
-	mPushConstantData.globalAO = renderer->mEnvironmentData.globalAO;
-	mPushConstantData.directionLightShadowMap = renderer->mEnvironmentData.directionalShadowMap;
+	const EnvironmentData& environmentData = renderer->GetRenderFrame().environmentData;
+	mPushConstantData.brdfLUT = environmentData.brdfLUT;
+	mPushConstantData.nLight = environmentData.nLight;
+	mPushConstantData.irradianceMap = environmentData.irradianceMap;
+	mPushConstantData.prefilterEnvMap = environmentData.prefilterEnvMap;
+	mPushConstantData.cameraPosition = environmentData.cameraPosition;
+	mPushConstantData.exposure = environmentData.exposure;
+	mPushConstantData.globalAO = environmentData.globalAO;
+	mPushConstantData.directionLightShadowMap = environmentData.directionalShadowMap;
 
 	device->PushConstants(commandList, pipeline, ShaderStage::Fragment, &mPushConstantData, sizeof(mPushConstantData), 0);
 
-	descriptorInfos[5] = { renderer->mLightBuffer, 0, sizeof(LightData) * 128, gfx::DescriptorType::StorageBuffer };
+	descriptorInfos[7] = { renderer->mLightBuffer, 0, sizeof(LightData) * 128, gfx::DescriptorType::StorageBuffer };
 
 	for (const auto& batch : batches) {
 		if (batch.count == 0) continue;
 
 		const gfx::BufferView& vbView = batch.vertexBuffer;
 		descriptorInfos[1] = { vbView.buffer, 0, device->GetBufferSize(vbView.buffer), gfx::DescriptorType::StorageBuffer };
-		descriptorInfos[2] = { transformBuffer, (uint32_t)(batch.offset * sizeof(glm::mat4)), (uint32_t)(batch.count * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
-		descriptorInfos[3] = { drawIndirectBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawIndirectCommand)), (uint32_t)(batch.count * sizeof(MeshDrawIndirectCommand)), gfx::DescriptorType::StorageBuffer };
-		descriptorInfos[4] = { materialBuffer, (uint32_t)(batch.offset * sizeof(MaterialComponent)), (uint32_t)(batch.count * sizeof(MaterialComponent)), gfx::DescriptorType::StorageBuffer };
+		descriptorInfos[2] = { transformBuffer, (uint32_t)(batch.instanceOffset * sizeof(glm::mat4)), (uint32_t)(batch.instanceCount * sizeof(glm::mat4)), gfx::DescriptorType::StorageBuffer };
+		descriptorInfos[3] = { instanceBuffer, (uint32_t)(batch.GetVisibleInstanceOffset() * sizeof(PerObjectData)), (uint32_t)(batch.GetVisibleInstanceCount() * sizeof(PerObjectData)), gfx::DescriptorType::StorageBuffer };
+		descriptorInfos[4] = { materialBuffer, (uint32_t)(batch.instanceOffset * sizeof(MaterialComponent)), (uint32_t)(batch.instanceCount * sizeof(MaterialComponent)), gfx::DescriptorType::StorageBuffer };
+		descriptorInfos[5] = { renderer->mMeshDrawDataBuffer, (uint32_t)(batch.offset * sizeof(MeshDrawData)), (uint32_t)(batch.count * sizeof(MeshDrawData)), gfx::DescriptorType::StorageBuffer };
 
 		const gfx::BufferView& ibView = batch.indexBuffer;
 
 		device->UpdateDescriptor(pipeline, descriptorInfos, (uint32_t)std::size(descriptorInfos));
 		device->BindPipeline(commandList, pipeline);
 
-		device->BindIndexBuffer(commandList, ibView.buffer);
+		device->BindIndexBuffer(commandList, ibView.buffer, batch.indexType);
 
 		device->DrawIndexedIndirectCount(commandList,
 			drawIndirectBuffer,
-			batch.offset * sizeof(gfx::MeshDrawIndirectCommand),
+			batch.GetCommandOffset() * sizeof(gfx::MeshDrawIndirectCommand),
 			drawCommandCountBuffer,
 			batch.id * sizeof(uint32_t),
-			batch.count,
+			batch.GetCommandCount(),
 			sizeof(MeshDrawIndirectCommand));
 
 	}
@@ -23,7 +23,7 @@ namespace gfx {
 
 		PipelineHandle pipeline;
 		Renderer* renderer;
-		DescriptorInfo descriptorInfos[7];
+		DescriptorInfo descriptorInfos[8];
 
 	private:
 		struct PushConstantData {
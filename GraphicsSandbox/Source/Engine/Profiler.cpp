@@ -1,13 +1,18 @@
 #include "Profiler.h"
 #include "Utils.h"
+#include "JobSystem.h"
 #include <unordered_map>
 
 #include <algorithm>
+#include <mutex>
 
 namespace Profiler
 {
 	bool initialized = false;
+	// Ranges are recorded by both the update and the render thread
+	std::mutex gMutex;
 	std::unordered_map<std::size_t, RangeData> gRangeData;
+	std::unordered_map<std::size_t, CounterData> gCounterData;
 	gfx::QueryPool gQueryPool;
 	uint32_t queryIdx;
 
@@ -17,9 +22,32 @@ namespace Profiler
 	uint64_t queryResult[128];
 	double gpuTimestampFrequency = 0.0;
 
+	Timer gFrameTimer;
+	std::vector<JobSystem::WorkerStats> gWorkerStats;
+	std::vector<WorkerData> gWorkerData;
+
 	void BeginFrame()
 	{
+		std::lock_guard<std::mutex> lock(gMutex);
 		id = 0;
+		gFrameTimer.record();
+	}
+
+	static void updateWorkerData()
+	{
+		const double frameTime = gFrameTimer.elapsedMilliseconds();
+		JobSystem::GetStatistics(gWorkerStats);
+		gWorkerData.resize(gWorkerStats.size());
+		for (std::size_t i = 0; i < gWorkerStats.size(); ++i)
+		{
+			const float utilization = frameTime > 0.0 ? float(gWorkerStats[i].busyTime / frameTime) : 0.0f;
+
+			// Smooth it out as the job distribution changes every frame
+			WorkerData& worker = gWorkerData[i];
+			worker.utilization = worker.utilization * 0.95f + std::min(utilization, 1.0f) * 0.05f;
+			worker.jobCount = gWorkerStats[i].jobCount;
+			worker.stealCount = gWorkerStats[i].stealCount;
+		}
 	}
 
 	void BeginFrameGPU(gfx::CommandList* commandList)
@@ -37,6 +65,7 @@ namespace Profiler
 
 	RangeId StartRangeCPU(const char* name)
 	{
+		std::lock_guard<std::mutex> lock(gMutex);
 		RangeId rangeId = Utils::StringHash(name);
 		gRangeData[rangeId].cpuTimer.record();
 		gRangeData[rangeId].name = name;
@@ -47,6 +76,7 @@ namespace Profiler
 
 	void EndRangeCPU(RangeId id)
 	{
+		std::lock_guard<std::mutex> lock(gMutex);
 		auto found = gRangeData.find(id);
 		if (found != gRangeData.end())
 		{
@@ -69,6 +99,7 @@ namespace Profiler
 
 	RangeId StartRangeGPU(gfx::CommandList* commandList, const char* name)
 	{
+		std::lock_guard<std::mutex> lock(gMutex);
 		RangeId rangeId = Utils::StringHash(name);
 		gRangeData[rangeId].name = name;
 		gRangeData[rangeId].gpuBegin = queryIdx;
@@ -82,6 +113,7 @@ namespace Profiler
 
 	void EndRangeGPU(gfx::CommandList* commandList, RangeId rangeId)
 	{
+		std::lock_guard<std::mutex> lock(gMutex);
 		auto found = gRangeData.find(rangeId);
 		if (found != gRangeData.end())
 		{
@@ -93,6 +125,9 @@ namespace Profiler
 
 	void EndFrame()
 	{
+		std::lock_guard<std::mutex> lock(gMutex);
+		updateWorkerData();
+
 		if (queryIdx == 0)
 			return;
 
@@ -122,6 +157,7 @@ namespace Profiler
 
 	void GetEntries(std::vector<RangeData>& out)
 	{
+		std::lock_guard<std::mutex> lock(gMutex);
 		for (auto& [k, v] : gRangeData)
 			out.push_back(v);
 
@@ -129,4 +165,34 @@ namespace Profiler
 			return lhs.id < rhs.id;
 			});
 	}
-}
\ No newline at end of file
+
+	void SetCounter(const char* name, uint32_t value)
+	{
+		std::lock_guard<std::mutex> lock(gMutex);
+		std::size_t counterId = Utils::StringHash(name);
+		auto& counter = gCounterData[counterId];
+		if (counter.name.empty())
+		{
+			counter.name = name;
+			counter.id = static_cast<uint32_t>(gCounterData.size());
+		}
+		counter.value = value;
+	}
+
+	void GetCounters(std::vector<CounterData>& out)
+	{
+		std::lock_guard<std::mutex> lock(gMutex);
+		for (auto& [k, v] : gCounterData)
+			out.push_back(v);
+
+		std::sort(out.begin(), out.end(), [](const CounterData& lhs, const CounterData& rhs) {
+			return lhs.id < rhs.id;
+			});
+	}
+
+	void GetWorkerData(std::vector<WorkerData>& out)
+	{
+		std::lock_guard<std::mutex> lock(gMutex);
+		out = gWorkerData;
+	}
+}
@@ -40,7 +40,29 @@ namespace Profiler
 	RangeId StartRangeGPU(gfx::CommandList* commandList, const char* name);
 	void EndRangeGPU(gfx::CommandList* commandList, RangeId rangeId);
 
+	struct CounterData
+	{
+		std::string name;
+		uint32_t value = 0;
+		uint32_t id = 0;
+	};
+
 	void EndFrame();
 
 	void GetEntries(std::vector<RangeData>& out);
+
+	// Per frame counter, value is overwritten each time it is set
+	void SetCounter(const char* name, uint32_t value);
+	void GetCounters(std::vector<CounterData>& out);
+
+	// Job system thread, index 0 is the main thread
+	struct WorkerData
+	{
+		// Busy time of the thread divided by the frame time
+		float utilization = 0.0f;
+		uint32_t jobCount = 0;
+		uint32_t stealCount = 0;
+	};
+
+	void GetWorkerData(std::vector<WorkerData>& out);
 };
@@ -8,14 +8,25 @@
 #include "DebugDraw.h"
 #include "TransformComponent.h"
 #include "TextureCache.h"
+#include "TransferQueue.h"
 #include "GUI/ImGuiService.h"
 #include "MeshData.h"
 #include "EventDispatcher.h"
+#include "JobSystem.h"
 
 #include "Pass/Pass.h"
 
 #include <vector>
 #include <algorithm>
+#include <cstring>
+
+// Number of items processed by a single job
+constexpr uint32_t kLightGrainSize = 64;
+constexpr uint32_t kBatchGrainSize = 512;
+
+// Batched entities kept outside the view before the batches are shrunk, relative to the visible ones
+constexpr uint32_t kMaxCandidateRatio = 2;
+constexpr uint32_t kMinCandidateSlack = 256;
 
 struct SortedLight {
 	uint32_t id;
@@ -82,6 +93,7 @@ Renderer::Renderer(uint32_t width, uint32_t height) : mDevice(gfx::GetDevice()),
 	RegisterPass("transparent_pass", new gfx::TransparentPass(this));
 	RegisterPass("fxaa_pass", new gfx::FXAAPass(this, width, height));
 	RegisterPass("drawcull_pass", new gfx::DrawCullPass(this));
+	RegisterPass("meshletcull_pass", new gfx::MeshletCullPass(this));
 	RegisterPass("ssao_pass", new gfx::SSAO(this));
 	RegisterPass("bloom_pass", new gfx::BloomPass(this, 1920, 1080));
 	// @NOTE For ComputePass with ImageStorage access layout we have to manually transition the image layout
@@ -109,6 +121,13 @@ Renderer::Renderer(uint32_t width, uint32_t height) : mDevice(gfx::GetDevice()),
 		mEnvironmentData.brdfLUT = env->GetBRDFLUT().handle;
 		mEnvironmentData.irradianceMap = env->GetIrradianceMap().handle;
 		mEnvironmentData.prefilterEnvMap = env->GetPrefilterMap().handle;
+
+		// Environment map is replaced between Update() and SwapFrame()
+		RenderFrame& frame = mFrames[mUpdateFrame];
+		frame.environmentData.brdfLUT = mEnvironmentData.brdfLUT;
+		frame.environmentData.irradianceMap = mEnvironmentData.irradianceMap;
+		frame.environmentData.prefilterEnvMap = mEnvironmentData.prefilterEnvMap;
+		frame.skyboxTexture = env->GetCubemap();
 		return true;
 		});
 }
@@ -139,8 +158,6 @@ void Renderer::SetScene(Scene* scene)
 // TODO: temp width and height variable
 void Renderer::Update(float dt)
 {
-	mUpdateBatches = true;
-
 	// Update Global Uniform Data
 	auto compMgr = mScene->GetComponentManager();
 	Camera* camera = mScene->GetCamera();
@@ -151,32 +168,158 @@ void Renderer::Update(float dt)
 	mGlobalUniformData.VP = P * V;
 	mGlobalUniformData.cameraPosition = camera->GetPosition();
 	mGlobalUniformData.dt += dt;
-	mDevice->CopyToBuffer(mGlobalUniformBuffer, &mGlobalUniformData, 0, sizeof(GlobalUniformData));
 
-	UpdateLights();
+	RenderFrame& frame = mFrames[mUpdateFrame];
+	frame.globalUniformData = mGlobalUniformData;
+	QueueUpload(mGlobalUniformBuffer, &mGlobalUniformData, 0, sizeof(GlobalUniformData));
+
+	// Camera is copied with its own frustum so the scene camera can keep moving
+	std::shared_ptr<Frustum> frustum = frame.camera.mFrustum;
+	frame.camera = *camera;
+	*frustum = *camera->mFrustum;
+	frame.camera.mFrustum = frustum;
 
 	// Update Environment data
-	mEnvironmentData.cameraPosition = mScene->GetCamera()->GetPosition();
+	frame.environmentData = mEnvironmentData;
+	frame.environmentData.cameraPosition = camera->GetPosition();
+
+	UpdateLights();
+
+	ecs::Entity sun = mScene->GetSun();
+	LightComponent* sunLight = compMgr->GetComponent<LightComponent>(sun);
+	TransformComponent* sunTransform = compMgr->GetComponent<TransformComponent>(sun);
+	frame.sunEnabled = sunLight != nullptr && sunTransform != nullptr && sunLight->enabled;
+	if (frame.sunEnabled)
+		frame.sunDirection = glm::normalize(glm::vec3(sunTransform->GetRotationMatrix() * glm::vec4(0.0f, 1.0f, 0.0f, 0.0f)));
+
+	MeshRenderer* skybox = compMgr->GetComponent<MeshRenderer>(mScene->mCube);
+	if (skybox)
+	{
+		frame.skyboxVertexBuffer = skybox->vertexBuffer;
+		frame.skyboxIndexBuffer = skybox->indexBuffer;
+		frame.skyboxIndexType = skybox->GetIndexType();
+		frame.skyboxIndexCount = static_cast<uint32_t>(skybox->GetIndexCount());
+	}
+	frame.skyboxTexture = mScene->GetEnvironmentMap()->GetCubemap();
+
+	// Rebuild the batch only if the set of drawable entity is changed,
+	// otherwise only upload the modified transform and material
+	auto meshRenderers = compMgr->GetComponentArray<MeshRenderer>();
+	auto transforms = compMgr->GetComponentArray<TransformComponent>();
+	auto materials = compMgr->GetComponentArray<MaterialComponent>();
+	if (meshRenderers->hasChanges() || transforms->hasStructuralChanges() || materials->hasStructuralChanges())
+		mUpdateBatches = true;
+
+	// Meshes outside the view that can't cast a shadow into it never become draw data. Batches
+	// cover a padded frustum and the draw cull rejects the instances that left the view, so they are
+	// only rebuilt when a visible mesh isn't batched or most of the batched ones are outside
+	const glm::vec3* shadowDirection = frame.sunEnabled && mEnvironmentData.enableShadow ? &frame.sunDirection : nullptr;
+	mScene->QueryVisible(*camera->mFrustum, shadowDirection, mVisibleEntities);
+	const std::size_t maxCandidates = kMaxCandidateRatio * mVisibleEntities.size() + kMinCandidateSlack;
+	if (!mUpdateBatches && (mDrawEntities.size() > maxCandidates || !IsBatched(mVisibleEntities)))
+		mUpdateBatches = true;
+
+	// Draw data is in mesh space, moved entities only upload their transform
+	uint32_t updatedDraws = 0;
+	if (!mUpdateBatches)
+		mUpdateBatches = !UpdateDrawData(materials->getModified(), updatedDraws);
+
+	TransformStore& transformStore = mScene->mTransformStore;
+	bool uploadTransforms = transforms->getModified().size() > 0;
 
-	// Update Batch if needed
 	if (mUpdateBatches) {
-		mDrawBatches.clear();
-		mTransparentBatches.clear();
+		frame.drawBatches.clear();
+		frame.transparentBatches.clear();
+
+		for (ecs::Entity entity : mDrawEntities)
+			mDrawSlots.reset(entity);
+		mDrawEntities.clear();
 
 		std::vector<DrawData> opaque;
 		std::vector<DrawData> transparent;
-		mScene->GenerateDrawData(opaque, transparent);
+		mScene->QueryVisible(*camera->mFrustum, shadowDirection, mCandidateEntities, mCandidateMargin);
+		mScene->GenerateDrawData(mCandidateEntities, opaque, transparent);
 
 		mBatchId = 0;
 		uint32_t lastOffset = 0;
-		lastOffset = CreateBatch(opaque, mDrawBatches, lastOffset);
-		lastOffset = CreateBatch(transparent, mTransparentBatches, lastOffset);
+		uint32_t drawOffset = 0;
+		CreateBatch(opaque, frame.drawBatches, lastOffset, drawOffset);
+		mOpaqueInstanceCount = lastOffset;
+
+		// Only the opaque batches are culled per meshlet, the ones that don't fit draw all the meshlets
+		uint32_t meshletTaskOffset = 0;
+		uint32_t meshletIndexOffset = 0;
+		for (RenderBatch& batch : frame.drawBatches)
+		{
+			if (meshletTaskOffset + batch.meshletTaskCount > kMaxMeshletTasks || meshletIndexOffset + batch.meshletIndexCount > kMaxMeshletIndices)
+			{
+				batch.meshletTaskCount = 0;
+				batch.meshletIndexCount = 0;
+				continue;
+			}
+			batch.meshletTaskOffset = meshletTaskOffset;
+			batch.meshletIndexOffset = meshletIndexOffset;
+			meshletTaskOffset += batch.meshletTaskCount;
+			meshletIndexOffset += batch.meshletIndexCount;
+		}
+
+		CreateBatch(transparent, frame.transparentBatches, lastOffset, drawOffset);
+		for (RenderBatch& batch : frame.transparentBatches)
+		{
+			batch.meshletTaskCount = 0;
+			batch.meshletIndexCount = 0;
+		}
+		updatedDraws = lastOffset;
+		Profiler::SetCounter("Mesh Draws", drawOffset);
+
+		// Order the world matrices same as the draws so it can be copied at once
+		transformStore.Reorder(mDrawEntities.data(), lastOffset);
+		uploadTransforms = true;
 		mUpdateBatches = false;
 	}
+
+	const uint32_t drawCount = static_cast<uint32_t>(mDrawEntities.size());
+	if (uploadTransforms && drawCount > 0)
+		QueueUpload(mTransformBuffer, transformStore.GetWorldMatrices(), 0, drawCount * sizeof(glm::mat4));
+
+	Profiler::SetCounter("Modified Transforms", static_cast<uint32_t>(transforms->getModified().size()));
+	Profiler::SetCounter("Modified Materials", static_cast<uint32_t>(materials->getModified().size()));
+	Profiler::SetCounter("Updated Draws", updatedDraws);
+	Profiler::SetCounter("Visible Meshes", static_cast<uint32_t>(mVisibleEntities.size()));
+	Profiler::SetCounter("Batched Meshes", drawCount);
 }
 
 
-void Renderer::Render(gfx::CommandList* commandList)
+void Renderer::SwapFrame()
+{
+	mUpdateFrame ^= 1;
+
+	// Batches are only rebuilt when the drawable entities are changed
+	RenderFrame& renderFrame = mFrames[mUpdateFrame ^ 1];
+	RenderFrame& updateFrame = mFrames[mUpdateFrame];
+	updateFrame.drawBatches = renderFrame.drawBatches;
+	updateFrame.transparentBatches = renderFrame.transparentBatches;
+
+	// Render() was skipped for the previous frame, its uploads go before the new ones
+	if (!updateFrame.uploads.empty())
+	{
+		const uint32_t dataOffset = static_cast<uint32_t>(updateFrame.uploadData.size());
+		for (RenderFrame::BufferUpload upload : renderFrame.uploads)
+		{
+			upload.dataOffset += dataOffset;
+			updateFrame.uploads.push_back(upload);
+		}
+		updateFrame.uploadData.insert(updateFrame.uploadData.end(), renderFrame.uploadData.begin(), renderFrame.uploadData.end());
+		std::swap(updateFrame.uploads, renderFrame.uploads);
+		std::swap(updateFrame.uploadData, renderFrame.uploadData);
+		updateFrame.uploads.clear();
+		updateFrame.uploadData.clear();
+	}
+
+	DebugDraw::Submit();
+}
+
+void Renderer::UpdateUI()
 {
 	// New GUI Frame
 	ui::ImGuiService::GetInstance()->NewFrame();
@@ -185,6 +328,35 @@ void Renderer::Render(gfx::CommandList* commandList)
 	AddUI();
 	mScene->AddUI();
 
+	for (uint32_t i = 0; i < mFrameGraph.nodeHandles.size(); ++i)
+	{
+		gfx::FrameGraphNode* node = mFrameGraphBuilder.AccessNode(mFrameGraph.nodeHandles[i]);
+		if (node->enabled)
+			node->renderer->AddUI();
+	}
+	ImGui::End();
+
+	ui::ImGuiService::GetInstance()->EndFrame();
+}
+
+void Renderer::QueueUpload(gfx::BufferHandle buffer, const void* data, uint32_t offset, uint32_t size)
+{
+	RenderFrame& frame = mFrames[mUpdateFrame];
+	const uint32_t dataOffset = static_cast<uint32_t>(frame.uploadData.size());
+	frame.uploadData.resize(dataOffset + size);
+	std::memcpy(frame.uploadData.data() + dataOffset, data, size);
+	frame.uploads.push_back({ buffer, offset, dataOffset, size });
+}
+
+void Renderer::Render(gfx::CommandList* commandList)
+{
+	RenderFrame& frame = mFrames[mUpdateFrame ^ 1];
+	for (const RenderFrame::BufferUpload& upload : frame.uploads)
+		mDevice->CopyToBuffer(upload.buffer, frame.uploadData.data() + upload.dataOffset, upload.offset, upload.size);
+	frame.uploads.clear();
+	frame.uploadData.clear();
+	TransferQueue::Flush(commandList);
+
 	for (uint32_t i = 0; i < mFrameGraph.nodeHandles.size(); ++i)
 	{
 		gfx::FrameGraphNode* node = mFrameGraphBuilder.AccessNode(mFrameGraph.nodeHandles[i]);
@@ -298,18 +470,15 @@ void Renderer::Render(gfx::CommandList* commandList)
 			node->renderer->Render(commandList, mScene);
 
 			if (node->name == "transparent_pass") {
-				DebugDraw::Draw(commandList, mGlobalUniformData.VP, mGlobalUniformData.cameraPosition);
+				DebugDraw::Draw(commandList, frame.globalUniformData.VP, frame.globalUniformData.cameraPosition);
 			}
 
 			mDevice->EndRenderPass(commandList);
 		}
 		// End GPU Timer
 		Profiler::EndRangeGPU(commandList, nodeProfilerId);
-		// Draw UI
-		node->renderer->AddUI();
 		mDevice->EndDebugLabel(commandList);
 	}
-	ImGui::End();
 
 	RangeId start = Profiler::StartRangeGPU(commandList, "fullscreen_pass");
 	mDevice->BeginDebugLabel(commandList, "fullscreen_pass");
@@ -469,17 +638,26 @@ void Renderer::InitializeBuffers()
 	mLightBuffer = mDevice->CreateBuffer(&bufferDesc);
 
 	// MeshDraw Data Buffer
-	bufferDesc.size = kMaxEntity * sizeof(MeshDrawData);
+	bufferDesc.size = kMaxDraws * sizeof(MeshDrawData);
 	bufferDesc.bindFlag = gfx::BindFlag::ShaderResource;
 	mMeshDrawDataBuffer = mDevice->CreateBuffer(&bufferDesc);
 
-	// Draw Indirect Buffer
+	// Instance Buffer
+	bufferDesc.size = kMaxEntity * sizeof(PerObjectData);
+	mInstanceBuffer = mDevice->CreateBuffer(&bufferDesc);
+
+	// Visible Instance Buffer, written by the cull pass in one range per LOD
+	bufferDesc.size = kMaxEntity * kMaxLODs * sizeof(PerObjectData);
 	bufferDesc.usage = gfx::Usage::Default;
-	bufferDesc.size = kMaxEntity * sizeof(gfx::MeshDrawIndirectCommand);
+	mVisibleInstanceBuffer = mDevice->CreateBuffer(&bufferDesc);
+
+	// Draw Indirect Buffer, one command per LOD of each draw
+	bufferDesc.size = kMaxDraws * kMaxLODs * sizeof(gfx::MeshDrawIndirectCommand);
 	bufferDesc.bindFlag = gfx::BindFlag::IndirectBuffer | gfx::BindFlag::ShaderResource;
 	mDrawIndirectBuffer = mDevice->CreateBuffer(&bufferDesc);
 
-	bufferDesc.size = kMaxEntity * sizeof(gfx::DrawIndirectCommand);
+	// Shadow pass commands, one per draw with all the instances for the indexed and the mesh shading path
+	bufferDesc.size = kMaxDraws * sizeof(gfx::MeshDrawIndirectCommand);
 	mIndexedIndirectCommandBuffer = mDevice->CreateBuffer(&bufferDesc);
 
 	// DrawCommand Count Buffer
@@ -492,6 +670,28 @@ void Renderer::InitializeBuffers()
 	bufferDesc.size = sizeof(CascadeData);
 	bufferDesc.usage = gfx::Usage::Upload;
 	mCascadeInfoBuffer = mDevice->CreateBuffer(&bufferDesc);
+
+	// Culled Meshlet Count Buffer, mapped to read the counters of the last frame
+	bufferDesc.size = sizeof(uint32_t) * static_cast<uint32_t>(MeshletCounter::Count);
+	bufferDesc.bindFlag = gfx::BindFlag::ShaderResource;
+	mCulledMeshletCountBuffer = mDevice->CreateBuffer(&bufferDesc);
+
+	// Meshlet cull buffers, the counters are the dispatch arguments and the draw counts
+	bufferDesc.usage = gfx::Usage::Default;
+	bufferDesc.size = kMaxMeshletTasks * sizeof(MeshletTask);
+	bufferDesc.bindFlag = gfx::BindFlag::ShaderResource;
+	mMeshletTaskBuffer = mDevice->CreateBuffer(&bufferDesc);
+
+	bufferDesc.size = kMaxBatches * sizeof(MeshletCullCounters);
+	bufferDesc.bindFlag = gfx::BindFlag::ShaderResource | gfx::BindFlag::IndirectBuffer;
+	mMeshletCounterBuffer = mDevice->CreateBuffer(&bufferDesc);
+
+	bufferDesc.size = kMaxMeshletTasks * sizeof(gfx::DrawIndirectCommand);
+	mMeshletDrawCommandBuffer = mDevice->CreateBuffer(&bufferDesc);
+
+	bufferDesc.size = kMaxMeshletIndices * sizeof(uint32_t);
+	bufferDesc.bindFlag = gfx::BindFlag::ShaderResource | gfx::BindFlag::IndexBuffer;
+	mMeshletIndexBuffer = mDevice->CreateBuffer(&bufferDesc);
 }
 
 void Renderer::AddUI()
@@ -504,6 +704,7 @@ void Renderer::AddUI()
 	ImGui::SliderFloat("globalAOMultiplier", &mEnvironmentData.globalAO, 0.0f, 1.0f);
 	ImGui::SliderFloat("exposure", &mEnvironmentData.exposure, 0.0f, 4.0f);
 	ImGui::DragFloat("Bloom Threshold", &mEnvironmentData.bloomThreshold, 0.001f, 0.0f, 1.0f);
+	ImGui::DragFloat("Batch Cull Margin", &mCandidateMargin, 0.1f, 0.0f, 100.0f);
 
 	static bool enableShadow = mEnvironmentData.enableShadow > 0 ? true : false;
 	if (ImGui::Checkbox("Shadow", &enableShadow)) {
@@ -516,7 +717,7 @@ void Renderer::AddUI()
 		mEnvironmentData.enableAO = uint32_t(enableAO);
 	}
 
-	ImGui::Text("Visible Light: %d", (uint32_t)projectedLightRects.size());
+	ImGui::Text("Visible Light: %d", (uint32_t)GetRenderFrame().projectedLightRects.size());
 
 	if (ImGui::BeginCombo("Final Output", mOutputAttachments[mFinalOutput].c_str()))
 	{
@@ -590,13 +791,24 @@ void Renderer::UpdateLights()
 {
 	// Update Light Uniform Data
 	auto compMgr = mScene->GetComponentManager();
-	auto lightArrComponent = compMgr->GetComponentArray<LightComponent>();
-	std::vector<LightComponent>& lights = lightArrComponent->components;
-	std::vector<ecs::Entity>& entities = lightArrComponent->entities;
+	auto lightView = compMgr->Query<LightComponent, TransformComponent>();
 	Camera* camera = mScene->GetCamera();
-
-	std::vector<SortedLight> sortedLights;
-	std::vector<LightData> lightData;
+	RenderFrame& frame = mFrames[mUpdateFrame];
+
+	// Lights are gathered in the view order and evaluated in parallel, the
+	// results are compacted in the same order so the light ids are unchanged
+	std::vector<std::pair<LightComponent*, TransformComponent*>> lights;
+	lights.reserve(lightView.sizeHint());
+	lightView.each([&](ecs::Entity entity, LightComponent& light, TransformComponent& transform) {
+		lights.emplace_back(&light, &transform);
+	});
+
+	enum LightResult : uint8_t { LightEnabled = 1, LightSorted = 2, LightVisible = 4 };
+	const uint32_t lightCount = static_cast<uint32_t>(lights.size());
+	std::vector<uint8_t> lightResults(lightCount, 0);
+	std::vector<LightData> lightDataResults(lightCount);
+	std::vector<SortedLight> sortedLightResults(lightCount);
+	std::vector<glm::vec4> lightRectResults(lightCount);
 
 	const float nearPlane = camera->GetNearPlane();
 	const float farPlane = camera->GetFarPlane();
@@ -604,22 +816,23 @@ void Renderer::UpdateLights()
 
 	// Compute the distance of the light min, max and center position in 
 	// the cameraSpace and convert it between 0 and 1
-	for (uint32_t i = 0; i < lights.size(); ++i) {
-		LightComponent& light = lights[i];
-		if (!light.enabled) continue;
+	auto computeLightData = [&](uint32_t i) {
+		const LightComponent& light = *lights[i].first;
+		const TransformComponent& transform = *lights[i].second;
+		if (!light.enabled) return;
 
 		// Update the lightData that is sent to buffer
-		TransformComponent* transform = compMgr->GetComponent<TransformComponent>(entities[i]);
 		glm::vec3 position = glm::vec3(0.0f);
-		if (lights[i].type == LightType::Directional)
-			position = normalize(transform->GetRotationMatrix() * glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
-		else if (lights[i].type == LightType::Point)
-			position = transform->position;
+		if (light.type == LightType::Directional)
+			position = normalize(transform.GetRotationMatrix() * glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+		else if (light.type == LightType::Point)
+			position = transform.position;
 		else assert(!"Undefined Light Type");
 
-		lightData.emplace_back(LightData{ position, lights[i].radius, lights[i].color * lights[i].intensity, (float)lights[i].type });
+		lightDataResults[i] = LightData{ position, light.radius, light.color * light.intensity, (float)light.type };
+		lightResults[i] |= LightEnabled;
 
-		if (light.type == LightType::Directional) continue;
+		if (light.type == LightType::Directional) return;
 		float radius = light.radius;
 
 		glm::vec3 projectedPosition = camera->ComputeViewSpaceCoordinate(position);
@@ -630,69 +843,23 @@ void Renderer::UpdateLights()
 		float zMin = (projectedMinPosition.z - nearPlane) * invPlaneDistance;
 		float zMax = (projectedMaxPosition.z - nearPlane) * invPlaneDistance;
 
-		SortedLight sortedLight = {
-			i, z, zMin, zMax
-		};
-		sortedLights.emplace_back(SortedLight{ (uint32_t)i, z, zMin, zMax });
-	}
-
-	// Sort the light by projectedZ value
-	std::qsort(sortedLights.data(), sortedLights.size(), sizeof(SortedLight), [](const void* a, const void* b) {
-		const SortedLight* la = (const SortedLight*)a;
-		const SortedLight* lb = (const SortedLight*)b;
-
-		if (la->projectedZ < lb->projectedZ) return -1;
-		else if (la->projectedZ > lb->projectedZ) return 1;
-		return 0;
-		});
-
-	// Upload LightData to GPU
-	uint32_t nLights = static_cast<uint32_t>(lightData.size());
-	assert(nLights <= kMaxLights);
-	if(nLights > 0)
-		mDevice->CopyToBuffer(mLightBuffer, lightData.data(), 0, sizeof(LightData) * nLights);
-	mEnvironmentData.nLight = nLights;
-
-
-
-	// Calculate light LUT, we use uniform distribution to sort the light into bins
-	const float binSize = 1.0f / kMaxLightBins;
-	for (uint16_t bin = 0; bin < kMaxLightBins; ++bin) {
-		uint16_t minLightId = kMaxLights + 1;
-		uint16_t maxLightId = 0;
-
-		const float binMin = binSize * bin;
-		const float binMax = binMin + binSize;
-
-		for (uint32_t i = 0; i < sortedLights.size(); ++i) {
-			SortedLight& light = sortedLights[i];
-
-			if ((light.projectedZ >= binMin && light.projectedZ <= binMax) ||
-				(light.projectedZMin >= binMin && light.projectedZMin <= binMax) || 
-				(light.projectedZMax >= binMin && light.projectedZMax <= binMax)) {
-				if (i < minLightId)
-					minLightId = i;
+		sortedLightResults[i] = SortedLight{ i, z, zMin, zMax };
+		lightResults[i] |= LightSorted;
+	};
 
-				if (i > maxLightId)
-					maxLightId = i;
-			}
-		}
-		mLightLUT[bin] = (maxLightId << 16) | minLightId;
-	}
+	auto computeLightRect = [&](uint32_t i) {
+		const LightComponent& light = *lights[i].first;
+		const TransformComponent& transform = *lights[i].second;
 
-	projectedLightRects.clear();
-	for (uint32_t i = 0; i < lights.size(); ++i) {
 		// Update the lightData that is sent to buffer
-		LightComponent& light = lights[i];
-		TransformComponent* transform = compMgr->GetComponent<TransformComponent>(entities[i]);
-		glm::vec3 position = transform->position;
+		glm::vec3 position = transform.position;
 		float radius = light.radius;
 
 		glm::vec3 vsPos = camera->ComputeViewSpaceCoordinate(position);
 
 		bool isVisible = (vsPos.z - radius) < camera->GetNearPlane();
 
-		if (!isVisible) continue;
+		if (!isVisible) return;
 
 		glm::vec3 aabbMin = glm::vec3(FLT_MAX);
 		glm::vec3 aabbMax = glm::vec3(-FLT_MAX);
@@ -734,16 +901,82 @@ void Renderer::UpdateLights()
 		float width = aabbScreen.z - aabbScreen.x;
 		float height = aabbScreen.w - aabbScreen.y;
 
-		if (width < 0.0001f || height < 0.0001f) continue;
+		if (width < 0.0001f || height < 0.0001f) return;
 
 		float minX = aabbScreen.x;
 		float minY = aabbScreen.y;
 		float maxX = minX + width;
 		float maxY = minY + height;
 
-		if (minX > mSwapchainWidth || minY > mSwapchainHeight) continue;
-		if (maxX < 0.0f || maxY < 0.0f) continue;
-		projectedLightRects.emplace_back(glm::vec4{ minX, minY, maxX, maxY });
+		if (minX > mSwapchainWidth || minY > mSwapchainHeight) return;
+		if (maxX < 0.0f || maxY < 0.0f) return;
+		lightRectResults[i] = glm::vec4{ minX, minY, maxX, maxY };
+		lightResults[i] |= LightVisible;
+	};
+
+	JobSystem::ParallelFor(lightCount, kLightGrainSize, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			computeLightData(i);
+			computeLightRect(i);
+		}
+	});
+
+	std::vector<SortedLight> sortedLights;
+	std::vector<LightData> lightData;
+	frame.projectedLightRects.clear();
+	for (uint32_t i = 0; i < lightCount; ++i)
+	{
+		if (lightResults[i] & LightEnabled)
+			lightData.push_back(lightDataResults[i]);
+		if (lightResults[i] & LightSorted)
+			sortedLights.push_back(sortedLightResults[i]);
+		if (lightResults[i] & LightVisible)
+			frame.projectedLightRects.push_back(lightRectResults[i]);
+	}
+
+	// Sort the light by projectedZ value
+	std::qsort(sortedLights.data(), sortedLights.size(), sizeof(SortedLight), [](const void* a, const void* b) {
+		const SortedLight* la = (const SortedLight*)a;
+		const SortedLight* lb = (const SortedLight*)b;
+
+		if (la->projectedZ < lb->projectedZ) return -1;
+		else if (la->projectedZ > lb->projectedZ) return 1;
+		return 0;
+		});
+
+	// Upload LightData to GPU
+	uint32_t nLights = static_cast<uint32_t>(lightData.size());
+	assert(nLights <= kMaxLights);
+	if(nLights > 0)
+		QueueUpload(mLightBuffer, lightData.data(), 0, sizeof(LightData) * nLights);
+	frame.environmentData.nLight = nLights;
+
+
+
+	// Calculate light LUT, we use uniform distribution to sort the light into bins
+	const float binSize = 1.0f / kMaxLightBins;
+	for (uint16_t bin = 0; bin < kMaxLightBins; ++bin) {
+		uint16_t minLightId = kMaxLights + 1;
+		uint16_t maxLightId = 0;
+
+		const float binMin = binSize * bin;
+		const float binMax = binMin + binSize;
+
+		for (uint32_t i = 0; i < sortedLights.size(); ++i) {
+			SortedLight& light = sortedLights[i];
+
+			if ((light.projectedZ >= binMin && light.projectedZ <= binMax) ||
+				(light.projectedZMin >= binMin && light.projectedZMin <= binMax) || 
+				(light.projectedZMax >= binMin && light.projectedZMax <= binMax)) {
+				if (i < minLightId)
+					minLightId = i;
+
+				if (i > maxLightId)
+					maxLightId = i;
+			}
+		}
+		mLightLUT[bin] = (maxLightId << 16) | minLightId;
 	}
 }
 /*
@@ -825,7 +1058,7 @@ void Renderer::DrawSkinnedMesh(gfx::CommandList* commandList, uint32_t offset, g
 		mDevice->UpdateDescriptor(pipeline, descriptorInfos, descriptorCount);
 		mDevice->BindPipeline(commandList, pipeline);
 
-		mDevice->BindIndexBuffer(commandList, ib);
+		mDevice->BindIndexBuffer(commandList, ib, drawData.indexType);
 		mDevice->DrawIndexed(commandList, drawData.indexCount, 1, drawData.indexBuffer.offset);
 
 		skinnedBufferOffset += dataSize;
@@ -833,96 +1066,214 @@ void Renderer::DrawSkinnedMesh(gfx::CommandList* commandList, uint32_t offset, g
 	}
 }
 */
-uint32_t Renderer::CreateBatch(std::vector<DrawData>& drawDatas, std::vector<RenderBatch>& renderBatch, uint32_t lastOffset)
+static MeshDrawData CreateMeshDrawData(const DrawData& drawData)
 {
-	// Sort the DrawData according to bufferIndex
+	MeshDrawData meshDrawData = {};
+	meshDrawData.indexOffset = drawData.indexBuffer.byteOffset / gfx::GetIndexSize(drawData.indexType);
+	meshDrawData.indexCount = drawData.indexCount;
+	meshDrawData.vertexOffset = drawData.vertexBuffer.byteOffset / drawData.elmSize;
+	meshDrawData.vertexCount = drawData.vertexBuffer.byteLength / drawData.elmSize;
+	meshDrawData.meshletCount = drawData.meshletCount;
+	meshDrawData.boudingSphere = drawData.boundingSphere;
+	meshDrawData.meshletOffset = drawData.meshletOffset;
+
+	// Meshes without generated levels draw the full range at any distance
+	meshDrawData.lodCount = std::max(drawData.lodCount, 1u);
+	if (drawData.lodCount > 0)
+		std::copy(drawData.lods, drawData.lods + drawData.lodCount, meshDrawData.lods);
+	else
+		meshDrawData.lods[0] = { meshDrawData.indexOffset, meshDrawData.indexCount, meshDrawData.meshletOffset, meshDrawData.meshletCount, 0.0f };
+
+	meshDrawData.vertexFormat = drawData.vertexFormat;
+	if (drawData.vertexFormat == VertexFormat::Compact)
+	{
+		meshDrawData.positionOffset = glm::vec4(drawData.boundingBox.min, 0.0f);
+		meshDrawData.positionScale = glm::vec4(drawData.boundingBox.max - drawData.boundingBox.min, 0.0f);
+	}
+	return meshDrawData;
+}
+
+// Entities drawing the same range of the same buffers are instances of one draw
+static bool IsSameMesh(const DrawData& lhs, const DrawData& rhs)
+{
+	return lhs.vertexBuffer.buffer.handle == rhs.vertexBuffer.buffer.handle &&
+		lhs.vertexBuffer.byteOffset == rhs.vertexBuffer.byteOffset &&
+		lhs.indexBuffer.buffer.handle == rhs.indexBuffer.buffer.handle &&
+		lhs.indexBuffer.byteOffset == rhs.indexBuffer.byteOffset &&
+		lhs.indexCount == rhs.indexCount;
+}
+
+void Renderer::CreateBatch(std::vector<DrawData>& drawDatas, std::vector<RenderBatch>& renderBatch, uint32_t& instanceOffset, uint32_t& drawOffset)
+{
+	// Sort the DrawData according to bufferIndex and then the mesh range so the instances are adjacent
 	std::sort(drawDatas.begin(), drawDatas.end(), [](const DrawData& lhs, const DrawData& rhs) {
-		return lhs.vertexBuffer.buffer.handle < rhs.vertexBuffer.buffer.handle;
+		if (lhs.vertexBuffer.buffer.handle != rhs.vertexBuffer.buffer.handle)
+			return lhs.vertexBuffer.buffer.handle < rhs.vertexBuffer.buffer.handle;
+		if (lhs.vertexBuffer.byteOffset != rhs.vertexBuffer.byteOffset)
+			return lhs.vertexBuffer.byteOffset < rhs.vertexBuffer.byteOffset;
+		if (lhs.indexBuffer.byteOffset != rhs.indexBuffer.byteOffset)
+			return lhs.indexBuffer.byteOffset < rhs.indexBuffer.byteOffset;
+		return lhs.indexCount < rhs.indexCount;
 		});
 
-	std::vector<glm::mat4> transforms;
-	std::vector<MaterialComponent> materials;
-	std::vector<MeshDrawData> meshDrawDatas;
-	// @TODO temp
-	std::vector<gfx::DrawIndirectCommand> drawIndexedCommand;
+	const uint32_t instanceCount = static_cast<uint32_t>(drawDatas.size());
+	if (instanceCount == 0)
+		return;
+
+	std::vector<MaterialComponent> materials(instanceCount);
+	std::vector<PerObjectData> instances(instanceCount);
+	// First instance of each draw
+	std::vector<uint32_t> drawFirstInstances;
 
 	gfx::BufferHandle lastBuffer = gfx::INVALID_BUFFER;
 	RenderBatch* activeBatch = nullptr;
-	uint32_t currentOffset = 0;
-	if (drawDatas.size() > 0)
+	for (uint32_t i = 0; i < instanceCount; ++i)
 	{
-		for (auto& drawData : drawDatas)
+		const DrawData& drawData = drawDatas[i];
+		gfx::BufferHandle buffer = drawData.vertexBuffer.buffer;
+		if (buffer.handle != lastBuffer.handle || activeBatch == nullptr)
 		{
-			gfx::BufferHandle buffer = drawData.vertexBuffer.buffer;
-			if (buffer.handle != lastBuffer.handle || activeBatch == nullptr)
-			{
-				currentOffset += activeBatch == nullptr ? 0 : activeBatch->count;
-
-				renderBatch.push_back(RenderBatch{});
-				activeBatch = &renderBatch.back();
-				activeBatch->id = mBatchId++;
-				activeBatch->vertexBuffer = drawData.vertexBuffer;
-				activeBatch->indexBuffer = drawData.indexBuffer;
-				activeBatch->meshletBuffer = drawData.meshletBuffer;
-				activeBatch->meshletTriangleBuffer = drawData.meshletTriangleBuffer;
-				activeBatch->meshletVertexBuffer = drawData.meshletVertexBuffer;
-				activeBatch->offset = lastOffset + currentOffset;
-				activeBatch->count = 0;
-				activeBatch->meshletCount = 0;
-				lastBuffer = buffer;
-			}
-
-			// Find texture and assign new index
-			MaterialComponent material = *drawData.material;
-			materials.push_back(std::move(material));
-
-			// Update transform Data
-			transforms.push_back(std::move(drawData.worldTransform));
-
-			// Create DrawCommands
-			MeshDrawData meshDrawData = {};
-			meshDrawData.indexOffset = drawData.indexBuffer.byteOffset / sizeof(uint32_t);
-			meshDrawData.indexCount = drawData.indexCount;
-			meshDrawData.vertexOffset = drawData.vertexBuffer.byteOffset / drawData.elmSize;
-			meshDrawData.vertexCount = drawData.vertexBuffer.byteLength / drawData.elmSize;
-			meshDrawData.meshletCount = drawData.meshletCount;
-			meshDrawData.boudingSphere = drawData.boundingSphere;
-			meshDrawData.meshletOffset = drawData.meshletOffset;
-			meshDrawDatas.push_back(std::move(meshDrawData));
-
-			gfx::DrawIndirectCommand indirectCommand;
-			indirectCommand.firstInstance = 0;
-			indirectCommand.instanceCount = 1;
-			indirectCommand.indexCount = drawData.indexCount;
-			indirectCommand.firstIndex = drawData.indexBuffer.byteOffset / sizeof(uint32_t);
-			indirectCommand.vertexOffset = drawData.vertexBuffer.byteOffset / drawData.elmSize;
-			drawIndexedCommand.push_back(std::move(indirectCommand));
+			renderBatch.push_back(RenderBatch{});
+			activeBatch = &renderBatch.back();
+			activeBatch->id = mBatchId++;
+			activeBatch->vertexBuffer = drawData.vertexBuffer;
+			activeBatch->indexBuffer = drawData.indexBuffer;
+			activeBatch->indexType = drawData.indexType;
+			activeBatch->meshletBuffer = drawData.meshletBuffer;
+			activeBatch->meshletTriangleBuffer = drawData.meshletTriangleBuffer;
+			activeBatch->meshletVertexBuffer = drawData.meshletVertexBuffer;
+			activeBatch->offset = drawOffset + static_cast<uint32_t>(drawFirstInstances.size());
+			activeBatch->count = 0;
+			activeBatch->instanceOffset = instanceOffset + i;
+			activeBatch->instanceCount = 0;
+			activeBatch->meshletCount = 0;
+			lastBuffer = buffer;
+		}
 
+		if (activeBatch->instanceCount == 0 || !IsSameMesh(drawDatas[i - 1], drawData))
+		{
+			drawFirstInstances.push_back(i);
 			activeBatch->count++;
 			activeBatch->meshletCount += drawData.meshletCount;
 		}
 
-		// Copy data to buffer
-		const uint32_t mat4Size = sizeof(glm::mat4);
-		const uint32_t materialSize = sizeof(MaterialComponent);
-		const uint32_t dicSize = sizeof(MeshDrawData);
+		activeBatch->meshletTaskCount += (drawData.meshletCount + kMeshletTaskSize - 1) / kMeshletTaskSize;
+		activeBatch->meshletIndexCount += drawData.indexCount;
 
-		uint32_t transformCount = (uint32_t)transforms.size();
-		mDevice->CopyToBuffer(mTransformBuffer, transforms.data(), lastOffset * mat4Size, transformCount * mat4Size);
+		const uint32_t slot = instanceOffset + i;
+		mDrawSlots.set(drawData.entity, slot);
+		mDrawEntities.push_back(drawData.entity);
 
-		uint32_t materialCount = (uint32_t)materials.size();
-		mDevice->CopyToBuffer(mMaterialBuffer, materials.data(), lastOffset * materialSize, materialCount * materialSize);
+		// Transform and material are stored per instance in the same slot
+		PerObjectData& instance = instances[i];
+		instance.transformIndex = slot - activeBatch->instanceOffset;
+		instance.materialIndex = instance.transformIndex;
+		instance.drawIndex = activeBatch->count - 1;
+		activeBatch->instanceCount++;
+	}
+
+	const uint32_t drawCount = static_cast<uint32_t>(drawFirstInstances.size());
+	assert(instanceOffset + instanceCount <= kMaxEntity && drawOffset + drawCount <= kMaxDraws);
+
+	std::vector<MeshDrawData> meshDrawDatas(drawCount);
+	// @TODO temp
+	std::vector<gfx::MeshDrawIndirectCommand> drawIndexedCommand(drawCount);
+
+	// Instance i always lands in the slot instanceOffset + i so the GPU data is filled in parallel
+	JobSystem::ParallelFor(instanceCount, kBatchGrainSize, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+			materials[i] = *drawDatas[i].material;
+		});
+
+	for (uint32_t draw = 0; draw < drawCount; ++draw)
+	{
+		const uint32_t first = drawFirstInstances[draw];
+		const uint32_t last = draw + 1 < drawCount ? drawFirstInstances[draw + 1] : instanceCount;
+		const DrawData& drawData = drawDatas[first];
+
+		// Create DrawCommands
+		MeshDrawData& meshDrawData = meshDrawDatas[draw];
+		meshDrawData = CreateMeshDrawData(drawData);
+		meshDrawData.firstInstance = instances[first].transformIndex;
+		meshDrawData.instanceCount = last - first;
+
+		// Shadow pass draws all the instances without culling
+		gfx::MeshDrawIndirectCommand& indirectCommand = drawIndexedCommand[draw];
+		indirectCommand.firstInstance = meshDrawData.firstInstance;
+		indirectCommand.instanceCount = meshDrawData.instanceCount;
+		indirectCommand.indexCount = drawData.indexCount;
+		indirectCommand.firstIndex = meshDrawData.indexOffset;
+		indirectCommand.vertexOffset = meshDrawData.vertexOffset;
+		// Task groups of LOD 0 for every instance, the first task is the first meshlet like the cull pass
+		indirectCommand.taskCount = (drawData.meshletCount + kMeshletTaskSize - 1) / kMeshletTaskSize * meshDrawData.instanceCount;
+		indirectCommand.firstTask = meshDrawData.meshletOffset;
+		indirectCommand.drawId = instances[first].drawIndex;
+	}
 
-		uint32_t meshDrawDataCount = (uint32_t)meshDrawDatas.size();
-		mDevice->CopyToBuffer(mMeshDrawDataBuffer, meshDrawDatas.data(), lastOffset * dicSize, meshDrawDataCount * dicSize);
+	// Copy data to buffer
+	// Transforms are uploaded from the TransformStore after all the batches are created
+	const uint32_t materialSize = sizeof(MaterialComponent);
+	const uint32_t instanceSize = sizeof(PerObjectData);
+	const uint32_t dicSize = sizeof(MeshDrawData);
 
-		uint32_t indexedDrawCommandCount = (uint32_t)drawIndexedCommand.size();
-		mDevice->CopyToBuffer(mIndexedIndirectCommandBuffer, drawIndexedCommand.data(), lastOffset * sizeof(gfx::DrawIndirectCommand), indexedDrawCommandCount * sizeof(gfx::DrawIndirectCommand));
-		
-		currentOffset += (activeBatch ? activeBatch->count : 0);
-		lastOffset += currentOffset;
+	QueueUpload(mMaterialBuffer, materials.data(), instanceOffset * materialSize, instanceCount * materialSize);
+	QueueUpload(mInstanceBuffer, instances.data(), instanceOffset * instanceSize, instanceCount * instanceSize);
+	QueueUpload(mMeshDrawDataBuffer, meshDrawDatas.data(), drawOffset * dicSize, drawCount * dicSize);
+	QueueUpload(mIndexedIndirectCommandBuffer, drawIndexedCommand.data(), drawOffset * sizeof(gfx::MeshDrawIndirectCommand), drawCount * sizeof(gfx::MeshDrawIndirectCommand));
+
+	instanceOffset += instanceCount;
+	drawOffset += drawCount;
+}
+
+bool Renderer::IsBatched(const std::vector<ecs::Entity>& entities) const
+{
+	auto meshRenderers = mScene->GetComponentManager()->GetComponentArray<MeshRenderer>();
+	for (ecs::Entity entity : entities)
+	{
+		const uint32_t slot = mDrawSlots.get(entity);
+		if (slot != ecs::SparseIndex::kInvalidIndex && mDrawEntities[slot] == entity)
+			continue;
+
+		// Meshes that aren't renderable yet have no draw data either
+		const MeshRenderer* meshRenderer = meshRenderers->getComponent(entity);
+		if (meshRenderer != nullptr && meshRenderer->IsRenderable())
+			return false;
+	}
+	return true;
+}
+
+bool Renderer::UpdateDrawData(const std::vector<ecs::Entity>& entities, uint32_t& updateCount)
+{
+	auto compMgr = mScene->GetComponentManager();
+
+	std::vector<DrawData> opaque;
+	std::vector<DrawData> transparent;
+	for (ecs::Entity entity : entities)
+	{
+		// Entity is not drawn
+		const uint32_t slot = mDrawSlots.get(entity);
+		if (slot == ecs::SparseIndex::kInvalidIndex || mDrawEntities[slot] != entity)
+			continue;
+
+		MeshRenderer* meshRenderer = compMgr->GetComponent<MeshRenderer>(entity);
+		TransformComponent* transform = compMgr->GetComponent<TransformComponent>(entity);
+		MaterialComponent* material = compMgr->GetComponent<MaterialComponent>(entity);
+		if (meshRenderer == nullptr || transform == nullptr || material == nullptr)
+			return false;
+
+		opaque.clear();
+		transparent.clear();
+		mScene->GenerateMeshData(entity, meshRenderer, transform, material, opaque, transparent);
+
+		// Moved between opaque and transparent batch
+		std::vector<DrawData>& drawDatas = slot < mOpaqueInstanceCount ? opaque : transparent;
+		if (drawDatas.size() != 1)
+			return false;
+
+		QueueUpload(mMaterialBuffer, drawDatas[0].material, slot * sizeof(MaterialComponent), sizeof(MaterialComponent));
+		updateCount++;
 	}
-	return lastOffset;
+	return true;
 }
 
 void Renderer::onResize(uint32_t width, uint32_t height)
@@ -948,4 +1299,11 @@ void Renderer::Shutdown()
 	mDevice->Destroy(mDrawCommandCountBuffer);
 	mDevice->Destroy(mIndexedIndirectCommandBuffer);
 	mDevice->Destroy(mCascadeInfoBuffer);
+	mDevice->Destroy(mInstanceBuffer);
+	mDevice->Destroy(mVisibleInstanceBuffer);
+	mDevice->Destroy(mCulledMeshletCountBuffer);
+	mDevice->Destroy(mMeshletTaskBuffer);
+	mDevice->Destroy(mMeshletCounterBuffer);
+	mDevice->Destroy(mMeshletDrawCommandBuffer);
+	mDevice->Destroy(mMeshletIndexBuffer);
 }
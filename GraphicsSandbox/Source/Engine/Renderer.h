@@ -6,6 +6,7 @@
 #include "Components.h"
 #include "Resource.h"
 #include "FrameGraph.h"
+#include "Camera.h"
 
 #include <vector>
 #include <array>
@@ -18,19 +19,37 @@ struct RenderBatch
 {
 	gfx::BufferView vertexBuffer;
 	gfx::BufferView indexBuffer;
+	gfx::IndexType indexType;
 	gfx::BufferHandle meshletVertexBuffer;
 	gfx::BufferHandle meshletTriangleBuffer;
 	gfx::BufferHandle meshletBuffer;
 	uint32_t meshletCount;
 
-	// Offset in number terms of number of element before this
-	// Used to offset in transform/material buffer and is assumed to have one to one mapping between mesh and material
+	// Offset in number of mesh draws before this
+	// Used to offset in drawData/drawCommand buffer, each draw is a mesh range shared by its instances
 	uint32_t offset;
-	// Count of number of transform/material/drawCommands in the batch
+	// Count of number of drawData/drawCommands in the batch
 	uint32_t count;
 
+	// Offset and count of the instances in the transform/material/instance buffer
+	uint32_t instanceOffset;
+	uint32_t instanceCount;
+
 	// Id in increasing order and may be unique every frame
 	uint32_t id;
+
+	// Meshlet culling of the indexed path, upper bounds of the tasks and compacted indices
+	// with all the instances at LOD 0. The count is 0 for the batches that aren't culled
+	uint32_t meshletTaskOffset;
+	uint32_t meshletTaskCount;
+	uint32_t meshletIndexOffset;
+	uint32_t meshletIndexCount;
+
+	// The cull pass writes a command and a range of visible instances per LOD of each draw
+	uint32_t GetCommandOffset() const { return offset * kMaxLODs; }
+	uint32_t GetCommandCount() const { return count * kMaxLODs; }
+	uint32_t GetVisibleInstanceOffset() const { return instanceOffset * kMaxLODs; }
+	uint32_t GetVisibleInstanceCount() const { return instanceCount * kMaxLODs; }
 };
 
 struct LightData
@@ -88,6 +107,42 @@ struct CascadeData
 	float pcfSampleRadiusMultiplier;
 };
 
+/*
+* Snapshot of the scene state read while recording a frame. Renderer::Update
+* fills one frame while the render thread records the other one, the buffer
+* writes are queued and applied by the render thread before recording.
+*/
+struct RenderFrame
+{
+	struct BufferUpload
+	{
+		gfx::BufferHandle buffer;
+		uint32_t offset;
+		uint32_t dataOffset;
+		uint32_t size;
+	};
+
+	GlobalUniformData globalUniformData;
+	EnvironmentData environmentData;
+	Camera camera;
+
+	glm::vec3 sunDirection;
+	bool sunEnabled = false;
+
+	gfx::BufferView skyboxVertexBuffer;
+	gfx::BufferView skyboxIndexBuffer;
+	gfx::IndexType skyboxIndexType = gfx::IndexType::UInt32;
+	uint32_t skyboxIndexCount = 0;
+	gfx::TextureHandle skyboxTexture;
+
+	std::vector<RenderBatch> drawBatches;
+	std::vector<RenderBatch> transparentBatches;
+	std::vector<glm::vec4> projectedLightRects;
+
+	std::vector<BufferUpload> uploads;
+	std::vector<uint8_t> uploadData;
+};
+
 class Renderer
 {
 public:
@@ -97,8 +152,19 @@ public:
 
 	void SetScene(Scene* scene);
 
+	// Hand the frame filled by Update() to the render thread, both threads have to be idle
+	void SwapFrame();
+
+	// Build the UI of the renderer, scene and passes, both threads have to be idle
+	void UpdateUI();
+
 	void Render(gfx::CommandList* commandList);
 
+	// Frame being recorded, only valid inside Render()
+	const RenderFrame& GetRenderFrame() const { return mFrames[mUpdateFrame ^ 1]; }
+
+	uint32_t GetHeight() const { return mSwapchainHeight; }
+
 	//gfx::TextureHandle GetOutputTexture(OutputTextureType colorTextureType);
 	void onResize(uint32_t width, uint32_t height);
 
@@ -115,18 +181,41 @@ public:
 	gfx::BufferHandle mMeshDrawDataBuffer;
 	gfx::BufferHandle mDrawCommandCountBuffer;
 	gfx::BufferHandle mCascadeInfoBuffer;
+	// PerObjectData of all the instances and the visible ones compacted by the cull pass
+	gfx::BufferHandle mInstanceBuffer;
+	gfx::BufferHandle mVisibleInstanceBuffer;
 
 	// @Note Temporary only used for CSM as it doesn't currently support frustum culling
+	// Indexed and mesh task command of each draw, the task shader culls the meshlets per cascade
 	gfx::BufferHandle mIndexedIndirectCommandBuffer;
 
+	// Meshlets culled by the task shaders, one counter per pass, read back a frame later
+	enum class MeshletCounter : uint32_t
+	{
+		DepthPrePass = 0,
+		GBuffer,
+		MeshletCull,
+		Count
+	};
+	gfx::BufferHandle mCulledMeshletCountBuffer;
+
+	// Output of the meshlet cull pass, draws of the visible meshlets with compacted indices
+	static constexpr uint32_t kMaxMeshletTasks = 128 * 1024;
+	static constexpr uint32_t kMaxMeshletIndices = 4 * 1024 * 1024;
+	gfx::BufferHandle mMeshletTaskBuffer;
+	gfx::BufferHandle mMeshletCounterBuffer;
+	gfx::BufferHandle mMeshletDrawCommandBuffer;
+	gfx::BufferHandle mMeshletIndexBuffer;
+
 	gfx::FrameGraphBuilder mFrameGraphBuilder;
 	gfx::FrameGraph mFrameGraph;
+	// Settings edited by UI, the per frame copy is in RenderFrame
 	EnvironmentData mEnvironmentData;
 	bool mUseMeshShading = false;
+	bool mUseMeshletCulling = true;
 
-	std::vector<RenderBatch> mDrawBatches;
-	std::vector<RenderBatch> mTransparentBatches;
-	std::vector<glm::vec4> projectedLightRects;
+	// Mesh shading culls the meshlets in the task shaders instead
+	bool IsMeshletCullingEnabled() const { return mUseMeshletCulling && !mUseMeshShading; }
 
 	Scene* mScene;
 private:
@@ -139,13 +228,32 @@ private:
 	uint32_t mFinalOutput;
 	std::string mFinalAttachmentName;
 
-	// Returns total number of drawElements pushed while creating batch
-	uint32_t CreateBatch(std::vector<DrawData>& drawDatas, std::vector<RenderBatch>& renderBatch, uint32_t lastOffset = 0);
+	// Entities with the same mesh range are merged into one instanced draw,
+	// instanceOffset and drawOffset are advanced by the instances and draws pushed
+	void CreateBatch(std::vector<DrawData>& drawDatas, std::vector<RenderBatch>& renderBatch, uint32_t& instanceOffset, uint32_t& drawOffset);
+
+	// Patch the material of the modified entities in place,
+	// returns false if the batches has to be rebuilt
+	bool UpdateDrawData(const std::vector<ecs::Entity>& entities, uint32_t& updateCount);
+
+	// True if every renderable entity has a slot in the batches
+	bool IsBatched(const std::vector<ecs::Entity>& entities) const;
+
+	// Location of the entity in the transform/material/instance buffer
+	ecs::SparseIndex mDrawSlots;
+	std::vector<ecs::Entity> mDrawEntities;
+	uint32_t mOpaqueInstanceCount = 0;
+
+	// Result of the frustum query, the batches are built from the query with the planes pushed out by mCandidateMargin
+	std::vector<ecs::Entity> mVisibleEntities;
+	std::vector<ecs::Entity> mCandidateEntities;
+	float mCandidateMargin = 2.0f;
 
 	gfx::RenderPassHandle mSwapchainRP;
 	gfx::PipelineHandle mFullScreenPipeline;
 
-	const uint32_t kMaxEntity = 1'000;
+	const uint32_t kMaxEntity = 100'000;
+	const uint32_t kMaxDraws = 4'096;
 	const uint32_t kMaxBatches = 25;
 	static const uint32_t kMaxLightBins = 16;
 	const uint32_t kMaxLights = 256;
@@ -156,6 +264,12 @@ private:
 	GlobalUniformData mGlobalUniformData;
 	bool mEnableDebugDraw = true;
 
+	std::array<RenderFrame, 2> mFrames;
+	uint32_t mUpdateFrame = 0;
+
+	// Copy the data to the upload list of the frame being updated
+	void QueueUpload(gfx::BufferHandle buffer, const void* data, uint32_t offset, uint32_t size);
+
 	void InitializeBuffers();
 	void AddUI();
 	void UpdateLights();
@@ -9,11 +9,22 @@
 #include "GUI/SceneHierarchy.h"
 #include "GLTF-Mesh.h"
 #include "EventDispatcher.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "ImageLoader.h"
+#include "Timer.h"
+#include "TransferQueue.h"
 
 #include <meshoptimizer.h>
-#include <execution>
 #include <algorithm>
+#include <cstdio>
 #include <fstream>
+#include <numeric>
+
+// Number of entities processed by a single job
+constexpr uint32_t kTransformGrainSize = 1024;
+constexpr uint32_t kDrawDataGrainSize = 512;
 
 void Scene::Initialize()
 {
@@ -26,6 +37,9 @@ void Scene::Initialize()
 	mComponentManager->RegisterComponent<LightComponent>();
 	mComponentManager->RegisterComponent<HierarchyComponent>();
 
+	// Keep the renderable components sorted in the same order for draw data generation
+	mComponentManager->CreateGroup<MeshRenderer, TransformComponent, MaterialComponent>();
+
 	InitializeLights();
 
 	LoadEnvMap(StringConstants::HDRI_PATH);
@@ -36,43 +50,51 @@ void Scene::Initialize()
 	initializePrimitiveMesh();
 }
 
-void Scene::GenerateMeshData(ecs::Entity entity, IMeshRenderer* meshRenderer, std::vector<DrawData>& opaque, std::vector<DrawData>& transparent)
+bool Scene::CreateDrawData(ecs::Entity entity, IMeshRenderer* meshRenderer, TransformComponent* transform, MaterialComponent* material, DrawData& drawData)
 {
-	if (meshRenderer->IsRenderable())
-	{
-		TransformComponent* transform = mComponentManager->GetComponent<TransformComponent>(entity);
-		if (transform == nullptr) return;
-
-		BoundingBox aabb = meshRenderer->boundingBox;
-		aabb.Transform(transform->worldMatrix);
-
-		auto& [min, max] = aabb;
-		const glm::vec3 halfExtent = (max - min) * 0.5f;
-		glm::vec3 center = min + halfExtent;
-
-		float radius = glm::compMax(glm::abs(halfExtent)) * sqrtf(3.0f);
-		meshRenderer->boundingSphere = glm::vec4(center.x, center.y, center.z, radius);
-
-		DrawData drawData = {};
-		const gfx::BufferView vertexBuffer = meshRenderer->vertexBuffer;
-		const gfx::BufferView indexBuffer = meshRenderer->indexBuffer;
-
-		drawData.vertexBuffer = vertexBuffer;
-		drawData.indexBuffer = indexBuffer;
-		drawData.entity = entity;
-		drawData.indexCount = static_cast<uint32_t>(meshRenderer->GetIndexCount());
-		drawData.worldTransform = transform->worldMatrix;
-		drawData.elmSize = meshRenderer->IsSkinned() ? sizeof(AnimatedVertex) : sizeof(Vertex);
-		drawData.meshletBuffer = meshRenderer->meshletBuffer;
-		drawData.meshletTriangleBuffer = meshRenderer->meshletTriangleBuffer;
-		drawData.meshletVertexBuffer = meshRenderer->meshletVertexBuffer;
-		drawData.meshletCount = meshRenderer->meshletCount;
-		drawData.boundingSphere = meshRenderer->boundingSphere;
-		drawData.meshletOffset = meshRenderer->meshletOffset;
-
-		MaterialComponent* material = mComponentManager->GetComponent<MaterialComponent>(entity);
-		drawData.material = material;
+	if (!meshRenderer->IsRenderable())
+		return false;
+
+	BoundingBox aabb = meshRenderer->boundingBox;
+	aabb.Transform(transform->worldMatrix);
+
+	auto& [min, max] = aabb;
+	const glm::vec3 halfExtent = (max - min) * 0.5f;
+	glm::vec3 center = min + halfExtent;
+
+	float radius = glm::compMax(glm::abs(halfExtent)) * sqrtf(3.0f);
+	meshRenderer->boundingSphere = glm::vec4(center.x, center.y, center.z, radius);
+
+	drawData = {};
+	drawData.vertexBuffer = meshRenderer->vertexBuffer;
+	drawData.indexBuffer = meshRenderer->indexBuffer;
+	drawData.indexType = meshRenderer->GetIndexType();
+	drawData.entity = entity;
+	drawData.indexCount = static_cast<uint32_t>(meshRenderer->GetIndexCount());
+	drawData.worldTransform = transform->worldMatrix;
+	drawData.elmSize = meshRenderer->IsSkinned() ? sizeof(AnimatedVertex) : meshRenderer->HasCompactVertices() ? sizeof(CompactVertex) : sizeof(Vertex);
+	drawData.vertexFormat = meshRenderer->HasCompactVertices() ? VertexFormat::Compact : VertexFormat::Full;
+	drawData.boundingBox = meshRenderer->boundingBox;
+	drawData.meshletBuffer = meshRenderer->meshletBuffer;
+	drawData.meshletTriangleBuffer = meshRenderer->meshletTriangleBuffer;
+	drawData.meshletVertexBuffer = meshRenderer->meshletVertexBuffer;
+	drawData.meshletCount = meshRenderer->meshletCount;
+	// Instances of the mesh share the mesh space sphere, the cull pass transforms it
+	const BoundingBox& localBox = meshRenderer->boundingBox;
+	drawData.boundingSphere = glm::vec4(localBox.GetCenter(), glm::length(localBox.GetSize()) * 0.5f);
+	drawData.meshletOffset = meshRenderer->meshletOffset;
+	drawData.lodCount = meshRenderer->lodCount;
+	std::copy(meshRenderer->lods, meshRenderer->lods + meshRenderer->lodCount, drawData.lods);
+
+	drawData.material = material;
+	return true;
+}
 
+void Scene::GenerateMeshData(ecs::Entity entity, IMeshRenderer* meshRenderer, TransformComponent* transform, MaterialComponent* material, std::vector<DrawData>& opaque, std::vector<DrawData>& transparent)
+{
+	DrawData drawData;
+	if (CreateDrawData(entity, meshRenderer, transform, material, drawData))
+	{
 		if (material->IsTransparent())
 			transparent.push_back(std::move(drawData));
 		else
@@ -80,31 +102,129 @@ void Scene::GenerateMeshData(ecs::Entity entity, IMeshRenderer* meshRenderer, st
 	}
 }
 
-void Scene::GenerateDrawData(std::vector<DrawData>& opaque, std::vector<DrawData>& transparent)
+void Scene::QueryVisible(const Frustum& frustum, const glm::vec3* lightDirection, std::vector<ecs::Entity>& out, float margin)
 {
-	auto meshRendererComponents = mComponentManager->GetComponentArray<MeshRenderer>();
-	auto& frustum = mCamera.mFrustum;
+	out.clear();
 
-	for (int i = 0; i < meshRendererComponents->GetCount(); ++i)
+	// Object outside a plane can only shadow the frustum if the light travels inward through it
+	std::array<Plane, 6> planes;
+	uint32_t planeCount = 0;
+	for (const Plane& plane : frustum.planes)
 	{
-		MeshRenderer& meshRenderer = meshRendererComponents->components[i];
-		const ecs::Entity entity = meshRendererComponents->entities[i];
-		GenerateMeshData(entity, &meshRenderer, opaque, transparent);
+		if (lightDirection == nullptr || glm::dot(plane.normal, -*lightDirection) <= 0.0f)
+		{
+			planes[planeCount] = plane;
+			planes[planeCount++].distance += margin;
+		}
 	}
+
+	auto meshRenderers = mComponentManager->GetComponentArray<MeshRenderer>();
+	auto group = mComponentManager->GetGroup<MeshRenderer, TransformComponent, MaterialComponent>();
+	std::vector<uint32_t> indices;
+	mBoundsTree.QueryPlanes(planes.data(), planeCount, [&](uint32_t entity) {
+		const uint32_t index = meshRenderers->find(entity);
+		if (index < group->size())
+			indices.push_back(index);
+		});
+
+	std::sort(indices.begin(), indices.end());
+	out.reserve(indices.size());
+	for (uint32_t index : indices)
+		out.push_back(meshRenderers->entities[index]);
 }
 
-void Scene::GenerateSkinnedMeshDrawData(std::vector<DrawData>& opaque, std::vector<DrawData>& transparent)
+bool Scene::RayCast(const Ray& ray, RayHit& hit, float maxDistance)
 {
-	// @TODO : Temporary only to visualize bones
-	auto skinnedMeshRendererComponents = mComponentManager->GetComponentArray<SkinnedMeshRenderer>();
-	for (int i = 0; i < skinnedMeshRendererComponents->GetCount(); ++i)
+	auto meshRenderers = mComponentManager->GetComponentArray<MeshRenderer>();
+	auto transforms = mComponentManager->GetComponentArray<TransformComponent>();
+
+	hit.entity = ecs::INVALID_ENTITY;
+	mBoundsTree.QueryRay(ray, maxDistance, [&](uint32_t entity, float distance) {
+		const MeshRenderer* meshRenderer = meshRenderers->getComponent(entity);
+		const TransformComponent* transform = transforms->getComponent(entity);
+		if (meshRenderer == nullptr || transform == nullptr || !meshRenderer->IsRenderable())
+			return distance;
+
+		const MeshBVH* meshBVH = findMeshBVH(meshRenderer);
+		if (meshBVH == nullptr)
+		{
+			BoundingBox aabb = meshRenderer->boundingBox;
+			aabb.Transform(transform->worldMatrix);
+			float tNear = 0.0f;
+			if (!IntersectRayAABB(ray, aabb, distance, tNear))
+				return distance;
+
+			hit.entity = entity;
+			hit.distance = tNear;
+			hit.normal = -ray.direction;
+			return tNear;
+		}
+
+		// Direction is transformed without normalization so the hit distance stays in world units
+		const glm::mat4 invWorld = glm::inverse(transform->worldMatrix);
+		const Ray localRay(glm::vec3(invWorld * glm::vec4(ray.origin, 1.0f)), glm::vec3(invWorld * glm::vec4(ray.direction, 0.0f)));
+		MeshBVH::Hit meshHit;
+		if (!meshBVH->RayCast(localRay, distance, meshHit))
+			return distance;
+
+		hit.entity = entity;
+		hit.distance = meshHit.distance;
+		hit.normal = glm::transpose(glm::mat3(invWorld)) * meshHit.normal;
+		return meshHit.distance;
+		});
+
+	if (hit.entity == ecs::INVALID_ENTITY)
+		return false;
+
+	// Normal faces the ray, triangles are hit from both sides
+	hit.position = ray.GetPoint(hit.distance);
+	hit.normal = glm::normalize(hit.normal);
+	if (glm::dot(hit.normal, ray.direction) > 0.0f)
+		hit.normal = -hit.normal;
+	return true;
+}
+
+void Scene::GenerateDrawData(const std::vector<ecs::Entity>& entities, std::vector<DrawData>& opaque, std::vector<DrawData>& transparent)
+{
+	enum DrawType : uint8_t { None, Opaque, Transparent };
+
+	auto meshRenderers = mComponentManager->GetComponentArray<MeshRenderer>();
+	auto transforms = mComponentManager->GetComponentArray<TransformComponent>();
+	auto materials = mComponentManager->GetComponentArray<MaterialComponent>();
+	const uint32_t count = static_cast<uint32_t>(entities.size());
+
+	// Draw data is generated in parallel in the given order and compacted afterwards,
+	// the arrays are owned by the group so the index is the same in all of them
+	std::vector<DrawData> drawDatas(count);
+	std::vector<uint8_t> drawTypes(count, DrawType::None);
+	JobSystem::ParallelFor(count, kDrawDataGrainSize, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint32_t index = meshRenderers->find(entities[i]);
+			MaterialComponent& material = materials->components[index];
+			if (CreateDrawData(entities[i], &meshRenderers->components[index], &transforms->components[index], &material, drawDatas[i]))
+				drawTypes[i] = material.IsTransparent() ? DrawType::Transparent : DrawType::Opaque;
+		}
+		});
+
+	for (uint32_t i = 0; i < count; ++i)
 	{
-		SkinnedMeshRenderer& meshRenderer = skinnedMeshRendererComponents->components[i];
-		const ecs::Entity entity = skinnedMeshRendererComponents->entities[i];
-		GenerateMeshData(entity, &meshRenderer, opaque, transparent);
+		if (drawTypes[i] == DrawType::Opaque)
+			opaque.push_back(std::move(drawDatas[i]));
+		else if (drawTypes[i] == DrawType::Transparent)
+			transparent.push_back(std::move(drawDatas[i]));
 	}
 }
 
+void Scene::GenerateSkinnedMeshDrawData(std::vector<DrawData>& opaque, std::vector<DrawData>& transparent)
+{
+	// @TODO : Temporary only to visualize bones
+	auto view = mComponentManager->Query<SkinnedMeshRenderer, TransformComponent, MaterialComponent>();
+	view.each([&](ecs::Entity entity, SkinnedMeshRenderer& meshRenderer, TransformComponent& transform, MaterialComponent& material) {
+		GenerateMeshData(entity, &meshRenderer, &transform, &material, opaque, transparent);
+	});
+}
+
 void Scene::DrawBoundingBox()
 {
 	auto meshRendererCompArray = mComponentManager->GetComponentArray<MeshRenderer>();
@@ -135,12 +255,20 @@ ecs::Entity Scene::CreateLight(std::string_view name)
 void Scene::Update(float dt)
 {
 	mCamera.Update(dt);
+	// Entities can be destroyed here so update it before the transforms
+	mUISceneHierarchy->Update(dt);
+
 	UpdateTransform();
 	UpdateHierarchy();
+	UpdateBounds();
 	
-	mUISceneHierarchy->Update(dt);
 	if(mShowBoundingBox)
 		DrawBoundingBox();
+}
+
+void Scene::UpdateResources()
+{
+	updatePendingMeshes();
 
 	if (queuedHDR.length() > 0) {
 		LoadEnvMap(queuedHDR);
@@ -155,21 +283,25 @@ void Scene::SetSize(int width, int height)
 		mCamera.SetAspect(float(width) / float(height));
 }
 
-void Scene::Destroy(ecs::Entity entity)
+void Scene::DestroyHierarchy(ecs::Entity entity)
 {
-	if (mComponentManager->HasComponent<HierarchyComponent>(entity))
-	{
-		auto hierarchy = mComponentManager->GetComponent<HierarchyComponent>(entity);
-		if (hierarchy->parent != ecs::INVALID_ENTITY)
-			RemoveChild(hierarchy->parent, entity);
+	if (!ecs::IsAlive(entity))
+		return;
 
-		if (hierarchy->childrens.size() > 0)
-		{
-			for (const auto& child : hierarchy->childrens)
-				Destroy(child);
-		}
+	HierarchyComponent* hierarchy = mComponentManager->GetComponent<HierarchyComponent>(entity);
+	if (hierarchy && hierarchy->parent != ecs::INVALID_ENTITY)
+		RemoveChild(hierarchy->parent, entity);
+
+	// Collect the whole subtree breadth first and destroy it in one pass
+	std::vector<ecs::Entity> subtree{ entity };
+	for (std::size_t i = 0; i < subtree.size(); ++i)
+	{
+		hierarchy = mComponentManager->GetComponent<HierarchyComponent>(subtree[i]);
+		if (hierarchy)
+			subtree.insert(subtree.end(), hierarchy->childrens.begin(), hierarchy->childrens.end());
 	}
-	ecs::DestroyEntity(mComponentManager.get(), entity);
+
+	ecs::DestroyEntities(mComponentManager.get(), subtree.data(), static_cast<uint32_t>(subtree.size()));
 }
 
 void Scene::AddUI()
@@ -209,9 +341,23 @@ void Scene::Shutdown()
 {
 	gfx::GraphicsDevice* device = gfx::GetDevice();
 
+	// Loaders stop at the next image, their buffers are in the allocated buffers
+	for (auto& mesh : mPendingMeshes)
+		mesh->cancelled.store(true, std::memory_order_relaxed);
+	for (auto& mesh : mPendingMeshes)
+	{
+		mesh->loader.wait();
+		for (PendingMesh::Image& image : mesh->images)
+			image.Free();
+	}
+	mPendingMeshes.clear();
+
 	for (gfx::BufferHandle buffer : mAllocatedBuffers)
 		device->Destroy(buffer);
 
+	mMeshBVHs.clear();
+	mMeshPrimitives.clear();
+	mMeshSources.clear();
 	mEnvMap->Shutdown();
 	ecs::Destroy(mComponentManager.get());
 }
@@ -219,13 +365,46 @@ void Scene::Shutdown()
 void Scene::UpdateTransform()
 {
 	auto transforms = mComponentManager->GetComponentArray<TransformComponent>();
-	std::for_each(std::execution::par, transforms->components.begin(), transforms->components.end(), [](TransformComponent& transform) {
-		transform.CalculateWorldMatrix();
-	});
 
+	// Keep the SoA store in sync with the component array
+	for (ecs::Entity entity : transforms->getRemoved())
+		mTransformStore.Remove(entity);
+
+	for (ecs::Entity entity : transforms->getAdded())
+	{
+		TransformComponent* transform = transforms->getComponent(entity);
+		if (transform)
+			mTransformStore.Add(entity, *transform);
+	}
+
+	// Writers of an existing transform record the edit with MarkModified
+	for (ecs::Entity entity : transforms->getModified())
+	{
+		TransformComponent* transform = transforms->getComponent(entity);
+		if (transform)
+			mTransformStore.Set(entity, *transform);
+	}
+
+	// Compute the local matrices of the dirty transforms and write it back
+	mTransformStore.Update();
+	const auto& storeEntities = mTransformStore.GetEntities();
+	const auto& updatedSlots = mTransformStore.GetUpdatedSlots();
+	JobSystem::ParallelFor(static_cast<uint32_t>(updatedSlots.size()), kTransformGrainSize, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint32_t slot = updatedSlots[i];
+			TransformComponent* transform = transforms->getComponent(storeEntities[slot]);
+			transform->localMatrix = mTransformStore.GetLocalMatrix(slot);
+			transform->worldMatrix = transform->localMatrix;
+			transform->dirty = false;
+		}
+		});
+
+	// Each skeleton is a single job, the palette update is the expensive part
 	auto skinnedMeshComp = mComponentManager->GetComponentArray<SkinnedMeshRenderer>();
-	std::for_each(std::execution::par, skinnedMeshComp->components.begin(), skinnedMeshComp->components.end(), [](SkinnedMeshRenderer& skinnedMesh) {
-		skinnedMesh.skeleton.GetAnimatedPose().UpdateMatrixPallete();
+	JobSystem::ParallelFor(static_cast<uint32_t>(skinnedMeshComp->GetCount()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+			skinnedMeshComp->components[i].skeleton.GetAnimatedPose().UpdateMatrixPallete();
 		});
 
 
@@ -235,26 +414,70 @@ void Scene::UpdateTransform()
 
 void Scene::UpdateHierarchy()
 {
-	auto compArr = mComponentManager->GetComponentArray<HierarchyComponent>();
-	auto entities = compArr->entities;
-	
-	for (uint32_t i = 0; i < compArr->GetCount(); ++i)
+	auto hierarchies = mComponentManager->GetComponentArray<HierarchyComponent>();
+	auto transforms = mComponentManager->GetComponentArray<TransformComponent>();
+
+	// Flattened hierarchy is only rebuilt when the scene graph is changed
+	if (hierarchies->hasChanges() || transforms->hasStructuralChanges())
+		mTransformHierarchy.Build(hierarchies, mTransformStore);
+
+	mTransformHierarchy.Update(mTransformStore);
+
+	// Write back the propagated world matrices
+	const glm::mat4* worldMatrices = mTransformStore.GetWorldMatrices();
+	for (ecs::Entity entity : mTransformHierarchy.GetUpdatedEntities())
 	{
-		auto& comp = compArr->components[i];
-		if (comp.parent == ecs::INVALID_ENTITY && comp.childrens.size() > 0)
-			UpdateChildren(entities[i], glm::mat4(1.0f));
+		TransformComponent* transform = transforms->getComponent(entity);
+		transform->worldMatrix = worldMatrices[mTransformStore.GetSlot(entity)];
+		transforms->markModified(entity);
 	}
 }
 
-void Scene::UpdateChildren(ecs::Entity entity, const glm::mat4& parentTransform)
+void Scene::UpdateBounds()
 {
-	TransformComponent* transform = mComponentManager->GetComponent<TransformComponent>(entity);
-	transform->worldMatrix = parentTransform * transform->localMatrix;
+	auto meshRenderers = mComponentManager->GetComponentArray<MeshRenderer>();
+	auto transforms = mComponentManager->GetComponentArray<TransformComponent>();
 
-	HierarchyComponent* hierarchy = mComponentManager->GetComponent<HierarchyComponent>(entity);
-	for (auto& child : hierarchy->childrens)
-		UpdateChildren(child, transform->worldMatrix);
+	auto removeProxy = [&](ecs::Entity entity) {
+		const uint32_t proxy = mBoundsProxies.get(entity);
+		if (proxy == ecs::SparseIndex::kInvalidIndex || mBoundsTree.GetUserData(proxy) != entity)
+			return;
+		mBoundsTree.Remove(proxy);
+		mBoundsProxies.reset(entity);
+	};
+
+	auto updateProxy = [&](ecs::Entity entity) {
+		const MeshRenderer* meshRenderer = meshRenderers->getComponent(entity);
+		const TransformComponent* transform = transforms->getComponent(entity);
+		if (meshRenderer == nullptr || transform == nullptr)
+		{
+			removeProxy(entity);
+			return;
+		}
+
+		BoundingBox aabb = meshRenderer->boundingBox;
+		aabb.Transform(transform->worldMatrix);
+		const uint32_t proxy = mBoundsProxies.get(entity);
+		if (proxy != ecs::SparseIndex::kInvalidIndex && mBoundsTree.GetUserData(proxy) == entity)
+			mBoundsTree.Update(proxy, aabb);
+		else
+			mBoundsProxies.set(entity, mBoundsTree.Insert(aabb, entity));
+	};
 
+	// Removed entities are handled first, the index can be reused by an added entity
+	for (ecs::Entity entity : meshRenderers->getRemoved())
+		removeProxy(entity);
+	for (ecs::Entity entity : transforms->getRemoved())
+		removeProxy(entity);
+
+	for (ecs::Entity entity : meshRenderers->getAdded())
+		updateProxy(entity);
+	for (ecs::Entity entity : meshRenderers->getModified())
+		updateProxy(entity);
+	for (ecs::Entity entity : transforms->getAdded())
+		updateProxy(entity);
+	for (ecs::Entity entity : transforms->getModified())
+		updateProxy(entity);
 }
 
 void Scene::InitializeLights()
@@ -279,137 +502,467 @@ ecs::Entity Scene::createEntity(const std::string& name) {
 	return entity;
 }
 
-void Scene::parseMaterial(tinygltf::Model* model, MaterialComponent* component, uint32_t matIndex) {
+namespace
+{
+	// Sums of the index buffer analysis over the primitives, index 0 is before the optimization
+	struct ImportStatistics
+	{
+		uint64_t triangles = 0;
+		uint64_t vertices[2] = {};
+		uint64_t verticesTransformed[2] = {};
+		uint64_t pixelsCovered[2] = {};
+		uint64_t pixelsShaded[2] = {};
+		uint64_t bytesFetched[2] = {};
+
+		void Add(const ImportStatistics& other)
+		{
+			triangles += other.triangles;
+			for (uint32_t i = 0; i < 2; ++i)
+			{
+				vertices[i] += other.vertices[i];
+				verticesTransformed[i] += other.verticesTransformed[i];
+				pixelsCovered[i] += other.pixelsCovered[i];
+				pixelsShaded[i] += other.pixelsShaded[i];
+				bytesFetched[i] += other.bytesFetched[i];
+			}
+		}
+	};
+
+	// Materials and images are added to the tables of the mesh the first time they are referenced
+	struct GltfImport
+	{
+		tinygltf::Model* model;
+		MeshCache::Data* data;
+		MeshCache::ImportOptions options;
+		std::vector<uint32_t> materials;
+		std::vector<uint32_t> images;
+		// Gltf image of each texture in the table
+		std::vector<uint32_t> textureImages;
+		// Gltf primitive of each primitive in the mesh
+		std::vector<const tinygltf::Primitive*> primitives;
+		ImportStatistics statistics;
+	};
+
+	// Unpacked vertices, widened indices and meshlets of a primitive, offsets are local
+	struct PrimitiveGeometry
+	{
+		std::vector<Vertex> vertices;
+		// Replaces the vertices with the compact option, quantized in bounds
+		std::vector<CompactVertex> compactVertices;
+		BoundingBox bounds;
+		std::vector<uint32_t> indices;
+		std::vector<MeshLod> lods;
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint8_t> meshletTriangles;
+		ImportStatistics statistics;
+	};
+}
+
+static uint32_t addNode(MeshCache::Data& data, uint32_t parent, const std::string& name, uint32_t primitive = MeshCache::kInvalidIndex)
+{
+	const TransformComponent transform;
+
+	MeshCache::Node node = {};
+	node.parent = parent;
+	node.name = data.AddString(name);
+	node.nameLength = static_cast<uint32_t>(name.length());
+	node.primitive = primitive;
+	node.position = transform.position;
+	node.rotation = transform.rotation;
+	node.scale = transform.scale;
+	data.nodes.push_back(node);
+	return static_cast<uint32_t>(data.nodes.size() - 1);
+}
+
+static uint32_t parseTexture(GltfImport& import, uint32_t textureIndex)
+{
+	tinygltf::Model* model = import.model;
+	const uint32_t imageIndex = model->textures[textureIndex].source;
+	if (import.images[imageIndex] != MeshCache::kInvalidIndex)
+		return import.images[imageIndex];
+
+	tinygltf::Image& image = model->images[imageIndex];
+	const std::string& name = image.uri.length() == 0 ? image.name : image.uri;
+
+	MeshCache::Data& data = *import.data;
+	MeshCache::Texture texture = {};
+	texture.name = data.AddString(name);
+	texture.nameLength = static_cast<uint32_t>(name.length());
+	texture.width = image.width;
+	texture.height = image.height;
+	if (image.bufferView >= 0)
+	{
+		// Embedded image is kept encoded, it's a lot smaller than the pixels
+		const tinygltf::BufferView& bufferView = model->bufferViews[image.bufferView];
+		texture.source = MeshCache::TextureSource::Encoded;
+		texture.dataOffset = data.AddBlob(model->buffers[bufferView.buffer].data.data() + bufferView.byteOffset, bufferView.byteLength);
+		texture.dataSize = bufferView.byteLength;
+	}
+	else if (image.uri.compare(0, 5, "data:") == 0)
+	{
+		// Data uri is only available decoded
+		texture.source = MeshCache::TextureSource::Raw;
+		texture.dataOffset = data.AddBlob(image.image.data(), image.image.size());
+		texture.dataSize = image.image.size();
+	}
+	else
+		texture.source = MeshCache::TextureSource::File;
+
+	const uint32_t index = static_cast<uint32_t>(data.textures.size());
+	data.textures.push_back(texture);
+	import.textureImages.push_back(imageIndex);
+	import.images[imageIndex] = index;
+	return index;
+}
+
+static uint32_t parseMaterial(GltfImport& import, int matIndex) {
 	if (matIndex == -1)
-		return;
+		return MeshCache::kInvalidIndex;
 
-	tinygltf::Material& material = model->materials[matIndex];
-	component->alphaCutoff = (float)material.alphaCutoff;
+	if (import.materials[matIndex] != MeshCache::kInvalidIndex)
+		return import.materials[matIndex];
+
+	MaterialComponent component;
+	tinygltf::Material& material = import.model->materials[matIndex];
+	component.alphaCutoff = (float)material.alphaCutoff;
 
 	if (material.alphaMode == "BLEND")
-		component->alphaMode = ALPHAMODE_BLEND;
+		component.alphaMode = ALPHAMODE_BLEND;
 	else if (material.alphaMode == "MASK")
-		component->alphaMode = ALPHAMODE_MASK;
+		component.alphaMode = ALPHAMODE_MASK;
 
 	// Parse Material value
 	tinygltf::PbrMetallicRoughness& pbr = material.pbrMetallicRoughness;
 	std::vector<double>& baseColor = pbr.baseColorFactor;
-	component->albedo = glm::vec4((float)baseColor[0], (float)baseColor[1], (float)baseColor[2], (float)baseColor[3]);
-	component->transparency = (float)baseColor[3];
-	component->metallic = (float)pbr.metallicFactor;
-	component->roughness = (float)pbr.roughnessFactor;
+	component.albedo = glm::vec4((float)baseColor[0], (float)baseColor[1], (float)baseColor[2], (float)baseColor[3]);
+	component.transparency = (float)baseColor[3];
+	component.metallic = (float)pbr.metallicFactor;
+	component.roughness = (float)pbr.roughnessFactor;
 	std::vector<double>& emissiveColor = material.emissiveFactor;
-	component->emissive = glm::vec3((float)emissiveColor[0], (float)emissiveColor[1], (float)emissiveColor[2]);
-
-	// Parse Material texture
-	auto loadTexture = [&](uint32_t index) {
-		tinygltf::Texture& texture = model->textures[index];
-		tinygltf::Image& image = model->images[texture.source];
-		const std::string& name = image.uri.length() == 0 ? image.name : image.uri;
-		return TextureCache::LoadTexture(name, image.width, image.height, image.image.data(), image.component, true);
-	};
-	
+	component.emissive = glm::vec3((float)emissiveColor[0], (float)emissiveColor[1], (float)emissiveColor[2]);
+
+	// Texture slots store the index in the texture table until the mesh is instantiated
+	std::fill(std::begin(component.textures), std::end(component.textures), MeshCache::kInvalidIndex);
 
 	if (pbr.baseColorTexture.index >= 0)
-		component->albedoMap = loadTexture(pbr.baseColorTexture.index);
+		component.albedoMap = parseTexture(import, pbr.baseColorTexture.index);
 
 	if (pbr.metallicRoughnessTexture.index >= 0) 
-		component->metallicMap = component->roughnessMap = loadTexture(pbr.metallicRoughnessTexture.index);
+		component.metallicMap = component.roughnessMap = parseTexture(import, pbr.metallicRoughnessTexture.index);
 
 	if (material.normalTexture.index >= 0)
-		component->normalMap = loadTexture(material.normalTexture.index);
+		component.normalMap = parseTexture(import, material.normalTexture.index);
 
 	if (material.occlusionTexture.index >= 0)
-		component->ambientOcclusionMap = loadTexture(material.occlusionTexture.index);
+		component.ambientOcclusionMap = parseTexture(import, material.occlusionTexture.index);
 
 	if (material.emissiveTexture.index >= 0)
-		component->emissiveMap = loadTexture(material.emissiveTexture.index);
+		component.emissiveMap = parseTexture(import, material.emissiveTexture.index);
+
+	MeshCache::Data& data = *import.data;
+	import.materials[matIndex] = static_cast<uint32_t>(data.materials.size());
+	data.materials.push_back(component);
+	return import.materials[matIndex];
 }
 
-void Scene::parseMesh(tinygltf::Model* model, tinygltf::Mesh& mesh, ecs::Entity parent) {
+// Geometry is built later by buildPrimitives(), only the material and the bounds are read here
+static void parseMesh(GltfImport& import, tinygltf::Mesh& mesh, uint32_t parent) {
+	tinygltf::Model* model = import.model;
+	MeshCache::Data& data = *import.data;
 	for (auto& primitive : mesh.primitives)
 	{
-		// Parse position
-		const tinygltf::Accessor& positionAccessor = model->accessors[primitive.attributes["POSITION"]];
-		float* positions = (float*)gltfMesh::getBufferPtr(model, positionAccessor);
-		uint32_t numPosition = (uint32_t)positionAccessor.count;
-
-		// Parse normals
-		float* normals = nullptr;
-		auto normalAttributes = primitive.attributes.find("NORMAL");
-		if (normalAttributes != primitive.attributes.end()) {
-			const tinygltf::Accessor& normalAccessor = model->accessors[normalAttributes->second];
-			assert(numPosition == normalAccessor.count);
-			normals = (float*)gltfMesh::getBufferPtr(model, normalAccessor);
-		}
+		const tinygltf::Accessor& positionAccessor = model->accessors[primitive.attributes.at("POSITION")];
+
+		MeshCache::Primitive record = {};
+		record.material = parseMaterial(import, primitive.material);
+		record.boundingBox.min = glm::vec3(positionAccessor.minValues[0], positionAccessor.minValues[1], positionAccessor.minValues[2]);
+		record.boundingBox.max = glm::vec3(positionAccessor.maxValues[0], positionAccessor.maxValues[1], positionAccessor.maxValues[2]);
+		data.primitives.push_back(record);
+		import.primitives.push_back(&primitive);
+
+		std::string name = mesh.name.length() > 0 ? mesh.name : "unnamed";
+		addNode(data, parent, "submesh_" + name, (uint32_t)data.primitives.size() - 1);
+	}
+}
+
+static void analyzePrimitive(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, ImportStatistics& statistics, uint32_t pass)
+{
+	if (indices.empty() || vertices.empty())
+		return;
+
+	// Cache size of the meshoptimizer analysis, close to the post transform cache of the current GPUs
+	constexpr uint32_t kCacheSize = 16;
+	const meshopt_VertexCacheStatistics vertexCache = meshopt_analyzeVertexCache(indices.data(), indices.size(), vertices.size(), kCacheSize, 0, 0);
+	const meshopt_OverdrawStatistics overdraw = meshopt_analyzeOverdraw(indices.data(), indices.size(), &vertices[0].px, vertices.size(), sizeof(Vertex));
+	const meshopt_VertexFetchStatistics vertexFetch = meshopt_analyzeVertexFetch(indices.data(), indices.size(), vertices.size(), sizeof(Vertex));
+
+	statistics.vertices[pass] = vertices.size();
+	statistics.verticesTransformed[pass] = vertexCache.vertices_transformed;
+	statistics.pixelsCovered[pass] = overdraw.pixels_covered;
+	statistics.pixelsShaded[pass] = overdraw.pixels_shaded;
+	statistics.bytesFetched[pass] = vertexFetch.bytes_fetched;
+}
+
+static void logStatistics(const std::string& name, const ImportStatistics& statistics)
+{
+	if (statistics.triangles == 0)
+		return;
+
+	auto ratio = [](uint64_t value, uint64_t total) { return total > 0 ? double(value) / double(total) : 0.0; };
+	auto format = [](double before, double after) {
+		char buffer[64];
+		std::snprintf(buffer, sizeof(buffer), "%.3f -> %.3f", before, after);
+		return std::string(buffer);
+	};
+
+	// ACMR is per triangle, ATVR per vertex, overfetch per byte of the vertex buffer
+	double values[4][2];
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		values[0][i] = ratio(statistics.verticesTransformed[i], statistics.triangles);
+		values[1][i] = ratio(statistics.verticesTransformed[i], statistics.vertices[i]);
+		values[2][i] = ratio(statistics.pixelsShaded[i], statistics.pixelsCovered[i]);
+		values[3][i] = ratio(statistics.bytesFetched[i], statistics.vertices[i] * sizeof(Vertex));
+	}
+	Logger::Info(name + ": ACMR " + format(values[0][0], values[0][1]) + ", ATVR " + format(values[1][0], values[1][1]) +
+		", overdraw " + format(values[2][0], values[2][1]) + ", overfetch " + format(values[3][0], values[3][1]));
+}
+
+/*
+* Each level is simplified from the previous one to half of its triangles and
+* appended to the indices. Errors are summed over the chain so a level is never
+* reported closer to LOD 0 than the level it was simplified from.
+*/
+static void buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods)
+{
+	// A level that keeps more than 85% of the previous one isn't worth the memory
+	constexpr float kMinReduction = 0.85f;
+	// Largest deviation of a single step relative to the mesh extents
+	constexpr float kMaxStepError = 0.05f;
+
+	const float scale = meshopt_simplifyScale(&vertices[0].px, vertices.size(), sizeof(Vertex));
+	std::vector<uint32_t> simplified;
+	float error = 0.0f;
+	while (lods.size() < kMaxLODs)
+	{
+		const MeshLod& previous = lods.back();
+		const std::size_t targetCount = previous.indexCount / 6 * 3;
+		simplified.resize(previous.indexCount);
+
+		float stepError = 0.0f;
+		const std::size_t count = meshopt_simplify(simplified.data(), indices.data() + previous.indexOffset, previous.indexCount,
+			&vertices[0].px, vertices.size(), sizeof(Vertex), targetCount, kMaxStepError, 0, &stepError);
+		if (count == 0 || count > previous.indexCount * kMinReduction)
+			break;
+
+		meshopt_optimizeVertexCache(simplified.data(), simplified.data(), count, vertices.size());
+		error += stepError * scale;
+		lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(count), 0, 0, error });
+		indices.insert(indices.end(), simplified.begin(), simplified.begin() + count);
+	}
+}
+
+static BoundingBox computeBounds(const std::vector<Vertex>& vertices)
+{
+	BoundingBox bounds(glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()));
+	for (const Vertex& vertex : vertices)
+	{
+		const glm::vec3 position(vertex.px, vertex.py, vertex.pz);
+		bounds.min = glm::min(bounds.min, position);
+		bounds.max = glm::max(bounds.max, position);
+	}
+	return vertices.empty() ? BoundingBox(glm::vec3(0.0f), glm::vec3(0.0f)) : bounds;
+}
+
+static glm::vec2 encodeOctahedral(glm::vec3 v)
+{
+	const float length = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+	if (length == 0.0f)
+		return glm::vec2(0.0f);
+
+	// Lower hemisphere is folded over the diagonals
+	v /= length;
+	if (v.z < 0.0f)
+		return glm::vec2((1.0f - std::abs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+	return glm::vec2(v.x, v.y);
+}
+
+// Packed normals are decoded as the shaders do, the sign of the bitangent is kept from the stored one
+static void compressVertices(const std::vector<Vertex>& vertices, const BoundingBox& bounds, std::vector<CompactVertex>& out)
+{
+	auto unpack = [](uint8_t x, uint8_t y, uint8_t z) { return (glm::vec3(x, y, z) - 127.0f) / 127.0f; };
+	auto quantizeSnorm = [](float value) { return static_cast<int8_t>(meshopt_quantizeSnorm(value, 8)); };
+
+	// Flat axes are stored as 0
+	const glm::vec3 extent = bounds.max - bounds.min;
+	const glm::vec3 scale(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+	out.resize(vertices.size());
+	for (std::size_t i = 0; i < vertices.size(); ++i)
+	{
+		const Vertex& vertex = vertices[i];
+		CompactVertex& compact = out[i];
+
+		const glm::vec3 position = (glm::vec3(vertex.px, vertex.py, vertex.pz) - bounds.min) * scale;
+		compact.px = static_cast<uint16_t>(meshopt_quantizeUnorm(position.x, 16));
+		compact.py = static_cast<uint16_t>(meshopt_quantizeUnorm(position.y, 16));
+		compact.pz = static_cast<uint16_t>(meshopt_quantizeUnorm(position.z, 16));
+
+		const glm::vec3 normal = unpack(vertex.nx, vertex.ny, vertex.nz);
+		const glm::vec3 tangent = unpack(vertex.tx, vertex.ty, vertex.tz);
+		const glm::vec3 bitangent = unpack(vertex.bx, vertex.by, vertex.bz);
+		const glm::vec2 octNormal = encodeOctahedral(normal);
+		const glm::vec2 octTangent = encodeOctahedral(tangent);
+		compact.nx = quantizeSnorm(octNormal.x);
+		compact.ny = quantizeSnorm(octNormal.y);
+		compact.tx = quantizeSnorm(octTangent.x);
+		compact.ty = quantizeSnorm(octTangent.y);
+		compact.tw = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -127 : 127;
+		compact.reserved = 0;
+
+		compact.u = meshopt_quantizeHalf(vertex.ux);
+		compact.v = meshopt_quantizeHalf(vertex.uy);
+	}
+}
+
+// Indices of the accessor widened to 32 bits, a primitive without indices draws its vertices in order
+static void readIndices(tinygltf::Model* model, int accessorIndex, uint32_t vertexCount, std::vector<uint32_t>& indices)
+{
+	if (accessorIndex < 0)
+	{
+		indices.resize(vertexCount);
+		std::iota(indices.begin(), indices.end(), 0u);
+		return;
+	}
+
+	const tinygltf::Accessor& accessor = model->accessors[accessorIndex];
+	const uint8_t* data = gltfMesh::getBufferPtr(model, accessor);
+	const std::size_t count = accessor.count;
+	switch (accessor.componentType)
+	{
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+		indices.assign(data, data + count);
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+		indices.assign(reinterpret_cast<const uint16_t*>(data), reinterpret_cast<const uint16_t*>(data) + count);
+		break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+		indices.assign(reinterpret_cast<const uint32_t*>(data), reinterpret_cast<const uint32_t*>(data) + count);
+		break;
+	default:
+		// Not allowed by the spec, the primitive is left empty
+		indices.clear();
+		break;
+	}
+}
+
+// Only reads the model, primitives are built in parallel
+static void buildPrimitive(tinygltf::Model* model, const tinygltf::Primitive& primitive, const MeshCache::ImportOptions& options, PrimitiveGeometry& out) {
+	// Parse position
+	const tinygltf::Accessor& positionAccessor = model->accessors[primitive.attributes.at("POSITION")];
+	float* positions = (float*)gltfMesh::getBufferPtr(model, positionAccessor);
+	uint32_t numPosition = (uint32_t)positionAccessor.count;
+
+	// Parse normals
+	float* normals = nullptr;
+	auto normalAttributes = primitive.attributes.find("NORMAL");
+	if (normalAttributes != primitive.attributes.end()) {
+		const tinygltf::Accessor& normalAccessor = model->accessors[normalAttributes->second];
+		assert(numPosition == normalAccessor.count);
+		normals = (float*)gltfMesh::getBufferPtr(model, normalAccessor);
+	}
+
+	// Parse tangents, w is the sign of the bitangent
+	float* tangents = nullptr;
+	auto tangentAttributes = primitive.attributes.find("TANGENT");
+	if (tangentAttributes != primitive.attributes.end()) {
+		const tinygltf::Accessor& tangentAccessor = model->accessors[tangentAttributes->second];
+		assert(numPosition == tangentAccessor.count);
+		tangents = (float*)gltfMesh::getBufferPtr(model, tangentAccessor);
+	}
 
-		// Parse tangents
-		float* tangents = nullptr;
-		auto tangentAttributes = primitive.attributes.find("TANGENT");
-		if (tangentAttributes != primitive.attributes.end()) {
-			const tinygltf::Accessor& tangentAccessor = model->accessors[normalAttributes->second];
-			assert(numPosition == tangentAccessor.count);
-			tangents = (float*)gltfMesh::getBufferPtr(model, tangentAccessor);
+	// Parse UV
+	float* uvs = nullptr;
+	auto uvAttributes = primitive.attributes.find("TEXCOORD_0");
+	if (uvAttributes != primitive.attributes.end()) {
+		const tinygltf::Accessor& uvAccessor = model->accessors[uvAttributes->second];
+		assert(numPosition == uvAccessor.count);
+		uvs = (float*)gltfMesh::getBufferPtr(model, uvAccessor);
+	}
+
+
+
+	std::vector<Vertex> vertices(numPosition);
+	for (uint32_t i = 0; i < numPosition; ++i) {
+		Vertex& vertex = vertices[i];
+
+		vertex.px = positions[i * 3 + 0];
+		vertex.py = positions[i * 3 + 1];
+		vertex.pz = positions[i * 3 + 2];
+
+		glm::vec3 n = glm::vec3(0.0f, 1.0f, 0.0f);
+		if (normals)
+		{
+			n = glm::vec3(normals[i * 3 + 0], normals[i * 3 + 1], normals[i * 3 + 2]);
+			vertex.nx = uint8_t(n.x * 127.0f + 127.0f);
+			vertex.ny = uint8_t(n.y * 127.0f + 127.0f);
+			vertex.nz = uint8_t(n.z * 127.0f + 127.0f);
 		}
 
-		// Parse UV
-		float* uvs = nullptr;
-		auto uvAttributes = primitive.attributes.find("TEXCOORD_0");
-		if (uvAttributes != primitive.attributes.end()) {
-			const tinygltf::Accessor& uvAccessor = model->accessors[uvAttributes->second];
-			assert(numPosition == uvAccessor.count);
-			uvs = (float*)gltfMesh::getBufferPtr(model, uvAccessor);
+		if (uvs)
+		{
+			vertex.ux = uvs[i * 2 + 0];
+			vertex.uy = 1.0f - uvs[i * 2 + 1];
 		}
 
 
-		uint32_t vertexOffset = (uint32_t)(mStagingData.vertices.size() * sizeof(Vertex));
-		uint32_t indexOffset = (uint32_t)(mStagingData.indices.size() * sizeof(uint32_t));
+		if (tangents) {
+			glm::vec3 t = glm::vec3(tangents[i * 4 + 0], tangents[i * 4 + 1], tangents[i * 4 + 2]);
+			glm::vec3 bt = glm::normalize(glm::cross(n, t)) * tangents[i * 4 + 3];
 
-		std::vector<Vertex> vertices(numPosition);
-		for (uint32_t i = 0; i < numPosition; ++i) {
-			Vertex& vertex = vertices[i];
+			vertex.tx = uint8_t(t.x * 127.0f + 127.0f);
+			vertex.ty = uint8_t(t.y * 127.0f + 127.0f);
+			vertex.tz = uint8_t(t.z * 127.0f + 127.0f);
 
-			vertex.px = positions[i * 3 + 0];
-			vertex.py = positions[i * 3 + 1];
-			vertex.pz = positions[i * 3 + 2];
+			vertex.bx = uint8_t(bt.x * 127.0f + 127.0f);
+			vertex.by = uint8_t(bt.y * 127.0f + 127.0f);
+			vertex.bz = uint8_t(bt.z * 127.0f + 127.0f);
+		}
+	}
 
-			glm::vec3 n = glm::vec3(0.0f, 1.0f, 0.0f);
-			if (normals)
-			{
-				n = glm::vec3(normals[i * 3 + 0], normals[i * 3 + 1], normals[i * 3 + 2]);
-				vertex.nx = uint8_t(n.x * 127.0f + 127.0f);
-				vertex.ny = uint8_t(n.y * 127.0f + 127.0f);
-				vertex.nz = uint8_t(n.z * 127.0f + 127.0f);
-			}
+	std::vector<uint32_t> indices;
+	readIndices(model, primitive.indices, numPosition, indices);
+	uint32_t indexCount = (uint32_t)indices.size();
 
-			if (uvs)
-			{
-				vertex.ux = uvs[i * 2 + 0];
-				vertex.uy = 1.0f - uvs[i * 2 + 1];
-			}
+	analyzePrimitive(indices, vertices, out.statistics, 0);
 
+	// Meshlets are built from the optimized order, so the indexed path draws it too
+	if (options.optimizeVertexCache)
+		meshopt_optimizeVertexCache(indices.data(), indices.data(), indexCount, numPosition);
 
-			if (tangents) {
-				glm::vec3 t = glm::vec3(tangents[i * 3 + 0], tangents[i * 3 + 1], tangents[i * 3 + 2]);
-				glm::vec3 bt = glm::normalize(glm::cross(n, t));
+	if (options.optimizeOverdraw)
+		meshopt_optimizeOverdraw(indices.data(), indices.data(), indexCount, &vertices[0].px, numPosition, sizeof(Vertex), options.overdrawThreshold);
 
-				vertex.tx = uint8_t(t.x * 127.0f + 127.0f);
-				vertex.ty = uint8_t(t.y * 127.0f + 127.0f);
-				vertex.tz = uint8_t(t.z * 127.0f + 127.0f);
+	// Unreferenced vertices are dropped
+	if (options.optimizeVertexFetch)
+		vertices.resize(meshopt_optimizeVertexFetch(vertices.data(), indices.data(), indexCount, vertices.data(), numPosition, sizeof(Vertex)));
 
-				vertex.bx = uint8_t(bt.x * 127.0f + 127.0f);
-				vertex.by = uint8_t(bt.y * 127.0f + 127.0f);
-				vertex.bz = uint8_t(bt.z * 127.0f + 127.0f);
-			}
-		}
+	analyzePrimitive(indices, vertices, out.statistics, 1);
+	out.statistics.triangles = indexCount / 3;
 
-		const tinygltf::Accessor& indicesAccessor = model->accessors[primitive.indices];
-		uint16_t* indicesPtr = (uint16_t*)gltfMesh::getBufferPtr(model, indicesAccessor);
-		uint32_t indexCount = (uint32_t)indicesAccessor.count;
-		std::vector<uint32_t> indices(indicesPtr, indicesPtr + indexCount);
+	// Levels are appended after LOD 0 in the index range of the primitive
+	out.lods.push_back({ 0, indexCount, 0, 0, 0.0f });
+	if (!vertices.empty())
+		buildLods(vertices, indices, out.lods);
 
-		// Generate Meshlets
-		const std::size_t maxMeshlets = meshopt_buildMeshletsBound(indexCount, MAX_MESHLET_VERTICES, MAX_MESHLET_TRIANGLES);
+	// Tighter normal cones for the backface culling at the cost of slightly larger meshlets
+	constexpr float kMeshletConeWeight = 0.25f;
+
+	// Generate Meshlets, the meshlets of each level follow the ones of the previous level
+	for (MeshLod& lod : out.lods)
+	{
+		const std::size_t maxMeshlets = meshopt_buildMeshletsBound(lod.indexCount, MAX_MESHLET_VERTICES, MAX_MESHLET_TRIANGLES);
 		std::vector<meshopt_Meshlet> localMeshlets(maxMeshlets);
 
 		std::vector<uint32_t> meshletVertices(maxMeshlets * MAX_MESHLET_VERTICES);
@@ -418,196 +971,929 @@ void Scene::parseMesh(tinygltf::Model* model, tinygltf::Mesh& mesh, ecs::Entity
 		std::size_t meshletCount = meshopt_buildMeshlets(localMeshlets.data(),
 			meshletVertices.data(),
 			meshletTriangles.data(),
-			indices.data(),
-			indexCount,
+			indices.data() + lod.indexOffset,
+			lod.indexCount,
 			(float*)vertices.data(),
 			vertices.size(),
 			sizeof(Vertex),
 			MAX_MESHLET_VERTICES,
 			MAX_MESHLET_TRIANGLES,
-			0.0f);
+			kMeshletConeWeight);
 
-		std::string name = mesh.name.length() > 0 ? mesh.name : "unnamed";
-		ecs::Entity child = createEntity("submesh_" + name);
-
-		uint32_t meshletVertexOffset = (uint32_t)mStagingData.meshletVertices.size();
-		uint32_t meshletTriangleOffset = (uint32_t)mStagingData.meshletTriangles.size();
-		uint32_t meshletOffset = (uint32_t)mStagingData.meshlets.size();
-		for (uint32_t i = 0; i < meshletCount; ++i) {
-
-			mStagingData.meshlets.emplace_back(Meshlet{
-				meshletVertexOffset + localMeshlets[i].vertex_offset,
-				localMeshlets[i].vertex_count,
-				meshletTriangleOffset + localMeshlets[i].triangle_offset,
-				localMeshlets[i].triangle_count,
-				glm::vec4(0.0f)
-				});
+		lod.meshletOffset = static_cast<uint32_t>(out.meshlets.size());
+		lod.meshletCount = static_cast<uint32_t>(meshletCount);
+
+		// Bounds for the culling in the task shader
+		const uint32_t vertexOffset = static_cast<uint32_t>(out.meshletVertices.size());
+		const uint32_t triangleOffset = static_cast<uint32_t>(out.meshletTriangles.size());
+		for (std::size_t i = 0; i < meshletCount; ++i)
+		{
+			const meshopt_Meshlet& meshlet = localMeshlets[i];
+			const meshopt_Bounds bounds = meshopt_computeMeshletBounds(&meshletVertices[meshlet.vertex_offset], &meshletTriangles[meshlet.triangle_offset],
+				meshlet.triangle_count, &vertices[0].px, vertices.size(), sizeof(Vertex));
+
+			out.meshlets.push_back(Meshlet{
+				vertexOffset + meshlet.vertex_offset,
+				meshlet.vertex_count,
+				triangleOffset + meshlet.triangle_offset,
+				meshlet.triangle_count,
+				glm::vec4(bounds.center[0], bounds.center[1], bounds.center[2], bounds.radius),
+				glm::vec4(bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2], bounds.cone_cutoff)
+			});
 		}
+		out.meshletVertices.insert(out.meshletVertices.end(), meshletVertices.begin(), meshletVertices.begin() + MAX_MESHLET_VERTICES * meshletCount);
+		out.meshletTriangles.insert(out.meshletTriangles.end(), meshletTriangles.begin(), meshletTriangles.begin() + MAX_MESHLET_TRIANGLES * meshletCount * 3);
+	}
 
-		// Add to the staging data
-		mStagingData.vertices.insert(mStagingData.vertices.end(), vertices.begin(), vertices.end());
-		mStagingData.indices.insert(mStagingData.indices.end(), indices.begin(), indices.end());
+	if (options.compactVertices)
+	{
+		out.bounds = computeBounds(vertices);
+		compressVertices(vertices, out.bounds, out.compactVertices);
+		vertices.clear();
+	}
 
-		std::size_t meshletVertexCount = MAX_MESHLET_VERTICES * meshletCount;
-		std::size_t meshletTriangleCount = MAX_MESHLET_TRIANGLES * meshletCount * 3;
-		mStagingData.meshletVertices.insert(mStagingData.meshletVertices.end(), meshletVertices.begin(), meshletVertices.begin() + meshletVertexCount);
-		mStagingData.meshletTriangles.insert(mStagingData.meshletTriangles.end(), meshletTriangles.begin(), meshletTriangles.begin() + meshletTriangleCount);
+	out.vertices = std::move(vertices);
+	out.indices = std::move(indices);
+}
 
-		MeshRenderer& meshRenderer = mComponentManager->AddComponent<MeshRenderer>(child);
-		meshRenderer.vertexBuffer.byteOffset = vertexOffset;
-		meshRenderer.vertexBuffer.byteLength = (uint32_t)(vertices.size() * sizeof(Vertex));
-		meshRenderer.indexBuffer.byteOffset = indexOffset;
-		meshRenderer.indexBuffer.byteLength = (uint32_t)(indexCount * sizeof(uint32_t));
-		meshRenderer.meshletCount = (uint32_t)meshletCount;
-		meshRenderer.meshletOffset = meshletOffset;
+/*
+* Primitives are built into private buffers in parallel, then the offsets
+* are assigned with a prefix sum in the primitive order and the buffers
+* are scattered into the mesh in parallel. Output matches a serial build.
+*/
+static void buildPrimitives(GltfImport& import)
+{
+	MeshCache::Data& data = *import.data;
+	const uint32_t primitiveCount = static_cast<uint32_t>(import.primitives.size());
+	std::vector<PrimitiveGeometry> geometry(primitiveCount);
+	JobSystem::ParallelFor(primitiveCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+			buildPrimitive(import.model, *import.primitives[i], import.options, geometry[i]);
+		});
 
-		glm::vec3 minExtent = glm::vec3(positionAccessor.minValues[0], positionAccessor.minValues[1], positionAccessor.minValues[2]);
-		glm::vec3 maxExtent = glm::vec3(positionAccessor.maxValues[0], positionAccessor.maxValues[1], positionAccessor.maxValues[2]);
+	struct Offsets
+	{
+		std::size_t meshletVertex;
+		std::size_t meshletTriangle;
+	};
+	std::vector<Offsets> offsets(primitiveCount);
+
+	std::vector<Vertex>& vertices = data.vertices;
+	std::vector<CompactVertex>& compactVertices = data.compactVertices;
+	std::size_t vertexCount = import.options.compactVertices ? compactVertices.size() : vertices.size();
+	std::size_t indexCount = data.indices.size();
+	std::size_t lodCount = data.lods.size();
+	std::size_t meshletCount = data.meshlets.size();
+	std::size_t meshletVertexCount = data.meshletVertices.size();
+	std::size_t meshletTriangleCount = data.meshletTriangles.size();
+	for (uint32_t i = 0; i < primitiveCount; ++i)
+	{
+		MeshCache::Primitive& record = data.primitives[i];
+		record.vertexOffset = static_cast<uint32_t>(vertexCount);
+		record.vertexCount = static_cast<uint32_t>(geometry[i].vertices.size() + geometry[i].compactVertices.size());
+		record.indexOffset = static_cast<uint32_t>(indexCount);
+		record.indexCount = geometry[i].lods[0].indexCount;
+		record.meshletOffset = static_cast<uint32_t>(meshletCount);
+		record.meshletCount = geometry[i].lods[0].meshletCount;
+		record.lodOffset = static_cast<uint32_t>(lodCount);
+		record.lodCount = static_cast<uint32_t>(geometry[i].lods.size());
+		offsets[i] = { meshletVertexCount, meshletTriangleCount };
+
+		// Positions are quantized in the bounds of the vertices, they replace the ones of the accessor
+		if (import.options.compactVertices)
+			record.boundingBox = geometry[i].bounds;
+
+		vertexCount += record.vertexCount;
+		lodCount += geometry[i].lods.size();
+		indexCount += geometry[i].indices.size();
+		meshletCount += geometry[i].meshlets.size();
+		meshletVertexCount += geometry[i].meshletVertices.size();
+		meshletTriangleCount += geometry[i].meshletTriangles.size();
+		import.statistics.Add(geometry[i].statistics);
+	}
 
-		meshRenderer.boundingBox.min = minExtent;
-		meshRenderer.boundingBox.max = maxExtent;
+	// Indices are relative to the first vertex of the primitive, 16 bits are enough when all the primitives fit
+	const bool shortIndices = std::all_of(data.primitives.begin(), data.primitives.end(), [](const MeshCache::Primitive& record) {
+		return record.vertexCount <= MeshCache::kMaxShortIndexVertices;
+		});
 
-		MaterialComponent& material = mComponentManager->AddComponent<MaterialComponent>(child);
-		parseMaterial(model, &material, primitive.material);
-		AddChild(parent, child);
-	}
+	if (import.options.compactVertices)
+		compactVertices.resize(vertexCount);
+	else
+		vertices.resize(vertexCount);
+	if (shortIndices)
+		data.shortIndices.resize(indexCount);
+	else
+		data.indices.resize(indexCount);
+	data.lods.resize(lodCount);
+	data.meshlets.resize(meshletCount);
+	data.meshletVertices.resize(meshletVertexCount);
+	data.meshletTriangles.resize(meshletTriangleCount);
+
+	// Each primitive writes its own ranges, the private buffers are released as soon as they are copied
+	JobSystem::ParallelFor(primitiveCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const MeshCache::Primitive& record = data.primitives[i];
+			PrimitiveGeometry& source = geometry[i];
+			if (import.options.compactVertices)
+				std::copy(source.compactVertices.begin(), source.compactVertices.end(), compactVertices.begin() + record.vertexOffset);
+			else
+				std::copy(source.vertices.begin(), source.vertices.end(), vertices.begin() + record.vertexOffset);
+			if (shortIndices)
+				std::transform(source.indices.begin(), source.indices.end(), data.shortIndices.begin() + record.indexOffset, [](uint32_t index) { return static_cast<uint16_t>(index); });
+			else
+				std::copy(source.indices.begin(), source.indices.end(), data.indices.begin() + record.indexOffset);
+			std::copy(source.meshletVertices.begin(), source.meshletVertices.end(), data.meshletVertices.begin() + offsets[i].meshletVertex);
+			std::copy(source.meshletTriangles.begin(), source.meshletTriangles.end(), data.meshletTriangles.begin() + offsets[i].meshletTriangle);
+
+			for (std::size_t j = 0; j < source.lods.size(); ++j)
+			{
+				MeshLod lod = source.lods[j];
+				lod.indexOffset += record.indexOffset;
+				lod.meshletOffset += record.meshletOffset;
+				data.lods[record.lodOffset + j] = lod;
+			}
+
+			for (std::size_t j = 0; j < source.meshlets.size(); ++j)
+			{
+				Meshlet meshlet = source.meshlets[j];
+				meshlet.vertexOffset += static_cast<uint32_t>(offsets[i].meshletVertex);
+				meshlet.triangleOffset += static_cast<uint32_t>(offsets[i].meshletTriangle);
+				data.meshlets[record.meshletOffset + j] = meshlet;
+			}
+			source = {};
+		}
+		});
 }
 
-void Scene::parseNodeHierarchy(tinygltf::Model* model, ecs::Entity parent, int nodeIndex) {
-	tinygltf::Node& node = model->nodes[nodeIndex];
+static void parseNodeHierarchy(GltfImport& import, uint32_t parent, int nodeIndex) {
+	tinygltf::Node& node = import.model->nodes[nodeIndex];
 
-	// Create entity and write the transforms
-	ecs::Entity entity = createEntity(node.name);
-	TransformComponent* transform = mComponentManager->GetComponent<TransformComponent>(entity);
+	// Create node and write the transforms
+	MeshCache::Data& data = *import.data;
+	const uint32_t index = addNode(data, parent, node.name);
+	MeshCache::Node& record = data.nodes[index];
 	if (node.translation.size() > 0)
-		transform->position = glm::vec3((float)node.translation[0], (float)node.translation[1], (float)node.translation[2]);
+		record.position = glm::vec3((float)node.translation[0], (float)node.translation[1], (float)node.translation[2]);
 	if (node.rotation.size() > 0)
-		transform->rotation = glm::fquat((float)node.rotation[3], (float)node.rotation[0], (float)node.rotation[1], (float)node.rotation[2]);
+		record.rotation = glm::fquat((float)node.rotation[3], (float)node.rotation[0], (float)node.rotation[1], (float)node.rotation[2]);
 	if (node.scale.size() > 0)
-		transform->scale = glm::vec3((float)node.scale[0], (float)node.scale[1], (float)node.scale[2]);
+		record.scale = glm::vec3((float)node.scale[0], (float)node.scale[1], (float)node.scale[2]);
 
 	// Update MeshData
 	if (node.mesh >= 0) {
-		tinygltf::Mesh& mesh = model->meshes[node.mesh];
-		parseMesh(model, mesh, entity);
+		tinygltf::Mesh& mesh = import.model->meshes[node.mesh];
+		parseMesh(import, mesh, index);
 	}
 
-	// Create the scene graph hierarchy
-	AddChild(parent, entity);
-
 	for (auto child : node.children)
-		parseNodeHierarchy(model, entity, child);
+		parseNodeHierarchy(import, index, child);
 }
 
-ecs::Entity Scene::parseScene(tinygltf::Model* model,
-	tinygltf::Scene* scene)
+// Returns the gltf image of each texture in the table
+static std::vector<uint32_t> parseModel(tinygltf::Model* model, const MeshCache::ImportOptions& options, MeshCache::Data& data, ImportStatistics& statistics)
 {
-	ecs::Entity entity = createEntity(scene->name);
-	for (auto node : scene->nodes)
-		parseNodeHierarchy(model, entity, node);
-	return entity;
+	GltfImport import = { model, &data, options,
+		std::vector<uint32_t>(model->materials.size(), MeshCache::kInvalidIndex),
+		std::vector<uint32_t>(model->images.size(), MeshCache::kInvalidIndex) };
+
+	const uint32_t root = addNode(data, MeshCache::kInvalidIndex, "");
+	for (auto& scene : model->scenes) {
+		const uint32_t entity = addNode(data, root, scene.name);
+		for (auto node : scene.nodes)
+			parseNodeHierarchy(import, entity, node);
+	}
+	buildPrimitives(import);
+	statistics = import.statistics;
+
+	// External buffers are part of the source hash
+	for (auto& buffer : model->buffers) {
+		if (buffer.uri.length() > 0 && buffer.uri.compare(0, 5, "data:") != 0)
+			data.dependencies.push_back({ data.AddString(buffer.uri), (uint32_t)buffer.uri.length() });
+	}
+	return std::move(import.textureImages);
 }
 
-ecs::Entity Scene::parseModel(tinygltf::Model* model)
+// Raw pixels point into the blob, the other images are freed with the image loader
+static uint8_t* decodeTexture(const std::string& directory, const MeshCache::View& view, const MeshCache::Texture& texture, int& width, int& height)
 {
-	ecs::Entity root = createEntity();
-	for (auto& scene : model->scenes) {
-		ecs::Entity entity = parseScene(model, &scene);
-		AddChild(root, entity);
+	int component = 0;
+	if (texture.source == MeshCache::TextureSource::File)
+	{
+		const std::string path = directory + std::string(view.GetString(texture.name, texture.nameLength));
+		return Utils::ImageLoader::Load(path.c_str(), width, height, component);
 	}
-	return root;
+	if (texture.source == MeshCache::TextureSource::Encoded)
+		return Utils::ImageLoader::LoadFromMemory(view.blob.data + texture.dataOffset, static_cast<uint32_t>(texture.dataSize), width, height, component);
+
+	width = texture.width;
+	height = texture.height;
+	// Pixels are only read, they are copied to the staging buffer
+	return const_cast<uint8_t*>(view.blob.data + texture.dataOffset);
 }
 
-void Scene::updateMeshRenderer(gfx::BufferHandle vertexBuffer,
-	gfx::BufferHandle indexBuffer,
-	gfx::BufferHandle meshletBuffer,
-	gfx::BufferHandle meshletVertexBuffer,
-	gfx::BufferHandle meshletTriangleBuffer,
-	ecs::Entity entity)
+// Texture slots index the table of the mesh, textures not uploaded yet are left unbound
+static void remapTextures(MaterialComponent& material, const MaterialComponent& source, const std::vector<uint32_t>& textureIds, uint32_t uploadedTextures)
 {
-	auto meshRenderer = mComponentManager->GetComponent<MeshRenderer>(entity);
-	if (meshRenderer) {
-		meshRenderer->vertexBuffer.buffer = vertexBuffer;
-		meshRenderer->indexBuffer.buffer = indexBuffer;
-		meshRenderer->meshletBuffer = meshletBuffer;
-		meshRenderer->meshletVertexBuffer = meshletVertexBuffer;
-		meshRenderer->meshletTriangleBuffer = meshletTriangleBuffer;
+	for (uint32_t i = 0; i < std::size(material.textures); ++i)
+	{
+		const uint32_t texture = source.textures[i];
+		material.textures[i] = texture == MeshCache::kInvalidIndex || texture >= uploadedTextures ? gfx::INVALID_TEXTURE_ID : textureIds[texture];
+	}
+}
+
+// Decode the images of the texture table in parallel, the upload stays on the calling thread
+static std::vector<uint32_t> loadTextures(const std::string& source, const MeshCache::View& view)
+{
+	struct Image {
+		int width = 0;
+		int height = 0;
+		uint8_t* pixels = nullptr;
+	};
+
+	const std::string directory = source.substr(0, source.find_last_of("/\\") + 1);
+	std::vector<Image> images(view.textures.count);
+	JobSystem::ParallelFor(static_cast<uint32_t>(view.textures.count), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+			images[i].pixels = decodeTexture(directory, view, view.textures[i], images[i].width, images[i].height);
+		});
+
+	std::vector<uint32_t> textureIds(view.textures.count);
+	for (std::size_t i = 0; i < view.textures.count; ++i)
+	{
+		const MeshCache::Texture& texture = view.textures[i];
+		const std::string name(view.GetString(texture.name, texture.nameLength));
+		textureIds[i] = TextureCache::LoadTexture(name, images[i].width, images[i].height, images[i].pixels, 4, true);
+		if (texture.source != MeshCache::TextureSource::Raw)
+			Utils::ImageLoader::Free(images[i].pixels);
+	}
+	return textureIds;
+}
+
+void Scene::createMeshBuffers(const MeshCache::View& view, uint32_t source, gfx::BufferHandle* buffers)
+{
+	gfx::GraphicsDevice* device = gfx::GetDevice();
+
+	// Slices are copied to the staging buffers straight from the source
+	auto createBuffer = [&](const void* data, std::size_t size, gfx::BindFlag bindFlag) {
+		gfx::GPUBufferDesc bufferDesc;
+		bufferDesc.bindFlag = bindFlag;
+		bufferDesc.usage = gfx::Usage::Default;
+		bufferDesc.size = static_cast<uint32_t>(size);
+
+		gfx::BufferHandle buffer = device->CreateBuffer(&bufferDesc);
+		mAllocatedBuffers.push_back(buffer);
+		device->CopyToBuffer(buffer, data, 0, bufferDesc.size);
+		return buffer;
+	};
+
+	buffers[PendingMesh::VertexStream] = createBuffer(view.GetVertexData(), view.GetVertexByteSize(), gfx::BindFlag::ShaderResource);
+	buffers[PendingMesh::MeshletStream] = createBuffer(view.meshlets.data, view.meshlets.GetByteSize(), gfx::BindFlag::ShaderResource);
+	buffers[PendingMesh::MeshletVertexStream] = createBuffer(view.meshletVertices.data, view.meshletVertices.GetByteSize(), gfx::BindFlag::ShaderResource);
+	buffers[PendingMesh::MeshletTriangleStream] = createBuffer(view.meshletTriangles.data, view.meshletTriangles.GetByteSize(), gfx::BindFlag::ShaderResource);
+	buffers[PendingMesh::IndexStream] = createBuffer(view.GetIndexData(), view.GetIndexByteSize(), gfx::BindFlag::IndexBuffer);
+	addMeshPrimitives(buffers[PendingMesh::IndexStream], source, view.primitives);
+
+	// Keep the triangles for the ray casts
+	buildMeshBVHs(buffers[PendingMesh::IndexStream], view);
+}
+
+ecs::Entity Scene::instantiateMesh(const MeshCache::View& view, uint32_t source, const std::vector<uint32_t>& textureIds)
+{
+	gfx::BufferHandle buffers[PendingMesh::StreamCount];
+	createMeshBuffers(view, source, buffers);
+
+	// Parents are created before the children
+	std::vector<ecs::Entity> entities(view.nodes.count);
+	for (std::size_t i = 0; i < view.nodes.count; ++i)
+	{
+		const MeshCache::Node& node = view.nodes[i];
+		ecs::Entity entity = createEntity(std::string(view.GetString(node.name, node.nameLength)));
+		entities[i] = entity;
+
+		TransformComponent* transform = mComponentManager->GetComponent<TransformComponent>(entity);
+		transform->position = node.position;
+		transform->rotation = node.rotation;
+		transform->scale = node.scale;
+
+		if (node.primitive != MeshCache::kInvalidIndex)
+		{
+			const MeshCache::Primitive& primitive = view.primitives[node.primitive];
+			addMeshRenderer(entity, view, primitive, buffers);
+
+			MaterialComponent& material = mComponentManager->AddComponent<MaterialComponent>(entity);
+			if (primitive.material != MeshCache::kInvalidIndex)
+			{
+				material = view.materials[primitive.material];
+				remapTextures(material, view.materials[primitive.material], textureIds, static_cast<uint32_t>(textureIds.size()));
+			}
+		}
+
+		if (node.parent != MeshCache::kInvalidIndex)
+			AddChild(entities[node.parent], entity);
+	}
+	return entities.empty() ? ecs::INVALID_ENTITY : entities[0];
+}
+
+void Scene::addMeshRenderer(ecs::Entity entity, const MeshCache::View& view, const MeshCache::Primitive& primitive, const gfx::BufferHandle* buffers)
+{
+	setMeshGeometry(mComponentManager->AddComponent<MeshRenderer>(entity), view, primitive, buffers);
+}
+
+void Scene::setMeshGeometry(MeshRenderer& meshRenderer, const MeshCache::View& view, const MeshCache::Primitive& primitive, const gfx::BufferHandle* buffers)
+{
+	meshRenderer.vertexBuffer.buffer = buffers[PendingMesh::VertexStream];
+	meshRenderer.vertexBuffer.byteOffset = primitive.vertexOffset * view.GetVertexStride();
+	meshRenderer.vertexBuffer.byteLength = primitive.vertexCount * view.GetVertexStride();
+	meshRenderer.SetCompactVertices(view.HasCompactVertices());
+	const uint32_t indexSize = gfx::GetIndexSize(view.GetIndexType());
+	meshRenderer.SetShortIndices(view.HasShortIndices());
+	meshRenderer.indexBuffer.buffer = buffers[PendingMesh::IndexStream];
+	meshRenderer.indexBuffer.byteOffset = primitive.indexOffset * indexSize;
+	meshRenderer.indexBuffer.byteLength = primitive.indexCount * indexSize;
+	meshRenderer.meshletBuffer = buffers[PendingMesh::MeshletStream];
+	meshRenderer.meshletVertexBuffer = buffers[PendingMesh::MeshletVertexStream];
+	meshRenderer.meshletTriangleBuffer = buffers[PendingMesh::MeshletTriangleStream];
+	meshRenderer.meshletOffset = primitive.meshletOffset;
+	meshRenderer.meshletCount = primitive.meshletCount;
+	meshRenderer.lodCount = std::min(primitive.lodCount, kMaxLODs);
+	std::copy(view.lods.begin() + primitive.lodOffset, view.lods.begin() + primitive.lodOffset + meshRenderer.lodCount, meshRenderer.lods);
+	meshRenderer.boundingBox = primitive.boundingBox;
+}
+
+// Compact positions and short indices are decoded for the build, the BVH keeps its own copy of the triangles
+static void buildMeshBVH(const MeshCache::View& view, const MeshCache::Primitive& primitive, MeshBVH& meshBVH)
+{
+	std::vector<uint32_t> wideIndices;
+	const uint32_t* indices = nullptr;
+	if (view.HasShortIndices())
+	{
+		const uint16_t* shortIndices = view.shortIndices.data + primitive.indexOffset;
+		wideIndices.assign(shortIndices, shortIndices + primitive.indexCount);
+		indices = wideIndices.data();
+	}
+	else
+		indices = view.indices.data + primitive.indexOffset;
+
+	if (!view.HasCompactVertices())
+	{
+		meshBVH.Build(&view.vertices[primitive.vertexOffset].px, sizeof(Vertex), primitive.vertexCount, indices, primitive.indexCount);
+		return;
+	}
+
+	const BoundingBox& bounds = primitive.boundingBox;
+	const glm::vec3 scale = (bounds.max - bounds.min) / 65535.0f;
+	std::vector<glm::vec3> positions(primitive.vertexCount);
+	for (uint32_t i = 0; i < primitive.vertexCount; ++i)
+	{
+		const CompactVertex& vertex = view.compactVertices[primitive.vertexOffset + i];
+		positions[i] = bounds.min + glm::vec3(vertex.px, vertex.py, vertex.pz) * scale;
+	}
+	meshBVH.Build(reinterpret_cast<const float*>(positions.data()), sizeof(glm::vec3), primitive.vertexCount, indices, primitive.indexCount);
+}
+
+void Scene::buildMeshBVHs(gfx::BufferHandle indexBuffer, const MeshCache::View& view)
+{
+	// Each primitive is built by a single job
+	std::vector<MeshBVH> meshBVHs(view.primitives.count);
+	JobSystem::ParallelFor(static_cast<uint32_t>(view.primitives.count), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+			buildMeshBVH(view, view.primitives[i], meshBVHs[i]);
+		});
+
+	addMeshBVHs(indexBuffer, view.primitives, meshBVHs);
+}
+
+// Mesh ranges are identified by the index buffer and the first index
+static uint64_t getMeshKey(gfx::BufferHandle indexBuffer, uint32_t firstIndex)
+{
+	return (uint64_t(indexBuffer.handle) << 32) | firstIndex;
+}
+
+static uint64_t getMeshKey(const IMeshRenderer* meshRenderer)
+{
+	return getMeshKey(meshRenderer->indexBuffer.buffer, meshRenderer->indexBuffer.byteOffset / gfx::GetIndexSize(meshRenderer->GetIndexType()));
+}
+
+void Scene::addMeshBVHs(gfx::BufferHandle indexBuffer, MeshCache::Slice<MeshCache::Primitive> primitives, std::vector<MeshBVH>& meshBVHs)
+{
+	for (std::size_t i = 0; i < primitives.count; ++i)
+		mMeshBVHs[getMeshKey(indexBuffer, primitives[i].indexOffset)] = std::move(meshBVHs[i]);
+}
+
+const MeshBVH* Scene::findMeshBVH(const IMeshRenderer* meshRenderer) const
+{
+	auto found = mMeshBVHs.find(getMeshKey(meshRenderer));
+	return found != mMeshBVHs.end() && !found->second.IsEmpty() ? &found->second : nullptr;
+}
+
+uint32_t Scene::addMeshSource(const std::string& filename, const MeshCache::ImportOptions& options)
+{
+	mMeshSources.push_back({ filename, options });
+	return static_cast<uint32_t>(mMeshSources.size() - 1);
+}
+
+void Scene::addMeshPrimitives(gfx::BufferHandle indexBuffer, uint32_t source, MeshCache::Slice<MeshCache::Primitive> primitives)
+{
+	for (std::size_t i = 0; i < primitives.count; ++i)
+		mMeshPrimitives[getMeshKey(indexBuffer, primitives[i].indexOffset)] = { source, static_cast<uint32_t>(i) };
+}
+
+const Scene::MeshPrimitive* Scene::findMeshPrimitive(const IMeshRenderer* meshRenderer) const
+{
+	auto found = mMeshPrimitives.find(getMeshKey(meshRenderer));
+	return found != mMeshPrimitives.end() ? &found->second : nullptr;
+}
+
+class Scene::SnapshotResolver : public SceneSnapshot::Resolver
+{
+public:
+	SnapshotResolver(Scene* scene) : mScene(scene) {}
+
+	// Buffers are filled, the cache of a touched source gets its new key
+	~SnapshotResolver()
+	{
+		for (auto& mesh : mMeshes)
+		{
+			if (mesh == nullptr)
+				continue;
+			mesh->cacheFile.Close();
+			if (mesh->refreshedKey)
+				MeshCache::WriteKey(MeshCache::GetCachePath(mesh->filename), *mesh->refreshedKey);
+		}
+	}
+
+	std::string GetTextureName(uint32_t texture) override
+	{
+		return TextureCache::GetTextureName(texture);
+	}
+
+	bool FindMeshPrimitive(const MeshRenderer& meshRenderer, uint32_t& source, uint32_t& primitive) override
+	{
+		const MeshPrimitive* found = mScene->findMeshPrimitive(&meshRenderer);
+		if (found)
+		{
+			source = found->source;
+			primitive = found->primitive;
+		}
+		return found != nullptr;
+	}
+
+	const MeshSource& GetMeshSource(uint32_t source) override
+	{
+		return mScene->mMeshSources[source];
+	}
+
+	uint32_t LoadTexture(const std::string& name) override
+	{
+		return TextureCache::LoadTexture(name);
+	}
+
+	void LoadMeshSource(uint32_t index, const MeshSource& source) override
+	{
+		if (index >= mMeshes.size())
+			mMeshes.resize(index + 1);
+
+		SnapshotMesh& mesh = *(mMeshes[index] = std::make_unique<SnapshotMesh>());
+		mesh.filename = source.filename;
+		if (mesh.filename.empty())
+			return;
+
+		mesh.loaded = loadMeshGeometry(mesh.filename, source.options, mesh.cacheFile, mesh.data, mesh.view, mesh.refreshedKey);
+		if (mesh.loaded)
+			mScene->createMeshBuffers(mesh.view, mScene->addMeshSource(mesh.filename, source.options), mesh.buffers);
+		else
+			Logger::Warn("Failed to load the mesh of the snapshot: " + mesh.filename);
+	}
+
+	bool SetMeshGeometry(uint32_t source, uint32_t primitive, MeshRenderer& meshRenderer) override
+	{
+		const SnapshotMesh* mesh = source < mMeshes.size() ? mMeshes[source].get() : nullptr;
+		if (mesh && mesh->filename.empty())
+		{
+			// Built-in primitives are indexed in the creation order of the default entities
+			const std::array<ecs::Entity, 3> prefabs = { mScene->mCube, mScene->mSphere, mScene->mPlane };
+			if (primitive >= prefabs.size())
+				return false;
+			meshRenderer = *mScene->mComponentManager->GetComponent<MeshRenderer>(prefabs[primitive]);
+			return true;
+		}
+
+		if (mesh == nullptr || !mesh->loaded || primitive >= mesh->view.primitives.count)
+			return false;
+		setMeshGeometry(meshRenderer, mesh->view, mesh->view.primitives[primitive], mesh->buffers);
+		return true;
+	}
+
+private:
+	// The views point into the cache files until the renderers are created
+	struct SnapshotMesh
+	{
+		std::string filename;
+		MappedFile cacheFile;
+		MeshCache::Data data;
+		MeshCache::View view;
+		std::optional<MeshCache::SourceKey> refreshedKey;
+		gfx::BufferHandle buffers[PendingMesh::StreamCount];
+		bool loaded = false;
+	};
+
+	Scene* mScene;
+	std::vector<std::unique_ptr<SnapshotMesh>> mMeshes;
+};
+
+bool Scene::SaveSnapshot(const std::string& filename)
+{
+	// Default entities are created by the scene itself
+	SnapshotResolver resolver(this);
+	return SceneSnapshot::Save(filename, *mComponentManager, resolver, { mSun, mCube, mSphere, mPlane });
+}
+
+bool Scene::LoadSnapshot(const std::string& filename)
+{
+	SnapshotResolver resolver(this);
+	return SceneSnapshot::Load(filename, *mComponentManager, resolver);
+}
+
+/*
+* Cooked mesh is used in place when it's written from the same source by the same importer,
+* the cache file is left open in that case. Otherwise the source is imported into data, the
+* model keeps the images decoded by the gltf loader and the cache is written again.
+*/
+static bool loadMeshView(const std::string& filename, const MeshCache::ImportOptions& options, MappedFile& cacheFile, MeshCache::Data& data, MeshCache::View& view,
+	tinygltf::Model& model, std::vector<uint32_t>& textureImages, std::optional<MeshCache::SourceKey>& refreshedKey)
+{
+	const std::string cachePath = MeshCache::GetCachePath(filename);
+	MeshCache::SourceKey cachedKey;
+	MeshCache::SourceKey sourceKey;
+	if (std::ifstream(cachePath).good() && cacheFile.Open(cachePath) && MeshCache::Read(cacheFile, cachedKey, view) &&
+		MeshCache::MatchSource(filename, options, view, cachedKey, sourceKey))
+	{
+		// Source is touched but not changed, the key is rewritten once the cache is closed
+		if (sourceKey.stamp != cachedKey.stamp)
+			refreshedKey = sourceKey;
+		return true;
+	}
+	// Stale cache is overwritten
+	cacheFile.Close();
+
+	if (!gltfMesh::loadFile(filename, &model))
+		return false;
+
+	ImportStatistics statistics;
+	textureImages = parseModel(&model, options, data, statistics);
+	logStatistics(filename, statistics);
+	view = data.GetView();
+	if (MeshCache::KeySource(filename, options, view, sourceKey))
+		MeshCache::Write(cachePath, sourceKey, view);
+	return true;
+}
+
+bool Scene::loadMeshGeometry(const std::string& filename, const MeshCache::ImportOptions& options, MappedFile& cacheFile, MeshCache::Data& data, MeshCache::View& view,
+	std::optional<MeshCache::SourceKey>& refreshedKey)
+{
+	tinygltf::Model model;
+	std::vector<uint32_t> textureImages;
+	return loadMeshView(filename, options, cacheFile, data, view, model, textureImages, refreshedKey);
+}
+
+ecs::Entity Scene::CreateMesh(const std::string& filename, const MeshCache::ImportOptions& options)
+{
+	Logger::Debug("Loading Mesh: " + filename);
+	Timer timer;
+
+	std::string name = filename.substr(filename.find_last_of("/\\") + 1, filename.size() - 1);
+	name = name.substr(0, name.find_last_of('.'));
+
+	MappedFile cacheFile;
+	MeshCache::Data data;
+	MeshCache::View view;
+	tinygltf::Model model;
+	std::vector<uint32_t> textureImages;
+	std::optional<MeshCache::SourceKey> refreshedKey;
+	if (!loadMeshView(filename, options, cacheFile, data, view, model, textureImages, refreshedKey))
+		return ecs::INVALID_ENTITY;
+
+	const uint32_t source = addMeshSource(filename, options);
+	if (cacheFile.IsOpen())
+	{
+		ecs::Entity entity = instantiateMesh(view, source, loadTextures(filename, view));
+		mComponentManager->GetComponent<NameComponent>(entity)->name = name;
+		cacheFile.Close();
+		if (refreshedKey)
+			MeshCache::WriteKey(MeshCache::GetCachePath(filename), *refreshedKey);
+		Logger::Info("Loaded " + name + " from the mesh cache in " + std::to_string(timer.elapsedMilliseconds()) + "ms");
+		return entity;
 	}
 
-	auto hierarchyComponent = mComponentManager->GetComponent<HierarchyComponent>(entity);
-	if (hierarchyComponent) {
-		for (auto child : hierarchyComponent->childrens)
-			updateMeshRenderer(vertexBuffer, indexBuffer, meshletBuffer, meshletVertexBuffer, meshletTriangleBuffer, child);
+	// Images are already decoded by the gltf loader
+	std::vector<uint32_t> textureIds(textureImages.size());
+	for (std::size_t i = 0; i < textureImages.size(); ++i)
+	{
+		tinygltf::Image& image = model.images[textureImages[i]];
+		const MeshCache::Texture& texture = view.textures[i];
+		const std::string textureName(view.GetString(texture.name, texture.nameLength));
+		textureIds[i] = TextureCache::LoadTexture(textureName, image.width, image.height, image.image.data(), image.component, true);
 	}
+
+	ecs::Entity entity = instantiateMesh(view, source, textureIds);
+	mComponentManager->GetComponent<NameComponent>(entity)->name = name;
+	Logger::Info("Imported " + name + " in " + std::to_string(timer.elapsedMilliseconds()) + "ms");
+	return entity;
 }
 
-ecs::Entity Scene::CreateMesh(const std::string& filename)
+ecs::Entity Scene::CreateMeshAsync(const std::string& filename, const MeshCache::ImportOptions& options)
 {
 	Logger::Debug("Loading Mesh: " + filename);
+
+	std::string name = filename.substr(filename.find_last_of("/\\") + 1, filename.size() - 1);
+	name = name.substr(0, name.find_last_of('.'));
+
+	auto mesh = std::make_unique<PendingMesh>();
+	mesh->filename = filename;
+	mesh->options = options;
+	mesh->root = createEntity(name);
+
+	// Dedicated thread, a job would be picked up by the main thread waiting on the job system
+	mesh->loader = std::async(std::launch::async, &Scene::loadPendingMesh, mesh.get());
+
+	ecs::Entity root = mesh->root;
+	mPendingMeshes.push_back(std::move(mesh));
+	return root;
+}
+
+bool Scene::loadPendingMesh(PendingMesh* mesh)
+{
 	tinygltf::Model model;
-	if (gltfMesh::loadFile(filename, &model))
+	std::vector<uint32_t> textureImages;
+	if (!loadMeshView(mesh->filename, mesh->options, mesh->cacheFile, mesh->data, mesh->view, model, textureImages, mesh->refreshedKey))
+		return false;
+
+	if (mesh->cacheFile.IsOpen())
+		mesh->images.resize(mesh->view.textures.count);
+	else
+	{
+		// Images are already decoded by the gltf loader
+		mesh->images.resize(textureImages.size());
+		for (std::size_t i = 0; i < textureImages.size(); ++i)
+		{
+			tinygltf::Image& image = model.images[textureImages[i]];
+			PendingMesh::Image& out = mesh->images[i];
+			out.width = image.width;
+			out.height = image.height;
+			out.storage = std::move(image.image);
+			out.pixels = out.storage.data();
+		}
+		mesh->decodedImages.store(static_cast<uint32_t>(textureImages.size()), std::memory_order_relaxed);
+	}
+	mesh->geometryReady.store(true, std::memory_order_release);
+
+	// One image at a time, the decoded ones are uploaded meanwhile
+	const MeshCache::View& view = mesh->view;
+	const std::string directory = mesh->filename.substr(0, mesh->filename.find_last_of("/\\") + 1);
+	for (uint32_t i = mesh->decodedImages.load(std::memory_order_relaxed); i < mesh->images.size(); ++i)
+	{
+		if (mesh->cancelled.load(std::memory_order_relaxed))
+			return false;
+
+		PendingMesh::Image& image = mesh->images[i];
+		image.pixels = decodeTexture(directory, view, view.textures[i], image.width, image.height);
+		image.loaded = view.textures[i].source != MeshCache::TextureSource::Raw;
+		mesh->decodedImages.store(i + 1, std::memory_order_release);
+	}
+
+	// Triangles for the ray casts, added to the scene with the index buffer
+	mesh->meshBVHs.resize(view.primitives.count);
+	for (std::size_t i = 0; i < view.primitives.count; ++i)
+	{
+		if (mesh->cancelled.load(std::memory_order_relaxed))
+			return false;
+
+		buildMeshBVH(view, view.primitives[i], mesh->meshBVHs[i]);
+	}
+	return true;
+}
+
+void Scene::PendingMesh::Image::Free()
+{
+	if (loaded)
+		Utils::ImageLoader::Free(pixels);
+	storage = {};
+	pixels = nullptr;
+	loaded = false;
+}
+
+void Scene::updatePendingMeshes()
+{
+	// Meshes are streamed in the request order, the first one gets the staging space first
+	for (auto it = mPendingMeshes.begin(); it != mPendingMeshes.end();)
+	{
+		if (updatePendingMesh(**it))
+		{
+			++it;
+			continue;
+		}
+
+		// Key is rewritten once the cache isn't mapped anymore
+		PendingMesh& mesh = **it;
+		mesh.cacheFile.Close();
+		if (mesh.refreshedKey)
+			MeshCache::WriteKey(MeshCache::GetCachePath(mesh.filename), *mesh.refreshedKey);
+		it = mPendingMeshes.erase(it);
+	}
+}
+
+bool Scene::updatePendingMesh(PendingMesh& mesh)
+{
+	const bool loaded = mesh.loader.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	if (!ecs::IsAlive(mesh.root))
+	{
+		// Root is destroyed while loading, the loader stops at the next image
+		mesh.cancelled.store(true, std::memory_order_relaxed);
+		if (!loaded)
+			return true;
+
+		for (PendingMesh::Image& image : mesh.images)
+			image.Free();
+		return false;
+	}
+
+	if (!mesh.geometryReady.load(std::memory_order_acquire))
+	{
+		if (!loaded)
+			return true;
+
+		Logger::Warn("Failed to load mesh: " + mesh.filename);
+		DestroyHierarchy(mesh.root);
+		return false;
+	}
+
+	const MeshCache::View& view = mesh.view;
+	if (!mesh.buffersCreated)
 	{
 		gfx::GraphicsDevice* device = gfx::GetDevice();
-		ecs::Entity entity = parseModel(&model);
-		std::string name = filename.substr(filename.find_last_of("/\\") + 1, filename.size() - 1);
-		name = name.substr(0, name.find_last_of('.'));
+		auto createStream = [&](PendingMesh::Stream stream, const void* data, std::size_t size, gfx::BindFlag bindFlag) {
+			gfx::GPUBufferDesc bufferDesc;
+			bufferDesc.bindFlag = bindFlag;
+			bufferDesc.usage = gfx::Usage::Default;
+			bufferDesc.size = static_cast<uint32_t>(size);
+
+			PendingMesh::StreamUpload& upload = mesh.streams[stream];
+			upload.data = static_cast<const uint8_t*>(data);
+			upload.size = bufferDesc.size;
+			upload.buffer = device->CreateBuffer(&bufferDesc);
+			mAllocatedBuffers.push_back(upload.buffer);
+		};
+
+		createStream(PendingMesh::VertexStream, view.GetVertexData(), view.GetVertexByteSize(), gfx::BindFlag::ShaderResource);
+		createStream(PendingMesh::IndexStream, view.GetIndexData(), view.GetIndexByteSize(), gfx::BindFlag::IndexBuffer);
+		createStream(PendingMesh::MeshletStream, view.meshlets.data, view.meshlets.GetByteSize(), gfx::BindFlag::ShaderResource);
+		createStream(PendingMesh::MeshletVertexStream, view.meshletVertices.data, view.meshletVertices.GetByteSize(), gfx::BindFlag::ShaderResource);
+		createStream(PendingMesh::MeshletTriangleStream, view.meshletTriangles.data, view.meshletTriangles.GetByteSize(), gfx::BindFlag::ShaderResource);
+		addMeshPrimitives(mesh.streams[PendingMesh::IndexStream].buffer, addMeshSource(mesh.filename, mesh.options), view.primitives);
+		mesh.textureIds.assign(mesh.images.size(), gfx::INVALID_TEXTURE_ID);
+		mesh.entities.assign(view.nodes.count, ecs::INVALID_ENTITY);
+		mesh.buffersCreated = true;
+	}
 
-		mComponentManager->GetComponent<NameComponent>(entity)->name = name;
+	// Staging space of the frame is shared in proportion to what each stream has left
+	uint64_t remaining = 0;
+	for (const PendingMesh::StreamUpload& upload : mesh.streams)
+		remaining += upload.size - upload.uploaded;
 
-		gfx::GPUBufferDesc bufferDesc;
-		bufferDesc.bindFlag = gfx::BindFlag::ShaderResource;
-		bufferDesc.usage = gfx::Usage::Default;
-		bufferDesc.size = static_cast<uint32_t>(mStagingData.vertices.size() * sizeof(Vertex));
+	const uint64_t budget = TransferQueue::GetAvailableSize();
+	for (PendingMesh::StreamUpload& upload : mesh.streams)
+	{
+		const uint32_t left = upload.size - upload.uploaded;
+		if (left == 0)
+			continue;
+
+		const uint32_t share = static_cast<uint32_t>(std::max<uint64_t>(budget * left / remaining, 1));
+		const uint32_t size = std::min({ left, share, TransferQueue::GetAvailableSize() });
+		if (size == 0 || !TransferQueue::CopyToBuffer(upload.buffer, upload.data + upload.uploaded, upload.uploaded, size))
+			break;
+		upload.uploaded += size;
+	}
 
-		// Vertex Buffer
-		gfx::BufferHandle vertexBuffer = device->CreateBuffer(&bufferDesc);
-		mAllocatedBuffers.push_back(vertexBuffer);
-		device->CopyToBuffer(vertexBuffer, mStagingData.vertices.data(), 0, bufferDesc.size);
+	commitPendingNodes(mesh);
+	if (mesh.committedNodes < view.nodes.count)
+		return true;
 
-		// Meshlet buffer
-		bufferDesc.size = static_cast<uint32_t>(mStagingData.meshlets.size() * sizeof(Meshlet));
-		gfx::BufferHandle meshletBuffer = device->CreateBuffer(&bufferDesc);
-		mAllocatedBuffers.push_back(meshletBuffer);
-		device->CopyToBuffer(meshletBuffer, mStagingData.meshlets.data(), 0, bufferDesc.size);
+	// Textures follow the geometry, the materials are patched as they arrive
+	const uint32_t decodedImages = mesh.decodedImages.load(std::memory_order_acquire);
+	const uint32_t firstTexture = mesh.uploadedTextures;
+	for (; mesh.uploadedTextures < decodedImages; ++mesh.uploadedTextures)
+	{
+		PendingMesh::Image& image = mesh.images[mesh.uploadedTextures];
+		const MeshCache::Texture& texture = view.textures[mesh.uploadedTextures];
+		const std::string name(view.GetString(texture.name, texture.nameLength));
+		if (!TextureCache::LoadTextureAsync(name, image.width, image.height, image.pixels, 4, true, mesh.textureIds[mesh.uploadedTextures]))
+			break;
+		image.Free();
+	}
 
-		// Meshlet vertex buffer
-		bufferDesc.size = static_cast<uint32_t>(mStagingData.meshletVertices.size() * sizeof(uint32_t));
-		gfx::BufferHandle meshletVertexBuffer = device->CreateBuffer(&bufferDesc);
-		mAllocatedBuffers.push_back(meshletVertexBuffer);
-		device->CopyToBuffer(meshletVertexBuffer, mStagingData.meshletVertices.data(), 0, bufferDesc.size);
+	if (mesh.uploadedTextures != firstTexture)
+	{
+		for (std::size_t i = 0; i < view.nodes.count; ++i)
+		{
+			const uint32_t primitive = view.nodes[i].primitive;
+			if (primitive == MeshCache::kInvalidIndex || view.primitives[primitive].material == MeshCache::kInvalidIndex || !ecs::IsAlive(mesh.entities[i]))
+				continue;
 
-		// Meshlet index buffer
-		bufferDesc.size = static_cast<uint32_t>(mStagingData.meshletTriangles.size() * sizeof(uint8_t));
-		gfx::BufferHandle meshletTriangleBuffer = device->CreateBuffer(&bufferDesc);
-		mAllocatedBuffers.push_back(meshletTriangleBuffer);
-		device->CopyToBuffer(meshletTriangleBuffer, mStagingData.meshletTriangles.data(), 0, bufferDesc.size);
+			MaterialComponent* material = mComponentManager->GetComponent<MaterialComponent>(mesh.entities[i]);
+			if (material == nullptr)
+				continue;
 
-		bufferDesc.bindFlag = gfx::BindFlag::IndexBuffer;
-		bufferDesc.size = static_cast<uint32_t>(mStagingData.indices.size() * sizeof(uint32_t));
+			remapTextures(*material, view.materials[view.primitives[primitive].material], mesh.textureIds, mesh.uploadedTextures);
+			mComponentManager->MarkModified<MaterialComponent>(mesh.entities[i]);
+		}
+	}
 
-		gfx::BufferHandle indexBuffer = device->CreateBuffer(&bufferDesc);
-		mAllocatedBuffers.push_back(indexBuffer);
-		device->CopyToBuffer(indexBuffer, mStagingData.indices.data(), 0, bufferDesc.size);
+	if (!loaded || mesh.uploadedTextures < mesh.images.size())
+		return true;
 
-		// Update all the mesh component recursively
-		updateMeshRenderer(vertexBuffer, indexBuffer, meshletBuffer, meshletVertexBuffer, meshletTriangleBuffer, entity);
+	if (mesh.loader.get())
+		addMeshBVHs(mesh.streams[PendingMesh::IndexStream].buffer, view.primitives, mesh.meshBVHs);
 
-		// clear the staging data
-		mStagingData.clear();
+	const std::string& name = mComponentManager->GetComponent<NameComponent>(mesh.root)->name;
+	Logger::Info("Streamed " + name + " in " + std::to_string(mesh.timer.elapsedMilliseconds()) + "ms");
+	return false;
+}
 
-		return entity;
+void Scene::commitPendingNodes(PendingMesh& mesh)
+{
+	const MeshCache::View& view = mesh.view;
+	auto isUploaded = [&](PendingMesh::Stream stream, uint64_t end) { return end <= mesh.streams[stream].uploaded; };
+
+	gfx::BufferHandle buffers[PendingMesh::StreamCount];
+	for (uint32_t i = 0; i < PendingMesh::StreamCount; ++i)
+		buffers[i] = mesh.streams[i].buffer;
+
+	// Nodes are committed in order once the ranges of the primitive are uploaded, parents come first
+	for (; mesh.committedNodes < view.nodes.count; ++mesh.committedNodes)
+	{
+		const MeshCache::Node& node = view.nodes[mesh.committedNodes];
+		const MeshCache::Primitive* primitive = node.primitive != MeshCache::kInvalidIndex ? &view.primitives[node.primitive] : nullptr;
+		if (primitive)
+		{
+			// Simplified levels are written after LOD 0, the last level ends the ranges of the primitive
+			const MeshLod& lod = view.lods[primitive->lodOffset + primitive->lodCount - 1];
+			bool ready = isUploaded(PendingMesh::VertexStream, (uint64_t(primitive->vertexOffset) + primitive->vertexCount) * view.GetVertexStride()) &&
+				isUploaded(PendingMesh::IndexStream, (uint64_t(lod.indexOffset) + lod.indexCount) * gfx::GetIndexSize(view.GetIndexType())) &&
+				isUploaded(PendingMesh::MeshletStream, (uint64_t(lod.meshletOffset) + lod.meshletCount) * sizeof(Meshlet));
+			if (ready && lod.meshletCount > 0)
+			{
+				const Meshlet& last = view.meshlets[lod.meshletOffset + lod.meshletCount - 1];
+				ready = isUploaded(PendingMesh::MeshletVertexStream, (uint64_t(last.vertexOffset) + last.vertexCount) * sizeof(uint32_t)) &&
+					isUploaded(PendingMesh::MeshletTriangleStream, uint64_t(last.triangleOffset) + last.triangleCount * 3);
+			}
+			if (!ready)
+				break;
+		}
+
+		// Subtree destroyed by the user is skipped
+		ecs::Entity parent = node.parent != MeshCache::kInvalidIndex ? mesh.entities[node.parent] : ecs::INVALID_ENTITY;
+		if (node.parent != MeshCache::kInvalidIndex && !ecs::IsAlive(parent))
+			continue;
+
+		// First node is the entity returned by CreateMeshAsync, it keeps the name and the transform
+		ecs::Entity entity = mesh.root;
+		if (mesh.committedNodes > 0)
+		{
+			entity = createEntity(std::string(view.GetString(node.name, node.nameLength)));
+			TransformComponent* transform = mComponentManager->GetComponent<TransformComponent>(entity);
+			transform->position = node.position;
+			transform->rotation = node.rotation;
+			transform->scale = node.scale;
+		}
+		mesh.entities[mesh.committedNodes] = entity;
+
+		if (primitive)
+		{
+			addMeshRenderer(entity, view, *primitive, buffers);
+
+			MaterialComponent& material = mComponentManager->AddComponent<MaterialComponent>(entity);
+			if (primitive->material != MeshCache::kInvalidIndex)
+			{
+				material = view.materials[primitive->material];
+				remapTextures(material, view.materials[primitive->material], mesh.textureIds, mesh.uploadedTextures);
+			}
+		}
+
+		if (parent != ecs::INVALID_ENTITY)
+			AddChild(parent, entity);
 	}
-	return ecs::INVALID_ENTITY;
 }
 
 
 void Scene::RemoveChild(ecs::Entity parent, ecs::Entity child)
 {
 	auto comp = mComponentManager->GetComponent<HierarchyComponent>(parent);
-	if (comp->RemoveChild(child))
-		Logger::Info("Children Removed of Id: " + std::to_string(child));
-	else
+	if (comp == nullptr || !comp->RemoveChild(child))
 		Logger::Warn("No Children of Id: " + std::to_string(child));
+	else
+		mComponentManager->MarkModified<HierarchyComponent>(parent);
 }
 
 void Scene::AddChild(ecs::Entity parent, ecs::Entity child)
@@ -620,22 +1906,27 @@ void Scene::AddChild(ecs::Entity parent, ecs::Entity child)
 		parentHierarchyComponent = &mComponentManager->AddComponent<HierarchyComponent>(parent);
 
 	parentHierarchyComponent->childrens.push_back(child);
+	mComponentManager->MarkModified<HierarchyComponent>(parent);
 
 }
 
 void Scene::initializePrimitiveMesh()
 {
-	// Careful create all entity and add component first and then upload the data
-	// to prevent the invalidation of refrence when container is resized
+	// MeshRenderer uses chunked storage so the references stay valid
+	// while the other primitives are added
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	std::array<MeshRenderer*, 3> primitives;
+	std::vector<MeshCache::Primitive> ranges;
 
 	{
 		mCube = ecs::CreateEntity();
 		mComponentManager->AddComponent<NameComponent>(mCube).name = "Cube";
 		MeshRenderer& meshRenderer = mComponentManager->AddComponent<MeshRenderer>(mCube);
+		primitives[0] = &meshRenderer;
 		meshRenderer.SetRenderable(false);
 		InitializeCubeMesh(vertices, indices);
+		ranges.push_back({ 0, (uint32_t)vertices.size(), 0, (uint32_t)indices.size() });
 		meshRenderer.vertexBuffer.byteOffset = 0;
 		meshRenderer.vertexBuffer.byteLength = static_cast<uint32_t>(vertices.size() * sizeof(Vertex));
 		meshRenderer.indexBuffer.byteOffset = 0;
@@ -651,8 +1942,10 @@ void Scene::initializePrimitiveMesh()
 		mSphere = ecs::CreateEntity();
 		mComponentManager->AddComponent<NameComponent>(mSphere).name = "Sphere";
 		MeshRenderer& meshRenderer = mComponentManager->AddComponent<MeshRenderer>(mSphere);
+		primitives[1] = &meshRenderer;
 		meshRenderer.SetRenderable(false);
 		InitializeSphereMesh(vertices, indices);
+		ranges.push_back({ vertexOffset, (uint32_t)vertices.size() - vertexOffset, indexOffset, (uint32_t)indices.size() - indexOffset });
 		meshRenderer.vertexBuffer.byteOffset = vertexOffset * sizeof(Vertex);
 		meshRenderer.vertexBuffer.byteLength = static_cast<uint32_t>((vertices.size() - vertexOffset) * sizeof(Vertex));
 		meshRenderer.indexBuffer.byteOffset = indexOffset * sizeof(uint32_t);
@@ -668,8 +1961,10 @@ void Scene::initializePrimitiveMesh()
 		mPlane = ecs::CreateEntity();
 		mComponentManager->AddComponent<NameComponent>(mPlane).name = "Plane";
 		MeshRenderer& meshRenderer = mComponentManager->AddComponent<MeshRenderer>(mPlane);
+		primitives[2] = &meshRenderer;
 		meshRenderer.SetRenderable(false);
 		InitializePlaneMesh(vertices, indices);
+		ranges.push_back({ vertexOffset, (uint32_t)vertices.size() - vertexOffset, indexOffset, (uint32_t)indices.size() - indexOffset });
 		meshRenderer.vertexBuffer.byteOffset = vertexOffset * sizeof(Vertex);
 		meshRenderer.vertexBuffer.byteLength = static_cast<uint32_t>((vertices.size() - vertexOffset) * sizeof(Vertex));
 		meshRenderer.indexBuffer.byteOffset = indexOffset * sizeof(uint32_t);
@@ -699,15 +1994,18 @@ void Scene::initializePrimitiveMesh()
 	mAllocatedBuffers.push_back(indexBuffer);
 	device->CopyToBuffer(indexBuffer, indices.data(), 0, indexSize);
 
-	auto updateBuffers = [&](ecs::Entity entity, gfx::BufferHandle vertexBuffer, gfx::BufferHandle indexBuffer) {
-		MeshRenderer* meshRenderer = mComponentManager->GetComponent<MeshRenderer>(entity);
+	for (MeshRenderer* meshRenderer : primitives)
+	{
 		meshRenderer->vertexBuffer.buffer = vertexBuffer;
 		meshRenderer->indexBuffer.buffer = indexBuffer;
-	};
+	}
 
-	updateBuffers(mCube, vertexBuffer, indexBuffer);
-	updateBuffers(mSphere, vertexBuffer, indexBuffer);
-	updateBuffers(mPlane, vertexBuffer, indexBuffer);
+	MeshCache::View view;
+	view.vertices = { vertices.data(), vertices.size() };
+	view.indices = { indices.data(), indices.size() };
+	view.primitives = { ranges.data(), ranges.size() };
+	addMeshPrimitives(indexBuffer, addMeshSource("", {}), view.primitives);
+	buildMeshBVHs(indexBuffer, view);
 }
 
 
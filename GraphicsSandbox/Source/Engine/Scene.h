@@ -4,20 +4,36 @@
 #include "Components.h"
 #include "EnvironmentMap.h"
 #include "Camera.h"
-
+#include "TransformStore.h"
+#include "TransformHierarchy.h"
+#include "AABBTree.h"
+#include "MeshBVH.h"
+#include "MeshCache.h"
+#include "SceneSnapshot.h"
+#include "MappedFile.h"
+#include "Timer.h"
+
+#include <array>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <optional>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
-namespace tinygltf {
-	class Model;
-	struct Scene;
-	struct Mesh;
-};
-
 namespace ui {
 	class SceneHierarchy;
 };
 
+struct RayHit
+{
+	ecs::Entity entity = ecs::INVALID_ENTITY;
+	float distance = 0.0f;
+	glm::vec3 position;
+	glm::vec3 normal;
+};
+
 class Scene
 {
 public:
@@ -36,7 +52,15 @@ public:
 	}
 
 	ecs::Entity GetSun() { return mSun; }
-	ecs::Entity CreateMesh(const std::string& filename);
+	// Import statistics are logged when the mesh cache is rebuilt
+	ecs::Entity CreateMesh(const std::string& filename, const MeshCache::ImportOptions& options = {});
+
+	/*
+	* Returns an empty entity at once and loads the mesh on a background
+	* thread. Buffers and textures are streamed through the transfer queue
+	* and the nodes are added under the entity as their primitives arrive.
+	*/
+	ecs::Entity CreateMeshAsync(const std::string& filename, const MeshCache::ImportOptions& options = {});
 	ecs::Entity CreateLight(std::string_view name = "");
 
 	ecs::Entity CreateCube(std::string_view name);
@@ -45,11 +69,19 @@ public:
 
 	void LoadEnvMap(const std::string& name);
 
+	// Binary snapshot of the scene entities, loaded entities are added to the scene
+	bool SaveSnapshot(const std::string& filename);
+	bool LoadSnapshot(const std::string& filename);
+
 	void Update(float dt);
 
+	// Create or replace the GPU resources requested by the UI, the render thread has to be idle
+	void UpdateResources();
+
 	void SetSize(int width, int height);
 
-	void Destroy(ecs::Entity entity);
+	// Destroy the entity along with all the children in the hierarchy
+	void DestroyHierarchy(ecs::Entity entity);
 
 	void AddUI();
 
@@ -59,6 +91,24 @@ public:
 
 	inline std::unique_ptr<EnvironmentMap>& GetEnvironmentMap() { return mEnvMap; }
 
+	// World bounds of the mesh renderers, user data of the proxies is the entity
+	const AABBTree& GetBoundsTree() const { return mBoundsTree; }
+
+	/*
+	* Mesh renderers intersecting the frustum in the group order. With a
+	* light direction the planes the light enters through are ignored so
+	* the shadow casters outside the frustum are kept. Planes are pushed
+	* out by margin.
+	*/
+	void QueryVisible(const Frustum& frustum, const glm::vec3* lightDirection, std::vector<ecs::Entity>& out, float margin = 0.0f);
+
+	/*
+	* Closest renderable mesh hit by the ray. Candidates are found with the
+	* bounds tree and the triangles are tested with the BVH of the mesh,
+	* meshes without the CPU copy of the triangles are tested by the bounds.
+	*/
+	bool RayCast(const Ray& ray, RayHit& hit, float maxDistance = FLT_MAX);
+
 	std::vector<ecs::Entity> FindChildren(ecs::Entity entity);
 
 	void Shutdown();
@@ -76,54 +126,127 @@ private:
 	bool mShowBoundingBox = false;
 
 	std::shared_ptr<ecs::ComponentManager> mComponentManager;
+	TransformStore mTransformStore;
+	TransformHierarchy mTransformHierarchy;
+	AABBTree mBoundsTree;
+	ecs::SparseIndex mBoundsProxies;
+	// Triangle BVH of the meshes, keyed by the index buffer and the first index
+	std::unordered_map<uint64_t, MeshBVH> mMeshBVHs;
+
+	using MeshSource = SceneSnapshot::MeshSource;
+	struct MeshPrimitive
+	{
+		uint32_t source;
+		uint32_t primitive;
+	};
+	std::vector<MeshSource> mMeshSources;
+	// Source of the mesh ranges, keyed like the BVHs so the snapshots can store them
+	std::unordered_map<uint64_t, MeshPrimitive> mMeshPrimitives;
 	std::unique_ptr<EnvironmentMap> mEnvMap;
 	std::vector<gfx::BufferHandle> mAllocatedBuffers;
 
-	void GenerateDrawData(std::vector<DrawData>& opaque, std::vector<DrawData>& transparent);
+	// Mesh loaded by a background thread and committed by UpdateResources()
+	struct PendingMesh
+	{
+		enum Stream
+		{
+			VertexStream = 0,
+			IndexStream,
+			MeshletStream,
+			MeshletVertexStream,
+			MeshletTriangleStream,
+			StreamCount
+		};
+
+		struct StreamUpload
+		{
+			const uint8_t* data = nullptr;
+			uint32_t size = 0;
+			uint32_t uploaded = 0;
+			gfx::BufferHandle buffer;
+		};
+
+		struct Image
+		{
+			int width = 0;
+			int height = 0;
+			uint8_t* pixels = nullptr;
+			// Pixels decoded by the gltf loader, other images are freed with the image loader
+			std::vector<uint8_t> storage;
+			bool loaded = false;
+
+			void Free();
+		};
+
+		std::string filename;
+		MeshCache::ImportOptions options;
+		ecs::Entity root = ecs::INVALID_ENTITY;
+		Timer timer;
+		std::atomic<bool> cancelled{ false };
+
+		// Written by the loader, the view and the images are read once the counters are published
+		std::future<bool> loader;
+		std::atomic<bool> geometryReady{ false };
+		std::atomic<uint32_t> decodedImages{ 0 };
+		MappedFile cacheFile;
+		// Set when only the stamp of the source changed
+		std::optional<MeshCache::SourceKey> refreshedKey;
+		MeshCache::Data data;
+		MeshCache::View view;
+		std::vector<Image> images;
+		std::vector<MeshBVH> meshBVHs;
+
+		// Upload state, only touched by the main thread
+		std::array<StreamUpload, StreamCount> streams;
+		bool buffersCreated = false;
+		uint32_t committedNodes = 0;
+		uint32_t uploadedTextures = 0;
+		std::vector<uint32_t> textureIds;
+		std::vector<ecs::Entity> entities;
+	};
+	std::vector<std::unique_ptr<PendingMesh>> mPendingMeshes;
+
+	void GenerateDrawData(const std::vector<ecs::Entity>& entities, std::vector<DrawData>& opaque, std::vector<DrawData>& transparent);
 	void GenerateSkinnedMeshDrawData(std::vector<DrawData>& opaque, std::vector<DrawData>& transparent);
 
 	void UpdateTransform();
 	void UpdateHierarchy();
-
-	void UpdateChildren(ecs::Entity entity, const glm::mat4& parentTransform);
+	void UpdateBounds();
 
 	void DrawBoundingBox();
 	void InitializeLights();
-	void GenerateMeshData(ecs::Entity entity, IMeshRenderer* meshRenderer, std::vector<DrawData>& opaque, std::vector<DrawData>& transparent);
+	bool CreateDrawData(ecs::Entity entity, IMeshRenderer* meshRenderer, TransformComponent* transform, MaterialComponent* material, DrawData& drawData);
+	void GenerateMeshData(ecs::Entity entity, IMeshRenderer* meshRenderer, TransformComponent* transform, MaterialComponent* material, std::vector<DrawData>& opaque, std::vector<DrawData>& transparent);
 	void RemoveChild(ecs::Entity parent, ecs::Entity child);
 	void AddChild(ecs::Entity parent, ecs::Entity child);
 
-	// Helpers for gltf mesh
-	struct StagingData {
-		std::vector<Vertex> vertices;
-		//@TODO remove indices and corresponding buffer
-		std::vector<unsigned int> indices;
-
-		std::vector<unsigned int> meshletVertices;
-		std::vector<uint8_t> meshletTriangles;
-		std::vector<Meshlet> meshlets;
-
-		void clear() {
-			vertices.clear();
-			indices.clear();
-			meshletTriangles.clear();
-			meshletVertices.clear();
-			meshlets.clear();
-		}
-	} mStagingData;
-
-	void parseMesh(tinygltf::Model* model, tinygltf::Mesh& mesh, ecs::Entity parent);
-	void parseMaterial(tinygltf::Model* model, MaterialComponent* component, uint32_t matIndex);
-	ecs::Entity parseModel(tinygltf::Model* model);
+	// Geometry of the mesh from the cache, the source is imported and cooked again when the cache is stale
+	static bool loadMeshGeometry(const std::string& filename, const MeshCache::ImportOptions& options, MappedFile& cacheFile, MeshCache::Data& data, MeshCache::View& view,
+		std::optional<MeshCache::SourceKey>& refreshedKey);
+	// Create the entities and the GPU buffers of the mesh, texture slots of the materials are remapped with textureIds
+	ecs::Entity instantiateMesh(const MeshCache::View& view, uint32_t source, const std::vector<uint32_t>& textureIds);
+	// Buffers are indexed by PendingMesh::Stream
+	void createMeshBuffers(const MeshCache::View& view, uint32_t source, gfx::BufferHandle* buffers);
+	void addMeshRenderer(ecs::Entity entity, const MeshCache::View& view, const MeshCache::Primitive& primitive, const gfx::BufferHandle* buffers);
+	static void setMeshGeometry(MeshRenderer& meshRenderer, const MeshCache::View& view, const MeshCache::Primitive& primitive, const gfx::BufferHandle* buffers);
+	void buildMeshBVHs(gfx::BufferHandle indexBuffer, const MeshCache::View& view);
+	void addMeshBVHs(gfx::BufferHandle indexBuffer, MeshCache::Slice<MeshCache::Primitive> primitives, std::vector<MeshBVH>& meshBVHs);
+
+	// Runs on the loader thread
+	static bool loadPendingMesh(PendingMesh* mesh);
+	// Returns false once the mesh is fully committed or cancelled
+	bool updatePendingMesh(PendingMesh& mesh);
+	void commitPendingNodes(PendingMesh& mesh);
+	void updatePendingMeshes();
+	const MeshBVH* findMeshBVH(const IMeshRenderer* meshRenderer) const;
+	uint32_t addMeshSource(const std::string& filename, const MeshCache::ImportOptions& options);
+	void addMeshPrimitives(gfx::BufferHandle indexBuffer, uint32_t source, MeshCache::Slice<MeshCache::Primitive> primitives);
+	const MeshPrimitive* findMeshPrimitive(const IMeshRenderer* meshRenderer) const;
+
 	ecs::Entity createEntity(const std::string& name = "");
-	ecs::Entity parseScene(tinygltf::Model* model, tinygltf::Scene* scene);
-	void parseNodeHierarchy(tinygltf::Model* model, ecs::Entity parent, int nodeIndex);
-	void updateMeshRenderer(gfx::BufferHandle vertexBuffer,
-		gfx::BufferHandle indexBuffer,
-		gfx::BufferHandle meshletBuffer,
-		gfx::BufferHandle meshletVertexBuffer,
-		gfx::BufferHandle meshletTriangleBuffer,
-		ecs::Entity entity);
+
+	// Resolves the textures and the mesh sources of the snapshots
+	class SnapshotResolver;
 
 	void initializePrimitiveMesh();
 
@@ -0,0 +1,652 @@
+#include "SceneSnapshot.h"
+#include "MappedFile.h"
+#include "Logger.h"
+
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <type_traits>
+#include <cstring>
+
+/*
+* Binary snapshot of the scene entities.
+* File is laid out as SnapshotHeader followed by the chunks, every chunk
+* starts with ChunkHeader and its payload is padded to kChunkAlignment.
+* Pool chunks store the slot of the entity in the entity table followed
+* by the component data. Trivially copyable pools are written as a raw
+* block, Name and Hierarchy use a variable length encoding. The texture
+* ids are session dependent so they are remapped while loading. Mesh
+* renderers reference the asset and the primitive they are created from,
+* the geometry is instantiated again by the resolver. The whole file is
+* validated before anything is created.
+*/
+namespace
+{
+	constexpr uint32_t kSnapshotMagic = 0x4e535347; // GSSN
+	constexpr uint32_t kSnapshotVersion = 3;
+	constexpr uint32_t kChunkAlignment = 16;
+	constexpr uint32_t kInvalidSlot = ~0u;
+
+	enum class ChunkType : uint32_t
+	{
+		TextureName = 0,
+		Transform,
+		Light,
+		Material,
+		MeshRenderer,
+		Name,
+		Hierarchy,
+		MeshSource,
+	};
+
+	struct SnapshotHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entityCount;
+		uint32_t chunkCount;
+	};
+
+	struct ChunkHeader
+	{
+		ChunkType type;
+		uint32_t count;
+		uint32_t elementSize;
+		uint32_t reserved;
+		uint64_t byteSize;
+		uint64_t reserved2;
+	};
+	static_assert(sizeof(SnapshotHeader) % kChunkAlignment == 0);
+	static_assert(sizeof(ChunkHeader) % kChunkAlignment == 0);
+
+	// Followed by the path, an empty path is the built-in primitive mesh
+	struct MeshSourceRecord
+	{
+		uint32_t optionFlags;
+		float overdrawThreshold;
+		uint32_t pathLength;
+	};
+
+	// Source is the index in the MeshSource chunk and primitive the one of the cooked mesh
+	struct MeshRendererRecord
+	{
+		uint32_t flags;
+		uint32_t source;
+		uint32_t primitive;
+		uint32_t reserved;
+	};
+
+	// Flags of the MeshRenderer that come from the geometry
+	constexpr uint32_t kGeometryFlags = IMeshRenderer::CompactVertices | IMeshRenderer::ShortIndices;
+
+	enum ImportFlags : uint32_t
+	{
+		ImportVertexCache = 1 << 0,
+		ImportOverdraw = 1 << 1,
+		ImportVertexFetch = 1 << 2,
+		ImportCompactVertices = 1 << 3
+	};
+
+	static_assert(std::is_trivially_copyable_v<TransformComponent>);
+	static_assert(std::is_trivially_copyable_v<LightComponent>);
+	static_assert(std::is_trivially_copyable_v<MaterialComponent>);
+	static_assert(std::is_trivially_copyable_v<MeshSourceRecord>);
+	static_assert(std::is_trivially_copyable_v<MeshRendererRecord>);
+
+	class ChunkWriter
+	{
+	public:
+		template<typename T>
+		void Write(const T* data, std::size_t count)
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+			mPayload.insert(mPayload.end(), bytes, bytes + count * sizeof(T));
+		}
+
+		template<typename T>
+		void Write(const T& value) { Write(&value, 1); }
+
+		void Align()
+		{
+			mPayload.resize((mPayload.size() + kChunkAlignment - 1) / kChunkAlignment * kChunkAlignment, 0);
+		}
+
+		void Flush(std::ofstream& stream, ChunkType type, uint32_t count, uint32_t elementSize)
+		{
+			Align();
+			ChunkHeader header = { type, count, elementSize, 0, mPayload.size(), 0 };
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(ChunkHeader));
+			stream.write(reinterpret_cast<const char*>(mPayload.data()), mPayload.size());
+			mPayload.clear();
+		}
+
+	private:
+		std::vector<uint8_t> mPayload;
+	};
+
+	class ChunkReader
+	{
+	public:
+		ChunkReader(const uint8_t* data, std::size_t size) : mData(data), mSize(size) {}
+
+		template<typename T>
+		const T* Read(std::size_t count)
+		{
+			const std::size_t byteSize = count * sizeof(T);
+			if (mOffset + byteSize > mSize)
+			{
+				mValid = false;
+				return nullptr;
+			}
+			const T* result = reinterpret_cast<const T*>(mData + mOffset);
+			mOffset += byteSize;
+			return result;
+		}
+
+		// Read the value without alignment requirement
+		template<typename T>
+		bool ReadValue(T& value)
+		{
+			const uint8_t* bytes = Read<uint8_t>(sizeof(T));
+			if (bytes)
+				std::memcpy(&value, bytes, sizeof(T));
+			return bytes != nullptr;
+		}
+
+		void Align()
+		{
+			mOffset = (mOffset + kChunkAlignment - 1) / kChunkAlignment * kChunkAlignment;
+		}
+
+		bool IsValid() const { return mValid; }
+
+	private:
+		const uint8_t* mData;
+		std::size_t mSize;
+		std::size_t mOffset = 0;
+		bool mValid = true;
+	};
+
+	// Pool chunk validated by the loader, slots are inside the entity table
+	template<typename T>
+	struct PoolChunk
+	{
+		const uint32_t* slots = nullptr;
+		const T* components = nullptr;
+		uint32_t count = 0;
+	};
+
+	struct HierarchyRecord
+	{
+		uint32_t parent;
+		uint32_t childCount;
+		const uint32_t* children;
+	};
+
+	// Decoded content of the file, nothing is created until the whole file is parsed
+	struct SnapshotContent
+	{
+		std::unordered_map<uint32_t, std::string> textureNames;
+		std::vector<SceneSnapshot::MeshSource> meshSources;
+		PoolChunk<TransformComponent> transforms;
+		PoolChunk<LightComponent> lights;
+		PoolChunk<MaterialComponent> materials;
+		PoolChunk<MeshRendererRecord> meshRenderers;
+		PoolChunk<NameComponent> names;
+		PoolChunk<HierarchyRecord> hierarchies;
+		std::vector<NameComponent> nameComponents;
+		std::vector<HierarchyRecord> hierarchyRecords;
+	};
+}
+
+bool SceneSnapshot::Save(const std::string& filename, ecs::ComponentManager& components, Resolver& resolver, const std::vector<ecs::Entity>& excluded)
+{
+	std::ofstream stream(filename, std::ios::binary);
+	if (!stream)
+	{
+		Logger::Error("Failed to create snapshot: " + filename);
+		return false;
+	}
+
+	auto isExcluded = [&](ecs::Entity entity) {
+		return std::find(excluded.begin(), excluded.end(), entity) != excluded.end();
+	};
+
+	// Assign the slot in the entity table
+	ecs::SparseIndex slotLookup;
+	std::vector<ecs::Entity> entityTable;
+	auto getSlot = [&](ecs::Entity entity) {
+		const uint32_t slot = slotLookup.get(entity);
+		if (slot != ecs::SparseIndex::kInvalidIndex && entityTable[slot] == entity)
+			return slot;
+		return kInvalidSlot;
+	};
+
+	auto addEntity = [&](ecs::Entity entity) {
+		if (getSlot(entity) == kInvalidSlot)
+		{
+			slotLookup.set(entity, static_cast<uint32_t>(entityTable.size()));
+			entityTable.push_back(entity);
+		}
+	};
+
+	auto collect = [&](auto* pool, std::vector<uint32_t>& indices) {
+		for (uint32_t i = 0; i < pool->GetCount(); ++i)
+		{
+			const ecs::Entity entity = pool->entities[i];
+			if (isExcluded(entity))
+				continue;
+			addEntity(entity);
+			indices.push_back(i);
+		}
+	};
+
+	auto writeSlots = [&](ChunkWriter& writer, auto* pool, const std::vector<uint32_t>& indices) {
+		for (uint32_t index : indices)
+			writer.Write(getSlot(pool->entities[index]));
+		writer.Align();
+	};
+
+	auto transforms = components.GetComponentArray<TransformComponent>();
+	auto lights = components.GetComponentArray<LightComponent>();
+	auto materials = components.GetComponentArray<MaterialComponent>();
+	auto meshRenderers = components.GetComponentArray<MeshRenderer>();
+	auto names = components.GetComponentArray<NameComponent>();
+	auto hierarchies = components.GetComponentArray<HierarchyComponent>();
+
+	std::vector<uint32_t> transformIndices, lightIndices, materialIndices, meshRendererIndices, nameIndices, hierarchyIndices;
+	collect(transforms, transformIndices);
+	collect(lights, lightIndices);
+	collect(materials, materialIndices);
+	collect(meshRenderers, meshRendererIndices);
+	collect(names, nameIndices);
+	collect(hierarchies, hierarchyIndices);
+
+	SnapshotHeader header = { kSnapshotMagic, kSnapshotVersion, static_cast<uint32_t>(entityTable.size()), 0 };
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(SnapshotHeader));
+
+	ChunkWriter writer;
+
+	// Texture names are written before the materials that reference it
+	std::vector<uint32_t> textureIds;
+	for (uint32_t index : materialIndices)
+	{
+		for (uint32_t texture : materials->components[index].textures)
+		{
+			if (texture != gfx::INVALID_TEXTURE_ID && std::find(textureIds.begin(), textureIds.end(), texture) == textureIds.end())
+				textureIds.push_back(texture);
+		}
+	}
+
+	for (uint32_t texture : textureIds)
+	{
+		const std::string name = resolver.GetTextureName(texture);
+		writer.Write(texture);
+		writer.Write(static_cast<uint32_t>(name.size()));
+		writer.Write(name.data(), name.size());
+	}
+	writer.Flush(stream, ChunkType::TextureName, static_cast<uint32_t>(textureIds.size()), 0);
+	header.chunkCount++;
+
+	auto writeRawPool = [&](ChunkType type, auto* pool, const std::vector<uint32_t>& indices) {
+		writeSlots(writer, pool, indices);
+		for (uint32_t index : indices)
+			writer.Write(pool->components[index]);
+		using Component = std::decay_t<decltype(pool->components[0])>;
+		writer.Flush(stream, type, static_cast<uint32_t>(indices.size()), sizeof(Component));
+		header.chunkCount++;
+	};
+
+	writeRawPool(ChunkType::Transform, transforms, transformIndices);
+	writeRawPool(ChunkType::Light, lights, lightIndices);
+	writeRawPool(ChunkType::Material, materials, materialIndices);
+
+	// Sources referenced by the mesh renderers are written before them
+	std::vector<MeshRendererRecord> meshRendererRecords;
+	std::unordered_map<uint32_t, uint32_t> sourceSlots;
+	std::vector<uint32_t> sources;
+	for (uint32_t index : meshRendererIndices)
+	{
+		const MeshRenderer& meshRenderer = meshRenderers->components[index];
+		MeshRendererRecord record = { meshRenderer.flags, kInvalidSlot, 0, 0 };
+		uint32_t source = 0;
+		if (resolver.FindMeshPrimitive(meshRenderer, source, record.primitive))
+		{
+			auto inserted = sourceSlots.insert({ source, static_cast<uint32_t>(sources.size()) });
+			if (inserted.second)
+				sources.push_back(source);
+			record.source = inserted.first->second;
+		}
+		meshRendererRecords.push_back(record);
+	}
+
+	for (uint32_t source : sources)
+	{
+		const MeshSource& meshSource = resolver.GetMeshSource(source);
+		const MeshCache::ImportOptions& options = meshSource.options;
+		MeshSourceRecord record = {};
+		record.optionFlags = (options.optimizeVertexCache ? ImportVertexCache : 0u) | (options.optimizeOverdraw ? ImportOverdraw : 0u) |
+			(options.optimizeVertexFetch ? ImportVertexFetch : 0u) | (options.compactVertices ? ImportCompactVertices : 0u);
+		record.overdrawThreshold = options.overdrawThreshold;
+		record.pathLength = static_cast<uint32_t>(meshSource.filename.size());
+		writer.Write(record);
+		writer.Write(meshSource.filename.data(), meshSource.filename.size());
+	}
+	writer.Flush(stream, ChunkType::MeshSource, static_cast<uint32_t>(sources.size()), 0);
+	header.chunkCount++;
+
+	writeSlots(writer, meshRenderers, meshRendererIndices);
+	writer.Write(meshRendererRecords.data(), meshRendererRecords.size());
+	writer.Flush(stream, ChunkType::MeshRenderer, static_cast<uint32_t>(meshRendererIndices.size()), sizeof(MeshRendererRecord));
+	header.chunkCount++;
+
+	// Name: length followed by the characters
+	writeSlots(writer, names, nameIndices);
+	for (uint32_t index : nameIndices)
+	{
+		const std::string& name = names->components[index].name;
+		writer.Write(static_cast<uint32_t>(name.size()));
+		writer.Write(name.data(), name.size());
+	}
+	writer.Flush(stream, ChunkType::Name, static_cast<uint32_t>(nameIndices.size()), 0);
+	header.chunkCount++;
+
+	// Hierarchy: parent slot, child count followed by the child slots
+	writeSlots(writer, hierarchies, hierarchyIndices);
+	std::vector<uint32_t> children;
+	for (uint32_t index : hierarchyIndices)
+	{
+		const HierarchyComponent& hierarchy = hierarchies->components[index];
+		writer.Write(getSlot(hierarchy.parent));
+
+		children.clear();
+		for (ecs::Entity child : hierarchy.childrens)
+		{
+			const uint32_t slot = getSlot(child);
+			if (slot != kInvalidSlot)
+				children.push_back(slot);
+		}
+		writer.Write(static_cast<uint32_t>(children.size()));
+		writer.Write(children.data(), children.size());
+	}
+	writer.Flush(stream, ChunkType::Hierarchy, static_cast<uint32_t>(hierarchyIndices.size()), 0);
+	header.chunkCount++;
+
+	// Patch the chunk count
+	stream.seekp(0);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(SnapshotHeader));
+	Logger::Info("Saved snapshot: " + filename + " (" + std::to_string(entityTable.size()) + " entities)");
+	return stream.good();
+}
+
+bool SceneSnapshot::Load(const std::string& filename, ecs::ComponentManager& components, Resolver& resolver, std::vector<ecs::Entity>* entities)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+		return false;
+
+	const uint8_t* data = file.GetData();
+	const std::size_t size = file.GetSize();
+	if (size < sizeof(SnapshotHeader))
+	{
+		Logger::Error("Invalid snapshot: " + filename);
+		return false;
+	}
+
+	const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(data);
+	if (header->magic != kSnapshotMagic || header->version != kSnapshotVersion)
+	{
+		Logger::Error("Invalid snapshot version: " + filename);
+		return false;
+	}
+
+	// Every entity has a slot in one of the pools at least
+	const uint32_t entityCount = header->entityCount;
+	if (entityCount > (size - sizeof(SnapshotHeader)) / sizeof(uint32_t) || entityCount > ecs::GetAvailableEntityCount())
+	{
+		Logger::Error("Invalid snapshot entity count: " + filename + " (" + std::to_string(entityCount) + " entities)");
+		return false;
+	}
+
+	// Chunk index that last used the slot, an entity appears once per pool
+	std::vector<uint32_t> slotChunks(entityCount, ~0u);
+	auto readSlots = [&](ChunkReader& reader, uint32_t chunk, uint32_t count) -> const uint32_t* {
+		const uint32_t* slots = reader.Read<uint32_t>(count);
+		reader.Align();
+		for (uint32_t i = 0; slots && i < count; ++i)
+		{
+			if (slots[i] >= entityCount || slotChunks[slots[i]] == chunk)
+				return nullptr;
+			slotChunks[slots[i]] = chunk;
+		}
+		return slots;
+	};
+
+	auto readRawPool = [&](ChunkReader& reader, uint32_t chunk, const ChunkHeader& chunkHeader, auto& pool) {
+		using Component = std::remove_const_t<std::remove_pointer_t<decltype(pool.components)>>;
+		if (chunkHeader.elementSize != sizeof(Component))
+			return false;
+		pool.count = chunkHeader.count;
+		pool.slots = readSlots(reader, chunk, pool.count);
+		pool.components = pool.slots ? reader.Read<Component>(pool.count) : nullptr;
+		return pool.components != nullptr || pool.count == 0;
+	};
+
+	SnapshotContent content;
+	uint32_t chunkTypes = 0;
+	bool valid = true;
+	std::size_t offset = sizeof(SnapshotHeader);
+	for (uint32_t chunk = 0; chunk < header->chunkCount && valid; ++chunk)
+	{
+		if (offset + sizeof(ChunkHeader) > size)
+		{
+			valid = false;
+			break;
+		}
+
+		const ChunkHeader* chunkHeader = reinterpret_cast<const ChunkHeader*>(data + offset);
+		offset += sizeof(ChunkHeader);
+		if (chunkHeader->byteSize > size - offset)
+		{
+			valid = false;
+			break;
+		}
+
+		ChunkReader reader(data + offset, chunkHeader->byteSize);
+		const uint32_t count = chunkHeader->count;
+		offset += chunkHeader->byteSize;
+
+		// Writer emits a single chunk of each type
+		const uint32_t typeBit = 1u << (static_cast<uint32_t>(chunkHeader->type) & 31);
+		if (chunkHeader->type <= ChunkType::MeshSource)
+		{
+			valid = (chunkTypes & typeBit) == 0;
+			chunkTypes |= typeBit;
+		}
+
+		switch (chunkHeader->type)
+		{
+		case ChunkType::TextureName:
+			for (uint32_t i = 0; i < count && valid; ++i)
+			{
+				uint32_t texture = 0, length = 0;
+				const char* name = reader.ReadValue(texture) && reader.ReadValue(length) ? reader.Read<char>(length) : nullptr;
+				if (name)
+					content.textureNames[texture].assign(name, length);
+				valid = name != nullptr;
+			}
+			break;
+		case ChunkType::Transform:
+			valid = valid && readRawPool(reader, chunk, *chunkHeader, content.transforms);
+			break;
+		case ChunkType::Light:
+			valid = valid && readRawPool(reader, chunk, *chunkHeader, content.lights);
+			break;
+		case ChunkType::Material:
+			valid = valid && readRawPool(reader, chunk, *chunkHeader, content.materials);
+			break;
+		case ChunkType::MeshSource:
+			for (uint32_t i = 0; i < count && valid; ++i)
+			{
+				MeshSourceRecord record = {};
+				const char* path = reader.ReadValue(record) ? reader.Read<char>(record.pathLength) : nullptr;
+				valid = path != nullptr;
+				if (path == nullptr)
+					break;
+
+				MeshSource& meshSource = content.meshSources.emplace_back();
+				meshSource.filename.assign(path, record.pathLength);
+				meshSource.options.optimizeVertexCache = (record.optionFlags & ImportVertexCache) != 0;
+				meshSource.options.optimizeOverdraw = (record.optionFlags & ImportOverdraw) != 0;
+				meshSource.options.optimizeVertexFetch = (record.optionFlags & ImportVertexFetch) != 0;
+				meshSource.options.compactVertices = (record.optionFlags & ImportCompactVertices) != 0;
+				meshSource.options.overdrawThreshold = record.overdrawThreshold;
+			}
+			break;
+		case ChunkType::MeshRenderer:
+			valid = valid && readRawPool(reader, chunk, *chunkHeader, content.meshRenderers);
+			break;
+		case ChunkType::Name:
+			content.names.count = count;
+			content.names.slots = valid ? readSlots(reader, chunk, count) : nullptr;
+			valid = content.names.slots != nullptr || count == 0;
+			content.nameComponents.resize(valid ? count : 0);
+			for (uint32_t i = 0; i < count && valid; ++i)
+			{
+				uint32_t length = 0;
+				const char* name = reader.ReadValue(length) ? reader.Read<char>(length) : nullptr;
+				if (name)
+					content.nameComponents[i].name.assign(name, length);
+				valid = name != nullptr;
+			}
+			content.names.components = content.nameComponents.data();
+			break;
+		case ChunkType::Hierarchy:
+			content.hierarchies.count = count;
+			content.hierarchies.slots = valid ? readSlots(reader, chunk, count) : nullptr;
+			valid = content.hierarchies.slots != nullptr || count == 0;
+			content.hierarchyRecords.resize(valid ? count : 0);
+			for (uint32_t i = 0; i < count && valid; ++i)
+			{
+				HierarchyRecord& record = content.hierarchyRecords[i];
+				valid = reader.ReadValue(record.parent) && reader.ReadValue(record.childCount);
+				record.children = valid ? reader.Read<uint32_t>(record.childCount) : nullptr;
+				valid = record.children != nullptr && (record.parent == kInvalidSlot || record.parent < entityCount);
+				for (uint32_t child = 0; valid && child < record.childCount; ++child)
+					valid = record.children[child] < entityCount;
+			}
+			content.hierarchies.components = content.hierarchyRecords.data();
+			break;
+		default:
+			// Skip the unknown chunk
+			break;
+		}
+
+		valid = valid && reader.IsValid();
+	}
+
+	// Renderers reference the sources by their index in the file
+	for (uint32_t i = 0; valid && i < content.meshRenderers.count; ++i)
+	{
+		const uint32_t source = content.meshRenderers.components[i].source;
+		valid = source == kInvalidSlot || source < content.meshSources.size();
+	}
+
+	// Children point back to their parent and the parent links don't loop
+	std::vector<uint32_t> parents(valid ? entityCount : 0, kInvalidSlot);
+	for (uint32_t i = 0; valid && i < content.hierarchies.count; ++i)
+		parents[content.hierarchies.slots[i]] = content.hierarchyRecords[i].parent;
+	for (uint32_t i = 0; valid && i < content.hierarchies.count; ++i)
+	{
+		const HierarchyRecord& record = content.hierarchyRecords[i];
+		for (uint32_t child = 0; valid && child < record.childCount; ++child)
+			valid = parents[record.children[child]] == content.hierarchies.slots[i];
+	}
+
+	std::vector<uint8_t> visited(parents.size(), 0);
+	std::vector<uint32_t> path;
+	for (uint32_t slot = 0; valid && slot < parents.size(); ++slot)
+	{
+		// 1 while on the current path, 2 once the path reached a root
+		uint32_t current = slot;
+		for (; current != kInvalidSlot && visited[current] == 0; current = parents[current])
+		{
+			visited[current] = 1;
+			path.push_back(current);
+		}
+		valid = current == kInvalidSlot || visited[current] == 2;
+		for (uint32_t node : path)
+			visited[node] = 2;
+		path.clear();
+	}
+
+	if (!valid)
+	{
+		Logger::Error("Corrupted snapshot: " + filename);
+		return false;
+	}
+
+	std::vector<ecs::Entity> entityTable(entityCount);
+	for (ecs::Entity& entity : entityTable)
+		entity = ecs::CreateEntity();
+
+	std::vector<ecs::Entity> poolEntities;
+	auto addPool = [&](const auto& pool, const auto* poolComponents) {
+		poolEntities.resize(pool.count);
+		for (uint32_t i = 0; i < pool.count; ++i)
+			poolEntities[i] = entityTable[pool.slots[i]];
+		if (pool.count > 0)
+			components.AddComponents(poolEntities.data(), poolComponents, pool.count);
+	};
+
+	addPool(content.transforms, content.transforms.components);
+	addPool(content.lights, content.lights.components);
+
+	std::unordered_map<uint32_t, uint32_t> textureRemap;
+	for (const auto& [texture, name] : content.textureNames)
+		textureRemap[texture] = resolver.LoadTexture(name);
+
+	std::vector<MaterialComponent> materials(content.materials.components, content.materials.components + content.materials.count);
+	for (MaterialComponent& material : materials)
+	{
+		for (uint32_t& texture : material.textures)
+		{
+			auto found = textureRemap.find(texture);
+			texture = found != textureRemap.end() ? found->second : gfx::INVALID_TEXTURE_ID;
+		}
+	}
+	addPool(content.materials, materials.data());
+
+	for (uint32_t i = 0; i < content.meshSources.size(); ++i)
+		resolver.LoadMeshSource(i, content.meshSources[i]);
+
+	std::vector<MeshRenderer> meshRenderers(content.meshRenderers.count);
+	for (uint32_t i = 0; i < content.meshRenderers.count; ++i)
+	{
+		const MeshRendererRecord& record = content.meshRenderers.components[i];
+		MeshRenderer& meshRenderer = meshRenderers[i];
+		const bool resolved = record.source != kInvalidSlot && resolver.SetMeshGeometry(record.source, record.primitive, meshRenderer);
+		meshRenderer.flags = (record.flags & ~kGeometryFlags) | (resolved ? meshRenderer.flags & kGeometryFlags : 0u);
+		if (!resolved)
+			meshRenderer.SetRenderable(false);
+	}
+	addPool(content.meshRenderers, meshRenderers.data());
+
+	addPool(content.names, content.names.components);
+
+	std::vector<HierarchyComponent> hierarchies(content.hierarchies.count);
+	for (uint32_t i = 0; i < content.hierarchies.count; ++i)
+	{
+		const HierarchyRecord& record = content.hierarchyRecords[i];
+		hierarchies[i].parent = record.parent != kInvalidSlot ? entityTable[record.parent] : ecs::INVALID_ENTITY;
+		hierarchies[i].childrens.reserve(record.childCount);
+		for (uint32_t child = 0; child < record.childCount; ++child)
+			hierarchies[i].childrens.push_back(entityTable[record.children[child]]);
+	}
+	addPool(content.hierarchies, hierarchies.data());
+
+	Logger::Info("Loaded snapshot: " + filename + " (" + std::to_string(entityCount) + " entities)");
+	if (entities)
+		*entities = std::move(entityTable);
+	return true;
+}
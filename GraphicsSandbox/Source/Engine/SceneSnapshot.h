@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ECS.h"
+#include "Components.h"
+#include "MeshCache.h"
+
+#include <string>
+#include <vector>
+
+/*
+* Binary snapshot of the entities of a component manager. Texture ids and
+* mesh buffers are session dependent, the resolver translates them to the
+* texture names and the assets the mesh renderers are created from.
+*/
+namespace SceneSnapshot
+{
+	// Asset a mesh renderer is created from, the built-in primitives have no filename
+	struct MeshSource
+	{
+		std::string filename;
+		MeshCache::ImportOptions options;
+	};
+
+	class Resolver
+	{
+	public:
+		virtual ~Resolver() = default;
+
+		virtual std::string GetTextureName(uint32_t texture) = 0;
+		// Returns false if the renderer isn't created from a mesh source
+		virtual bool FindMeshPrimitive(const MeshRenderer& meshRenderer, uint32_t& source, uint32_t& primitive) = 0;
+		virtual const MeshSource& GetMeshSource(uint32_t source) = 0;
+
+		// Loading callbacks are only invoked once the whole file is validated
+		virtual uint32_t LoadTexture(const std::string& name) = 0;
+		// Index is the one referenced by SetMeshGeometry
+		virtual void LoadMeshSource(uint32_t index, const MeshSource& source) = 0;
+		// Returns false if the primitive isn't available, the renderer is then hidden
+		virtual bool SetMeshGeometry(uint32_t source, uint32_t primitive, MeshRenderer& meshRenderer) = 0;
+	};
+
+	// Excluded entities aren't written, neither are the references to them
+	bool Save(const std::string& filename, ecs::ComponentManager& components, Resolver& resolver, const std::vector<ecs::Entity>& excluded = {});
+
+	/*
+	* Created entities are added to the component manager and returned in
+	* entities. Nothing is created when the file is rejected.
+	*/
+	bool Load(const std::string& filename, ecs::ComponentManager& components, Resolver& resolver, std::vector<ecs::Entity>* entities = nullptr);
+}
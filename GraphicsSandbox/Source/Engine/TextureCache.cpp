@@ -4,6 +4,7 @@
 #include "Logger.h"
 #include "ImageLoader.h"
 #include "MeshData.h"
+#include "TransferQueue.h"
 
 #include <vector>
 #include <cassert>
@@ -20,6 +21,14 @@ namespace TextureCache
 	std::vector<std::string> gAllTextureName(1024);
 	gfx::TextureHandle gSolidTexture;
 
+	// Textures uploaded a few rows at a time, added to the cache with the last rows
+	struct PendingUpload
+	{
+		gfx::TextureHandle texture;
+		uint32_t uploadedRows;
+	};
+	std::unordered_map<std::string, PendingUpload> gPendingUploads;
+
 	gfx::TextureHandle GetDefaultTexture()
 	{
 		return gSolidTexture;
@@ -38,7 +47,7 @@ namespace TextureCache
 		return mipLevels;
 	}
 
-	gfx::TextureHandle CreateTexture(unsigned char* pixels, int width, int height, int nChannel, bool generateMipmap)
+	static gfx::TextureHandle AllocateTexture(int width, int height, bool generateMipmap)
 	{
 		gfx::GPUTextureDesc desc;
 		desc.width = width;
@@ -54,11 +63,14 @@ namespace TextureCache
 			desc.samplerInfo.enableAnisotropicFiltering = true;
 		}
 		
-		gfx::GraphicsDevice* device = gfx::GetDevice();
+		return gfx::GetDevice()->CreateTexture(&desc);
+	}
 
-		gfx::TextureHandle texture = device->CreateTexture(&desc);
+	gfx::TextureHandle CreateTexture(unsigned char* pixels, int width, int height, int nChannel, bool generateMipmap)
+	{
+		gfx::TextureHandle texture = AllocateTexture(width, height, generateMipmap);
 		const uint32_t imageDataSize = width * height * nChannel * sizeof(uint8_t);
-		device->CopyTexture(texture, pixels, imageDataSize, 0, 0, true);
+		gfx::GetDevice()->CopyTexture(texture, pixels, imageDataSize, 0, 0, true);
 		return texture;
 	}
 
@@ -121,6 +133,54 @@ namespace TextureCache
 		return texture.handle;
 	}
 
+	bool LoadTextureAsync(const std::string& name, uint32_t width, uint32_t height, const unsigned char* data, uint32_t nChannel, bool generateMipmap, uint32_t& texture)
+	{
+		auto found = gAllTextureIndex.find(name);
+		if (found != gAllTextureIndex.end())
+		{
+			texture = found->second.handle;
+			return true;
+		}
+
+		const uint32_t rowPitch = width * nChannel * sizeof(uint8_t);
+		if (data == nullptr || rowPitch > TransferQueue::GetMaxSize())
+		{
+			// Pixels are only read by the staging copy
+			texture = LoadTexture(name, width, height, const_cast<unsigned char*>(data), nChannel, generateMipmap);
+			return true;
+		}
+
+		auto pending = gPendingUploads.find(name);
+		if (pending == gPendingUploads.end())
+		{
+			if (TransferQueue::GetAvailableSize() < rowPitch)
+				return false;
+
+			Logger::Debug("Loading Texture: " + name);
+			pending = gPendingUploads.emplace(name, PendingUpload{ AllocateTexture(width, height, generateMipmap), 0 }).first;
+		}
+
+		// As many rows as the staging space of this frame holds
+		PendingUpload& upload = pending->second;
+		const uint32_t rowCount = std::min(height - upload.uploadedRows, TransferQueue::GetAvailableSize() / rowPitch);
+		if (rowCount == 0)
+			return false;
+
+		TransferQueue::CopyToTexture(upload.texture, data + upload.uploadedRows * rowPitch, rowCount * rowPitch, upload.uploadedRows, rowCount, generateMipmap);
+		upload.uploadedRows += rowCount;
+		if (upload.uploadedRows < height)
+			return false;
+
+		// Texture is visible to the shaders once all the rows are copied
+		gfx::TextureHandle handle = upload.texture;
+		gPendingUploads.erase(pending);
+		gAllTextureName[handle.handle] = name;
+
+		gAllTextures[handle.handle] = handle;
+		gAllTextureIndex[name] = handle;
+		texture = handle.handle;
+		return true;
+	}
 
 	std::string GetTextureName(uint32_t index)
 	{
@@ -145,6 +205,9 @@ namespace TextureCache
 		device->Destroy(gSolidTexture);
 		for (auto& [key, val] : gAllTextureIndex)
 			device->Destroy(val);
+		for (auto& [key, val] : gPendingUploads)
+			device->Destroy(val.texture);
+		gPendingUploads.clear();
 		gAllTextures.clear();
 		gAllTextureName.clear();
 		gAllTextureIndex.clear();
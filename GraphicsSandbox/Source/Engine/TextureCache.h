@@ -13,6 +13,13 @@ namespace TextureCache
 
 	uint32_t LoadTexture(const std::string& name, uint32_t width, uint32_t height, unsigned char* data, uint32_t nChannel, bool generateMipmap = false);
 
+	/*
+	* Texture is uploaded through the transfer queue, large images are split
+	* over several frames. Returns true once the last rows are queued, call
+	* again with the same data in the next frames until then.
+	*/
+	bool LoadTextureAsync(const std::string& name, uint32_t width, uint32_t height, const unsigned char* data, uint32_t nChannel, bool generateMipmap, uint32_t& texture);
+
 	std::string GetTextureName(uint32_t index);
 
 	gfx::TextureHandle GetDefaultTexture();
@@ -0,0 +1,137 @@
+#include "TransferQueue.h"
+
+#include "GraphicsDevice.h"
+
+#include <cstring>
+#include <vector>
+
+namespace TransferQueue
+{
+	// Device keeps a single frame in flight, the other region is written meanwhile
+	constexpr uint32_t kRegionCount = 2;
+	constexpr uint32_t kRegionSize = 16 * 1024 * 1024;
+	constexpr uint32_t kAlignment = 16;
+
+	struct BufferCopy
+	{
+		gfx::BufferHandle buffer;
+		uint32_t dstOffset;
+		uint32_t srcOffset;
+		uint32_t size;
+	};
+
+	struct TextureCopy
+	{
+		gfx::TextureHandle texture;
+		uint32_t srcOffset;
+		uint32_t firstRow;
+		uint32_t rowCount;
+		bool generateMipmap;
+	};
+
+	gfx::BufferHandle gStagingBuffer = gfx::INVALID_BUFFER;
+	uint8_t* gStagingData = nullptr;
+	uint32_t gRegion = 0;
+	uint32_t gRegionOffset = 0;
+	std::vector<BufferCopy> gBufferCopies;
+	std::vector<TextureCopy> gTextureCopies;
+
+	static bool allocate(const void* data, uint32_t size, uint32_t& srcOffset)
+	{
+		if (gStagingData == nullptr || size > GetAvailableSize())
+			return false;
+
+		srcOffset = gRegion * kRegionSize + gRegionOffset;
+		std::memcpy(gStagingData + srcOffset, data, size);
+		gRegionOffset = (gRegionOffset + size + kAlignment - 1) / kAlignment * kAlignment;
+		return true;
+	}
+
+	void Initialize()
+	{
+		gfx::GraphicsDevice* device = gfx::GetDevice();
+
+		gfx::GPUBufferDesc bufferDesc;
+		bufferDesc.bindFlag = gfx::BindFlag::None;
+		bufferDesc.usage = gfx::Usage::Upload;
+		bufferDesc.size = kRegionCount * kRegionSize;
+		gStagingBuffer = device->CreateBuffer(&bufferDesc);
+		gStagingData = reinterpret_cast<uint8_t*>(device->GetMappedDataPtr(gStagingBuffer));
+		gRegion = 0;
+		gRegionOffset = 0;
+	}
+
+	uint32_t GetAvailableSize()
+	{
+		return gRegionOffset < kRegionSize ? kRegionSize - gRegionOffset : 0;
+	}
+
+	uint32_t GetMaxSize()
+	{
+		return kRegionSize;
+	}
+
+	bool CopyToBuffer(gfx::BufferHandle buffer, const void* data, uint32_t offset, uint32_t size)
+	{
+		uint32_t srcOffset = 0;
+		if (!allocate(data, size, srcOffset))
+			return false;
+
+		gBufferCopies.push_back({ buffer, offset, srcOffset, size });
+		return true;
+	}
+
+	bool CopyToTexture(gfx::TextureHandle texture, const void* data, uint32_t size, uint32_t firstRow, uint32_t rowCount, bool generateMipmap)
+	{
+		uint32_t srcOffset = 0;
+		if (!allocate(data, size, srcOffset))
+			return false;
+
+		gTextureCopies.push_back({ texture, srcOffset, firstRow, rowCount, generateMipmap });
+		return true;
+	}
+
+	void Flush(gfx::CommandList* commandList)
+	{
+		if (gBufferCopies.empty() && gTextureCopies.empty())
+			return;
+
+		gfx::GraphicsDevice* device = gfx::GetDevice();
+		if (!gBufferCopies.empty())
+		{
+			std::vector<gfx::ResourceBarrierInfo> barriers;
+			barriers.reserve(gBufferCopies.size());
+			for (const BufferCopy& copy : gBufferCopies)
+			{
+				device->CopyBuffer(commandList, copy.buffer, gStagingBuffer, copy.dstOffset, copy.srcOffset, copy.size);
+				barriers.push_back(gfx::ResourceBarrierInfo::CreateBufferBarrier(gfx::AccessFlag::TransferWriteBit, gfx::AccessFlag::MemoryRead, copy.buffer, copy.dstOffset, copy.size));
+			}
+
+			// Buffers can be read as vertices, indices or storage by any of the passes
+			gfx::PipelineBarrierInfo barrierInfo = {
+				barriers.data(),
+				static_cast<uint32_t>(barriers.size()),
+				gfx::PipelineStage::Transfer,
+				gfx::PipelineStage::AllCommands
+			};
+			device->PipelineBarrier(commandList, &barrierInfo);
+		}
+
+		for (const TextureCopy& copy : gTextureCopies)
+			device->CopyTexture(commandList, copy.texture, gStagingBuffer, copy.srcOffset, copy.firstRow, copy.rowCount, copy.generateMipmap);
+
+		gBufferCopies.clear();
+		gTextureCopies.clear();
+		gRegion = (gRegion + 1) % kRegionCount;
+		gRegionOffset = 0;
+	}
+
+	void Shutdown()
+	{
+		if (gStagingData != nullptr)
+			gfx::GetDevice()->Destroy(gStagingBuffer);
+		gStagingData = nullptr;
+		gBufferCopies.clear();
+		gTextureCopies.clear();
+	}
+}
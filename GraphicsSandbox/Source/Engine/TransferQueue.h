@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Graphics.h"
+
+#include <cstdint>
+
+namespace gfx {
+	struct CommandList;
+}
+
+/*
+* Staging ring for the uploads that don't wait for the GPU. Copies are
+* queued on the main thread while the render thread is idle and recorded
+* at the start of the next frame by Flush(). The staging buffer is split
+* in one region per frame in flight, so a region is only written again
+* after the frame that read it is finished.
+*/
+namespace TransferQueue
+{
+	void Initialize();
+
+	// Staging space left for the copies of the current frame
+	uint32_t GetAvailableSize();
+
+	// Largest copy that fits in a frame
+	uint32_t GetMaxSize();
+
+	// Returns false if the data doesn't fit in the staging space left for this frame
+	bool CopyToBuffer(gfx::BufferHandle buffer, const void* data, uint32_t offset, uint32_t size);
+
+	/*
+	* Rows of mip 0 starting at firstRow, so a large image can be split over
+	* frames. The other mips are generated with the copy of the last row.
+	*/
+	bool CopyToTexture(gfx::TextureHandle texture, const void* data, uint32_t size, uint32_t firstRow, uint32_t rowCount, bool generateMipmap);
+
+	// Record the queued copies, called by the render thread before the passes
+	void Flush(gfx::CommandList* commandList);
+
+	void Shutdown();
+}
@@ -12,6 +12,7 @@ struct TransformComponent
 	glm::mat4 localMatrix{ 1.0f };
 	glm::mat4 worldMatrix{ 1.0f };
 
+	// Consumed by CalculateWorldMatrix, the scene only updates the transforms marked with MarkModified
 	bool dirty = true;
 	glm::mat4 CalculateWorldMatrix()
 	{
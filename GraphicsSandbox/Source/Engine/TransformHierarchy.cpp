@@ -0,0 +1,167 @@
+#include "TransformHierarchy.h"
+#include "Components.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Dirty nodes of a level updated by a single job, smaller levels stay on the calling thread
+constexpr uint32_t kMinParallelNodes = 1024;
+
+void TransformHierarchy::Build(ecs::ComponentArray<HierarchyComponent>* hierarchies, const TransformStore& store)
+{
+	mNodes.clear();
+	mEntities.clear();
+	mLevels.clear();
+
+	// Roots are the first level
+	for (uint32_t i = 0; i < hierarchies->GetCount(); ++i)
+	{
+		const HierarchyComponent& hierarchy = hierarchies->components[i];
+		if (hierarchy.parent == ecs::INVALID_ENTITY && hierarchy.childrens.size() > 0 && store.GetSlot(hierarchies->entities[i]) != ecs::SparseIndex::kInvalidIndex)
+		{
+			mNodes.push_back({ kInvalidNode, ecs::SparseIndex::kInvalidIndex, 0, 0 });
+			mEntities.push_back(hierarchies->entities[i]);
+		}
+	}
+
+	// Breadth first walk, the children of the current level forms the next level
+	uint32_t levelStart = 0;
+	while (levelStart < mEntities.size())
+	{
+		const uint32_t levelEnd = static_cast<uint32_t>(mEntities.size());
+		mLevels.push_back(levelStart);
+		for (uint32_t node = levelStart; node < levelEnd; ++node)
+		{
+			mNodes[node].firstChild = static_cast<uint32_t>(mNodes.size());
+
+			const HierarchyComponent* hierarchy = hierarchies->getComponent(mEntities[node]);
+			if (hierarchy == nullptr)
+				continue;
+
+			for (ecs::Entity child : hierarchy->childrens)
+			{
+				// Subtree of the entities without transform is skipped
+				if (store.GetSlot(child) == ecs::SparseIndex::kInvalidIndex)
+					continue;
+
+				mNodes.push_back({ node, ecs::SparseIndex::kInvalidIndex, 0, 0 });
+				mEntities.push_back(child);
+			}
+			mNodes[node].childCount = static_cast<uint32_t>(mNodes.size()) - mNodes[node].firstChild;
+		}
+		levelStart = levelEnd;
+	}
+	mLevels.push_back(static_cast<uint32_t>(mEntities.size()));
+
+	resolveSlots(store);
+	mQueued.assign(mNodes.size(), 0);
+	mRebuilt = true;
+}
+
+void TransformHierarchy::Update(TransformStore& store)
+{
+	mUpdatedEntities.clear();
+	if (mNodes.empty())
+		return;
+
+	if (mLayoutVersion != store.GetLayoutVersion())
+		resolveSlots(store);
+
+	// Parent of the nodes could be changed by the rebuild so everything is recomputed
+	mPending.clear();
+	if (mRebuilt)
+	{
+		mPending.resize(mNodes.size());
+		std::iota(mPending.begin(), mPending.end(), 0);
+	}
+	else
+	{
+		for (uint32_t slot : store.GetUpdatedSlots())
+		{
+			const uint32_t node = slot < mSlotToNode.size() ? mSlotToNode[slot] : kInvalidNode;
+			if (node != kInvalidNode)
+				mPending.push_back(node);
+		}
+		std::sort(mPending.begin(), mPending.end());
+	}
+	mRebuilt = false;
+
+	if (mPending.empty())
+		return;
+
+	const glm::mat4* localMatrices = store.GetLocalMatrices();
+	glm::mat4* worldMatrices = store.GetWorldMatrices();
+
+	auto updateNode = [&](uint32_t index) {
+		const Node& node = mNodes[index];
+		const uint32_t parentSlot = mNodes[node.parent].slot;
+		if (parentSlot != ecs::SparseIndex::kInvalidIndex)
+			worldMatrices[node.slot] = worldMatrices[parentSlot] * localMatrices[node.slot];
+		else
+			worldMatrices[node.slot] = localMatrices[node.slot];
+	};
+
+	// mQueue holds the dirty nodes level by level, the children of the
+	// dirty nodes are queued while the level is processed
+	mQueue.clear();
+	std::size_t pending = 0;
+	std::size_t levelBegin = 0;
+	for (uint32_t level = 0; level < GetLevelCount(); ++level)
+	{
+		while (pending < mPending.size() && mPending[pending] < mLevels[level + 1])
+			enqueue(mPending[pending++]);
+
+		const std::size_t levelEnd = mQueue.size();
+		if (levelBegin == levelEnd && pending == mPending.size())
+			break;
+
+		// Roots keep the world matrix computed by TransformStore::Update
+		if (level > 0)
+		{
+			const uint32_t* levelNodes = mQueue.data() + levelBegin;
+			JobSystem::ParallelFor(static_cast<uint32_t>(levelEnd - levelBegin), kMinParallelNodes, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; ++i)
+					updateNode(levelNodes[i]);
+				});
+		}
+
+		for (std::size_t i = levelBegin; i < levelEnd; ++i)
+		{
+			const Node& node = mNodes[mQueue[i]];
+			for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; ++child)
+				enqueue(child);
+		}
+		levelBegin = levelEnd;
+	}
+
+	for (uint32_t node : mQueue)
+	{
+		mQueued[node] = 0;
+		if (node >= mLevels[1])
+			mUpdatedEntities.push_back(mEntities[node]);
+	}
+}
+
+void TransformHierarchy::enqueue(uint32_t node)
+{
+	// Node without transform can only be left by a removed TransformComponent
+	if (mQueued[node] || mNodes[node].slot == ecs::SparseIndex::kInvalidIndex)
+		return;
+
+	mQueued[node] = 1;
+	mQueue.push_back(node);
+}
+
+void TransformHierarchy::resolveSlots(const TransformStore& store)
+{
+	mSlotToNode.assign(store.GetCount(), kInvalidNode);
+	for (uint32_t node = 0; node < mNodes.size(); ++node)
+	{
+		const uint32_t slot = store.GetSlot(mEntities[node]);
+		mNodes[node].slot = slot;
+		if (slot != ecs::SparseIndex::kInvalidIndex)
+			mSlotToNode[slot] = node;
+	}
+	mLayoutVersion = store.GetLayoutVersion();
+}
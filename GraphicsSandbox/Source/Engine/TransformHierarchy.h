@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ECS.h"
+#include "TransformStore.h"
+
+#include <vector>
+
+struct HierarchyComponent;
+
+/*
+* Flattened copy of the scene graph sorted by depth. Every node stores the
+* index of its parent node and the slot of the transform in the TransformStore,
+* the parent of a node is always in the previous level so the world matrices
+* are computed level by level and each level is updated in parallel.
+* Children of a node are contiguous, so only the subtrees below the updated
+* transforms are visited. The node list is only rebuilt when the
+* HierarchyComponent are changed.
+*/
+class TransformHierarchy
+{
+public:
+	static constexpr uint32_t kInvalidNode = ~0u;
+
+	TransformHierarchy() = default;
+	TransformHierarchy(const TransformHierarchy&) = delete;
+	void operator=(const TransformHierarchy&) = delete;
+
+	// Rebuild the node list starting from the root entities of the hierarchy
+	void Build(ecs::ComponentArray<HierarchyComponent>* hierarchies, const TransformStore& store);
+
+	// Propagate the world matrix to the subtree of the updated transforms
+	void Update(TransformStore& store);
+
+	// Child entities whose world matrix is changed by the last Update()
+	const std::vector<ecs::Entity>& GetUpdatedEntities() const { return mUpdatedEntities; }
+
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(mEntities.size()); }
+	uint32_t GetLevelCount() const { return mLevels.empty() ? 0 : static_cast<uint32_t>(mLevels.size() - 1); }
+
+private:
+	struct Node
+	{
+		uint32_t parent;
+		uint32_t slot;
+		uint32_t firstChild;
+		uint32_t childCount;
+	};
+
+	void resolveSlots(const TransformStore& store);
+	void enqueue(uint32_t node);
+
+	std::vector<Node> mNodes;
+	std::vector<ecs::Entity> mEntities;
+	// Offset of the first node of each level, last entry is the node count
+	std::vector<uint32_t> mLevels;
+	std::vector<uint8_t> mQueued;
+	// Nodes of the updated transforms and the dirty nodes in depth order
+	std::vector<uint32_t> mPending;
+	std::vector<uint32_t> mQueue;
+	std::vector<uint32_t> mSlotToNode;
+	std::vector<ecs::Entity> mUpdatedEntities;
+
+	uint32_t mLayoutVersion = 0;
+	bool mRebuilt = false;
+};
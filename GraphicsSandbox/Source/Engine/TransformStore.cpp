@@ -0,0 +1,273 @@
+#include "TransformStore.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define TRANSFORM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Number of dirty transforms computed by a single job, multiple of the SSE width
+constexpr uint32_t kUpdateGrainSize = 4096;
+
+namespace TransformKernel
+{
+	static void ComputeLocalMatrix(const float* px, const float* py, const float* pz,
+		const float* qx, const float* qy, const float* qz, const float* qw,
+		const float* sx, const float* sy, const float* sz,
+		uint32_t slot, glm::mat4& out)
+	{
+		const float x = qx[slot], y = qy[slot], z = qz[slot], w = qw[slot];
+		const float xx = x * x, yy = y * y, zz = z * z;
+		const float xy = x * y, xz = x * z, yz = y * z;
+		const float wx = w * x, wy = w * y, wz = w * z;
+
+		out[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * sx[slot];
+		out[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * sy[slot];
+		out[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * sz[slot];
+		out[3] = glm::vec4(px[slot], py[slot], pz[slot], 1.0f);
+	}
+
+#ifdef TRANSFORM_USE_SSE
+	static inline __m128 Gather(const float* data, const uint32_t* slots)
+	{
+		return _mm_set_ps(data[slots[3]], data[slots[2]], data[slots[1]], data[slots[0]]);
+	}
+
+	// Transpose the component lanes into one column of the four matrices
+	static inline void StoreColumn(__m128 x, __m128 y, __m128 z, __m128 w, const uint32_t* slots, uint32_t column, glm::mat4* out)
+	{
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&out[slots[0]][column][0], x);
+		_mm_storeu_ps(&out[slots[1]][column][0], y);
+		_mm_storeu_ps(&out[slots[2]][column][0], z);
+		_mm_storeu_ps(&out[slots[3]][column][0], w);
+	}
+#endif
+
+	void ComputeLocalMatrices(const float* px, const float* py, const float* pz,
+		const float* qx, const float* qy, const float* qz, const float* qw,
+		const float* sx, const float* sy, const float* sz,
+		const glm::mat4* defaultMatrices, const uint8_t* hasDefaultMatrix,
+		const uint32_t* slots, uint32_t count, glm::mat4* out)
+	{
+		uint32_t i = 0;
+#ifdef TRANSFORM_USE_SSE
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			const uint32_t* s = slots + i;
+			const __m128 x = Gather(qx, s), y = Gather(qy, s), z = Gather(qz, s), w = Gather(qw, s);
+			const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+			const __m128 scaleX = Gather(sx, s);
+			const __m128 scaleY = Gather(sy, s);
+			const __m128 scaleZ = Gather(sz, s);
+
+			// Rotation columns scaled by the corresponding axis
+			__m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX);
+			__m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX);
+			__m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX);
+
+			__m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY);
+			__m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY);
+			__m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY);
+
+			__m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ);
+			__m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ);
+			__m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ);
+
+			StoreColumn(c0x, c0y, c0z, zero, s, 0, out);
+			StoreColumn(c1x, c1y, c1z, zero, s, 1, out);
+			StoreColumn(c2x, c2y, c2z, zero, s, 2, out);
+			StoreColumn(Gather(px, s), Gather(py, s), Gather(pz, s), one, s, 3, out);
+		}
+#endif
+		for (; i < count; ++i)
+			ComputeLocalMatrix(px, py, pz, qx, qy, qz, qw, sx, sy, sz, slots[i], out[slots[i]]);
+
+		// Imported nodes has the default matrix, most of the transforms are identity
+		for (i = 0; i < count; ++i)
+		{
+			const uint32_t slot = slots[i];
+			if (hasDefaultMatrix[slot])
+				out[slot] = out[slot] * defaultMatrices[slot];
+		}
+	}
+}
+
+uint32_t TransformStore::Add(ecs::Entity entity, const TransformComponent& transform)
+{
+	uint32_t slot = GetSlot(entity);
+	if (slot != ecs::SparseIndex::kInvalidIndex)
+	{
+		Set(entity, transform);
+		return slot;
+	}
+
+	slot = static_cast<uint32_t>(mEntities.size());
+	mLookup.set(entity, slot);
+	mEntities.push_back(entity);
+
+	mPositionX.push_back(0.0f); mPositionY.push_back(0.0f); mPositionZ.push_back(0.0f);
+	mRotationX.push_back(0.0f); mRotationY.push_back(0.0f); mRotationZ.push_back(0.0f); mRotationW.push_back(1.0f);
+	mScaleX.push_back(1.0f); mScaleY.push_back(1.0f); mScaleZ.push_back(1.0f);
+	mDefaultMatrices.push_back(glm::mat4(1.0f));
+	mHasDefaultMatrix.push_back(0);
+	mLocalMatrices.push_back(transform.localMatrix);
+	mWorldMatrices.push_back(transform.worldMatrix);
+	mDirty.push_back(0);
+
+	Set(entity, transform);
+	return slot;
+}
+
+void TransformStore::Remove(ecs::Entity entity)
+{
+	const uint32_t slot = GetSlot(entity);
+	if (slot == ecs::SparseIndex::kInvalidIndex)
+		return;
+
+	const uint32_t last = GetCount() - 1;
+	if (mDirty[last])
+		std::replace(mDirtySlots.begin(), mDirtySlots.end(), last, slot);
+	if (mDirty[slot])
+		mDirtySlots.erase(std::find(mDirtySlots.begin(), mDirtySlots.end(), slot));
+	swapSlots(slot, last);
+
+	mLookup.reset(entity);
+	mEntities.pop_back();
+	mPositionX.pop_back(); mPositionY.pop_back(); mPositionZ.pop_back();
+	mRotationX.pop_back(); mRotationY.pop_back(); mRotationZ.pop_back(); mRotationW.pop_back();
+	mScaleX.pop_back(); mScaleY.pop_back(); mScaleZ.pop_back();
+	mDefaultMatrices.pop_back();
+	mHasDefaultMatrix.pop_back();
+	mLocalMatrices.pop_back();
+	mWorldMatrices.pop_back();
+	mDirty.pop_back();
+}
+
+void TransformStore::Set(ecs::Entity entity, const TransformComponent& transform)
+{
+	const uint32_t slot = GetSlot(entity);
+	assert(slot != ecs::SparseIndex::kInvalidIndex);
+
+	mPositionX[slot] = transform.position.x;
+	mPositionY[slot] = transform.position.y;
+	mPositionZ[slot] = transform.position.z;
+	mRotationX[slot] = transform.rotation.x;
+	mRotationY[slot] = transform.rotation.y;
+	mRotationZ[slot] = transform.rotation.z;
+	mRotationW[slot] = transform.rotation.w;
+	mScaleX[slot] = transform.scale.x;
+	mScaleY[slot] = transform.scale.y;
+	mScaleZ[slot] = transform.scale.z;
+	mDefaultMatrices[slot] = transform.defaultMatrix;
+	mHasDefaultMatrix[slot] = transform.defaultMatrix != glm::mat4(1.0f);
+
+	if (!mDirty[slot])
+	{
+		mDirty[slot] = 1;
+		mDirtySlots.push_back(slot);
+	}
+}
+
+void TransformStore::SetWorldMatrix(ecs::Entity entity, const glm::mat4& worldMatrix)
+{
+	const uint32_t slot = GetSlot(entity);
+	if (slot != ecs::SparseIndex::kInvalidIndex)
+		mWorldMatrices[slot] = worldMatrix;
+}
+
+void TransformStore::Update()
+{
+	mUpdatedSlots.clear();
+	if (mDirtySlots.empty())
+		return;
+
+	// Dirty slots are unique so the ranges write to disjoint matrices
+	JobSystem::ParallelFor(static_cast<uint32_t>(mDirtySlots.size()), kUpdateGrainSize, [&](uint32_t begin, uint32_t end) {
+		TransformKernel::ComputeLocalMatrices(mPositionX.data(), mPositionY.data(), mPositionZ.data(),
+			mRotationX.data(), mRotationY.data(), mRotationZ.data(), mRotationW.data(),
+			mScaleX.data(), mScaleY.data(), mScaleZ.data(),
+			mDefaultMatrices.data(), mHasDefaultMatrix.data(),
+			mDirtySlots.data() + begin, end - begin, mLocalMatrices.data());
+
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint32_t slot = mDirtySlots[i];
+			mWorldMatrices[slot] = mLocalMatrices[slot];
+			mDirty[slot] = 0;
+		}
+		});
+	mUpdatedSlots.swap(mDirtySlots);
+	mDirtySlots.clear();
+}
+
+void TransformStore::Reorder(const ecs::Entity* entities, uint32_t count)
+{
+	// Pending dirty slots are remapped after the swap
+	for (uint32_t slot : mDirtySlots)
+		mDirty[slot] = 0;
+	std::vector<ecs::Entity> dirtyEntities;
+	dirtyEntities.reserve(mDirtySlots.size());
+	for (uint32_t slot : mDirtySlots)
+		dirtyEntities.push_back(mEntities[slot]);
+
+	uint32_t target = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t slot = GetSlot(entities[i]);
+		if (slot == ecs::SparseIndex::kInvalidIndex)
+			continue;
+		swapSlots(target++, slot);
+	}
+
+	mDirtySlots.clear();
+	for (ecs::Entity entity : dirtyEntities)
+	{
+		const uint32_t slot = GetSlot(entity);
+		mDirty[slot] = 1;
+		mDirtySlots.push_back(slot);
+	}
+	mUpdatedSlots.clear();
+}
+
+uint32_t TransformStore::GetSlot(ecs::Entity entity) const
+{
+	const uint32_t slot = mLookup.get(entity);
+	if (slot != ecs::SparseIndex::kInvalidIndex && mEntities[slot] == entity)
+		return slot;
+	return ecs::SparseIndex::kInvalidIndex;
+}
+
+void TransformStore::swapSlots(uint32_t lhs, uint32_t rhs)
+{
+	if (lhs == rhs) return;
+
+	mLayoutVersion++;
+	std::swap(mEntities[lhs], mEntities[rhs]);
+	std::swap(mPositionX[lhs], mPositionX[rhs]);
+	std::swap(mPositionY[lhs], mPositionY[rhs]);
+	std::swap(mPositionZ[lhs], mPositionZ[rhs]);
+	std::swap(mRotationX[lhs], mRotationX[rhs]);
+	std::swap(mRotationY[lhs], mRotationY[rhs]);
+	std::swap(mRotationZ[lhs], mRotationZ[rhs]);
+	std::swap(mRotationW[lhs], mRotationW[rhs]);
+	std::swap(mScaleX[lhs], mScaleX[rhs]);
+	std::swap(mScaleY[lhs], mScaleY[rhs]);
+	std::swap(mScaleZ[lhs], mScaleZ[rhs]);
+	std::swap(mDefaultMatrices[lhs], mDefaultMatrices[rhs]);
+	std::swap(mHasDefaultMatrix[lhs], mHasDefaultMatrix[rhs]);
+	std::swap(mLocalMatrices[lhs], mLocalMatrices[rhs]);
+	std::swap(mWorldMatrices[lhs], mWorldMatrices[rhs]);
+	std::swap(mDirty[lhs], mDirty[rhs]);
+
+	mLookup.set(mEntities[lhs], lhs);
+	mLookup.set(mEntities[rhs], rhs);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ECS.h"
+#include "TransformComponent.h"
+
+#include <vector>
+
+/*
+* Structure of arrays copy of the TransformComponent used to compute
+* the local matrices of the dirty transforms four at a time. The world
+* matrices are packed in slot order, Reorder() can move the drawn entities
+* to the front so that the range can be uploaded with a single copy.
+*/
+class TransformStore
+{
+public:
+	TransformStore() = default;
+	TransformStore(const TransformStore&) = delete;
+	void operator=(const TransformStore&) = delete;
+
+	uint32_t Add(ecs::Entity entity, const TransformComponent& transform);
+	void Remove(ecs::Entity entity);
+
+	// Copy the TRS from the component and queue the slot for Update()
+	void Set(ecs::Entity entity, const TransformComponent& transform);
+	void SetWorldMatrix(ecs::Entity entity, const glm::mat4& worldMatrix);
+
+	// Compute the local matrix of all the dirty slots, world matrix is set to the local matrix
+	void Update();
+
+	// Move the entities to the slot [0, count) in the given order
+	void Reorder(const ecs::Entity* entities, uint32_t count);
+
+	uint32_t GetSlot(ecs::Entity entity) const;
+	const glm::mat4& GetLocalMatrix(uint32_t slot) const { return mLocalMatrices[slot]; }
+	const glm::mat4* GetLocalMatrices() const { return mLocalMatrices.data(); }
+	glm::mat4* GetWorldMatrices() { return mWorldMatrices.data(); }
+
+	const std::vector<uint32_t>& GetUpdatedSlots() const { return mUpdatedSlots; }
+	const std::vector<ecs::Entity>& GetEntities() const { return mEntities; }
+	uint32_t GetCount() const { return static_cast<uint32_t>(mEntities.size()); }
+
+	// Incremented every time an existing entity is moved to another slot
+	uint32_t GetLayoutVersion() const { return mLayoutVersion; }
+
+private:
+	void swapSlots(uint32_t lhs, uint32_t rhs);
+
+	ecs::SparseIndex mLookup;
+	std::vector<ecs::Entity> mEntities;
+
+	// TRS streams
+	std::vector<float> mPositionX, mPositionY, mPositionZ;
+	std::vector<float> mRotationX, mRotationY, mRotationZ, mRotationW;
+	std::vector<float> mScaleX, mScaleY, mScaleZ;
+
+	std::vector<glm::mat4> mDefaultMatrices;
+	std::vector<uint8_t> mHasDefaultMatrix;
+	std::vector<glm::mat4> mLocalMatrices;
+	std::vector<glm::mat4> mWorldMatrices;
+
+	std::vector<uint8_t> mDirty;
+	std::vector<uint32_t> mDirtySlots;
+	std::vector<uint32_t> mUpdatedSlots;
+	uint32_t mLayoutVersion = 0;
+};
+
+namespace TransformKernel
+{
+	/*
+	* Build the local matrix T * R * S * defaultMatrix of the given slots,
+	* uses SSE to build four matrices at a time when it is available.
+	*/
+	void ComputeLocalMatrices(const float* px, const float* py, const float* pz,
+		const float* qx, const float* qy, const float* qz, const float* qw,
+		const float* sx, const float* sy, const float* sz,
+		const glm::mat4* defaultMatrices, const uint8_t* hasDefaultMatrix,
+		const uint32_t* slots, uint32_t count, glm::mat4* out);
+};
@@ -157,6 +157,8 @@ namespace gfx {
 			return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         case PipelineStage::DrawIndirect:
             return VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        case PipelineStage::AllCommands:
+            return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
         default:
             assert(!"Undefined pipeline stage flag");
             return VK_PIPELINE_STAGE_NONE;
@@ -211,6 +213,8 @@ namespace gfx {
             return VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
         case AccessFlag::DrawCommandRead:
             return VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        case AccessFlag::MemoryRead:
+            return VK_ACCESS_MEMORY_READ_BIT;
         default:
             assert(!"Undefined Access Flags");
             return VK_ACCESS_NONE;
@@ -1360,6 +1364,7 @@ namespace gfx {
 
         // Enable required features
         features2_.features.multiDrawIndirect = true;
+        features2_.features.drawIndirectFirstInstance = true;
         features2_.features.pipelineStatisticsQuery = true;
         features2_.features.shaderInt16 = true;
         features2_.features.fillModeNonSolid = true;
@@ -2284,6 +2289,13 @@ namespace gfx {
         vkCmdDispatch(cmd->commandBuffer, groupCountX, groupCountY, groupCountZ);
     }
 
+    void VulkanGraphicsDevice::DispatchComputeIndirect(CommandList* commandList, BufferHandle argumentBuffer, uint32_t offset)
+    {
+        auto cmd = GetCommandList(commandList);
+        auto ab = buffers.AccessResource(argumentBuffer.handle);
+        vkCmdDispatchIndirect(cmd->commandBuffer, ab->buffer, offset);
+    }
+
     bool VulkanGraphicsDevice::IsSwapchainReady()
     {
         if (isSwapchainResized())
@@ -2294,11 +2306,11 @@ namespace gfx {
         return true;
     }
 
-    void VulkanGraphicsDevice::BindIndexBuffer(CommandList* commandList, BufferHandle buffer)
+    void VulkanGraphicsDevice::BindIndexBuffer(CommandList* commandList, BufferHandle buffer, IndexType indexType)
     {
         auto cmd = GetCommandList(commandList);
         auto gpuBuffer = buffers.AccessResource(buffer.handle);
-        vkCmdBindIndexBuffer(cmd->commandBuffer, gpuBuffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(cmd->commandBuffer, gpuBuffer->buffer, 0, indexType == IndexType::UInt16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
     }
 
     void VulkanGraphicsDevice::EndRenderPass(CommandList* commandList)
@@ -2477,7 +2489,7 @@ namespace gfx {
         AdvanceFrameCounter();
     }
 
-    void VulkanGraphicsDevice::CopyToBuffer(BufferHandle handle, void* data, uint32_t offset, uint32_t size)
+    void VulkanGraphicsDevice::CopyToBuffer(BufferHandle handle, const void* data, uint32_t offset, uint32_t size)
     {
         VulkanBuffer* buffer = buffers.AccessResource(handle.handle);
         if (data == nullptr)
@@ -2654,7 +2666,18 @@ namespace gfx {
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         VK_CHECK(vkBeginCommandBuffer(stagingCmdBuffer_, &beginInfo));
 
-        VulkanTexture* vkImage = textures.AccessResource(src.handle);
+        recordGenerateMipmap(stagingCmdBuffer_, textures.AccessResource(src.handle), mipCount);
+
+        VK_CHECK(vkEndCommandBuffer(stagingCmdBuffer_));
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &stagingCmdBuffer_;
+        VK_CHECK(vkQueueSubmit(queue_, 1, &submitInfo, VK_NULL_HANDLE));
+        vkDeviceWaitIdle(device_);
+    }
+
+    void VulkanGraphicsDevice::recordGenerateMipmap(VkCommandBuffer commandBuffer, VulkanTexture* vkImage, uint32_t mipCount)
+    {
         if (mipCount > 1)
         {
             int width = vkImage->width;
@@ -2668,7 +2691,7 @@ namespace gfx {
                     vkImage->layout,
                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, i, 0, 1);
 
-                vkCmdPipelineBarrier(stagingCmdBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
                     VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrierInfo);
 
                 VkImageBlit blitRegion = {};
@@ -2683,7 +2706,7 @@ namespace gfx {
                 blitRegion.srcOffsets[1] = { width, height, 1 };
                 blitRegion.dstOffsets[0] = { 0, 0, 0 };
                 blitRegion.dstOffsets[1] = { width >> 1, height >> 1, 1 };
-                vkCmdBlitImage(stagingCmdBuffer_, vkImage->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, vkImage->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_LINEAR);
+                vkCmdBlitImage(commandBuffer, vkImage->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, vkImage->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_LINEAR);
                 width = width >> 1;
                 height = height >> 1;
             }
@@ -2704,10 +2727,10 @@ namespace gfx {
                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
 			};
 
-            vkCmdPipelineBarrier(stagingCmdBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
                 VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrierInfo[0]);
 
-            vkCmdPipelineBarrier(stagingCmdBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                 VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrierInfo[1]);
 
         }
@@ -2720,19 +2743,59 @@ namespace gfx {
                 vkImage->layout,
                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-            vkCmdPipelineBarrier(stagingCmdBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                 VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &barrierInfo);
         }
 
         vkImage->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        VK_CHECK(vkEndCommandBuffer(stagingCmdBuffer_));
-        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &stagingCmdBuffer_;
-        VK_CHECK(vkQueueSubmit(queue_, 1, &submitInfo, VK_NULL_HANDLE));
-        vkDeviceWaitIdle(device_);
     }
 
+    void VulkanGraphicsDevice::CopyBuffer(CommandList* commandList, BufferHandle dst, BufferHandle src, uint32_t dstOffset, uint32_t srcOffset, uint32_t size)
+    {
+        VulkanBuffer* srcBuffer = buffers.AccessResource(src.handle);
+        VulkanBuffer* dstBuffer = buffers.AccessResource(dst.handle);
+
+        auto cmd = GetCommandList(commandList);
+        VkBufferCopy region = { VkDeviceSize(srcOffset), VkDeviceSize(dstOffset), VkDeviceSize(size) };
+        vkCmdCopyBuffer(cmd->commandBuffer, srcBuffer->buffer, dstBuffer->buffer, 1, &region);
+    }
+
+    void VulkanGraphicsDevice::CopyTexture(CommandList* commandList, TextureHandle dst, BufferHandle src, uint32_t srcOffset, uint32_t firstRow, uint32_t rowCount, bool generateMipMap)
+    {
+        VulkanBuffer* from = buffers.AccessResource(src.handle);
+        VulkanTexture* to = textures.AccessResource(dst.handle);
+
+        assert(from != nullptr);
+        assert(to != nullptr);
+        assert(firstRow + rowCount <= to->height);
+
+        // Image stays in TRANSFER_DST layout between the rows copied in the previous frames
+        auto cmd = GetCommandList(commandList);
+        if (to->layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+        {
+            VkImageMemoryBarrier barrier = CreateImageBarrier(to->image,
+                to->imageAspect,
+                VK_ACCESS_NONE,
+                VK_ACCESS_TRANSFER_WRITE_BIT,
+                to->layout,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            vkCmdPipelineBarrier(cmd->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, 0, 0, 0, 1, &barrier);
+            to->layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        }
+
+        VkBufferImageCopy region = {};
+        region.bufferOffset = srcOffset;
+        region.imageSubresource.aspectMask = to->imageAspect;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, static_cast<int32_t>(firstRow), 0 };
+        region.imageExtent = { to->width, rowCount, to->depth };
+        vkCmdCopyBufferToImage(cmd->commandBuffer, from->buffer, to->image, to->layout, 1, &region);
+
+        // Mips are generated once the last rows are copied
+        if (firstRow + rowCount == to->height)
+            recordGenerateMipmap(cmd->commandBuffer, to, generateMipMap ? to->mipLevels : 1);
+    }
 
     void VulkanGraphicsDevice::PipelineBarrier(CommandList* commandList, PipelineBarrierInfo* barriers)
     {
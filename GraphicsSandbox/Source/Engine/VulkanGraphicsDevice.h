@@ -47,11 +47,13 @@ namespace gfx
 
 		void CopyToSwapchain(CommandList* commandList, TextureHandle texture, ImageLayout finalSwapchainImageLayout, uint32_t arrayLevel = 0, uint32_t mipLevel = 0) override;
 
-		void CopyToBuffer(BufferHandle buffer, void* data, uint32_t offset, uint32_t size) override;
+		void CopyToBuffer(BufferHandle buffer, const void* data, uint32_t offset, uint32_t size) override;
 		void CopyBuffer(BufferHandle dst, BufferHandle src, uint32_t dstOffset = 0)                override;
 		void CopyTexture(TextureHandle dst, BufferHandle src, PipelineBarrierInfo* barrier, uint32_t arrayLevel = 0, uint32_t mipLevel = 0) override;
 		void CopyTexture(TextureHandle dst, void* src, uint32_t sizeInByte, uint32_t arrayLevel = 0, uint32_t mipLevel = 0, bool generateMipMap = false) override;
 		void FillBuffer(CommandList* commandList, BufferHandle buffer, uint32_t offset, uint32_t size, uint32_t data = 0) override;
+		void CopyBuffer(CommandList* commandList, BufferHandle dst, BufferHandle src, uint32_t dstOffset, uint32_t srcOffset, uint32_t size) override;
+		void CopyTexture(CommandList* commandList, TextureHandle dst, BufferHandle src, uint32_t srcOffset, uint32_t firstRow, uint32_t rowCount, bool generateMipMap) override;
 		void PipelineBarrier(CommandList* commandList, PipelineBarrierInfo* barriers)          override;
 
 		void* GetMappedDataPtr(BufferHandle buffer) override;
@@ -71,7 +73,7 @@ namespace gfx
 		void PrepareSwapchainForPresent(CommandList* commandList)                                override;
 
 		void BindPipeline(CommandList* commandList, PipelineHandle pipeline)                        override;
-		void BindIndexBuffer(CommandList* commandList, BufferHandle buffer)                      override;
+		void BindIndexBuffer(CommandList* commandList, BufferHandle buffer, IndexType indexType) override;
 
 		void BeginDebugLabel(CommandList* commandList, const char* name, float r = 1.0f, float g = 1.0f, float b = 1.0f, float a = 1.0f) override;
 		void EndDebugLabel(CommandList* commandList) override;
@@ -92,6 +94,7 @@ namespace gfx
 		void DrawMeshTasksIndirectCount(CommandList* commandList, BufferHandle meshDrawBuffer, uint32_t offset, BufferHandle drawCountBuffer, uint32_t drawCountBufferOffset, uint32_t maxDrawCount, uint32_t stride) override;
 
 		void DispatchCompute(CommandList* commandList, uint32_t groupCountX, uint32_t groupCountY, uint32_t workGroupZ)         override;
+		void DispatchComputeIndirect(CommandList* commandList, BufferHandle argumentBuffer, uint32_t offset) override;
 		bool IsSwapchainReady() override;
 
 		VkInstance GetInstance() { return instance_; }
@@ -212,6 +215,9 @@ namespace gfx
 
 		void destroyReleasedResources();
 
+		// Blits the mips of an image in TRANSFER_DST layout and leaves them in SHADER_READ layout
+		void recordGenerateMipmap(VkCommandBuffer commandBuffer, VulkanTexture* vkImage, uint32_t mipCount);
+
 		VkRenderPass createRenderPass(const RenderPassDesc* desc);
 
 		VkPipeline createGraphicsPipeline(VulkanShader& vertexShader,